@@ -0,0 +1,105 @@
+//
+//  EventLatency.swift
+//  NuwaClient
+//
+//  Created by ConradSun on 2026/10/17.
+//
+//  This file tracks how long kext events take to reach NuwaClient.
+//  It keeps latency histograms of the dequeued records and counts the events lost from sequence holes.
+//
+
+import Foundation
+
+/// Histogram of latencies in power of two buckets of microseconds.
+struct LatencyHistogram {
+    // Bucket 0 holds latencies below 1 us, bucket i those below 2^i us, the last one the rest.
+    private(set) var buckets = [UInt64](repeating: 0, count: 24)
+    private(set) var count: UInt64 = 0
+    private(set) var maxLatency: UInt64 = 0
+
+    /// Adds a latency in nanoseconds.
+    mutating func add(_ latency: UInt64) {
+        let micros = latency / 1000
+        let index = micros == 0 ? 0 : min(64 - micros.leadingZeroBitCount, buckets.count - 1)
+        buckets[index] += 1
+        count += 1
+        maxLatency = max(maxLatency, latency)
+    }
+
+    /// Returns the upper bound in microseconds of the bucket holding the percentile, from 0 to 100.
+    func percentile(_ percent: Double) -> UInt64 {
+        let rank = UInt64((Double(count) * percent / 100).rounded(.up))
+        var total: UInt64 = 0
+        for (index, number) in buckets.enumerated() {
+            total += number
+            if total >= rank && number > 0 {
+                return index == buckets.count - 1 ? maxLatency / 1000 : UInt64(1) << index
+            }
+        }
+        return 0
+    }
+
+    var summary: String {
+        return "p50 <= \(percentile(50)) us, p99 <= \(percentile(99)) us, max \(maxLatency / 1000) us"
+    }
+}
+
+/// Latency of the events dequeued from the queues of a type, reported once per interval.
+class EventLatencyTracker {
+    private let name: String
+    private let interval: UInt64
+    // Kext stamps records with the same clock, in nanoseconds since boot.
+    private var windowStart = clock_gettime_nsec_np(CLOCK_UPTIME_RAW)
+    private var nextSequences = [Int: UInt32]()
+    // From the commit in kext, the time spent in the queue.
+    private(set) var queueLatency = LatencyHistogram()
+    // From the event being seen by kext, its handling in kext included.
+    private(set) var eventLatency = LatencyHistogram()
+    private(set) var lostEvents: UInt64 = 0
+
+    init(name: String, interval: TimeInterval = 60) {
+        self.name = name
+        self.interval = UInt64(interval * 1_000_000_000)
+    }
+
+    /// Called when the queues were mapped again, their sequences start over.
+    func resetSequences() {
+        nextSequences.removeAll()
+    }
+
+    /// Adds a record dequeued from the queue at index.
+    func record(_ header: NuwaKextRecordHeader, queue: Int) {
+        let now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW)
+        if let expected = nextSequences[queue] {
+            // A record older than expected is not a hole, the sequence only wraps forwards.
+            let hole = header.sequence &- expected
+            if hole < UInt32.max / 2 {
+                lostEvents += UInt64(hole)
+            }
+        }
+        nextSequences[queue] = header.sequence &+ 1
+
+        if header.uptime != 0 && now >= header.uptime {
+            queueLatency.add(now - header.uptime)
+        }
+        if header.eventUptime != 0 && now >= header.eventUptime {
+            eventLatency.add(now - header.eventUptime)
+        }
+        if now - windowStart >= interval {
+            report()
+            windowStart = now
+        }
+    }
+
+    private func report() {
+        if queueLatency.count > 0 {
+            Logger(.Info, "\(name) latency of \(queueLatency.count) events, in queue \(queueLatency.summary), from event \(eventLatency.summary).")
+        }
+        if lostEvents > 0 {
+            Logger(.Warning, "\(name) queues lost \(lostEvents) events, seen from sequence holes.")
+        }
+        queueLatency = LatencyHistogram()
+        eventLatency = LatencyHistogram()
+        lostEvents = 0
+    }
+}
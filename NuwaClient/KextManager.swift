@@ -18,6 +18,10 @@ class KextManager {
     var isConnected = false
     var userPref = Preferences()
     var delegate: NuwaEventProcessProtocol?
+    // Mute lists last sent to kext with their generation, updates only send what changed.
+    private var muteLists = [UInt32: (generation: UInt64, vnodeIDs: Set<UInt64>)]()
+    // Bumped when kext resized a queue, listeners map their queues again when it changes.
+    private var queueGeneration: UInt32 = 0
     
     private func processConnectionRequest(iterator: io_iterator_t) {
         repeat {
@@ -63,17 +67,50 @@ class KextManager {
         processConnectionRequest(iterator: iterator)
     }
     
-    private func processKextRequests(type: UInt32, address: mach_vm_address_t, recvPort: mach_port_t) {
-        let queueMemory = UnsafeMutablePointer<IODataQueueMemory>.init(bitPattern: UInt(address))
+    // Returns true when the queues were replaced by resizing, after draining them.
+    private func processKextRequests(type: UInt32, queues: [UnsafeMutablePointer<IODataQueueMemory>?], recvPort: mach_port_t, latency: EventLatencyTracker) -> Bool {
+        var record = [UInt8](repeating: 0, count: Int(kMaxEventRecordSize))
+        // Notify events start with the critical lane, ahead of the bulk rings.
+        let prioritized = type == kQueueTypeCritical.rawValue ? 1 : 0
+        let generation = queueGeneration
+        var isRetired = false
         
         repeat {
-            var dataSize = UInt32(MemoryLayout<NuwaKextEvent>.size)
-            while IODataQueueDataAvailable(queueMemory) {
-                var kextEvent = NuwaKextEvent()
-                let result = IODataQueueDequeue(queueMemory, &kextEvent, &dataSize)
+            // Read before draining, so nothing reaches the queues after the last drain once it is set.
+            isRetired = generation != queueGeneration
+            while let index = nextQueueToDequeue(queues: queues, prioritized: prioritized) {
+                var dataSize = UInt32(record.count)
+                let result = IODataQueueDequeue(queues[index], &record, &dataSize)
                 if result != kIOReturnSuccess {
                     Logger(.Error, "Failed to dequeue data [\(String.init(format: "0x%x", result))].")
-                    return
+                    return false
+                }
+                var header = NuwaKextRecordHeader()
+                if readRecordHeader(record, dataSize, &header) {
+                    latency.record(header, queue: index)
+                }
+                var kextEvent = NuwaKextEvent()
+                if decodeEventRecord(record, dataSize, &kextEvent) == 0 {
+                    Logger(.Error, "Failed to decode event record of \(dataSize) bytes.")
+                    continue
+                }
+                if kextEvent.eventType == kActionNull {
+                    // Given up by the kext after other events were queued behind it.
+                    continue
+                }
+                if let count = getRecordValue(record, size: dataSize, type: kRecordFieldSkipped) {
+                    Logger(.Debug, "\(count) events of type \(kextEvent.eventType.rawValue) were skipped by kext before this one.")
+                }
+                let repeats = getRecordValue(record, size: dataSize, type: kRecordFieldRepeats) ?? 0
+                if kextEvent.eventType == kActionNotifyThrottle {
+                    reportThrottledEvents(record, size: dataSize, pid: kextEvent.mainProcess.pid)
+                    continue
+                }
+                var pathLength: UInt32 = 0
+                if repeats != 0 && findRecordField(record, dataSize, UInt16(kRecordFieldPath.rawValue), &pathLength) == nil {
+                    // Repeats left when the event expired in kext, only the process and file are known.
+                    Logger(.Info, "Event \(kextEvent.eventType.rawValue) of pid \(kextEvent.mainProcess.pid) on file \(kextEvent.vnodeID) repeated \(repeats) more times.")
+                    continue
                 }
                 
                 switch type {
@@ -81,23 +118,75 @@ class KextManager {
                     authEventQueue.async {
                         self.processAuthEvent(&kextEvent)
                     }
-                case kQueueTypeNotify.rawValue:
+                case kQueueTypeCritical.rawValue, kQueueTypeNotify.rawValue:
                     notifyEventQueue.async {
-                        self.processNotifyEvent(&kextEvent)
+                        self.processNotifyEvent(&kextEvent, repeats: repeats)
                     }
                 default:
                     break
                 }
             }
             
-            if IODataQueueWaitForAvailableData(queueMemory, recvPort) != kIOReturnSuccess {
+            if isRetired {
+                return true
+            }
+            
+            // All queues of the type share the port, any of them wakes it up, the new ones after resizing too.
+            if IODataQueueWaitForAvailableData(queues[0], recvPort) != kIOReturnSuccess {
                 Logger(.Error, "Failed to wait for data available.")
-                return
+                return false
             }
         } while isConnected
+        return false
+    }
+    
+    // Reads a UInt32 field of a record, nil if the record has none.
+    private func getRecordValue(_ record: [UInt8], size: UInt32, type: NuwaKextRecordFieldType) -> UInt32? {
+        var length: UInt32 = 0
+        guard let data = findRecordField(record, size, UInt16(type.rawValue), &length),
+              length == UInt32(MemoryLayout<UInt32>.size) else {
+            return nil
+        }
+        var value: UInt32 = 0
+        memcpy(&value, data, MemoryLayout<UInt32>.size)
+        return value
     }
     
-    func listenRequestsForType(type: UInt32) {
+    // Logs the events of a process suppressed by the rate limit of kext since its last summary.
+    private func reportThrottledEvents(_ record: [UInt8], size: UInt32, pid: Int32) {
+        var length: UInt32 = 0
+        var counts = [UInt32](repeating: 0, count: Int(kEventClassCount))
+        guard let data = findRecordField(record, size, UInt16(kRecordFieldThrottled.rawValue), &length),
+              length == UInt32(MemoryLayout<UInt32>.stride * counts.count) else {
+            return
+        }
+        memcpy(&counts, data, Int(length))
+        Logger(.Warning, "Events of pid \(pid) are throttled by kext, suppressed per class \(counts).")
+    }
+    
+    // Prioritized queues are drained first in order, the others are merged by commit time, the oldest head going first.
+    private func nextQueueToDequeue(queues: [UnsafeMutablePointer<IODataQueueMemory>?], prioritized: Int) -> Int? {
+        var oldestQueue: Int?
+        var oldestUptime = UInt64.max
+        
+        for index in 0..<min(prioritized, queues.count) where IODataQueuePeek(queues[index]) != nil {
+            return index
+        }
+        for index in prioritized..<queues.count {
+            guard let entry = IODataQueuePeek(queues[index]) else {
+                continue
+            }
+            let data = UnsafeRawPointer(entry).advanced(by: MemoryLayout<UInt32>.size)
+            let uptime = getRecordUptime(data, entry.pointee.size)
+            if oldestQueue == nil || uptime < oldestUptime {
+                oldestQueue = index
+                oldestUptime = uptime
+            }
+        }
+        return oldestQueue
+    }
+    
+    func listenRequestsForType(type: UInt32, count: UInt32 = 1) {
         while !isConnected {
             usleep(1000000)
         }
@@ -108,24 +197,40 @@ class KextManager {
                 Logger(.Error, "Failed to allocate notification port.")
                 return
             }
-            var result = IOConnectSetNotificationPort(self.connection, type, recvPort, 0)
-            if result != kIOReturnSuccess {
-                Logger(.Error, "Failed to register notification port [\(String.init(format: "0x%x", result))].")
-                mach_port_deallocate(mach_task_self_, recvPort)
-                return
-            }
             
-            var address: mach_vm_address_t = 0
-            var size: mach_vm_size_t = 0
-            result = IOConnectMapMemory(self.connection, type, mach_task_self_, &address, &size, kIOMapAnywhere)
-            if result != kIOReturnSuccess {
-                Logger(.Error, "Failed to map memory [\(String.init(format: "0x%x", result))].")
-                mach_port_deallocate(mach_task_self_, recvPort)
-                return
-            }
-            
-            self.processKextRequests(type: type, address: address, recvPort: recvPort)
-            IOConnectUnmapMemory(self.connection, type, mach_task_self_, address)
+            let latency = EventLatencyTracker(name: type == kQueueTypeAuth.rawValue ? "Auth" : "Notify")
+            var isResized = false
+            repeat {
+                var addresses = [mach_vm_address_t]()
+                var queues = [UnsafeMutablePointer<IODataQueueMemory>?]()
+                for index in 0..<count {
+                    var result = IOConnectSetNotificationPort(self.connection, type + index, recvPort, 0)
+                    if result != kIOReturnSuccess {
+                        Logger(.Error, "Failed to register notification port [\(String.init(format: "0x%x", result))].")
+                        break
+                    }
+                    
+                    var address: mach_vm_address_t = 0
+                    var size: mach_vm_size_t = 0
+                    result = IOConnectMapMemory(self.connection, type + index, mach_task_self_, &address, &size, kIOMapAnywhere)
+                    if result != kIOReturnSuccess {
+                        Logger(.Error, "Failed to map memory [\(String.init(format: "0x%x", result))].")
+                        break
+                    }
+                    addresses.append(address)
+                    queues.append(UnsafeMutablePointer<IODataQueueMemory>.init(bitPattern: UInt(address)))
+                }
+                
+                isResized = false
+                if addresses.count == Int(count) {
+                    // New queues number their records from the start.
+                    latency.resetSequences()
+                    isResized = self.processKextRequests(type: type, queues: queues, recvPort: recvPort, latency: latency)
+                }
+                for (index, address) in addresses.enumerated() {
+                    IOConnectUnmapMemory(self.connection, type + UInt32(index), mach_task_self_, address)
+                }
+            } while isResized
             mach_port_deallocate(mach_task_self_, recvPort)
         }
     }
@@ -166,7 +271,7 @@ extension KextManager {
         }
     }
     
-    func processNotifyEvent(_ event: inout NuwaKextEvent) {
+    func processNotifyEvent(_ event: inout NuwaKextEvent, repeats: UInt32 = 0) {
         var nuwaEvent = NuwaEventInfo()
         
         switch event.eventType {
@@ -209,6 +314,10 @@ extension KextManager {
         nuwaEvent.pid = event.mainProcess.pid
         nuwaEvent.ppid = event.mainProcess.ppid
         nuwaEvent.setUserName(uid: event.mainProcess.euid)
+        if repeats != 0 {
+            // Same event of the same process and file, coalesced by kext since the previous one.
+            nuwaEvent.props[PropRepeatCount] = String(repeats)
+        }
         
         if nuwaEvent.eventType == .ProcessCreate {
             nuwaEvent.fillProcCurrentDir { error in
@@ -261,7 +370,8 @@ extension KextManager: NuwaEventProviderProtocol {
         waitForDriver(matchingDict: service)
         
         listenRequestsForType(type: kQueueTypeAuth.rawValue)
-        listenRequestsForType(type: kQueueTypeNotify.rawValue)
+        // The critical lane and the bulk rings follow each other, so they are listened to together.
+        listenRequestsForType(type: kQueueTypeCritical.rawValue, count: 1 + kNotifyRingCount)
         return isConnected
     }
     
@@ -288,6 +398,93 @@ extension KextManager: NuwaEventProviderProtocol {
         Logger(.Info, "Log level is setted to \(NuwaLog.logLevel)")
         return true
     }
+
+    func setWakeupCoalescing(events: UInt32, delay: UInt32) -> Bool {
+        // Notify events wake us up once per batch, at most delay microseconds late.
+        let scalar: [UInt64] = [UInt64(events), UInt64(delay)]
+        let result = IOConnectCallScalarMethod(connection, kNuwaUserClientSetWakeupCoalescing.rawValue, scalar, 2, nil, nil)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to set wakeup coalescing for kext [\(String.init(format: "0x%x", result))].")
+            return false
+        }
+        Logger(.Info, "Wakeup is setted to be after \(events) events or \(delay) us")
+        return true
+    }
+    
+    func setCriticalClasses(mask: UInt32) -> Bool {
+        let scalar: [UInt64] = [UInt64(mask)]
+        let result = IOConnectCallScalarMethod(connection, kNuwaUserClientSetCriticalClasses.rawValue, scalar, 1, nil, nil)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to set critical classes for kext [\(String.init(format: "0x%x", result))].")
+            return false
+        }
+        Logger(.Info, "Critical classes are setted to \(String.init(format: "0x%x", mask))")
+        return true
+    }
+    
+    func setRateLimit(mask: UInt32, rate: UInt32, burst: UInt32) -> Bool {
+        // Each process gets rate events per second of each class in mask after a burst, rate 0 lifts the limit.
+        let scalar: [UInt64] = [UInt64(mask), UInt64(rate), UInt64(burst)]
+        let result = IOConnectCallScalarMethod(connection, kNuwaUserClientSetRateLimit.rawValue, scalar, 3, nil, nil)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to set rate limit for kext [\(String.init(format: "0x%x", result))].")
+            return false
+        }
+        Logger(.Info, "Rate limit of \(String.init(format: "0x%x", mask)) is setted to \(rate)/s burst \(burst)")
+        return true
+    }
+    
+    func setQueueSize(type: NuwaKextQueue, entries: UInt32) -> UInt32? {
+        // kQueueTypeNotify resizes all the bulk rings, sharing the entries.
+        let scalar: [UInt64] = [UInt64(type.rawValue), UInt64(entries)]
+        var output: UInt64 = 0
+        var outputCount: UInt32 = 1
+        let result = IOConnectCallScalarMethod(connection, kNuwaUserClientSetQueueSize.rawValue, scalar, 2, &output, &outputCount)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to set queue size for kext [\(String.init(format: "0x%x", result))].")
+            return nil
+        }
+        // The old queues are drained by the listeners, then they map the new ones.
+        queueGeneration &+= 1
+        Logger(.Info, "Queue of type \(type.rawValue) is resized to \(output) entries")
+        return UInt32(output)
+    }
+    
+    func setCacheCapacity(type: NuwaKextCacheType, capacity: UInt32) -> Bool {
+        // Only kCacheTypePortBind and kCacheTypeDnsOut, the others keep kMaxCacheItems.
+        let scalar: [UInt64] = [UInt64(type.rawValue), UInt64(capacity)]
+        let result = IOConnectCallScalarMethod(connection, kNuwaUserClientSetCacheCapacity.rawValue, scalar, 2, nil, nil)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to set cache capacity for kext [\(String.init(format: "0x%x", result))].")
+            return false
+        }
+        Logger(.Info, "Capacity of cache \(type.rawValue) is setted to \(capacity) items")
+        return true
+    }
+    
+    func getEventCounters() -> [NuwaKextEventCounters]? {
+        var counters = [NuwaKextEventCounters](repeating: NuwaKextEventCounters(), count: Int(kEventClassCount))
+        var size = MemoryLayout<NuwaKextEventCounters>.stride * counters.count
+        let result = IOConnectCallStructMethod(connection, kNuwaUserClientGetEventCounters.rawValue, nil, 0, &counters, &size)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to get event counters from kext [\(String.init(format: "0x%x", result))].")
+            return nil
+        }
+        // Indexed by the bit of the event class in NuwaKextSubscription.
+        return Array(counters.prefix(size / MemoryLayout<NuwaKextEventCounters>.stride))
+    }
+    
+    func getCacheCounters() -> [NuwaKextCacheCounters]? {
+        var counters = [NuwaKextCacheCounters](repeating: NuwaKextCacheCounters(), count: Int(kCacheTypeCount))
+        var size = MemoryLayout<NuwaKextCacheCounters>.stride * counters.count
+        let result = IOConnectCallStructMethod(connection, kNuwaUserClientGetCacheCounters.rawValue, nil, 0, &counters, &size)
+        if result != KERN_SUCCESS {
+            Logger(.Error, "Failed to get cache counters from kext [\(String.init(format: "0x%x", result))].")
+            return nil
+        }
+        // Indexed by NuwaKextCacheType.
+        return Array(counters.prefix(size / MemoryLayout<NuwaKextCacheCounters>.stride))
+    }
     
     func replyAuthEvent(eventID: UInt64, isAllowed: Bool) -> Bool {
         guard eventID != 0 else {
@@ -310,24 +507,96 @@ extension KextManager: NuwaEventProviderProtocol {
     }
     
     func udpateMuteList(list: [String], type: NuwaMuteType) -> Bool {
-        var result = KERN_SUCCESS
-        var muteInfo = NuwaKextMuteInfo()
-        muteInfo.muteType.rawValue = UInt32(type.rawValue)
-        withUnsafeMutablePointer(to: &muteInfo.vnodeIDs) { pointer in
-            let vnodePtr = UnsafeMutableRawPointer(pointer).assumingMemoryBound(to: UInt64.self)
-            for i in 0 ..< list.count {
-                if i >= kMaxCacheItems {
-                    break
-                }
-                vnodePtr[i] = getFileVnodeID(list[i])
+        let muteType = UInt32(type.rawValue)
+        if type == .FilterFileByFilePath || type == .FilterFileByProcPath {
+            // Directories are muted with everything below them by path prefix.
+            if !sendMutePaths(type: muteType, paths: list) {
+                return false
+            }
+            if type == .FilterFileByProcPath {
+                return true
             }
         }
+        let vnodeIDs = Set(list.map { getFileVnodeID($0) }.filter { $0 != 0 })
         
-        result = IOConnectCallStructMethod(connection, kNuwaUserClientUpdateMuteList.rawValue, &muteInfo, MemoryLayout<NuwaKextMuteInfo>.size, nil, nil)
+        if let sent = muteLists[muteType] {
+            let adds = Array(vnodeIDs.subtracting(sent.vnodeIDs))
+            let removes = Array(sent.vnodeIDs.subtracting(vnodeIDs))
+            if sendMuteDelta(type: muteType, vnodeIDs: vnodeIDs, generation: sent.generation, adds: adds, removes: removes, reset: false) {
+                return true
+            }
+        }
+        // First update, or the list in kext changed meanwhile, send it as a whole.
+        return sendMuteDelta(type: muteType, vnodeIDs: vnodeIDs, generation: 0, adds: Array(vnodeIDs), removes: [], reset: true)
+    }
+    
+    private func sendMutePaths(type: UInt32, paths: [String]) -> Bool {
+        var packed = Data()
+        for path in paths where path.hasPrefix("/") {
+            packed.append(contentsOf: path.utf8)
+            packed.append(0)
+        }
+        if packed.count > Int(kMaxMutePathsSize) {
+            Logger(.Error, "Too many paths to mute [\(packed.count) bytes].")
+            return false
+        }
+        
+        var info = NuwaKextMutePaths()
+        info.muteType.rawValue = type
+        info.size = UInt32(packed.count)
+        var input = Data(bytes: &info, count: MemoryLayout<NuwaKextMutePaths>.size)
+        input.append(packed)
+        
+        let result = input.withUnsafeBytes { pointer in
+            IOConnectCallStructMethod(connection, kNuwaUserClientUpdateMutePaths.rawValue, pointer.baseAddress, input.count, nil, nil)
+        }
         if result != KERN_SUCCESS {
-            Logger(.Error, "Failed to add mute info to list [\(String.init(format: "0x%x", result))].")
+            Logger(.Error, "Failed to update mute paths [\(String.init(format: "0x%x", result))].")
             return false
         }
         return true
     }
+    
+    private func sendMuteDelta(type: UInt32, vnodeIDs: Set<UInt64>, generation: UInt64, adds: [UInt64], removes: [UInt64], reset: Bool) -> Bool {
+        var addIndex = 0
+        var removeIndex = 0
+        var generation = generation
+        var flags: UInt32 = 0
+        
+        repeat {
+            let addCount = min(adds.count - addIndex, Int(kMaxMuteDeltaItems))
+            let removeCount = min(removes.count - removeIndex, Int(kMaxMuteDeltaItems) - addCount)
+            flags = 0
+            if addIndex == 0 && removeIndex == 0 {
+                flags |= kMuteDeltaBegin.rawValue | (reset ? kMuteDeltaReset.rawValue : 0)
+            }
+            if addIndex + addCount == adds.count && removeIndex + removeCount == removes.count {
+                flags |= kMuteDeltaCommit.rawValue
+            }
+            
+            var delta = NuwaKextMuteDelta()
+            delta.muteType.rawValue = type
+            delta.flags = flags
+            delta.generation = generation
+            delta.addCount = UInt32(addCount)
+            delta.removeCount = UInt32(removeCount)
+            var chunk = Data(bytes: &delta, count: MemoryLayout<NuwaKextMuteDelta>.size)
+            adds[addIndex ..< addIndex + addCount].withUnsafeBytes { chunk.append(contentsOf: $0) }
+            removes[removeIndex ..< removeIndex + removeCount].withUnsafeBytes { chunk.append(contentsOf: $0) }
+            
+            var outputCount: UInt32 = 1
+            let result = chunk.withUnsafeBytes { pointer in
+                IOConnectCallMethod(connection, kNuwaUserClientUpdateMuteDelta.rawValue, nil, 0, pointer.baseAddress, chunk.count, &generation, &outputCount, nil, nil)
+            }
+            if result != KERN_SUCCESS {
+                Logger(.Error, "Failed to update mute list [\(String.init(format: "0x%x", result))].")
+                return false
+            }
+            addIndex += addCount
+            removeIndex += removeCount
+        } while flags & kMuteDeltaCommit.rawValue == 0
+        
+        muteLists[type] = (generation, vnodeIDs)
+        return true
+    }
 }
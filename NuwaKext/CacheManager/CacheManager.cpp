@@ -17,20 +17,22 @@ lck_grp_t *g_driverLockGrp = lck_grp_alloc_init("nuwa-locks", g_driverLockGrpAtt
 CacheManager* CacheManager::m_sharedInstance = nullptr;
 
 bool CacheManager::init() {
-    // Pair VnodeID: Auth Result
-    m_authResultCache = new DriverCache<UInt64, UInt8>(kMaxCacheItems);
+    // Pair VnodeID: Auth Result, written on every exec so keep it allocation free
+    m_authResultCache = new FlatCache<UInt64, UInt8>(kMaxCacheItems);
     if (m_authResultCache == nullptr) {
         return false;
     }
     m_authResultCache->zero = 0;
+    m_authResultCache->setLifetime(kAuthResultCacheLifetime);
     
-    // Pair VnodeID: pid-32bit|ppid-32bit
-    m_authExecCache = new DriverCache<UInt64, UInt64>(kMaxCacheItems);
+    // Pair VnodeID: pid-32bit|ppid-32bit, written on every exec so keep it allocation free
+    m_authExecCache = new FlatCache<UInt64, UInt64>(kMaxCacheItems);
     if (m_authExecCache == nullptr) {
         free();
         return false;
     }
     m_authExecCache->zero = 0;
+    m_authExecCache->setLifetime(kAuthExecCacheLifetime);
     
     // Pair Port: pid-32bit|ppid-32bit
     m_portBindCache = new DriverCache<UInt16, UInt64>(kMaxCacheItems);
@@ -39,6 +41,7 @@ bool CacheManager::init() {
         return false;
     }
     m_portBindCache->zero = 0;
+    m_portBindCache->setLifetime(kPortBindCacheLifetime);
     
     // Pair Addr: pid-32bit|ppid-32bit
     m_dnsOutCache = new DriverCache<UInt64, UInt64>(kMaxCacheItems);
@@ -47,6 +50,17 @@ bool CacheManager::init() {
         return false;
     }
     m_dnsOutCache->zero = 0;
+    m_dnsOutCache->setLifetime(kDnsOutCacheLifetime);
+    
+    // Pair Type|Pid|VnodeID: count of the event, written on every file event so keep it allocation free
+    m_eventRepeatCache = new EventRepeatCache(kMaxCacheItems);
+    if (m_eventRepeatCache == nullptr) {
+        free();
+        return false;
+    }
+    m_eventRepeatCache->zero = 0;
+    m_eventRepeatCache->setLifetime(kEventRepeatCacheLifetime);
+    m_eventRepeatLifetime = kEventRepeatCacheLifetime;
 
     return true;
 }
@@ -68,6 +82,10 @@ void CacheManager::free() {
         delete m_dnsOutCache;
         m_dnsOutCache = nullptr;
     }
+    if (m_eventRepeatCache != nullptr) {
+        delete m_eventRepeatCache;
+        m_eventRepeatCache = nullptr;
+    }
 }
 
 CacheManager *CacheManager::getInstance() {
@@ -130,6 +148,18 @@ bool CacheManager::updateDnsOutCache(UInt64 addr, UInt64 value) {
     return m_dnsOutCache->setObject(addr, value);
 }
 
+bool CacheManager::updateEventRepeatCache(NuwaKextAction action, UInt32 pid, UInt64 vnodeID, UInt32 *repeats,
+                                          EventRepeatEntry *dropped, UInt32 *dropCount) {
+    *repeats = 0;
+    if (vnodeID == 0 || m_eventRepeatLifetime == 0) {
+        *dropCount = 0;
+        return false;
+    }
+    
+    EventRepeatKey key = { vnodeID, pid, (UInt32)action };
+    return countEventRepeat(m_eventRepeatCache, key, repeats, dropped, dropCount);
+}
+
 UInt8 CacheManager::obtainAuthResultCache(UInt64 vnodeID) {
     if (vnodeID == 0) {
         return 0;
@@ -160,3 +190,60 @@ UInt64 CacheManager::obtainDnsOutCache(UInt64 addr) {
     
     return m_dnsOutCache->getObject(addr);
 }
+
+bool CacheManager::setCacheLifetime(NuwaKextCacheType type, UInt32 milliseconds) {
+    switch (type) {
+        case kCacheTypeAuthResult:
+            m_authResultCache->setLifetime(milliseconds);
+            break;
+        case kCacheTypeAuthExec:
+            m_authExecCache->setLifetime(milliseconds);
+            break;
+        case kCacheTypePortBind:
+            m_portBindCache->setLifetime(milliseconds);
+            break;
+        case kCacheTypeDnsOut:
+            m_dnsOutCache->setLifetime(milliseconds);
+            break;
+        case kCacheTypeEventRepeat:
+            m_eventRepeatCache->setLifetime(milliseconds);
+            m_eventRepeatLifetime = milliseconds;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool CacheManager::setCacheCapacity(NuwaKextCacheType type, UInt32 capacity) {
+    // The flat caches take their slots once, sized by kMaxCacheItems.
+    switch (type) {
+        case kCacheTypePortBind:
+            m_portBindCache->setCapacity(capacity);
+            break;
+        case kCacheTypeDnsOut:
+            m_dnsOutCache->setCapacity(capacity);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+UInt32 CacheManager::obtainCacheCounters(NuwaKextCacheCounters *counters, UInt32 count) const {
+    CacheStatistics stats[kCacheTypeCount];
+    m_authResultCache->getStatistics(&stats[kCacheTypeAuthResult]);
+    m_authExecCache->getStatistics(&stats[kCacheTypeAuthExec]);
+    m_portBindCache->getStatistics(&stats[kCacheTypePortBind]);
+    m_dnsOutCache->getStatistics(&stats[kCacheTypeDnsOut]);
+    m_eventRepeatCache->getStatistics(&stats[kCacheTypeEventRepeat]);
+    
+    count = count < kCacheTypeCount ? count : kCacheTypeCount;
+    for (UInt32 i = 0; i < count; ++i) {
+        counters[i].hits = stats[i].hits;
+        counters[i].misses = stats[i].misses;
+        counters[i].evictions = stats[i].evictions;
+        counters[i].expirations = stats[i].expirations;
+    }
+    return count;
+}
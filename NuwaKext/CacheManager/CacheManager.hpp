@@ -9,6 +9,9 @@
 #define CacheManager_hpp
 
 #include "DriverCache.hpp"
+#include "FlatCache.hpp"
+#include "EventRepeats.hpp"
+#include "KextCommon.hpp"
 
 class CacheManager {
 
@@ -31,6 +34,20 @@ public:
     // Called when update the cache for outbound flow.
     bool updateDnsOutCache(UInt64 addr, UInt64 value);
     
+    /**
+     * @brief Count the event in the cache for repeated events, the first one of each lifetime is sent
+     
+     * @param action    type of the event
+     * @param pid       pid of the process
+     * @param vnodeID   ID of the file
+     * @param repeats   set to the repeats coalesced since the previous one sent, when this one is sent
+     * @param dropped   filled with other events expired or evicted meanwhile, with repeats still to send
+     * @param dropCount room of dropped, at least kMaxDroppedRepeats, set to the number of events filled
+     * @return          true if the event repeats one sent within the lifetime and is coalesced
+     */
+    bool updateEventRepeatCache(NuwaKextAction action, UInt32 pid, UInt64 vnodeID, UInt32 *repeats,
+                                EventRepeatEntry *dropped, UInt32 *dropCount);
+    
     // Called when obtain the result from auth result cache.
     UInt8 obtainAuthResultCache(UInt64 vnodeID);
     
@@ -43,15 +60,26 @@ public:
     // Called when obtain the result outbound cache.
     UInt64 obtainDnsOutCache(UInt64 addr);
     
+    // Called when set how long the entries of a cache stay valid.
+    bool setCacheLifetime(NuwaKextCacheType type, UInt32 milliseconds);
+    
+    // Called when set the max number of items of a cache, only those growing with their items.
+    bool setCacheCapacity(NuwaKextCacheType type, UInt32 capacity);
+    
+    // Called when obtain the counters of the caches, returns the number filled.
+    UInt32 obtainCacheCounters(NuwaKextCacheCounters *counters, UInt32 count) const;
+    
 private:
     bool init();
     void free();
     
     static CacheManager *m_sharedInstance;
-    DriverCache<UInt64, UInt8> *m_authResultCache;
-    DriverCache<UInt64, UInt64> *m_authExecCache;
+    FlatCache<UInt64, UInt8> *m_authResultCache;
+    FlatCache<UInt64, UInt64> *m_authExecCache;
     DriverCache<UInt16, UInt64> *m_portBindCache;
     DriverCache<UInt64, UInt64> *m_dnsOutCache;
+    EventRepeatCache *m_eventRepeatCache;
+    UInt32 m_eventRepeatLifetime;
 };
 
 #endif /* CacheManager_hpp */
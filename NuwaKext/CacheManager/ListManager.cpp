@@ -12,41 +12,283 @@
 ListManager* ListManager::m_sharedInstance = nullptr;
 
 bool ListManager::init() {
-    m_allowProcList = new DriverCache<UInt64, UInt8>(kMaxCacheItems);
-    if (m_allowProcList == nullptr) {
+    m_updateLock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+    if (m_updateLock == nullptr) {
         return false;
     }
-    m_allowProcList->zero = kProcPlainType;
-    m_denyProcList = new DriverCache<UInt64, UInt8>(kMaxCacheItems);
-    if (m_denyProcList == nullptr) {
+    m_memoryBudget = kDefaultListMemoryBudget;
+    m_readers = new ReaderEpoch();
+    if (m_readers == nullptr || !m_readers->isReady()) {
         free();
         return false;
     }
-    m_denyProcList->zero = kProcPlainType;
     
-    m_muteFileList = new DriverCache<UInt64, UInt8>(kMaxCacheItems);
+    UInt64 emptyList = 0;
+    m_authProcList = buildList(&emptyList, kProcWhiteType, nullptr);
+    if (m_authProcList == nullptr) {
+        free();
+        return false;
+    }
+    
+    m_muteFileList = buildList(&emptyList, true, nullptr);
     if (m_muteFileList == nullptr) {
         free();
         return false;
     }
-    m_muteFileList->zero = false;
+    
+    m_mutePathList = buildPaths(nullptr, 0, 0);
+    m_muteProcList = buildPaths(nullptr, 0, 0);
+    m_mutedProcCache = new FlatCache<UInt64, UInt64>(kMutedProcCacheCapacity);
+    if (m_mutePathList == nullptr || m_muteProcList == nullptr || m_mutedProcCache == nullptr) {
+        free();
+        return false;
+    }
+    
+    m_excludedFsids = new FsidSet;
+    if (m_excludedFsids == nullptr) {
+        free();
+        return false;
+    }
 
     return true;
 }
 
 void ListManager::free() {
-    if (m_allowProcList != nullptr) {
-        delete m_allowProcList;
-        m_allowProcList = nullptr;
-    }
-    if (m_denyProcList != nullptr) {
-        delete m_denyProcList;
-        m_denyProcList = nullptr;
+    if (m_authProcList != nullptr) {
+        delete m_authProcList;
+        m_authProcList = nullptr;
     }
     if (m_muteFileList != nullptr) {
         delete m_muteFileList;
         m_muteFileList = nullptr;
     }
+    if (m_mutePathList != nullptr) {
+        delete m_mutePathList;
+        m_mutePathList = nullptr;
+    }
+    if (m_muteProcList != nullptr) {
+        delete m_muteProcList;
+        m_muteProcList = nullptr;
+    }
+    if (m_mutedProcCache != nullptr) {
+        delete m_mutedProcCache;
+        m_mutedProcCache = nullptr;
+    }
+    if (m_excludedFsids != nullptr) {
+        delete m_excludedFsids;
+        m_excludedFsids = nullptr;
+    }
+    for (UInt32 i = 0; i < kMuteTypeCount; ++i) {
+        m_muteDeltas[i].reset();
+    }
+    // Nobody reads the lists once the kext is stopped.
+    freeRetired(true);
+    if (m_readers != nullptr) {
+        delete m_readers;
+        m_readers = nullptr;
+    }
+    if (m_updateLock != nullptr) {
+        lck_mtx_free(m_updateLock, g_driverLockGrp);
+        m_updateLock = nullptr;
+    }
+}
+
+VnodeSet *ListManager::buildList(UInt64 *vnodeID, UInt8 value, const VnodeSet *oldList) {
+    UInt32 count = 0;
+    while (count < kMaxCacheItems && vnodeID[count] != 0) {
+        count++;
+    }
+    
+    // Items of the old list tagged with another value are kept.
+    UInt32 capacity = count + (oldList != nullptr ? oldList->getCount() : 0);
+    VnodeSet *list = new VnodeSet(capacity);
+    if (list == nullptr) {
+        return nullptr;
+    }
+    list->addItems(oldList, value);
+    if (list->addItems(vnodeID, count, value) != count || !list->finish()) {
+        delete list;
+        return nullptr;
+    }
+    return list;
+}
+
+PathTrie *ListManager::buildPaths(const char *paths, UInt32 size, UInt32 count) {
+    PathTrie *list = new PathTrie(count, size);
+    if (list == nullptr) {
+        return nullptr;
+    }
+    list->addPaths(paths, size);
+    if (!list->finish()) {
+        delete list;
+        return nullptr;
+    }
+    return list;
+}
+
+template <typename ListType>
+static void destroyList(void *list) {
+    delete (ListType *)list;
+}
+
+template <typename ListType>
+void ListManager::publishList(ListType **list, ListType *newList) {
+    ListType *oldList = __atomic_exchange_n(list, newList, __ATOMIC_SEQ_CST);
+    
+    // The wait is bounded, the update lock is held meanwhile.
+    UInt32 epoch = 0;
+    if (m_readers->synchronize(kMaxListDrainTime, &epoch)) {
+        delete oldList;
+    } else {
+        retireList(oldList, destroyList<ListType>, epoch);
+    }
+    freeRetired(false);
+}
+
+void ListManager::retireList(void *list, void (*destroy)(void *list), UInt32 epoch) {
+    if (m_retiredCount == kMaxRetiredLists) {
+        // Readers stuck that long are a bug, rather wait for them than leak more.
+        Logger(LOG_ERROR, "Lookups of epoch %u still inside with %u lists retired, waiting for them.", epoch, m_retiredCount)
+        while (!m_readers->isDrained(epoch)) {
+            IOSleep(1);
+        }
+        destroy(list);
+        return;
+    }
+    
+    Logger(LOG_WARN, "Lookups of epoch %u still inside after %u ms, list freed once they leave.", epoch, kMaxListDrainTime)
+    m_retiredLists[m_retiredCount].list = list;
+    m_retiredLists[m_retiredCount].destroy = destroy;
+    m_retiredLists[m_retiredCount].epoch = epoch;
+    m_retiredCount++;
+}
+
+void ListManager::freeRetired(bool force) {
+    UInt32 kept = 0;
+    for (UInt32 i = 0; i < m_retiredCount; ++i) {
+        RetiredList *retired = &m_retiredLists[i];
+        if (force || m_readers->isDrained(retired->epoch)) {
+            retired->destroy(retired->list);
+        } else {
+            m_retiredLists[kept++] = *retired;
+        }
+    }
+    m_retiredCount = kept;
+}
+
+bool ListManager::getMuteList(NuwaKextMuteType type, VnodeSet ***list, UInt8 *value) {
+    switch (type) {
+        case kAllowAuthExec:
+            *list = &m_authProcList;
+            *value = kProcWhiteType;
+            break;
+        case kDenyAuthExec:
+            *list = &m_authProcList;
+            *value = kProcBlackType;
+            break;
+        case kFilterFileByFilePath:
+            *list = &m_muteFileList;
+            *value = true;
+            break;
+        default:
+            // Processes are muted by path prefix, see updateMutePaths.
+            return false;
+    }
+    return true;
+}
+
+NuwaKextListStatus ListManager::updateMuteDelta(const NuwaKextMuteDelta *delta, const UInt64 *vnodeID, UInt64 *generation) {
+    VnodeSet **list = nullptr;
+    UInt8 value = 0;
+    NuwaKextMuteType type = delta->muteType;
+    if (!getMuteList(type, &list, &value)) {
+        return kListUpdateInvalid;
+    }
+    
+    lck_mtx_lock(m_updateLock);
+    VnodeSet *newList = nullptr;
+    NuwaKextListStatus status = m_muteDeltas[type].apply(delta, vnodeID, *list, value, m_memoryBudget, &newList);
+    if (newList != nullptr) {
+        publishList(list, newList);
+    }
+    *generation = m_muteDeltas[type].getGeneration();
+    lck_mtx_unlock(m_updateLock);
+    return status;
+}
+
+NuwaKextListStatus ListManager::updateMutePaths(NuwaKextMuteType type, const char *paths, UInt32 size) {
+    PathTrie **list = nullptr;
+    if (type == kFilterFileByFilePath) {
+        list = &m_mutePathList;
+    } else if (type == kFilterFileByProcPath) {
+        list = &m_muteProcList;
+    } else {
+        return kListUpdateInvalid;
+    }
+    
+    // Every path is terminated, so the terminators give the count.
+    UInt32 count = 0;
+    for (UInt32 i = 0; i < size; ++i) {
+        count += (paths[i] == '\0');
+    }
+    if (PathTrie::getMemorySize(count, size) > m_memoryBudget) {
+        return kListUpdateNoMemory;
+    }
+    PathTrie *newList = buildPaths(paths, size, count);
+    if (newList == nullptr) {
+        Logger(LOG_WARN, "Failed to build path list for filtering file event.")
+        return kListUpdateNoMemory;
+    }
+    
+    lck_mtx_lock(m_updateLock);
+    publishList(list, newList);
+    if (type == kFilterFileByProcPath) {
+        // Published first, so a tag of the new generation was matched against the new list.
+        __atomic_fetch_add(&m_mutedProcGeneration, 1, __ATOMIC_SEQ_CST);
+        m_mutedProcCache->clearObjects();
+    }
+    lck_mtx_unlock(m_updateLock);
+    
+    return kListUpdateSuccess;
+}
+
+void ListManager::updateMutedProcess(SInt32 pid, const char *path) {
+    if (path == nullptr) {
+        return;
+    }
+    
+    UInt64 generation = __atomic_load_n(&m_mutedProcGeneration, __ATOMIC_SEQ_CST);
+    UInt32 ticket = m_readers->enter();
+    bool muted = __atomic_load_n(&m_muteProcList, __ATOMIC_ACQUIRE)->matchPath(path);
+    m_readers->leave(ticket);
+    
+    // Zero drops the tag left by an earlier process with the same pid.
+    m_mutedProcCache->setObject(pid, muted ? generation + 1 : 0);
+}
+
+NuwaKextListStatus ListManager::updateExcludedFsids(const UInt32 *fsids, UInt32 count) {
+    if (count > kMaxExcludedFsids) {
+        return kListUpdateInvalid;
+    }
+    FsidSet *newSet = new FsidSet;
+    if (newSet == nullptr) {
+        return kListUpdateNoMemory;
+    }
+    
+    lck_mtx_lock(m_updateLock);
+    for (UInt32 i = 0; i < count; ++i) {
+        newSet->addFsid(fsids[i], m_excludedFsids);
+    }
+    publishList(&m_excludedFsids, newSet);
+    lck_mtx_unlock(m_updateLock);
+    
+    return kListUpdateSuccess;
+}
+
+void ListManager::setMemoryBudget(UInt64 budget) {
+    lck_mtx_lock(m_updateLock);
+    m_memoryBudget = budget;
+    lck_mtx_unlock(m_updateLock);
 }
 
 ListManager *ListManager::getInstance() {
@@ -77,24 +319,21 @@ bool ListManager::updateAuthProcessList(UInt64 *vnodeID, NuwaKextMuteType type)
         return false;
     }
     
-    SInt i = 0;
-    NuwaKextProcType procType = kProcPlainType;
-    DriverCache<UInt64, UInt8> *procList = nullptr;
+    NuwaKextProcType procType = (type == kAllowAuthExec) ? kProcWhiteType : kProcBlackType;
     
-    if (type == kAllowAuthExec) {
-        procType = kProcWhiteType;
-        procList = m_allowProcList;
-    } else {
-        procType = kProcBlackType;
-        procList = m_denyProcList;
-    }
-    procList->clearObjects();
-    while (vnodeID[i] != 0 && i < kMaxCacheItems) {
-        if (!procList->setObject(vnodeID[i], procType)) {
-            Logger(LOG_WARN, "Failed to update item for auth process.")
-        }
-        i++;
+    // The other type is carried over from the current list, so the update is serialized from here.
+    lck_mtx_lock(m_updateLock);
+    // Build the new list aside, lookups keep using the old one until it is complete.
+    VnodeSet *newList = buildList(vnodeID, procType, m_authProcList);
+    if (newList == nullptr) {
+        lck_mtx_unlock(m_updateLock);
+        Logger(LOG_WARN, "Failed to build list for auth process.")
+        return false;
     }
+    publishList(&m_authProcList, newList);
+    // Deltas in progress were based on the replaced list.
+    m_muteDeltas[type].reset();
+    lck_mtx_unlock(m_updateLock);
     
     return true;
 }
@@ -104,14 +343,15 @@ bool ListManager::updateFilterFileList(UInt64 *vnodeID, NuwaKextMuteType type) {
         return false;
     }
     
-    SInt i = 0;
-    m_muteFileList->clearObjects();
-    while (vnodeID[i] != 0 && i < kMaxCacheItems) {
-        if (!m_muteFileList->setObject(vnodeID[i], true)) {
-            Logger(LOG_WARN, "Failed to update item for filtering file event.")
-        }
-        i++;
+    VnodeSet *newList = buildList(vnodeID, true, nullptr);
+    if (newList == nullptr) {
+        Logger(LOG_WARN, "Failed to build list for filtering file event.")
+        return false;
     }
+    lck_mtx_lock(m_updateLock);
+    publishList(&m_muteFileList, newList);
+    m_muteDeltas[kFilterFileByFilePath].reset();
+    lck_mtx_unlock(m_updateLock);
     
     return true;
 }
@@ -122,10 +362,10 @@ UInt8 ListManager::obtainAuthProcessList(UInt64 vnodeID) {
         return type;
     }
     
-    type = m_allowProcList->getObject(vnodeID);
-    if (type == kProcPlainType) {
-        type = m_denyProcList->getObject(vnodeID);
-    }
+    // A process in both lists is allowed, its white type is the smaller value.
+    UInt32 ticket = m_readers->enter();
+    type = __atomic_load_n(&m_authProcList, __ATOMIC_ACQUIRE)->getValue(vnodeID);
+    m_readers->leave(ticket);
     return type;
 }
 
@@ -134,5 +374,53 @@ UInt8 ListManager::obtainFilterFileList(UInt64 vnodeID) {
         return false;
     }
     
-    return m_muteFileList->getObject(vnodeID);
+    UInt32 ticket = m_readers->enter();
+    UInt8 muted = __atomic_load_n(&m_muteFileList, __ATOMIC_ACQUIRE)->getValue(vnodeID);
+    m_readers->leave(ticket);
+    return muted;
+}
+
+bool ListManager::obtainFilterPathList(const char *path) {
+    if (path == nullptr) {
+        return false;
+    }
+    
+    UInt32 ticket = m_readers->enter();
+    bool muted = __atomic_load_n(&m_mutePathList, __ATOMIC_ACQUIRE)->matchPath(path);
+    m_readers->leave(ticket);
+    return muted;
+}
+
+bool ListManager::obtainMutedProcess(SInt32 pid) {
+    // Most processes are not muted, skip the lock of the cache while none is.
+    if (m_mutedProcCache->getCount() == 0) {
+        return false;
+    }
+    
+    UInt64 value = m_mutedProcCache->getObject(pid);
+    return value != 0 && value == __atomic_load_n(&m_mutedProcGeneration, __ATOMIC_SEQ_CST) + 1;
+}
+
+bool ListManager::obtainExcludedFsid(UInt32 fsid) {
+    UInt32 ticket = m_readers->enter();
+    FsidSet *set = __atomic_load_n(&m_excludedFsids, __ATOMIC_ACQUIRE);
+    bool excluded = set->isExcluded(fsid);
+    m_readers->leave(ticket);
+    return excluded;
+}
+
+bool ListManager::hasExcludedFsids() {
+    UInt32 ticket = m_readers->enter();
+    FsidSet *set = __atomic_load_n(&m_excludedFsids, __ATOMIC_ACQUIRE);
+    bool excluded = !set->isEmpty();
+    m_readers->leave(ticket);
+    return excluded;
+}
+
+UInt32 ListManager::obtainFsidDrops(NuwaKextFsidDrops *drops, UInt32 count) {
+    UInt32 ticket = m_readers->enter();
+    FsidSet *set = __atomic_load_n(&m_excludedFsids, __ATOMIC_ACQUIRE);
+    count = set->getDrops(drops, count);
+    m_readers->leave(ticket);
+    return count;
 }
@@ -8,7 +8,13 @@
 #ifndef ListManager_hpp
 #define ListManager_hpp
 
-#include "DriverCache.hpp"
+#include "ObjectPool.hpp"
+#include "VnodeSet.hpp"
+#include "PathTrie.hpp"
+#include "FlatCache.hpp"
+#include "MuteDelta.hpp"
+#include "ReaderEpoch.hpp"
+#include "FsidSet.hpp"
 #include "KextCommon.hpp"
 
 typedef enum {
@@ -17,6 +23,11 @@ typedef enum {
     kProcBlackType  = 2
 } NuwaKextProcType;
 
+static const UInt32 kMuteTypeCount = kFilterFileByProcPath + 1;
+static const UInt32 kMutedProcCacheCapacity = 4096;
+static const UInt32 kMaxListDrainTime = 1000; // ms a publisher waits for the readers of a replaced list
+static const UInt32 kMaxRetiredLists = 8;
+
 class ListManager {
 
 public:
@@ -32,20 +43,83 @@ public:
     // Called when add path to file filter list.
     bool updateFilterFileList(UInt64 *vnodeID, NuwaKextMuteType type);
     
+    // Called when apply a chunk of changes to a mute list, generation is set to the current one.
+    NuwaKextListStatus updateMuteDelta(const NuwaKextMuteDelta *delta, const UInt64 *vnodeID, UInt64 *generation);
+    
+    // Called when replace the path prefixes muting file events, by file path or by process path.
+    NuwaKextListStatus updateMutePaths(NuwaKextMuteType type, const char *paths, UInt32 size);
+    
+    // Called when a process is executed, to remember whether its path is muted.
+    void updateMutedProcess(SInt32 pid, const char *path);
+    
+    // Called when replace the filesystems whose file events are dropped.
+    NuwaKextListStatus updateExcludedFsids(const UInt32 *fsids, UInt32 count);
+    
+    // Called when set the max memory taken by one mute list.
+    void setMemoryBudget(UInt64 budget);
+    
     // Called when check whether the process path within white/black list.
     UInt8 obtainAuthProcessList(UInt64 vnodeID);
     
     // Called when check whether the file path within white list.
     UInt8 obtainFilterFileList(UInt64 vnodeID);
     
+    // Called when check whether the file path is under a muted path.
+    bool obtainFilterPathList(const char *path);
+    
+    // Called when check whether the file events of the process are muted.
+    bool obtainMutedProcess(SInt32 pid);
+    
+    // Called when check whether the filesystem is excluded, its drops are counted if so.
+    bool obtainExcludedFsid(UInt32 fsid);
+    
+    // Called when check whether any filesystem is excluded, before the fsid costs a lookup.
+    bool hasExcludedFsids();
+    
+    // Called when obtain the drops counted for the excluded filesystems, returns their number.
+    UInt32 obtainFsidDrops(NuwaKextFsidDrops *drops, UInt32 count);
+    
 private:
+    struct RetiredList {
+        void *list;
+        void (*destroy)(void *list);
+        // Epoch whose readers may still see it.
+        UInt32 epoch;
+    };
+    
     bool init();
     void free();
+    VnodeSet *buildList(UInt64 *vnodeID, UInt8 value, const VnodeSet *oldList);
+    PathTrie *buildPaths(const char *paths, UInt32 size, UInt32 count);
+    template <typename ListType>
+    void publishList(ListType **list, ListType *newList);
+    void retireList(void *list, void (*destroy)(void *list), UInt32 epoch);
+    void freeRetired(bool force);
+    bool getMuteList(NuwaKextMuteType type, VnodeSet ***list, UInt8 *value);
     
     static ListManager *m_sharedInstance;
-    DriverCache<UInt64, UInt8> *m_allowProcList;
-    DriverCache<UInt64, UInt8> *m_denyProcList;
-    DriverCache<UInt64, UInt8> *m_muteFileList;
+    // Lists are never modified once published, an update swaps in a new one.
+    // Allowed and denied processes share one list, tagged with their NuwaKextProcType.
+    VnodeSet *m_authProcList;
+    VnodeSet *m_muteFileList;
+    // Prefixes of file paths, and of the paths of processes whose file events are muted.
+    PathTrie *m_mutePathList;
+    PathTrie *m_muteProcList;
+    // Pids of the muted processes, tagged with the generation of the list they matched plus one.
+    FlatCache<UInt64, UInt64> *m_mutedProcCache;
+    // Bumped by each update of the process paths, older tags are stale.
+    UInt64 m_mutedProcGeneration;
+    FsidSet *m_excludedFsids;
+    // Serializes the updates, lookups never take it.
+    lck_mtx_t *m_updateLock;
+    UInt64 m_memoryBudget;
+    // Updates of each mute type in progress, with the generation of its list.
+    MuteDelta m_muteDeltas[kMuteTypeCount];
+    // Lookups count themselves in, a replaced list is freed once they are out.
+    ReaderEpoch *m_readers;
+    // Replaced lists whose readers were still in when the wait expired.
+    RetiredList m_retiredLists[kMaxRetiredLists];
+    UInt32 m_retiredCount;
 };
 
 #endif /* ListManager_hpp */
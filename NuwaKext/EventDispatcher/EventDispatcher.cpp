@@ -7,33 +7,264 @@
 
 #include "EventDispatcher.hpp"
 #include "KextLogger.hpp"
+#include "ObjectPool.hpp"
+#include <kern/clock.h>
+#include <kern/cpu_number.h>
+#include <sys/sysctl.h>
 
 EventDispatcher* EventDispatcher::m_sharedInstance = nullptr;
 
 bool EventDispatcher::init() {
     m_isConnected = false;
-    m_authDataQueue = IOSharedDataQueue::withEntries(kMaxAuthQueueEvents, sizeof(NuwaKextEvent));
+    m_subscription = kSubscribeAll;
+    m_eventLanes.setCriticalClasses(kDefaultCriticalClasses);
+    m_eventCounters = nullptr;
+    m_rateLimiter = nullptr;
+    m_throttleCall = nullptr;
+    m_isCollecting = false;
+    m_isStopping = false;
+    m_criticalDataQueue = nullptr;
+    bzero(m_notifyDataQueues, sizeof(m_notifyDataQueues));
+    bzero(m_retiredQueues, sizeof(m_retiredQueues));
+    m_isResizing = false;
+    m_producerEpoch = 0;
+    bzero(m_activeProducers, sizeof(m_activeProducers));
+    bzero(m_notificationPorts, sizeof(m_notificationPorts));
+    m_queueLock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+    if (m_queueLock == nullptr) {
+        Logger(LOG_ERROR, "Failed to alloc lock for queues.")
+        return false;
+    }
+    m_authDataQueue = EventQueue::withEntries(kMaxAuthQueueEvents, sizeof(NuwaKextEvent));
     if (m_authDataQueue == nullptr) {
         Logger(LOG_ERROR, "Failed to create auth data queue.")
+        free();
         return false;
     }
-    m_notifyDataQueue = IOSharedDataQueue::withEntries(kMaxNotifyQueueEvents, sizeof(NuwaKextEvent));
-    if (m_notifyDataQueue == nullptr) {
-        Logger(LOG_ERROR, "Failed to create notify data queue.")
-        m_authDataQueue->release();
-        m_authDataQueue = nullptr;
+    m_criticalDataQueue = EventQueue::withEntries(kMaxCriticalQueueEvents, sizeof(NuwaKextEvent));
+    if (m_criticalDataQueue == nullptr) {
+        Logger(LOG_ERROR, "Failed to create critical data queue.")
+        free();
         return false;
     }
+    int cpuCount = 0;
+    size_t length = sizeof(cpuCount);
+    if (sysctlbyname("hw.logicalcpu_max", &cpuCount, &length, nullptr, 0) != 0 || cpuCount <= 0) {
+        // Evenly shared, as if every ring had its CPU.
+        cpuCount = kNotifyRingCount;
+    }
+    m_cpuCount = (UInt32)cpuCount;
+    for (UInt32 i = 0; i < kNotifyRingCount; ++i) {
+        m_notifyDataQueues[i] = EventQueue::withEntries(getRingEntries(i, kMaxNotifyQueueEvents), sizeof(NuwaKextEvent));
+        if (m_notifyDataQueues[i] == nullptr) {
+            Logger(LOG_ERROR, "Failed to create notify data queue.")
+            free();
+            return false;
+        }
+    }
+    m_eventCounters = new EventCounters();
+    if (m_eventCounters == nullptr) {
+        Logger(LOG_ERROR, "Failed to create event counters.")
+        free();
+        return false;
+    }
+    m_rateLimiter = new RateLimiter();
+    if (m_rateLimiter == nullptr) {
+        Logger(LOG_ERROR, "Failed to create rate limiter.")
+        free();
+        return false;
+    }
+    m_throttleCall = thread_call_allocate(throttleCallback, this);
+    if (m_throttleCall == nullptr) {
+        Logger(LOG_ERROR, "Failed to alloc thread call for throttle summaries.")
+        free();
+        return false;
+    }
+    setRateLimit(kRateLimitedEventClasses, kDefaultProcEventRate, kDefaultProcEventBurst);
+    setWakeupCoalescing(kDefaultWakeupEvents, kDefaultWakeupDelay);
     return true;
 }
 
 void EventDispatcher::free() {
-    m_authDataQueue->setNotificationPort(nullptr);
-    m_authDataQueue->release();
-    m_authDataQueue = nullptr;
-    m_notifyDataQueue->setNotificationPort(nullptr);
-    m_notifyDataQueue->release();
-    m_notifyDataQueue = nullptr;
+    if (m_throttleCall != nullptr) {
+        // Set under the lock, a run in progress either scheduled the next one already or sees it and stops.
+        lck_mtx_lock(m_queueLock);
+        m_isStopping = true;
+        m_isCollecting = false;
+        lck_mtx_unlock(m_queueLock);
+        thread_call_cancel_wait(m_throttleCall);
+        thread_call_free(m_throttleCall);
+        m_throttleCall = nullptr;
+    }
+    if (m_rateLimiter != nullptr) {
+        delete m_rateLimiter;
+        m_rateLimiter = nullptr;
+    }
+    if (m_eventCounters != nullptr) {
+        delete m_eventCounters;
+        m_eventCounters = nullptr;
+    }
+    if (m_authDataQueue != nullptr) {
+        m_authDataQueue->setNotificationPort(nullptr);
+        m_authDataQueue->release();
+        m_authDataQueue = nullptr;
+    }
+    if (m_criticalDataQueue != nullptr) {
+        m_criticalDataQueue->setNotificationPort(nullptr);
+        m_criticalDataQueue->release();
+        m_criticalDataQueue = nullptr;
+    }
+    for (UInt32 i = 0; i < kNotifyRingCount; ++i) {
+        if (m_notifyDataQueues[i] != nullptr) {
+            m_notifyDataQueues[i]->setNotificationPort(nullptr);
+            m_notifyDataQueues[i]->release();
+            m_notifyDataQueues[i] = nullptr;
+        }
+    }
+    for (UInt32 i = 0; i < kQueueTypeNotify + kNotifyRingCount; ++i) {
+        if (m_retiredQueues[i] != nullptr) {
+            m_retiredQueues[i]->setNotificationPort(nullptr);
+            m_retiredQueues[i]->release();
+            m_retiredQueues[i] = nullptr;
+        }
+    }
+    if (m_queueLock != nullptr) {
+        lck_mtx_free(m_queueLock, g_driverLockGrp);
+        m_queueLock = nullptr;
+    }
+}
+
+EventQueue **EventDispatcher::getQueueSlot(UInt32 type) {
+    if (type == kQueueTypeAuth) {
+        return &m_authDataQueue;
+    }
+    if (type == kQueueTypeCritical) {
+        return &m_criticalDataQueue;
+    }
+    if (type >= kQueueTypeNotify && type < kQueueTypeNotify + kNotifyRingCount) {
+        return &m_notifyDataQueues[type - kQueueTypeNotify];
+    }
+    return nullptr;
+}
+
+UInt32 EventDispatcher::getRingEntries(UInt32 ring, UInt32 numEntries) const {
+    // Rings no CPU maps to keep a few entries for the producers falling over.
+    return EventRing::shareByCpus(ring, kNotifyRingCount, m_cpuCount, numEntries, kMinResizedQueueEvents / kNotifyRingCount);
+}
+
+UInt32 EventDispatcher::getNotifyType(UInt32 size) const {
+    // The thread may move to another CPU meanwhile, the rings take any number of producers anyway.
+    UInt32 ring = (UInt32)cpu_number() % kNotifyRingCount;
+    for (UInt32 i = 0; i < kNotifyRingCount; ++i) {
+        UInt32 type = kQueueTypeNotify + (ring + i) % kNotifyRingCount;
+        EventQueue *queue = getQueue(type);
+        if (queue != nullptr && queue->hasRoom(size)) {
+            return type;
+        }
+    }
+    // All full, the ring of the CPU refuses it and counts the drop.
+    return kQueueTypeNotify + ring;
+}
+
+EventQueue *EventDispatcher::getQueue(UInt32 type) const {
+    // Queues may be replaced by resizing at any time.
+    EventQueue **slot = const_cast<EventDispatcher *>(this)->getQueueSlot(type);
+    return slot != nullptr ? __atomic_load_n(slot, __ATOMIC_ACQUIRE) : nullptr;
+}
+
+void EventDispatcher::enterProducer(EventReservation *reservation) {
+    UInt32 epoch = __atomic_load_n(&m_producerEpoch, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&m_activeProducers[epoch], 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&m_producerEpoch, __ATOMIC_SEQ_CST) != epoch) {
+        // Counted in an epoch drained meanwhile, resizing may have stopped waiting for it.
+        __atomic_fetch_sub(&m_activeProducers[epoch], 1, __ATOMIC_SEQ_CST);
+        epoch = __atomic_load_n(&m_producerEpoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&m_activeProducers[epoch], 1, __ATOMIC_SEQ_CST);
+    }
+    reservation->epoch = epoch;
+}
+
+void EventDispatcher::leaveProducer(EventReservation *reservation) {
+    __atomic_fetch_sub(&m_activeProducers[reservation->epoch], 1, __ATOMIC_SEQ_CST);
+}
+
+void EventDispatcher::drainProducers() {
+    // Producers entering from now on take the queues in place, those of the old epoch are waited for.
+    UInt32 epoch = __atomic_load_n(&m_producerEpoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_producerEpoch, epoch ^ 1, __ATOMIC_SEQ_CST);
+    // Producers only hold a queue while building a record, so this is short.
+    while (__atomic_load_n(&m_activeProducers[epoch], __ATOMIC_SEQ_CST) != 0) {
+        IOSleep(1);
+    }
+}
+
+IOReturn EventDispatcher::resizeQueue(UInt32 type, UInt32 numEntries, UInt32 *resized) {
+    EventQueue *queues[kNotifyRingCount] = {};
+    EventQueue *released[kNotifyRingCount] = {};
+    UInt32 count = 1;
+    if (type == kQueueTypeNotify) {
+        count = kNotifyRingCount;
+    } else if (type != kQueueTypeAuth && type != kQueueTypeCritical) {
+        return kIOReturnBadArgument;
+    }
+    if (numEntries < count) {
+        return kIOReturnBadArgument;
+    }
+    UInt32 queueEntries = 0;
+    
+    lck_mtx_lock(m_queueLock);
+    if (m_isResizing) {
+        lck_mtx_unlock(m_queueLock);
+        return kIOReturnBusy;
+    }
+    for (UInt32 i = 0; i < count; ++i) {
+        // Its memory is still mapped in the client, which has not taken the previous resizing yet.
+        if (m_retiredQueues[type + i] != nullptr && m_retiredQueues[type + i]->isMapped()) {
+            lck_mtx_unlock(m_queueLock);
+            return kIOReturnBusy;
+        }
+    }
+    for (UInt32 i = 0; i < count; ++i) {
+        UInt32 entries = type == kQueueTypeNotify ? getRingEntries(i, numEntries) : numEntries;
+        queues[i] = EventQueue::withEntries(entries, sizeof(NuwaKextEvent));
+        if (queues[i] == nullptr) {
+            Logger(LOG_ERROR, "Failed to create queue of %u entries for resizing.", entries)
+            for (UInt32 j = 0; j < i; ++j) {
+                queues[j]->release();
+            }
+            lck_mtx_unlock(m_queueLock);
+            return kIOReturnNoMemory;
+        }
+        queueEntries += entries;
+        queues[i]->setNotificationPort(m_notificationPorts[type + i]);
+        if (type == kQueueTypeNotify) {
+            queues[i]->setWakeupCoalescing(m_wakeupCount, m_wakeupDelay);
+        }
+    }
+    
+    for (UInt32 i = 0; i < count; ++i) {
+        queues[i] = __atomic_exchange_n(getQueueSlot(type + i), queues[i], __ATOMIC_ACQ_REL);
+        // Those retired before are drained and unmapped by now, the ones replaced take their place.
+        released[i] = m_retiredQueues[type + i];
+        m_retiredQueues[type + i] = queues[i];
+    }
+    m_isResizing = true;
+    lck_mtx_unlock(m_queueLock);
+    
+    // No producer holds the old queues after that, the lock is left to the client meanwhile.
+    drainProducers();
+    for (UInt32 i = 0; i < count; ++i) {
+        queues[i]->retire();
+        if (released[i] != nullptr) {
+            released[i]->setNotificationPort(nullptr);
+            released[i]->release();
+        }
+    }
+    lck_mtx_lock(m_queueLock);
+    m_isResizing = false;
+    lck_mtx_unlock(m_queueLock);
+    *resized = queueEntries;
+    return kIOReturnSuccess;
 }
 
 EventDispatcher *EventDispatcher::getInstance() {
@@ -61,55 +292,268 @@ void EventDispatcher::release() {
 
 void EventDispatcher::setConnectionStatus(bool connected) {
     m_isConnected = connected;
+    updateThrottleCall();
+}
+
+void EventDispatcher::setWakeupCoalescing(UInt32 count, UInt32 delay) {
+    lck_mtx_lock(m_queueLock);
+    m_wakeupCount = count;
+    m_wakeupDelay = delay;
+    for (UInt32 i = 0; i < kNotifyRingCount; ++i) {
+        m_notifyDataQueues[i]->setWakeupCoalescing(count, delay);
+    }
+    lck_mtx_unlock(m_queueLock);
+}
+
+void EventDispatcher::setSubscription(UInt32 mask) {
+    __atomic_store_n(&m_subscription, mask & kSubscribeAll, __ATOMIC_RELAXED);
+    updateThrottleCall();
+}
+
+void EventDispatcher::setCriticalClasses(UInt32 mask) {
+    m_eventLanes.setCriticalClasses(mask);
+}
+
+void EventDispatcher::setRateLimit(UInt32 mask, UInt32 rate, UInt32 burst) {
+    // Auth events have a waiter and summaries are already bounded, neither is limited.
+    mask &= kSubscribeAll & ~(kSubscribeAuthExec | kSubscribeThrottle);
+    for (UInt32 i = 0; i < kEventClassCount; ++i) {
+        if (mask & (1 << i)) {
+            m_rateLimiter->setLimit(i, rate, burst);
+        }
+    }
 }
 
 void EventDispatcher::setNotificationPortForQueue(UInt32 type, mach_port_t port) {
-    switch (type) {
-        case kQueueTypeAuth:
-            m_authDataQueue->setNotificationPort(port);
-            break;
-        case kQueueTypeNotify:
-            m_notifyDataQueue->setNotificationPort(port);
-            break;
-        default:
-            break;
+    lck_mtx_lock(m_queueLock);
+    EventQueue *queue = getQueue(type);
+    if (queue != nullptr) {
+        m_notificationPorts[type] = port;
+        queue->setNotificationPort(port);
+    }
+    lck_mtx_unlock(m_queueLock);
+}
+
+IOMemoryDescriptor *EventDispatcher::getMemoryDescriptorForQueue(UInt32 type) {
+    IOMemoryDescriptor *memory = nullptr;
+    lck_mtx_lock(m_queueLock);
+    EventQueue *queue = getQueue(type);
+    EventQueue *retired = type < kQueueTypeNotify + kNotifyRingCount ? m_retiredQueues[type] : nullptr;
+    if (retired != nullptr && retired->isMapped()) {
+        // The client unmaps a resized queue before mapping the new one, and unmapping looks it up here too.
+        queue = retired;
+        queue->setMapped(false);
+    } else if (queue != nullptr) {
+        queue->setMapped(true);
+    }
+    if (queue != nullptr) {
+        memory = queue->getMemoryDescriptor();
+    }
+    lck_mtx_unlock(m_queueLock);
+    return memory;
+}
+
+void EventDispatcher::unmapQueues() {
+    lck_mtx_lock(m_queueLock);
+    for (UInt32 type = 0; type < kQueueTypeNotify + kNotifyRingCount; ++type) {
+        EventQueue *queue = getQueue(type);
+        if (queue != nullptr) {
+            queue->setMapped(false);
+        }
+        if (m_retiredQueues[type] != nullptr) {
+            m_retiredQueues[type]->setMapped(false);
+        }
+    }
+    lck_mtx_unlock(m_queueLock);
+}
+
+UInt32 EventDispatcher::obtainEventCounters(NuwaKextEventCounters *counters, UInt32 count) const {
+    return m_eventCounters->obtainCounters(counters, count);
+}
+
+void EventDispatcher::countSkippedEvent(UInt32 eventClass, bool dropped) {
+    UInt32 drops = 0;
+    UInt32 samples = 0;
+    m_eventCounters->countSkipped(eventClass, dropped);
+    if (m_eventCounters->takeReport(&drops, &samples)) {
+        Logger(LOG_WARN, "Queues are overloaded, %u events dropped and %u sampled out since last report.", drops, samples)
+    }
+}
+
+bool EventDispatcher::isThrottled(const NuwaKextRecordHeader *header) {
+    UInt32 eventClass = getEventClass(header->eventType);
+    ThrottleSummary summaries[kMaxConsumeSummaries];
+    UInt32 summaryCount = 0;
+    if (header->eventType == kActionAuthProcessCreate || eventClass >= kEventClassCount) {
+        return false;
+    }
+    
+    bool isAllowed = m_rateLimiter->consume(header->mainProcess.pid, eventClass, summaries, &summaryCount);
+    for (UInt32 i = 0; i < summaryCount; ++i) {
+        postThrottleSummary(header, &summaries[i]);
     }
+    if (isAllowed) {
+        return false;
+    }
+    m_eventCounters->countThrottled(eventClass);
+    return true;
 }
 
-IOMemoryDescriptor *EventDispatcher::getMemoryDescriptorForQueue(UInt32 type) const {
-    IOMemoryDescriptor *descriptor = nullptr;
+void EventDispatcher::postThrottleSummary(const NuwaKextRecordHeader *header, const ThrottleSummary *summary) {
+    EventReservation reservation;
+    UInt32 length = sizeof(summary->suppressed);
+    UInt32 size = sizeof(NuwaKextRecordHeader) + alignRecordSize(sizeof(NuwaKextRecordField) + length);
+    UInt8 *record = (UInt8 *)reserveEvent(kActionNotifyThrottle, size, &reservation);
+    if (record == nullptr) {
+        return;
+    }
     
-    switch (type) {
-        case kQueueTypeAuth:
-            descriptor = m_authDataQueue->getMemoryDescriptor();
-            break;
-        case kQueueTypeNotify:
-            descriptor = m_notifyDataQueue->getMemoryDescriptor();
-            break;
-        default:
+    NuwaKextRecordHeader summaryHeader = {};
+    if (header != nullptr && (UInt32)header->mainProcess.pid == summary->pid) {
+        // Same process and time as the event it was found with.
+        summaryHeader = *header;
+    } else {
+        // Evicted or gone quiet, only the pid of the process is left.
+        clock_sec_t seconds = 0;
+        clock_usec_t microseconds = 0;
+        clock_get_calendar_microtime(&seconds, &microseconds);
+        summaryHeader.eventTime = seconds;
+        clock_get_uptime(&summaryHeader.eventUptime);
+        absolutetime_to_nanoseconds(summaryHeader.eventUptime, &summaryHeader.eventUptime);
+        summaryHeader.mainProcess.pid = summary->pid;
+    }
+    summaryHeader.eventType = kActionNotifyThrottle;
+    summaryHeader.vnodeID = 0;
+    UInt32 offset = appendRecordField(record, size, sizeof(NuwaKextRecordHeader), kRecordFieldThrottled, summary->suppressed, length);
+    commitEvent(&reservation, closeEventRecord(record, offset, &summaryHeader));
+}
+
+void EventDispatcher::collectThrottleSummaries() {
+    ThrottleSummary summaries[kRateLimiterWays];
+    UInt32 count = 0;
+    // Taken summaries would be lost while no client is there to send them to.
+    while (m_isConnected && (count = m_rateLimiter->collectSummaries(summaries, kRateLimiterWays)) > 0) {
+        for (UInt32 i = 0; i < count; ++i) {
+            postThrottleSummary(nullptr, &summaries[i]);
+        }
+        if (count < kRateLimiterWays) {
             break;
+        }
+    }
+    
+    lck_mtx_lock(m_queueLock);
+    if (m_isCollecting) {
+        armThrottleCall();
     }
-    return descriptor;
+    lck_mtx_unlock(m_queueLock);
 }
 
-bool EventDispatcher::postToAuthQueue(NuwaKextEvent *eventInfo) {
-    if (!m_isConnected) {
-        return false;
+void EventDispatcher::armThrottleCall() {
+    UInt64 deadline = 0;
+    clock_interval_to_deadline(kThrottleSummaryInterval, NSEC_PER_MSEC, &deadline);
+    thread_call_enter_delayed(m_throttleCall, deadline);
+}
+
+void EventDispatcher::updateThrottleCall() {
+    if (m_throttleCall == nullptr) {
+        return;
     }
-    bool result = m_authDataQueue->enqueue(eventInfo, sizeof(NuwaKextEvent));
-    if (!result) {
-        Logger(LOG_WARN, "Failed to push back data to auth queue.")
+    
+    // Summaries are only sent to a client taking them, nothing wakes up for them otherwise.
+    lck_mtx_lock(m_queueLock);
+    bool wanted = !m_isStopping && m_isConnected && (getSubscription() & kSubscribeThrottle) != 0;
+    if (wanted && !m_isCollecting) {
+        armThrottleCall();
+    } else if (!wanted && m_isCollecting) {
+        thread_call_cancel(m_throttleCall);
     }
-    return result;
+    m_isCollecting = wanted;
+    lck_mtx_unlock(m_queueLock);
 }
 
-bool EventDispatcher::postToNotifyQueue(NuwaKextEvent *eventInfo) {
-    if (!m_isConnected) {
-        return false;
+void EventDispatcher::throttleCallback(thread_call_param_t param0, thread_call_param_t param1) {
+    EventDispatcher *dispatcher = reinterpret_cast<EventDispatcher *>(param0);
+    dispatcher->collectThrottleSummaries();
+}
+
+void EventDispatcher::postRepeatSummary(const NuwaKextRecordHeader *header, UInt32 repeats) {
+    EventReservation reservation;
+    UInt32 size = sizeof(NuwaKextRecordHeader) + alignRecordSize(sizeof(NuwaKextRecordField) + sizeof(UInt32));
+    UInt8 *record = (UInt8 *)reserveEvent(header->eventType, size, &reservation);
+    if (record == nullptr) {
+        return;
+    }
+    
+    // Without a path, the client tells it from the events themselves.
+    UInt32 offset = appendRecordField(record, size, sizeof(NuwaKextRecordHeader), kRecordFieldRepeats, &repeats, sizeof(UInt32));
+    commitEvent(&reservation, closeEventRecord(record, offset, header));
+}
+
+void *EventDispatcher::reserveEvent(NuwaKextAction action, UInt32 size, EventReservation *reservation) {
+    if (!m_isConnected || !isSubscribed(action) || size > kMaxEventRecordSize - kRecordSkippedFieldSize) {
+        return nullptr;
+    }
+    
+    reservation->eventClass = getEventClass(action);
+    UInt32 type = m_eventLanes.getLane(action, reservation->eventClass);
+    if (type == kQueueTypeNotify) {
+        type = getNotifyType(size + kRecordSkippedFieldSize);
     }
-    bool result = m_notifyDataQueue->enqueue(eventInfo, sizeof(NuwaKextEvent));
-    if (!result) {
-        Logger(LOG_WARN, "Failed to push back data to notify queue.")
+    // Held until the event is committed or aborted, resizing neither retires nor frees the queue meanwhile.
+    enterProducer(reservation);
+    reservation->queue = getQueue(type);
+    if (type >= kQueueTypeNotify && m_eventCounters->isSampledOut(reservation->eventClass, reservation->queue->getUsage())) {
+        leaveProducer(reservation);
+        countSkippedEvent(reservation->eventClass, false);
+        return nullptr;
+    }
+    
+    // Room for the skipped count is always reserved, it is given back when unused.
+    reservation->record = reservation->queue->reserve(size + kRecordSkippedFieldSize, &reservation->entry);
+    if (reservation->record == nullptr) {
+        leaveProducer(reservation);
+        countSkippedEvent(reservation->eventClass, true);
+    }
+    return reservation->record;
+}
+
+UInt32 EventDispatcher::appendSkippedCount(EventReservation *reservation, UInt32 size) {
+    UInt32 skipped = m_eventCounters->takeSkipped(reservation->eventClass);
+    if (skipped == 0) {
+        return size;
+    }
+    
+    UInt8 *record = (UInt8 *)reservation->record;
+    UInt32 offset = appendRecordField(record, reservation->entry.size, size, kRecordFieldSkipped, &skipped, sizeof(UInt32));
+    if (offset == 0) {
+        m_eventCounters->restoreSkipped(reservation->eventClass, skipped);
+        return size;
     }
-    return result;
+    UInt16 recordSize = (UInt16)offset;
+    memcpy(record + offsetof(NuwaKextRecordHeader, size), &recordSize, sizeof(recordSize));
+    return offset;
+}
+
+bool EventDispatcher::commitEvent(EventReservation *reservation, UInt32 size) {
+    if (size == 0) {
+        // The record did not fit, which only a wrong size estimate leads to.
+        reservation->queue->abort(&reservation->entry);
+        leaveProducer(reservation);
+        return false;
+    }
+    
+    size = appendSkippedCount(reservation, size);
+    UInt64 uptime = 0;
+    clock_get_uptime(&uptime);
+    absolutetime_to_nanoseconds(uptime, &uptime);
+    stampEventRecord(reservation->record, uptime, reservation->entry.sequence);
+    reservation->queue->commit(&reservation->entry, size);
+    m_eventCounters->countEnqueued(reservation->eventClass);
+    leaveProducer(reservation);
+    return true;
+}
+
+void EventDispatcher::abortEvent(EventReservation *reservation) {
+    reservation->queue->abort(&reservation->entry);
+    leaveProducer(reservation);
 }
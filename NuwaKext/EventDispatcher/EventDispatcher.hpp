@@ -10,8 +10,24 @@
 
 #include <IOKit/IODataQueueShared.h>
 #include <IOKit/IOMemoryDescriptor.h>
-#include <IOKit/IOSharedDataQueue.h>
 #include "KextCommon.hpp"
+#include "EventRecord.hpp"
+#include "EventQueue.hpp"
+#include "EventCounters.hpp"
+#include "EventLanes.hpp"
+#include "RateLimiter.hpp"
+
+/**
+ * @brief Queue entry reserved for the record of an event
+ */
+typedef struct {
+    EventQueue *queue;
+    void *record;
+    EventRing::Reservation entry;
+    UInt32 eventClass;
+    // Producer epoch the queue was taken in.
+    UInt32 epoch;
+} EventReservation;
 
 class EventDispatcher {
 
@@ -25,25 +41,134 @@ public:
     // Sets the Mach port for notifying the auth or other queue.
     void setNotificationPortForQueue(UInt32 type, mach_port_t port);
     
-    // Called in client to provide the shared dataqueue memory for the auth or other queue.
-    IOMemoryDescriptor *getMemoryDescriptorForQueue(UInt32 type) const;
+    // Called in client to provide the shared dataqueue memory for the auth or other queue, to map or unmap it.
+    IOMemoryDescriptor *getMemoryDescriptorForQueue(UInt32 type);
+    
+    // Called when the client is gone, its mappings go away with the connection.
+    void unmapQueues();
     
-    // Called when send auth event to client.
-    bool postToAuthQueue(NuwaKextEvent *eventInfo);
+    /**
+     * @brief Reserve room in the queue of the event, so that its record is built in place
+     
+     * @param action        type of the event, picks the auth or notify queue
+     * @param size          max size of the record, no more than kMaxEventRecordSize without the skipped count
+     * @param reservation   filled with the reserved entry
+     * @return              where the record goes, nullptr if not connected, not subscribed, full or sampled out
+     */
+    void *reserveEvent(NuwaKextAction action, UInt32 size, EventReservation *reservation);
     
-    // Called when send notify event to client.
-    bool postToNotifyQueue(NuwaKextEvent *eventInfo);
+    // Called when send the record built in the reserved entry to client.
+    bool commitEvent(EventReservation *reservation, UInt32 size);
+    
+    // Called when the event is dropped after its entry was reserved.
+    void abortEvent(EventReservation *reservation);
     
     void setConnectionStatus(bool connected);
     
+    // Called when batch the wakeups of the client on the bulk rings, auth and critical events always wake it at once.
+    void setWakeupCoalescing(UInt32 count, UInt32 delay);
+    
+    // Called when set the event classes subscribed by client, a NuwaKextSubscription mask.
+    void setSubscription(UInt32 mask);
+    
+    // Called when set the notify classes sent to the critical lane, a NuwaKextSubscription mask.
+    void setCriticalClasses(UInt32 mask);
+    
+    // Called when set the rate per second and burst of each process for the notify classes of the mask, rate 0 lifts the limit.
+    void setRateLimit(UInt32 mask, UInt32 rate, UInt32 burst);
+    
+    // Called when check the rate limit of the process before building its event, its summary is sent when due.
+    bool isThrottled(const NuwaKextRecordHeader *header);
+    
+    // Called when send the repeats of an event no later one will carry, the header names the event and process.
+    void postRepeatSummary(const NuwaKextRecordHeader *header, UInt32 repeats);
+    
+    /**
+     * @brief Replace the auth queue, the critical lane or the bulk rings with queues of another size
+     * Producers move to the new queues at once. The old ones take no more events once those holding
+     * them are done, and are kept for the client to drain until it maps them out.
+     
+     * @param type          kQueueTypeAuth, kQueueTypeCritical or kQueueTypeNotify for all the rings
+     * @param numEntries    entries of NuwaKextEvent size, shared by the rings by their CPUs as in init
+     * @param resized       filled with entries of the new queues together
+     * @return              kIOReturnBusy while the client maps the queues replaced by the previous resizing
+     *                      or another resizing is in progress, kIOReturnNoMemory if the new ones cannot be created
+     */
+    IOReturn resizeQueue(UInt32 type, UInt32 numEntries, UInt32 *resized);
+    
+    UInt32 getSubscription() const {
+        return __atomic_load_n(&m_subscription, __ATOMIC_RELAXED);
+    }
+    
+    // Called when check whether the class of the event is subscribed, before building it.
+    bool isSubscribed(NuwaKextAction action) const {
+        UInt32 eventClass = getEventClass(action);
+        if (eventClass >= kEventClassCount) {
+            return false;
+        }
+        return (getSubscription() & (1 << eventClass)) != 0;
+    }
+    
+    // Called when obtain the class of the event, its bit in NuwaKextSubscription, kEventClassCount if none.
+    static UInt32 getEventClass(NuwaKextAction action) {
+        if (action > kActionNotifyBegin && action < kActionNotifyBegin + kEventClassCount) {
+            return action - kActionNotifyBegin;
+        }
+        return action == kActionAuthProcessCreate ? 0 : kEventClassCount;
+    }
+    
+    // Called when copy the counters of the event classes out, returns the number copied.
+    UInt32 obtainEventCounters(NuwaKextEventCounters *counters, UInt32 count) const;
+    
 private:
     bool init();
     void free();
+    EventQueue *getQueue(UInt32 type) const;
+    EventQueue **getQueueSlot(UInt32 type);
+    UInt32 getNotifyType(UInt32 size) const;
+    UInt32 getRingEntries(UInt32 ring, UInt32 numEntries) const;
+    void enterProducer(EventReservation *reservation);
+    void leaveProducer(EventReservation *reservation);
+    void drainProducers();
+    void countSkippedEvent(UInt32 eventClass, bool dropped);
+    void postThrottleSummary(const NuwaKextRecordHeader *header, const ThrottleSummary *summary);
+    void collectThrottleSummaries();
+    void armThrottleCall();
+    void updateThrottleCall();
+    static void throttleCallback(thread_call_param_t param0, thread_call_param_t param1);
+    UInt32 appendSkippedCount(EventReservation *reservation, UInt32 size);
     
     static EventDispatcher *m_sharedInstance;
     bool m_isConnected;
-    IOSharedDataQueue *m_authDataQueue;
-    IOSharedDataQueue *m_notifyDataQueue;
+    UInt32 m_subscription;
+    EventLanes m_eventLanes;
+    EventCounters *m_eventCounters;
+    RateLimiter *m_rateLimiter;
+    // Collects the summaries of the quiet processes every kThrottleSummaryInterval while armed,
+    // that is while a client subscribed to them is connected, both flags taken under m_queueLock.
+    thread_call_t m_throttleCall;
+    bool m_isCollecting;
+    bool m_isStopping;
+    EventQueue *m_authDataQueue;
+    // Lane of the critical classes, a bulk storm never takes its room.
+    EventQueue *m_criticalDataQueue;
+    // Bulk lane, producers take the ring of their CPU and fall over to another one when it is full.
+    EventQueue *m_notifyDataQueues[kNotifyRingCount];
+    // Rings are sized by the CPUs mapped to them.
+    UInt32 m_cpuCount;
+    // Replaced by the last resizing, released once the client maps them out.
+    EventQueue *m_retiredQueues[kQueueTypeNotify + kNotifyRingCount];
+    // Set while a resizing drains the producers of the old queues, out of the lock.
+    bool m_isResizing;
+    // Producers holding a queue are counted in the epoch they took it in, resizing waits for the old epoch.
+    UInt32 m_producerEpoch;
+    UInt32 m_activeProducers[2];
+    // Settings given to the queues, applied again to those created by resizing.
+    mach_port_t m_notificationPorts[kQueueTypeNotify + kNotifyRingCount];
+    UInt32 m_wakeupCount;
+    UInt32 m_wakeupDelay;
+    // Serializes the replacement of queues with the settings applied to them.
+    lck_mtx_t *m_queueLock;
 };
 
 #endif /* EventDispatcher_hpp */
@@ -0,0 +1,150 @@
+//
+//  EventQueue.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventQueue.hpp"
+#include "EventRecord.hpp"
+
+OSDefineMetaClassAndStructors(EventQueue, IOSharedDataQueue);
+
+EventQueue *EventQueue::withEntries(UInt32 numEntries, UInt32 entrySize) {
+    EventQueue *queue = new EventQueue;
+    if (queue != nullptr && !queue->initWithEntries(numEntries, entrySize)) {
+        queue->release();
+        queue = nullptr;
+    }
+    return queue;
+}
+
+Boolean EventQueue::initWithCapacity(UInt32 size) {
+    m_ring = nullptr;
+    m_wakeupCall = nullptr;
+    m_memoryDescriptor = nullptr;
+    m_isMapped = false;
+    if (!IOSharedDataQueue::initWithCapacity(size)) {
+        return false;
+    }
+    m_wakeupCall = thread_call_allocate(wakeupCallback, this);
+    m_ring = new EventRing(dataQueue, getQueueSize());
+    return m_ring != nullptr;
+}
+
+void EventQueue::free() {
+    if (m_wakeupCall != nullptr) {
+        thread_call_cancel_wait(m_wakeupCall);
+        thread_call_free(m_wakeupCall);
+        m_wakeupCall = nullptr;
+    }
+    if (m_memoryDescriptor != nullptr) {
+        m_memoryDescriptor->release();
+        m_memoryDescriptor = nullptr;
+    }
+    if (m_ring != nullptr) {
+        delete m_ring;
+        m_ring = nullptr;
+    }
+    IOSharedDataQueue::free();
+}
+
+Boolean EventQueue::enqueue(void *data, UInt32 dataSize) {
+    EventRing::Reservation reservation;
+    void *entry = reserve(dataSize, &reservation);
+    if (entry == nullptr) {
+        return false;
+    }
+    memcpy(entry, data, dataSize);
+    commit(&reservation, dataSize);
+    return true;
+}
+
+void *EventQueue::reserve(UInt32 size, EventRing::Reservation *reservation) {
+    if (m_ring == nullptr) {
+        return nullptr;
+    }
+    return m_ring->reserve(size, reservation);
+}
+
+void EventQueue::commit(EventRing::Reservation *reservation, UInt32 size) {
+    notifyCommitted(m_ring->commit(reservation, size));
+}
+
+void EventQueue::notifyCommitted(bool wasEmpty) {
+    UInt32 actions = m_wakeupBatch.addEvent(wasEmpty);
+    if ((actions & kWakeupArmTimer) != 0) {
+        UInt64 deadline = 0;
+        clock_interval_to_deadline(m_wakeupBatch.getDelay(), NSEC_PER_USEC, &deadline);
+        thread_call_enter_delayed(m_wakeupCall, deadline);
+    }
+    if ((actions & kWakeupNow) != 0) {
+        sendDataAvailableNotification();
+    } else if ((actions & kWakeupBatchFull) != 0) {
+        wakeup();
+    }
+}
+
+void EventQueue::wakeup() {
+    if (m_wakeupBatch.takeBatch() != 0) {
+        sendDataAvailableNotification();
+    }
+}
+
+void EventQueue::wakeupCallback(thread_call_param_t param0, thread_call_param_t param1) {
+    EventQueue *queue = reinterpret_cast<EventQueue *>(param0);
+    queue->wakeup();
+}
+
+void EventQueue::setWakeupCoalescing(UInt32 count, UInt32 delay) {
+    // Without a timer, a batch not filled would wait for the next one.
+    m_wakeupBatch.setCoalescing(m_wakeupCall != nullptr ? count : 1, delay);
+    // Events batched under the former values are not left waiting.
+    wakeup();
+}
+
+bool EventQueue::hasRoom(UInt32 size) const {
+    return m_ring != nullptr && m_ring->hasRoom(size);
+}
+
+UInt32 EventQueue::getUsage() const {
+    return (UInt32)((UInt64)m_ring->getUsedSize() * 100 / m_ring->getQueueSize());
+}
+
+void EventQueue::retire() {
+    if (m_ring == nullptr) {
+        return;
+    }
+    m_ring->close();
+    // Producers only hold an entry while filling it, so this is short.
+    while (!m_ring->isSettled()) {
+        IOSleep(1);
+    }
+    m_wakeupBatch.takeBatch();
+    sendDataAvailableNotification();
+}
+
+void EventQueue::abort(EventRing::Reservation *reservation) {
+    if (m_ring->abort(reservation)) {
+        return;
+    }
+
+    // Others are queued behind it, so it still goes to the client as a header only.
+    NuwaKextRecordHeader header = {};
+    header.eventType = kActionNull;
+    header.sequence = reservation->sequence;
+    void *record = (UInt8 *)dataQueue->queue + reservation->entry + DATA_QUEUE_ENTRY_HEADER_SIZE;
+    commit(reservation, closeEventRecord(record, sizeof(header), &header));
+}
+
+IOMemoryDescriptor *EventQueue::getMemoryDescriptor() {
+    if (m_memoryDescriptor == nullptr) {
+        m_memoryDescriptor = IOSharedDataQueue::getMemoryDescriptor();
+        if (m_memoryDescriptor == nullptr) {
+            return nullptr;
+        }
+    }
+    // The caller owns a reference as with IOSharedDataQueue, the queue keeps its own.
+    m_memoryDescriptor->retain();
+    return m_memoryDescriptor;
+}
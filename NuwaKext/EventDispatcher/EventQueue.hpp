@@ -0,0 +1,92 @@
+//
+//  EventQueue.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventQueue_hpp
+#define EventQueue_hpp
+
+#include <IOKit/IOSharedDataQueue.h>
+#include <kern/thread_call.h>
+#include "EventRing.hpp"
+#include "WakeupBatch.hpp"
+
+/**
+ * @brief Shared data queue whose entries are reserved, filled in place and committed
+ * Every producer goes through the ring, enqueue included, so they never corrupt each other.
+ * The client may be woken up once per batch of events rather than once per event.
+ */
+class EventQueue : public IOSharedDataQueue {
+    OSDeclareDefaultStructors(EventQueue);
+
+public:
+    static EventQueue *withEntries(UInt32 numEntries, UInt32 entrySize);
+
+    // Called by initWithEntries once the shared memory is sized.
+    Boolean initWithCapacity(UInt32 size) override;
+
+    // Called automatically when retain count drops to 0.
+    void free() override;
+
+    // Copies the data into a reserved entry.
+    Boolean enqueue(void *data, UInt32 dataSize) override;
+
+    // Called when reserve an entry of at most size bytes, nullptr if the queue is full.
+    void *reserve(UInt32 size, EventRing::Reservation *reservation);
+
+    // Called when publish a reserved entry with the number of bytes filled.
+    void commit(EventRing::Reservation *reservation, UInt32 size);
+
+    // Called when give a reserved entry up, its record is turned into a null event if it cannot be taken back.
+    void abort(EventRing::Reservation *reservation);
+
+    /**
+     * @brief Batch the wakeups of the client
+     
+     * @param count     events committed before the client is woken up, 1 wakes it up at once
+     * @param delay     max microseconds the first of them waits, 0 wakes it up at once
+     */
+    void setWakeupCoalescing(UInt32 count, UInt32 delay);
+
+    // Called when check whether an entry of size bytes fits now, without counting a drop if it does not.
+    bool hasRoom(UInt32 size) const;
+
+    // Called when obtain the percentage of the queue taken, reservations included.
+    UInt32 getUsage() const;
+
+    /**
+     * @brief Take the queue out of service, once another one takes its producers
+     * Reservations are refused from then on. It returns when those already taken are committed,
+     * and wakes the client up to drain what is left, the queue keeps its memory until released.
+     */
+    void retire();
+
+    // Called in client to map the queue, every mapping shares the descriptor and holds a reference on it.
+    IOMemoryDescriptor *getMemoryDescriptor() override;
+
+    // Called when the client maps the queue or unmaps it, or its connection goes away with the mappings.
+    void setMapped(bool mapped) {
+        m_isMapped = mapped;
+    }
+
+    // Called when check whether the client still maps the queue, its memory must not be freed then.
+    bool isMapped() const {
+        return m_isMapped;
+    }
+
+private:
+    void notifyCommitted(bool wasEmpty);
+    void wakeup();
+    static void wakeupCallback(thread_call_param_t param0, thread_call_param_t param1);
+
+    EventRing *m_ring;
+    thread_call_t m_wakeupCall;
+    IOMemoryDescriptor *m_memoryDescriptor;
+    WakeupBatch m_wakeupBatch;
+    // Handed out to the client for mapping and not unmapped since, set under the lock of EventDispatcher.
+    bool m_isMapped;
+};
+
+#endif /* EventQueue_hpp */
@@ -10,9 +10,28 @@
 #include "KextLogger.hpp"
 #include <sys/fcntl.h>
 #include <sys/proc.h>
+#include <sys/mount.h>
+#include <kern/clock.h>
 
 OSDefineMetaClassAndStructors(KauthController, OSObject);
 
+static NuwaKextAction getFileOpAction(kauth_action_t action) {
+    switch (action) {
+        case KAUTH_FILEOP_OPEN:
+            return kActionNotifyFileOpen;
+        case KAUTH_FILEOP_CLOSE:
+            return kActionNotifyFileCloseModify;
+        case KAUTH_FILEOP_DELETE:
+            return kActionNotifyFileDelete;
+        case KAUTH_FILEOP_EXEC:
+            return kActionNotifyProcessCreate;
+        case KAUTH_FILEOP_RENAME:
+            return kActionNotifyFileRename;
+        default:
+            return kActionNull;
+    }
+}
+
 #pragma mark - Kauth Controller
 
 bool KauthController::init() {
@@ -21,6 +40,8 @@ bool KauthController::init() {
     }
     
     m_activeEventCount = 0;
+    m_vnodeListener = nullptr;
+    m_fileopListener = nullptr;
     m_cacheManager = CacheManager::getInstance();
     if (m_cacheManager == nullptr) {
         return false;
@@ -45,18 +66,33 @@ void KauthController::free() {
 }
 
 bool KauthController::startListeners() {
+    // The allow and deny lists are enforced whatever is subscribed, so the vnode scope is always listened.
     m_vnodeListener = kauth_listen_scope(KAUTH_SCOPE_VNODE, vnode_scope_callback, reinterpret_cast<void *>(this));
-    if (m_vnodeListener == nullptr) {
-        return false;
-    }
-    m_fileopListener = kauth_listen_scope(KAUTH_SCOPE_FILEOP, fileop_scope_callback, reinterpret_cast<void *>(this));
-    if (m_fileopListener == nullptr) {
-        kauth_unlisten_scope(m_vnodeListener);
+    if (m_vnodeListener == nullptr || !updateListeners(m_eventDispatcher->getSubscription())) {
+        stopListeners();
         return false;
     }
     return true;
 }
 
+bool KauthController::updateListeners(UInt32 mask) {
+    bool result = true;
+    
+    UInt32 fileopMask = kSubscribeProcessCreate | kSubscribeFileOpen | kSubscribeFileCloseModify |
+        kSubscribeFileRename | kSubscribeFileDelete;
+    if (!(mask & fileopMask)) {
+        if (m_fileopListener != nullptr) {
+            kauth_unlisten_scope(m_fileopListener);
+            m_fileopListener = nullptr;
+        }
+    } else if (m_fileopListener == nullptr) {
+        m_fileopListener = kauth_listen_scope(KAUTH_SCOPE_FILEOP, fileop_scope_callback, reinterpret_cast<void *>(this));
+        result = m_fileopListener != nullptr;
+    }
+    
+    return result;
+}
+
 void KauthController::stopListeners() {
     static timespec wait = {
         .tv_sec = 0,
@@ -65,10 +101,9 @@ void KauthController::stopListeners() {
     
     if (m_vnodeListener != nullptr) {
         kauth_unlisten_scope(m_vnodeListener);
+        m_vnodeListener = nullptr;
     }
-    if (m_fileopListener != nullptr) {
-        kauth_unlisten_scope(m_fileopListener);
-    }
+    updateListeners(0);
     while (m_activeEventCount > 0) {
         msleep(nullptr, nullptr, 0, "wait for kauth stopped", &wait);
     }
@@ -107,19 +142,16 @@ int KauthController::getDecisionFromClient(UInt64 vnodeID) {
 
 int KauthController::vnodeCallback(const vfs_context_t ctx, const vnode_t vp, int *errno) {
     int response = KAUTH_RESULT_DEFER;
-    NuwaKextEvent *event = (NuwaKextEvent *)IOMallocAligned(sizeof(NuwaKextEvent), 2);
-    if (event == nullptr) {
-        return response;
-    }
-    
-    bzero(event, sizeof(NuwaKextEvent));
-    event->eventType = kActionAuthProcessCreate;
-    if (fillEventInfo(event, ctx, ctx, vp) == 0) {
-        NuwaKextProcType type = (NuwaKextProcType)m_listManager->obtainAuthProcessList(event->vnodeID);
+    NuwaKextRecordHeader header = {};
+    header.eventType = kActionAuthProcessCreate;
+    if (fillEventInfo(&header, ctx, ctx, vp) == 0) {
+        NuwaKextProcType type = (NuwaKextProcType)m_listManager->obtainAuthProcessList(header.vnodeID);
         switch (type) {
             case kProcPlainType:
-                if (m_eventDispatcher->postToAuthQueue(event)) {
-                    response = getDecisionFromClient(event->vnodeID);
+                // Only the client decision waits for exec auth being subscribed, the lists above never do.
+                if (m_eventDispatcher->isSubscribed(kActionAuthProcessCreate) &&
+                    postFileEvent(&header, ctx, vp, nullptr, nullptr, 0)) {
+                    response = getDecisionFromClient(header.vnodeID);
                 }
                 break;
             case kProcWhiteType:
@@ -133,63 +165,49 @@ int KauthController::vnodeCallback(const vfs_context_t ctx, const vnode_t vp, in
     
     if (response == KAUTH_RESULT_DEFER || response == KAUTH_RESULT_ALLOW) {
         // Notify exec event may obtain ppid as pid, so cache info here.
-        UInt64 value = ((UInt64)event->mainProcess.pid << 32) | event->mainProcess.ppid;
-        m_cacheManager->updateAuthExecCache(event->vnodeID, value);
+        UInt64 value = ((UInt64)header.mainProcess.pid << 32) | header.mainProcess.ppid;
+        m_cacheManager->updateAuthExecCache(header.vnodeID, value);
     }
     
-    IOFreeAligned(event, sizeof(NuwaKextEvent));
     return response;
 }
 
 void KauthController::fileOpCallback(kauth_action_t action, const vnode_t vp, const char *srcPath, const char *newPath) {
     errno_t errCode = 0;
-    NuwaKextEvent *event = (NuwaKextEvent *)IOMallocAligned(sizeof(NuwaKextEvent), 2);
-    if (event == nullptr) {
+    NuwaKextAction eventType = getFileOpAction(action);
+    if (!m_eventDispatcher->isSubscribed(eventType)) {
+        if (action == KAUTH_FILEOP_EXEC) {
+            // File events of the new process may still be subscribed.
+            m_listManager->updateMutedProcess(proc_selfpid(), srcPath);
+        }
+        return;
+    }
+    if (action != KAUTH_FILEOP_EXEC && isMutedFileOp(vp, srcPath, newPath)) {
         return;
     }
     
-    bzero(event, sizeof(NuwaKextEvent));
+    NuwaKextRecordHeader header = {};
     vfs_context_t procCtx = vfs_context_create(nullptr);
     vfs_context_t fileCtx = vfs_context_create(nullptr);
-    switch (action) {
-        case KAUTH_FILEOP_OPEN:
-            event->eventType = kActionNotifyFileOpen;
-            strlcpy(event->fileOpen.path, srcPath, kMaxPathLength);
-            break;
-        case KAUTH_FILEOP_CLOSE:
-            event->eventType = kActionNotifyFileCloseModify;
-            strlcpy(event->fileCloseModify.path, srcPath, kMaxPathLength);
-            break;
-        case KAUTH_FILEOP_DELETE:
-            event->eventType = kActionNotifyFileDelete;
-            strlcpy(event->fileDelete.path, srcPath, kMaxPathLength);
-            break;
-        case KAUTH_FILEOP_EXEC:
-            event->eventType = kActionNotifyProcessCreate;
-            strlcpy(event->processCreate.path, srcPath, kMaxPathLength);
-            break;
-        case KAUTH_FILEOP_RENAME:
-            event->eventType = kActionNotifyFileRename;
-            strlcpy(event->fileRename.srcFile.path, srcPath, kMaxPathLength);
-            strlcpy(event->fileRename.newPath, newPath, kMaxPathLength);
-            break;
-            
-        default:
-            break;
-    }
+    header.eventType = eventType;
     
-    errCode = fillEventInfo(event, procCtx, fileCtx, vp);
+    errCode = fillEventInfo(&header, procCtx, fileCtx, vp);
     if (action == KAUTH_FILEOP_EXEC) {
-        UInt64 result = m_cacheManager->obtainAuthExecCache(event->vnodeID);
+        UInt64 result = m_cacheManager->obtainAuthExecCache(header.vnodeID);
         // Notify exec event may obtain outdated pid, here modify it with cache info.
-        if ((result >> 32) != event->mainProcess.pid) {
-            event->mainProcess.pid = result >> 32;
-            event->mainProcess.ppid = (result << 32) >> 32;
+        // Nothing is cached when the exec was not seen by the vnode scope, the pid obtained is kept then.
+        if (result != 0 && (result >> 32) != header.mainProcess.pid) {
+            header.mainProcess.pid = result >> 32;
+            header.mainProcess.ppid = (result << 32) >> 32;
         }
+        m_listManager->updateMutedProcess(header.mainProcess.pid, srcPath);
     }
     if (errCode == 0) {
-        if (action == KAUTH_FILEOP_EXEC || !m_listManager->obtainFilterFileList(event->vnodeID)) {
-            m_eventDispatcher->postToNotifyQueue(event);
+        // Filtered and coalesced before any queue room is taken.
+        UInt32 repeats = 0;
+        bool isFiltered = action != KAUTH_FILEOP_EXEC && m_listManager->obtainFilterFileList(header.vnodeID);
+        if (!isFiltered && !isRepeatedFileOp(&header, &repeats) && !m_eventDispatcher->isThrottled(&header)) {
+            postFileEvent(&header, fileCtx, vp, srcPath, newPath, repeats);
         }
     }
     
@@ -199,18 +217,138 @@ void KauthController::fileOpCallback(kauth_action_t action, const vnode_t vp, co
     if (fileCtx != nullptr) {
         vfs_context_rele(fileCtx);
     }
-    IOFreeAligned(event, sizeof(NuwaKextEvent));
+}
+
+bool KauthController::isRepeatedFileOp(const NuwaKextRecordHeader *header, UInt32 *repeats) {
+    EventRepeatEntry dropped[kMaxDroppedRepeats];
+    UInt32 dropCount = kMaxDroppedRepeats;
+    *repeats = 0;
+    if (((1 << EventDispatcher::getEventClass(header->eventType)) & kCoalescedEventClasses) == 0) {
+        return false;
+    }
+    
+    bool result = m_cacheManager->updateEventRepeatCache(header->eventType, header->mainProcess.pid, header->vnodeID,
+                                                         repeats, dropped, &dropCount);
+    for (UInt32 i = 0; i < dropCount; ++i) {
+        // Expired or evicted before the event came again, its repeats are sent on their own.
+        NuwaKextRecordHeader summaryHeader = {};
+        summaryHeader.eventType = (NuwaKextAction)dropped[i].key.eventType;
+        summaryHeader.vnodeID = dropped[i].key.vnodeID;
+        summaryHeader.eventTime = header->eventTime;
+        summaryHeader.eventUptime = header->eventUptime;
+        summaryHeader.mainProcess.pid = dropped[i].key.pid;
+        m_eventDispatcher->postRepeatSummary(&summaryHeader, dropped[i].value);
+    }
+    return result;
+}
+
+bool KauthController::postFileEvent(const NuwaKextRecordHeader *header, const vfs_context_t ctx, const vnode_t vp,
+                                    const char *srcPath, const char *newPath, UInt32 repeats) {
+    EventReservation reservation;
+    UInt32 offset = sizeof(NuwaKextRecordHeader);
+    UInt32 newLength = newPath != nullptr ? (UInt32)strnlen(newPath, kMaxPathLength - 1) : 0;
+    // Only a path left to vn_getpath needs the room of the longest one.
+    UInt32 pathLength = srcPath != nullptr ? (UInt32)strnlen(srcPath, kMaxPathLength - 1) : kMaxPathLength;
+    UInt32 size = alignRecordSize(offset + sizeof(NuwaKextRecordField) + sizeof(NuwaKextFileAttr)) +
+        alignRecordSize(sizeof(NuwaKextRecordField) + pathLength);
+    if (newPath != nullptr) {
+        size += alignRecordSize(sizeof(NuwaKextRecordField) + newLength);
+    }
+    if (repeats != 0) {
+        size += alignRecordSize(sizeof(NuwaKextRecordField) + sizeof(UInt32));
+    }
+    
+    // Without a known path, vn_getpath writes it right into the queue, the unused room is given back on commit.
+    UInt8 *record = (UInt8 *)m_eventDispatcher->reserveEvent(header->eventType, size, &reservation);
+    if (record == nullptr) {
+        return false;
+    }
+    UInt32 pathOffset = alignRecordSize(offset + sizeof(NuwaKextRecordField) + sizeof(NuwaKextFileAttr));
+    char *path = (char *)openRecordField(record, size, pathOffset, pathLength);
+    NuwaKextFileAttr fileAttr = {};
+    errno_t errCode = 0;
+    if (srcPath != nullptr) {
+        memcpy(path, srcPath, pathLength);
+        errCode = fillFileInfo(&fileAttr, nullptr, ctx, vp);
+    } else {
+        path[0] = '\0';
+        errCode = fillFileInfo(&fileAttr, path, ctx, vp);
+        pathLength = (UInt32)strnlen(path, kMaxPathLength - 1);
+    }
+    if (errCode != 0) {
+        Logger(LOG_WARN, "Failed to fill file info [%d].", errCode)
+        m_eventDispatcher->abortEvent(&reservation);
+        return false;
+    }
+    offset = appendRecordField(record, size, offset, kRecordFieldFileAttr, &fileAttr, sizeof(NuwaKextFileAttr));
+    offset = closeRecordField(record, offset, kRecordFieldPath, pathLength);
+    if (newPath != nullptr) {
+        offset = appendRecordField(record, size, offset, kRecordFieldNewPath, newPath, newLength);
+    }
+    if (repeats != 0) {
+        offset = appendRecordField(record, size, offset, kRecordFieldRepeats, &repeats, sizeof(UInt32));
+    }
+    return m_eventDispatcher->commitEvent(&reservation, closeEventRecord(record, offset, header));
+}
+
+bool KauthController::isMutedFileOp(const vnode_t vp, const char *srcPath, const char *newPath) {
+    // Checked before any info is gathered, so muted subtrees cost a lookup only.
+    if (m_listManager->hasExcludedFsids()) {
+        // A rename has no vnode, the item is found at its new path, on the same filesystem as the old one.
+        UInt32 fsid = vp != nullptr ? getVnodeFsid(vp) : getPathFsid(newPath != nullptr ? newPath : srcPath);
+        if (fsid != 0 && m_listManager->obtainExcludedFsid(fsid)) {
+            return true;
+        }
+    }
+    if (m_listManager->obtainMutedProcess(proc_selfpid())) {
+        return true;
+    }
+    // A rename is muted when both sides are.
+    return m_listManager->obtainFilterPathList(srcPath) &&
+        (newPath == nullptr || m_listManager->obtainFilterPathList(newPath));
 }
 
 #pragma mark - Info Filler Methods
 
-errno_t KauthController::fillBasicInfo(NuwaKextEvent *eventInfo, const vfs_context_t ctx, const vnode_t vp) {
+UInt32 KauthController::getVnodeFsid(const vnode_t vp) {
+    // Same as va_fsid, without the cost of vnode_getattr.
+    mount_t mount = vnode_mount(vp);
+    if (mount == nullptr) {
+        return 0;
+    }
+    return vfs_statfs(mount)->f_fsid.val[0];
+}
+
+UInt32 KauthController::getPathFsid(const char *path) {
+    UInt32 fsid = 0;
+    vnode_t vp = nullptr;
+    if (path == nullptr) {
+        return fsid;
+    }
+    
+    // The item itself, not what a symlink points to, which may be on another filesystem.
+    vfs_context_t ctx = vfs_context_create(nullptr);
+    if (vnode_lookup(path, VNODE_LOOKUP_NOFOLLOW, &vp, ctx) == 0) {
+        fsid = getVnodeFsid(vp);
+        vnode_put(vp);
+    }
+    if (ctx != nullptr) {
+        vfs_context_rele(ctx);
+    }
+    return fsid;
+}
+
+errno_t KauthController::fillBasicInfo(NuwaKextRecordHeader *header, const vfs_context_t ctx, const vnode_t vp) {
     errno_t errCode = 0;
     timeval time;
     vnode_attr vap;
     
+    UInt64 uptime = 0;
+    
     microtime(&time);
-    eventInfo->eventTime = time.tv_sec;
+    header->eventTime = time.tv_sec;
+    clock_get_uptime(&uptime);
+    absolutetime_to_nanoseconds(uptime, &header->eventUptime);
     if (ctx == nullptr || vp == nullptr) {
         return errCode;
     }
@@ -220,7 +358,7 @@ errno_t KauthController::fillBasicInfo(NuwaKextEvent *eventInfo, const vfs_conte
     VATTR_WANTED(&vap, va_fileid);
     errCode = vnode_getattr(vp, &vap, ctx);
     if (errCode == 0) {
-        eventInfo->vnodeID = ((UInt64)vap.va_fsid << 32) | vap.va_fileid;
+        header->vnodeID = ((UInt64)vap.va_fsid << 32) | vap.va_fileid;
     }
     
     return errCode;
@@ -249,7 +387,7 @@ errno_t KauthController::fillProcInfo(NuwaKextProc *ProctInfo, const vfs_context
     return 0;
 }
 
-errno_t KauthController::fillFileInfo(NuwaKextFile *FileInfo, const vfs_context_t ctx, const vnode_t vp) {
+errno_t KauthController::fillFileInfo(NuwaKextFileAttr *FileInfo, char *path, const vfs_context_t ctx, const vnode_t vp) {
     errno_t errCode = 0;
     int length = kMaxPathLength;
     vnode_attr vap;
@@ -274,49 +412,28 @@ errno_t KauthController::fillFileInfo(NuwaKextFile *FileInfo, const vfs_context_
         FileInfo->atime = vap.va_access_time.tv_sec;
         FileInfo->mtime = vap.va_modify_time.tv_sec;
         FileInfo->ctime = vap.va_change_time.tv_sec;
-        errCode = vn_getpath(vp, FileInfo->path, &length);
+        if (path != nullptr) {
+            errCode = vn_getpath(vp, path, &length);
+        }
     }
     
     return errCode;
 }
 
-errno_t KauthController::fillEventInfo(NuwaKextEvent *event, const vfs_context_t procCtx, const vfs_context_t fileCtx, const vnode_t fileVp) {
+errno_t KauthController::fillEventInfo(NuwaKextRecordHeader *header, const vfs_context_t procCtx, const vfs_context_t fileCtx, const vnode_t fileVp) {
     errno_t errCode = 0;
-    NuwaKextFile *fileInfo = nullptr;
-    
-    switch (event->eventType) {
-        case kActionAuthProcessCreate:
-        case kActionNotifyProcessCreate:
-        case kActionNotifyFileOpen:
-        case kActionNotifyFileCloseModify:
-        case kActionNotifyFileDelete:
-            fileInfo = &event->fileDelete;
-            break;
-            
-        case kActionNotifyFileRename:
-            fileInfo = &event->fileRename.srcFile;
-            break;
-            
-        default:
-            break;
-    }
     
-    errCode = fillBasicInfo(event, fileCtx, fileVp);
+    errCode = fillBasicInfo(header, fileCtx, fileVp);
     if (errCode != 0 && errCode != ENOENT) {
         Logger(LOG_WARN, "Failed to fill basic info [%d].", errCode)
         return errCode;
     }
-    errCode = fillProcInfo(&event->mainProcess, procCtx);
+    errCode = fillProcInfo(&header->mainProcess, procCtx);
     if (errCode != 0) {
         Logger(LOG_WARN, "Failed to fill proc info [%d].", errCode)
         return errCode;
     }
-    errCode = fillFileInfo(fileInfo, fileCtx, fileVp);
-    if (errCode != 0) {
-        Logger(LOG_WARN, "Failed to fill file info [%d].", errCode)
-        return errCode;
-    }
-    return errCode;
+    return 0;
 }
 
 #pragma mark - Callback Methods
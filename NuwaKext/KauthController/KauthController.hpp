@@ -30,6 +30,9 @@ public:
     // Stops the kauth listeners.
     void stopListeners();
     
+    // Listens to the fileop scope only while its event classes are subscribed, the vnode scope stays.
+    bool updateListeners(UInt32 mask);
+    
     void increaseEventCount();
     void decreaseEventCount();
     
@@ -38,11 +41,17 @@ public:
     
 private:
     int getDecisionFromClient(UInt64 vnodeID);
+    bool isMutedFileOp(const vnode_t vp, const char *srcPath, const char *newPath);
+    bool isRepeatedFileOp(const NuwaKextRecordHeader *header, UInt32 *repeats);
+    bool postFileEvent(const NuwaKextRecordHeader *header, const vfs_context_t ctx, const vnode_t vp,
+                       const char *srcPath, const char *newPath, UInt32 repeats);
     
-    errno_t fillBasicInfo(NuwaKextEvent *eventInfo, const vfs_context_t ctx, const vnode_t vp);
+    UInt32 getVnodeFsid(const vnode_t vp);
+    UInt32 getPathFsid(const char *path);
+    errno_t fillBasicInfo(NuwaKextRecordHeader *header, const vfs_context_t ctx, const vnode_t vp);
     errno_t fillProcInfo(NuwaKextProc *ProctInfo, const vfs_context_t ctx);
-    errno_t fillFileInfo(NuwaKextFile *FileInfo, const vfs_context_t ctx, const vnode_t vp);
-    errno_t fillEventInfo(NuwaKextEvent *event, const vfs_context_t procCtx, const vfs_context_t fileCtx, const vnode_t fileVp);
+    errno_t fillFileInfo(NuwaKextFileAttr *FileInfo, char *path, const vfs_context_t ctx, const vnode_t vp);
+    errno_t fillEventInfo(NuwaKextRecordHeader *header, const vfs_context_t procCtx, const vfs_context_t fileCtx, const vnode_t fileVp);
     
     kauth_listener_t m_vnodeListener;
     kauth_listener_t m_fileopListener;
@@ -55,12 +55,14 @@ void DriverClient::stop(IOService *provider) {
 
 IOReturn DriverClient::clientDied() {
     m_eventDispatcher->setConnectionStatus(false);
+    m_eventDispatcher->unmapQueues();
     Logger(LOG_INFO, "Client died.")
     return terminate(0) ? kIOReturnSuccess : kIOReturnError;
 }
 
 IOReturn DriverClient::clientClose() {
     m_eventDispatcher->setConnectionStatus(false);
+    m_eventDispatcher->unmapQueues();
     if (m_driverService != nullptr && m_driverService->isOpen(this)) {
         m_driverService->close(this);
     }
@@ -86,31 +88,24 @@ IOReturn DriverClient::registerNotificationPort(mach_port_t port, UInt32 type, U
         return kIOReturnError;
     }
     
-    switch (type) {
-        case kQueueTypeAuth:
-        case kQueueTypeNotify:
-            m_eventDispatcher->setNotificationPortForQueue(type, port);
-            break;
-        default:
-            return kIOReturnBadArgument;
+    if (type >= kQueueTypeNotify + kNotifyRingCount) {
+        return kIOReturnBadArgument;
     }
     
+    m_eventDispatcher->setNotificationPortForQueue(type, port);
     return kIOReturnSuccess;
 }
 
 IOReturn DriverClient::clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) {
-    switch (type) {
-        case kQueueTypeAuth:
-        case kQueueTypeNotify:
-            *options = 0;
-            *memory = m_eventDispatcher->getMemoryDescriptorForQueue(type);
-            break;
-        default:
-            return kIOReturnBadArgument;
+    if (type >= kQueueTypeNotify + kNotifyRingCount) {
+        return kIOReturnBadArgument;
     }
-
-    (*memory)->retain();
-    return kIOReturnSuccess;
+    
+    *options = 0;
+    // Called for IOConnectUnmapMemory too, which finds the mapping from the descriptor returned.
+    *memory = m_eventDispatcher->getMemoryDescriptorForQueue(type);
+    // Its reference is consumed by the caller, the mapping holds the descriptor until the client unmaps it.
+    return *memory != nullptr ? kIOReturnSuccess : kIOReturnError;
 }
 
 #pragma mark Callable Methods
@@ -180,7 +175,7 @@ IOReturn DriverClient::updateMuteList(OSObject* target, void* reference, IOExter
     }
     
     NuwaKextMuteInfo *info = (NuwaKextMuteInfo *)arguments->structureInput;
-    // It's unsupported to filter file event by proc paths in kext for now.
+    // Processes are muted by path prefix, see updateMutePaths.
     if (info->muteType == kAllowAuthExec || info->muteType == kDenyAuthExec) {
         me->m_listManager->updateAuthProcessList(info->vnodeIDs, info->muteType);
     } else if (info->muteType == kFilterFileByFilePath) {
@@ -190,6 +185,310 @@ IOReturn DriverClient::updateMuteList(OSObject* target, void* reference, IOExter
     return kIOReturnSuccess;
 }
 
+IOReturn DriverClient::setCacheLifetime(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    NuwaKextCacheType type = (NuwaKextCacheType)arguments->scalarInput[0];
+    UInt32 lifetime = (UInt32)arguments->scalarInput[1];
+    if (!me->m_cacheManager->setCacheLifetime(type, lifetime)) {
+        return kIOReturnBadArgument;
+    }
+    Logger(LOG_INFO, "Lifetime of cache [%d] is setted to be %u ms", type, lifetime)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::copyStructInput(IOExternalMethodArguments *arguments, UInt32 maxSize,
+                                       const void **input, UInt32 *size, void **buffer) {
+    *size = arguments->structureInputSize;
+    *input = arguments->structureInput;
+    *buffer = nullptr;
+    if (arguments->structureInputDescriptor == nullptr) {
+        return kIOReturnSuccess;
+    }
+    
+    // Large inputs arrive out of line, copy them so the client cannot change them meanwhile.
+    IOMemoryDescriptor *descriptor = arguments->structureInputDescriptor;
+    UInt32 length = (UInt32)descriptor->getLength();
+    if (length > maxSize) {
+        return kIOReturnInvalid;
+    }
+    void *copy = IOMallocAligned(length, 2);
+    if (copy == nullptr) {
+        return kIOReturnNoMemory;
+    }
+    bool copied = descriptor->prepare() == kIOReturnSuccess;
+    if (copied) {
+        copied = descriptor->readBytes(0, copy, length) == length;
+        descriptor->complete();
+    }
+    if (!copied) {
+        IOFreeAligned(copy, length);
+        return kIOReturnInvalid;
+    }
+    
+    *size = length;
+    *input = copy;
+    *buffer = copy;
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::updateMuteDelta(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt32 size = 0;
+    const void *input = nullptr;
+    void *buffer = nullptr;
+    IOReturn result = copyStructInput(arguments, sizeof(NuwaKextMuteDelta) + sizeof(UInt64) * kMaxMuteDeltaItems, &input, &size, &buffer);
+    if (result != kIOReturnSuccess) {
+        return result;
+    }
+    
+    const NuwaKextMuteDelta *delta = (const NuwaKextMuteDelta *)input;
+    if (input == nullptr || size < sizeof(NuwaKextMuteDelta) ||
+        (UInt64)delta->addCount + delta->removeCount > kMaxMuteDeltaItems ||
+        size != sizeof(NuwaKextMuteDelta) + sizeof(UInt64) * (delta->addCount + delta->removeCount)) {
+        result = kIOReturnInvalid;
+    } else {
+        switch (me->m_listManager->updateMuteDelta(delta, (const UInt64 *)(delta + 1), &arguments->scalarOutput[0])) {
+            case kListUpdateSuccess:
+                break;
+            case kListUpdateStale:
+                result = kIOReturnNotPermitted;
+                break;
+            case kListUpdateNoMemory:
+                result = kIOReturnNoMemory;
+                break;
+            default:
+                result = kIOReturnBadArgument;
+                break;
+        }
+    }
+    
+    if (buffer != nullptr) {
+        IOFreeAligned(buffer, size);
+    }
+    return result;
+}
+
+IOReturn DriverClient::setListBudget(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt64 budget = arguments->scalarInput[0];
+    me->m_listManager->setMemoryBudget(budget);
+    Logger(LOG_INFO, "Memory budget of mute lists is setted to be %llu bytes", budget)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::updateMutePaths(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt32 size = 0;
+    const void *input = nullptr;
+    void *buffer = nullptr;
+    IOReturn result = copyStructInput(arguments, sizeof(NuwaKextMutePaths) + kMaxMutePathsSize, &input, &size, &buffer);
+    if (result != kIOReturnSuccess) {
+        return result;
+    }
+    
+    const NuwaKextMutePaths *info = (const NuwaKextMutePaths *)input;
+    if (input == nullptr || size < sizeof(NuwaKextMutePaths) || info->size > kMaxMutePathsSize ||
+        size != sizeof(NuwaKextMutePaths) + info->size) {
+        result = kIOReturnInvalid;
+    } else {
+        switch (me->m_listManager->updateMutePaths(info->muteType, (const char *)(info + 1), info->size)) {
+            case kListUpdateSuccess:
+                break;
+            case kListUpdateNoMemory:
+                result = kIOReturnNoMemory;
+                break;
+            default:
+                result = kIOReturnBadArgument;
+                break;
+        }
+    }
+    
+    if (buffer != nullptr) {
+        IOFreeAligned(buffer, size);
+    }
+    return result;
+}
+
+IOReturn DriverClient::setExcludedFsids(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    UInt32 size = arguments->structureInputSize;
+    if (arguments->structureInput == nullptr || size % sizeof(UInt32) != 0 ||
+        size > sizeof(UInt32) * kMaxExcludedFsids) {
+        return kIOReturnInvalid;
+    }
+    
+    UInt32 count = size / sizeof(UInt32);
+    if (me->m_listManager->updateExcludedFsids((const UInt32 *)arguments->structureInput, count) != kListUpdateSuccess) {
+        return kIOReturnNoMemory;
+    }
+    Logger(LOG_INFO, "File events of %u filesystems are excluded", count)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::getFsidDrops(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    if (arguments->structureOutput == nullptr) {
+        return kIOReturnInvalid;
+    }
+    
+    UInt32 count = arguments->structureOutputSize / sizeof(NuwaKextFsidDrops);
+    count = me->m_listManager->obtainFsidDrops((NuwaKextFsidDrops *)arguments->structureOutput, count);
+    arguments->structureOutputSize = count * sizeof(NuwaKextFsidDrops);
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setSubscription(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr || me->m_driverService == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt32 mask = (UInt32)arguments->scalarInput[0];
+    if (!me->m_driverService->setSubscription(mask)) {
+        return kIOReturnError;
+    }
+    Logger(LOG_INFO, "Subscription is setted to be 0x%x", mask)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setWakeupCoalescing(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt64 count = arguments->scalarInput[0];
+    UInt64 delay = arguments->scalarInput[1];
+    if (count > kMaxNotifyQueueEvents || delay > kMaxWakeupDelay) {
+        return kIOReturnBadArgument;
+    }
+    me->m_eventDispatcher->setWakeupCoalescing((UInt32)count, (UInt32)delay);
+    Logger(LOG_INFO, "Wakeup is setted to be after %llu events or %llu us", count, delay)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::getEventCounters(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    if (arguments->structureOutput == nullptr) {
+        return kIOReturnInvalid;
+    }
+    
+    UInt32 count = arguments->structureOutputSize / sizeof(NuwaKextEventCounters);
+    count = me->m_eventDispatcher->obtainEventCounters((NuwaKextEventCounters *)arguments->structureOutput, count);
+    arguments->structureOutputSize = count * sizeof(NuwaKextEventCounters);
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setCriticalClasses(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt32 mask = (UInt32)arguments->scalarInput[0];
+    me->m_eventDispatcher->setCriticalClasses(mask);
+    Logger(LOG_INFO, "Critical classes are setted to be 0x%x", mask)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setRateLimit(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt64 mask = arguments->scalarInput[0];
+    UInt64 rate = arguments->scalarInput[1];
+    UInt64 burst = arguments->scalarInput[2];
+    if (mask > kSubscribeAll || rate > UINT32_MAX || burst > UINT32_MAX) {
+        return kIOReturnBadArgument;
+    }
+    me->m_eventDispatcher->setRateLimit((UInt32)mask, (UInt32)rate, (UInt32)burst);
+    Logger(LOG_INFO, "Rate limit of 0x%llx is setted to be %llu/s burst %llu", mask, rate, burst)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setQueueSize(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    UInt64 type = arguments->scalarInput[0];
+    UInt64 entries = arguments->scalarInput[1];
+    if ((type != kQueueTypeAuth && type != kQueueTypeCritical && type != kQueueTypeNotify) ||
+        entries < kMinResizedQueueEvents || entries > kMaxResizedQueueEvents) {
+        return kIOReturnBadArgument;
+    }
+    UInt32 effective = 0;
+    IOReturn result = me->m_eventDispatcher->resizeQueue((UInt32)type, (UInt32)entries, &effective);
+    if (result != kIOReturnSuccess) {
+        return result;
+    }
+    // The client maps the queues of the type again to see the new ones.
+    arguments->scalarOutput[0] = effective;
+    Logger(LOG_INFO, "Queue of type %llu is setted to be %u entries", type, effective)
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::getCacheCounters(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    if (arguments->structureOutput == nullptr) {
+        return kIOReturnInvalid;
+    }
+    
+    UInt32 count = arguments->structureOutputSize / sizeof(NuwaKextCacheCounters);
+    count = me->m_cacheManager->obtainCacheCounters((NuwaKextCacheCounters *)arguments->structureOutput, count);
+    arguments->structureOutputSize = count * sizeof(NuwaKextCacheCounters);
+    return kIOReturnSuccess;
+}
+
+IOReturn DriverClient::setCacheCapacity(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    DriverClient *me = OSDynamicCast(DriverClient, target);
+    if (me == nullptr) {
+        return kIOReturnBadArgument;
+    }
+    
+    NuwaKextCacheType type = (NuwaKextCacheType)arguments->scalarInput[0];
+    UInt64 capacity = arguments->scalarInput[1];
+    if (capacity == 0 || capacity > kMaxCacheCapacity) {
+        return kIOReturnBadArgument;
+    }
+    if (!me->m_cacheManager->setCacheCapacity(type, (UInt32)capacity)) {
+        return kIOReturnBadArgument;
+    }
+    Logger(LOG_INFO, "Capacity of cache [%d] is setted to be %llu items", type, capacity)
+    return kIOReturnSuccess;
+}
+
 #pragma mark Method Resolution
 
 IOReturn DriverClient::externalMethod(UInt32 selector, IOExternalMethodArguments *arguments,
@@ -201,7 +500,21 @@ IOReturn DriverClient::externalMethod(UInt32 selector, IOExternalMethodArguments
         { &DriverClient::allowBinary, 1, 0, 0, 0 },
         { &DriverClient::denyBinary, 1, 0, 0, 0 },
         { &DriverClient::setLogLevel, 1, 0, 0, 0 },
-        { &DriverClient::updateMuteList, 0, sizeof(NuwaKextMuteInfo), 0, 0 }
+        { &DriverClient::updateMuteList, 0, sizeof(NuwaKextMuteInfo), 0, 0 },
+        { &DriverClient::setCacheLifetime, 2, 0, 0, 0 },
+        { &DriverClient::updateMuteDelta, 0, kIOUCVariableStructureSize, 1, 0 },
+        { &DriverClient::setListBudget, 1, 0, 0, 0 },
+        { &DriverClient::updateMutePaths, 0, kIOUCVariableStructureSize, 0, 0 },
+        { &DriverClient::setExcludedFsids, 0, kIOUCVariableStructureSize, 0, 0 },
+        { &DriverClient::getFsidDrops, 0, 0, 0, kIOUCVariableStructureSize },
+        { &DriverClient::setSubscription, 1, 0, 0, 0 },
+        { &DriverClient::setWakeupCoalescing, 2, 0, 0, 0 },
+        { &DriverClient::getEventCounters, 0, 0, 0, kIOUCVariableStructureSize },
+        { &DriverClient::setCriticalClasses, 1, 0, 0, 0 },
+        { &DriverClient::setRateLimit, 3, 0, 0, 0 },
+        { &DriverClient::setQueueSize, 2, 0, 1, 0 },
+        { &DriverClient::getCacheCounters, 0, 0, 0, kIOUCVariableStructureSize },
+        { &DriverClient::setCacheCapacity, 2, 0, 0, 0 }
     };
 
     if (selector >= static_cast<UInt32>(kNuwaUserClientMethodsNumber)) {
@@ -61,7 +61,52 @@ public:
     // Called to add process to the white list.
     static IOReturn updateMuteList(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
     
+    // Called to set the entry lifetime of a kext cache.
+    static IOReturn setCacheLifetime(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to apply a chunk of changes to a mute list.
+    static IOReturn updateMuteDelta(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to set the max memory taken by one mute list.
+    static IOReturn setListBudget(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to replace the path prefixes muting file events.
+    static IOReturn updateMutePaths(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to replace the filesystems whose file events are dropped.
+    static IOReturn setExcludedFsids(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to obtain the file events dropped on each excluded filesystem.
+    static IOReturn getFsidDrops(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to set the event classes the client subscribes to.
+    static IOReturn setSubscription(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to batch the wakeups for notify events, by count and by delay.
+    static IOReturn setWakeupCoalescing(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to obtain the enqueued, dropped and sampled counts of each event class.
+    static IOReturn getEventCounters(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to set the notify event classes sent to the critical lane.
+    static IOReturn setCriticalClasses(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to set the rate limit of each process for the notify event classes.
+    static IOReturn setRateLimit(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to resize the queues of a type while connected, returns the entries they got.
+    static IOReturn setQueueSize(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to obtain the hit, miss, eviction and expiration counts of each kext cache.
+    static IOReturn getCacheCounters(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
+    // Called to set the max number of items of a kext cache.
+    static IOReturn setCacheCapacity(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    
 private:
+    // Called to obtain the struct input, copied aside when it arrives out of line.
+    static IOReturn copyStructInput(IOExternalMethodArguments *arguments, UInt32 maxSize, const void **input, UInt32 *size, void **buffer);
+    
     CacheManager *m_cacheManager;
     ListManager *m_listManager;
     EventDispatcher *m_eventDispatcher;
@@ -36,6 +36,11 @@ void DriverService::clearInstances() {
         m_socketFilter->release();
         m_socketFilter = nullptr;
     }
+    
+    if (m_subscribeLock != nullptr) {
+        lck_mtx_free(m_subscribeLock, g_driverLockGrp);
+        m_subscribeLock = nullptr;
+    }
 }
 
 bool DriverService::start(IOService *provider) {
@@ -48,8 +53,9 @@ bool DriverService::start(IOService *provider) {
     m_eventDispatcher = EventDispatcher::getInstance();
     m_kauthController = new KauthController();
     m_socketFilter = new SocketFilter();
+    m_subscribeLock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
     if (m_cacheManager == nullptr || m_listManager == nullptr || m_eventDispatcher == nullptr || 
-        m_kauthController == nullptr || m_socketFilter == nullptr) {
+        m_kauthController == nullptr || m_socketFilter == nullptr || m_subscribeLock == nullptr) {
         clearInstances();
         return false;
     }
@@ -57,7 +63,7 @@ bool DriverService::start(IOService *provider) {
         clearInstances();
         return false;
     }
-    if (!m_kauthController->startListeners() || !m_socketFilter->registerFilters()) {
+    if (!m_kauthController->startListeners() || !m_socketFilter->updateFilters(m_eventDispatcher->getSubscription())) {
         clearInstances();
         return false;
     }
@@ -68,6 +74,20 @@ bool DriverService::start(IOService *provider) {
     return true;
 }
 
+bool DriverService::setSubscription(UInt32 mask) {
+    lck_mtx_lock(m_subscribeLock);
+    // Masked first, so the callbacks still running skip the events no longer wanted.
+    m_eventDispatcher->setSubscription(mask);
+    bool result = m_kauthController->updateListeners(mask);
+    result = m_socketFilter->updateFilters(mask) && result;
+    lck_mtx_unlock(m_subscribeLock);
+    
+    if (!result) {
+        Logger(LOG_ERROR, "Failed to update listeners for subscription [0x%x].", mask)
+    }
+    return result;
+}
+
 void DriverService::stop(IOService *provider) {
     m_kauthController->stopListeners();
     m_socketFilter->unregisterFilters();
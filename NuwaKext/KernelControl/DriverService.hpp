@@ -26,9 +26,15 @@ public:
     // Called by the kernel when the kext is unloaded
     void stop(IOService *provider) override;
     
+    // Called when client subscribes to event classes, unused listeners and filters are removed.
+    bool setSubscription(UInt32 mask);
+    
 private:
     void clearInstances();
     
+    // Serializes the changes of subscription.
+    lck_mtx_t *m_subscribeLock;
+    
     CacheManager *m_cacheManager;
     ListManager *m_listManager;
     KauthController *m_kauthController;
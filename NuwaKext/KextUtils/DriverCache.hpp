@@ -8,171 +8,1071 @@
 #ifndef DriverCache_hpp
 #define DriverCache_hpp
 
-#include <IOKit/IOLib.h>
-#include <libkern/OSTypes.h>
-
-extern lck_attr_t *g_driverLockAttr;
-extern lck_grp_attr_t *g_driverLockGrpAttr;
-extern lck_grp_t *g_driverLockGrp;
+#include "KextPlatform.hpp"
+#include "ObjectPool.hpp"
 
 static const UInt8 kDefaultBucketCapacity = 4;
+static const UInt8 kMaxCacheStripes = 16;
+static const UInt8 kCacheSweepBuckets = 2;
+static const UInt8 kCacheMigrateBuckets = 2;
+static const UInt8 kMinBucketCount = 2;
+// Slots of the lockless readers of a stripe, picked by CPU number.
+static const UInt8 kCacheReaderSlots = 16;
+
+/**
+* @berif Counters of a cache, summed over its stripes
+*/
+typedef struct {
+    UInt64 hits;
+    UInt64 misses;
+    UInt64 evictions;
+    UInt64 expirations;
+} CacheStatistics;
+
+/**
+ * @brief Obtain the time used for the expiry of cache entries
 
+ * @return  monotonic time in absolute time units
+ */
+static inline UInt64 cacheUptime() {
+    UInt64 now = 0;
+    clock_get_uptime(&now);
+    return now;
+}
+
+/**
+ * @brief Mix the key of the cache into a 64-bit hash
+
+ * @param key   key must be numeric type
+ * @return      hash value
+ */
 template <typename KeyType>
+static inline UInt64 cacheMixer(KeyType const &key) {
+    // 11400714819323198549 is the largest 64-bit prime number. Use prime numbers to reduce hash collisions.
+    return (UInt64)key * 11400714819323198549UL;
+}
 
 /**
  * @brief Calculate the hash value of the cache
- 
+
  * @param key   key must be numeric type
  * @param count number of buckets
  * @return      hash value
  */
+template <typename KeyType>
 static UInt64 cacheHasher(KeyType const &key, UInt64 count) {
-    // 11400714819323198549 is the largest 64-bit prime number. Use prime numbers to reduce hash collisions.
-    UInt64 hash = (UInt64)key * 11400714819323198549UL;
-    return hash % count;
+    return cacheMixer(key) % count;
 };
 
-template <typename KeyType, typename ValueType>
+template <typename KeyType, typename ValueType, template <typename> class Allocator = PoolAllocator>
 class DriverCache {
 
 public:
     ValueType zero;
-    
-    DriverCache(UInt64 capacity = 1024) {
+
+    /**
+     * @brief Create the cache
+
+     * @param capacity      max number of items
+     * @param readMostly    lookups walk the buckets without taking the lock, for caches rarely written
+     */
+    DriverCache(UInt64 capacity = 1024, bool readMostly = false) : m_allocator((UInt32)capacity) {
         if (capacity < 1) {
             capacity = 1;
         }
         m_capacity = capacity;
-        m_itemCount = 0;
-        // Make sure the number of buckets is even
-        m_bucketCount = (((capacity + kDefaultBucketCapacity) / kDefaultBucketCapacity) >> 1) << 1;
-        m_buckets = (Bucket *)IOMallocAligned(sizeof(Bucket)*m_bucketCount, 2);
-        bzero(m_buckets, sizeof(Bucket)*m_bucketCount);
-        m_lock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
-    }
-    
+        m_lifetime = 0;
+        m_isSweeping = false;
+        m_readMostly = readMostly;
+
+        // Use a power of two stripes so that the stripe can be picked by masking the hash
+        m_stripeCount = 1;
+        while (m_stripeCount < kMaxCacheStripes && m_stripeCount * kDefaultBucketCapacity * 2 <= capacity) {
+            m_stripeCount <<= 1;
+        }
+
+        UInt64 stripeCapacity = (capacity + m_stripeCount - 1) / m_stripeCount;
+        // Make sure the number of buckets is even, the table grows with the items from there
+        UInt64 bucketCount = (((stripeCapacity + kDefaultBucketCapacity) / kDefaultBucketCapacity) >> 1) << 1;
+        if (bucketCount < kMinBucketCount) {
+            bucketCount = kMinBucketCount;
+        }
+
+        m_stripes = (Stripe *)IOMallocAligned(sizeof(Stripe)*m_stripeCount, kCacheLineSize);
+        if (m_stripes == nullptr) {
+            m_stripeCount = 0;
+            return;
+        }
+        bzero(m_stripes, sizeof(Stripe)*m_stripeCount);
+
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            stripe->capacity = stripeCapacity;
+            stripe->table = allocTable(bucketCount);
+            stripe->lock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+            if (readMostly) {
+                // Without its slots the stripe is read under the lock.
+                stripe->readers = (ReaderSlot *)IOMallocAligned(sizeof(ReaderSlot)*kCacheReaderSlots, kCacheLineSize);
+                if (stripe->readers != nullptr) {
+                    bzero(stripe->readers, sizeof(ReaderSlot)*kCacheReaderSlots);
+                }
+            }
+        }
+    }
+
     ~DriverCache() {
         clearObjects();
-        if (m_lock != nullptr) {
-            lck_mtx_free(m_lock, g_driverLockGrp);
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            freeRetired(stripe, 0);
+            freeRetired(stripe, 1);
+            if (stripe->table != nullptr) {
+                freeTable(stripe->table);
+            }
+            if (stripe->lock != nullptr) {
+                lck_mtx_free(stripe->lock, g_driverLockGrp);
+            }
+            if (stripe->readers != nullptr) {
+                IOFreeAligned(stripe->readers, sizeof(ReaderSlot)*kCacheReaderSlots);
+            }
+        }
+        if (m_stripes != nullptr) {
+            IOFreeAligned(m_stripes, sizeof(Stripe)*m_stripeCount);
         }
     }
-    
+
     ValueType getObject(KeyType key) {
         ValueType value = zero;
-        Bucket *bucket = &m_buckets[cacheHasher(key, m_bucketCount)];
+        UInt64 hash = cacheMixer(key);
+        Stripe *stripe = getStripe(hash);
+        if (stripe == nullptr) {
+            return value;
+        }
 
-        lck_mtx_lock(m_lock);
-        Entry *entry = bucket->entry;
-        while (entry != nullptr) {
-            if (key == entry->key) {
-                value = entry->value;
-                break;
-            }
-            entry = entry->next;
+        if (stripe->readers != nullptr) {
+            return getObjectLockless(stripe, hash, key);
         }
-        lck_mtx_unlock(m_lock);
+
+        lck_mtx_lock(stripe->lock);
+        value = lookupObject(stripe, hash, key);
+        lck_mtx_unlock(stripe->lock);
 
         return value;
     }
-    
+
     bool setObject(const KeyType &key, const ValueType &value) {
         bool result = false;
-        Bucket *bucket = &m_buckets[cacheHasher(key, m_bucketCount)];
+        UInt64 hash = cacheMixer(key);
+        Stripe *stripe = getStripe(hash);
+        if (stripe == nullptr) {
+            return result;
+        }
 
-        lck_mtx_lock(m_lock);
-        Entry *last = nullptr;
-        Entry *current = bucket->entry;
+        lck_mtx_lock(stripe->lock);
+        beginWrite(stripe);
+        result = storeObject(stripe, hash, key, value, nullptr);
+        if (m_isSweeping) {
+            sweepExpired(stripe);
+        }
+        resizeTable(stripe);
 
-        while (current != nullptr) {
-            if (key == current->key) {
-                current->value = value;
-                if (value == zero) {
-                    if (last == nullptr) {
-                        bucket->entry = current->next;
-                    } else {
-                        last->next = current->next;
-                    }
-                    IOFreeAligned(current, sizeof(Entry));
-                    current = nullptr;
-                    OSDecrementAtomic(&m_itemCount);
-                }
-                result = true;
-                break;
+        endWrite(stripe);
+        lck_mtx_unlock(stripe->lock);
+        return result;
+    }
+
+    /**
+     * @brief Look up a batch of keys, taking the lock of each stripe once
+
+     * @param keys      keys to look up
+     * @param values    filled with the value of each key, zero if not found
+     * @param count     number of keys
+     * @return          number of keys found
+     */
+    UInt32 getObjects(const KeyType *keys, ValueType *values, UInt32 count) {
+        UInt32 found = 0;
+        BatchOrder order;
+
+        // Lockless lookups have no lock round trip to save.
+        if (m_readMostly || !sortByStripe(keys, count, &order)) {
+            for (UInt32 i = 0; i < count; ++i) {
+                values[i] = getObject(keys[i]);
+                found += values[i] != zero;
             }
-            last = current;
-            current = current->next;
+            return found;
         }
 
-        if (current == nullptr && value != zero) {
-            result = addObject(bucket, last, key, value);
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            UInt32 begin = order.starts[i];
+            UInt32 end = order.starts[i + 1];
+            if (begin == end || stripe->lock == nullptr || stripe->table == nullptr) {
+                continue;
+            }
+
+            lck_mtx_lock(stripe->lock);
+            for (UInt32 j = begin; j < end; ++j) {
+                UInt32 index = order.indexes[j];
+                values[index] = lookupObject(stripe, order.hashes[index], keys[index]);
+                found += values[index] != zero;
+            }
+            lck_mtx_unlock(stripe->lock);
         }
+        freeOrder(&order);
 
-        lck_mtx_unlock(m_lock);
-        return result;
+        return found;
+    }
+
+    /**
+     * @brief Set a batch of items
+     * Keys are grouped by stripe, each stripe is locked once, grown once for the whole
+     * batch and its entries are allocated before taking the lock.
+
+     * @param keys      keys to set
+     * @param values    value of each key, zero removes the key
+     * @param count     number of keys
+     * @return          number of keys set
+     */
+    UInt32 setObjects(const KeyType *keys, const ValueType *values, UInt32 count) {
+        return setBatch(keys, values, 1, count);
+    }
+
+    // Called when set a batch of keys to the same value.
+    UInt32 setObjects(const KeyType *keys, UInt32 count, const ValueType &value) {
+        return setBatch(keys, &value, 0, count);
+    }
+
+    // Called when remove a batch of keys, returns the number of keys removed.
+    UInt32 removeObjects(const KeyType *keys, UInt32 count) {
+        return setBatch(keys, &zero, 0, count);
     }
-    
+
     void clearObjects() {
-        for (UInt64 i = 0; i < m_bucketCount; ++i) {
-            lck_mtx_lock(m_lock);
-            Entry *current = m_buckets[i].entry;
-            Entry *next = nullptr;
-            while (current != nullptr) {
-                next = current->next;
-                IOFreeAligned(current, sizeof(Entry));
-                current = next;
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            if (stripe->lock == nullptr || stripe->table == nullptr) {
+                continue;
+            }
+            lck_mtx_lock(stripe->lock);
+            beginWrite(stripe);
+            clearStripe(stripe);
+            endWrite(stripe);
+            lck_mtx_unlock(stripe->lock);
+        }
+    }
+
+    UInt64 getCount() const {
+        UInt64 count = 0;
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            count += __atomic_load_n(&m_stripes[i].itemCount, __ATOMIC_RELAXED);
+        }
+        return count;
+    }
+
+    void getStatistics(CacheStatistics *stats) const {
+        bzero(stats, sizeof(CacheStatistics));
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            stats->hits += __atomic_load_n(&stripe->hits, __ATOMIC_RELAXED);
+            stats->misses += __atomic_load_n(&stripe->misses, __ATOMIC_RELAXED);
+            stats->evictions += __atomic_load_n(&stripe->evictions, __ATOMIC_RELAXED);
+            stats->expirations += __atomic_load_n(&stripe->expirations, __ATOMIC_RELAXED);
+            for (UInt32 j = 0; stripe->readers != nullptr && j < kCacheReaderSlots; ++j) {
+                stats->hits += __atomic_load_n(&stripe->readers[j].hits, __ATOMIC_RELAXED);
+                stats->misses += __atomic_load_n(&stripe->readers[j].misses, __ATOMIC_RELAXED);
             }
-            lck_mtx_unlock(m_lock);
         }
-        
-        m_itemCount = 0;
-        bzero(m_buckets, sizeof(Bucket)*m_bucketCount);
     }
-    
+
+    /**
+     * @brief Set how long an entry stays valid after it is set
+
+     * @param milliseconds  lifetime of entries set from now on, 0 means forever
+     */
+    void setLifetime(UInt64 milliseconds) {
+        UInt64 lifetime = 0;
+        nanoseconds_to_absolutetime(milliseconds * NSEC_PER_MSEC, &lifetime);
+        m_lifetime = lifetime;
+        // Entries set before keep their expiry, so they are still swept once the lifetime is lifted.
+        if (lifetime != 0) {
+            m_isSweeping = true;
+        }
+    }
+
+    /**
+     * @brief Change the max number of items
+     * The buckets follow the number of items, so they grow or shrink by themselves
+     * and the extra items of a lowered capacity are evicted by the next inserts.
+
+     * @param capacity  max number of items
+     */
+    void setCapacity(UInt64 capacity) {
+        if (capacity < m_stripeCount) {
+            capacity = m_stripeCount;
+        }
+        m_capacity = capacity;
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            __atomic_store_n(&m_stripes[i].capacity, (capacity + m_stripeCount - 1) / m_stripeCount, __ATOMIC_RELAXED);
+        }
+    }
+
 private:
+    // Once linked, the value, expiry, referenced bit and next pointer of an entry are
+    // written atomically, lockless readers load them while writers change them.
     struct Entry {
         KeyType key;
         ValueType value;
         Entry *next;
+        // Set on lookup, cleared when the clock hand passes by.
+        bool referenced;
+        // Uptime after which the entry is stale, 0 means never.
+        UInt64 expiry;
+        // Links the entry into the retired list once unlinked in read-mostly mode.
+        // The next pointer is left intact for readers still walking through it.
+        Entry *retired;
     };
     struct Bucket {
         Entry *entry;
     };
-    
-    bool addObject(Bucket *bucket, Entry *last, const KeyType &key, const ValueType &value) {
-        if (m_itemCount >= m_capacity) {
-            lck_mtx_unlock(m_lock);
-            if (m_itemCount >= m_capacity) {
-                clearObjects();
+
+    /**
+     * @brief Lockless readers of a stripe running on one CPU
+     * Readers only write the slot of their CPU, so lookups on different CPUs share no line
+     * with each other nor with the lock and the sequence of the stripe.
+     */
+    struct __attribute__((aligned(kCacheLineSize))) ReaderSlot {
+        // Readers inside, counted in the slot of the epoch they entered in.
+        SInt32 readerCount[2];
+        UInt64 hits;
+        UInt64 misses;
+    };
+
+    /**
+     * @brief Bucket array of a stripe, allocated in one block with its buckets
+     */
+    struct Table {
+        UInt64 bucketCount;
+        Bucket *buckets;
+        // Links the table into the retired list once replaced in read-mostly mode.
+        Table *retired;
+    };
+
+    /**
+     * @brief Independently locked part of the cache
+     * Each stripe owns its buckets and item counter, and is aligned to a cache line
+     * so that callbacks working on different stripes never share a line.
+     */
+    struct __attribute__((aligned(kCacheLineSize))) Stripe {
+        lck_mtx_t *lock;
+        UInt64 itemCount;
+        UInt64 capacity;
+        Table *table;
+        // Table migrated into the current one bucket by bucket, null when not resizing.
+        Table *oldTable;
+        // Buckets of the old table below this index are migrated.
+        UInt64 migrateIndex;
+        // Odd while a writer is modifying the stripe, read-mostly mode only.
+        UInt32 sequence;
+        // Epoch lockless readers enter in, their counts and lookups are in the slots of their CPU.
+        UInt32 readEpoch;
+        ReaderSlot *readers;
+        // Unlinked entries and replaced tables of each epoch, waiting for its readers to drain.
+        Entry *retired[2];
+        Table *retiredTables[2];
+        // Bucket the clock hand of the eviction points to.
+        UInt64 clockHand;
+        // Bucket the sweeper of expired entries points to.
+        UInt64 sweepHand;
+        // Lookups under the lock, lockless ones are counted in the reader slots.
+        UInt64 hits;
+        UInt64 misses;
+        UInt64 evictions;
+        UInt64 expirations;
+    };
+
+    /**
+     * @brief Keys of a batch grouped by stripe
+     * The indexes of the keys of stripe i are indexes[starts[i]] to indexes[starts[i + 1] - 1].
+     */
+    struct BatchOrder {
+        UInt64 *hashes;
+        UInt32 *indexes;
+        UInt32 starts[kMaxCacheStripes + 1];
+    };
+
+    UInt32 getStripeIndex(UInt64 hash) const {
+        // The low bits pick the bucket, so use the high bits to pick the stripe.
+        return (hash >> 48) & (m_stripeCount - 1);
+    }
+
+    Stripe *getStripe(UInt64 hash) const {
+        if (m_stripeCount == 0) {
+            return nullptr;
+        }
+        Stripe *stripe = &m_stripes[getStripeIndex(hash)];
+        // Only null if its allocation failed, but a resize may be swapping it.
+        if (stripe->lock == nullptr || __atomic_load_n(&stripe->table, __ATOMIC_RELAXED) == nullptr) {
+            return nullptr;
+        }
+        return stripe;
+    }
+
+    // Called with the lock of the stripe held.
+    ValueType lookupObject(Stripe *stripe, UInt64 hash, const KeyType &key) {
+        ValueType value = zero;
+        Bucket *bucket = nullptr;
+        Entry *last = nullptr;
+        // Entries not migrated yet are still in the old table.
+        Entry *entry = findEntry(stripe->table, hash, key, &bucket, &last);
+        if (entry == nullptr && stripe->oldTable != nullptr) {
+            entry = findEntry(stripe->oldTable, hash, key, &bucket, &last);
+        }
+        if (entry != nullptr && isExpired(entry, 0)) {
+            // Expire lazily, the caller sees a miss.
+            unlinkEntry(stripe, bucket, last, entry);
+            countEvent(&stripe->expirations);
+            entry = nullptr;
+        }
+        if (entry != nullptr) {
+            value = entry->value;
+            __atomic_store_n(&entry->referenced, true, __ATOMIC_RELAXED);
+        }
+        // Counted under the lock, the line is already ours.
+        UInt64 *counter = entry != nullptr ? &stripe->hits : &stripe->misses;
+        __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+        return value;
+    }
+
+    /**
+     * @brief Set the value of the key in the stripe
+     * Called with the lock of the stripe held and inside beginWrite/endWrite.
+
+     * @param stripe    stripe of the key
+     * @param hash      mixed hash of the key
+     * @param key       key to set
+     * @param value     value to set, zero removes the key
+     * @param spares    entries allocated up front, nullptr to allocate on demand
+     * @return          true if the key was set or removed
+     */
+    bool storeObject(Stripe *stripe, UInt64 hash, const KeyType &key, const ValueType &value, Entry **spares) {
+        bool result = false;
+        // After this step the key can only live in the current table.
+        migrateBuckets(stripe, hash);
+
+        Bucket *bucket = nullptr;
+        Entry *last = nullptr;
+        Entry *current = findEntry(stripe->table, hash, key, &bucket, &last);
+
+        if (current != nullptr) {
+            storeValue(current, value);
+            __atomic_store_n(&current->expiry, getExpiry(), __ATOMIC_RELAXED);
+            if (value == zero) {
+                unlinkEntry(stripe, bucket, last, current);
+            }
+            result = true;
+        } else if (value != zero) {
+            UInt64 capacity = __atomic_load_n(&stripe->capacity, __ATOMIC_RELAXED);
+            if (stripe->itemCount >= capacity) {
+                // More than one entry goes if the capacity was lowered.
+                while (stripe->itemCount >= capacity && evictObject(stripe)) {}
+                // The victim may have been the tail of our bucket.
+                findEntry(stripe->table, hash, key, &bucket, &last);
+            }
+            result = addObject(stripe, bucket, last, key, value, spares);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Set a batch of items stripe by stripe
+
+     * @param keys      keys to set
+     * @param values    values of the keys
+     * @param stride    step between the values of two keys, 0 to set all keys to values[0]
+     * @param count     number of keys
+     * @return          number of keys set
+     */
+    UInt32 setBatch(const KeyType *keys, const ValueType *values, UInt32 stride, UInt32 count) {
+        UInt32 result = 0;
+        BatchOrder order;
+
+        if (!sortByStripe(keys, count, &order)) {
+            // Not worth it for one key, or no memory for the order, set one at a time.
+            for (UInt32 i = 0; i < count; ++i) {
+                result += setObject(keys[i], values[i * stride]);
+            }
+            return result;
+        }
+
+        // Removing only needs neither new entries nor a larger table.
+        bool removing = (stride == 0 && values[0] == zero);
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            UInt32 begin = order.starts[i];
+            UInt32 end = order.starts[i + 1];
+            if (begin == end || stripe->lock == nullptr || stripe->table == nullptr) {
+                continue;
+            }
+
+            Entry *spares = removing ? nullptr : allocSpares(end - begin);
+            lck_mtx_lock(stripe->lock);
+            beginWrite(stripe);
+            if (!removing) {
+                reserveTable(stripe, stripe->itemCount + end - begin);
+            }
+
+            for (UInt32 j = begin; j < end; ++j) {
+                UInt32 index = order.indexes[j];
+                result += storeObject(stripe, order.hashes[index], keys[index], values[index * stride], &spares);
+            }
+            if (m_isSweeping) {
+                sweepExpired(stripe);
+            }
+            resizeTable(stripe);
+            endWrite(stripe);
+            lck_mtx_unlock(stripe->lock);
+
+            // Keys already present did not use their spare entry.
+            freeSpares(spares);
+        }
+        freeOrder(&order);
+
+        return result;
+    }
+
+    /**
+     * @brief Group the keys of a batch by stripe with a counting sort
+     * The sort is stable, so the last duplicate of a key in the batch wins.
+
+     * @param keys      keys of the batch
+     * @param count     number of keys
+     * @param order     filled with the hashes and the grouped indexes, freed by freeOrder
+     * @return          false if the batch is too small or the memory is short
+     */
+    bool sortByStripe(const KeyType *keys, UInt32 count, BatchOrder *order) {
+        if (count < 2 || m_stripeCount == 0) {
+            return false;
+        }
+        order->hashes = (UInt64 *)IOMallocAligned(sizeof(UInt64)*count, 2);
+        order->indexes = (UInt32 *)IOMallocAligned(sizeof(UInt32)*count, 2);
+        if (order->hashes == nullptr || order->indexes == nullptr) {
+            freeOrder(order, count);
+            return false;
+        }
+
+        UInt32 next[kMaxCacheStripes] = {0};
+        bzero(order->starts, sizeof(order->starts));
+        for (UInt32 i = 0; i < count; ++i) {
+            order->hashes[i] = cacheMixer(keys[i]);
+            order->starts[getStripeIndex(order->hashes[i]) + 1]++;
+        }
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            order->starts[i + 1] += order->starts[i];
+            next[i] = order->starts[i];
+        }
+        for (UInt32 i = 0; i < count; ++i) {
+            order->indexes[next[getStripeIndex(order->hashes[i])]++] = i;
+        }
+        return true;
+    }
+
+    void freeOrder(BatchOrder *order, UInt32 count = 0) {
+        if (count == 0) {
+            count = order->starts[m_stripeCount];
+        }
+        if (order->hashes != nullptr) {
+            IOFreeAligned(order->hashes, sizeof(UInt64)*count);
+        }
+        if (order->indexes != nullptr) {
+            IOFreeAligned(order->indexes, sizeof(UInt32)*count);
+        }
+    }
+
+    // Called without any lock held, the allocator may block.
+    Entry *allocSpares(UInt32 count) {
+        Entry *spares = nullptr;
+        for (UInt32 i = 0; i < count; ++i) {
+            Entry *entry = m_allocator.allocObject();
+            if (entry == nullptr) {
+                break;
+            }
+            entry->next = spares;
+            spares = entry;
+        }
+        return spares;
+    }
+
+    void freeSpares(Entry *spares) {
+        while (spares != nullptr) {
+            Entry *next = spares->next;
+            m_allocator.freeObject(spares);
+            spares = next;
+        }
+    }
+
+    /**
+     * @brief Look up the key without taking the lock
+     * The sequence of the stripe detects concurrent writers and the reader count of the
+     * epoch keeps unlinked entries alive until every reader that could have seen them has left.
+     */
+    ValueType getObjectLockless(Stripe *stripe, UInt64 hash, const KeyType &key) {
+        ValueType value = zero;
+        UInt32 sequence = 0;
+        // Left from the slot entered, even if the thread moved to another CPU meanwhile.
+        ReaderSlot *slot = &stripe->readers[(UInt32)cpu_number() % kCacheReaderSlots];
+
+        UInt32 epoch = __atomic_load_n(&stripe->readEpoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&slot->readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&stripe->readEpoch, __ATOMIC_SEQ_CST) != epoch) {
+            // Counted in an epoch whose entries may be freed without waiting for it.
+            __atomic_fetch_sub(&slot->readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+            epoch = __atomic_load_n(&stripe->readEpoch, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&slot->readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+        }
+        do {
+            sequence = __atomic_load_n(&stripe->sequence, __ATOMIC_ACQUIRE);
+            if (sequence & 1) {
+                continue;
+            }
+
+            value = zero;
+            Table *table = __atomic_load_n(&stripe->table, __ATOMIC_ACQUIRE);
+            Table *oldTable = __atomic_load_n(&stripe->oldTable, __ATOMIC_ACQUIRE);
+            Entry *entry = findEntryLockless(table, hash, key);
+            if (entry == nullptr && oldTable != nullptr) {
+                entry = findEntryLockless(oldTable, hash, key);
+            }
+            // Expired entries are left for the sweeper, writers own the chains.
+            if (entry != nullptr && !isExpired(entry, 0)) {
+                __atomic_load(&entry->value, &value, __ATOMIC_RELAXED);
+                // Avoid dirtying the line when the bit is already set.
+                if (!__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED)) {
+                    __atomic_store_n(&entry->referenced, true, __ATOMIC_RELAXED);
+                }
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((sequence & 1) || __atomic_load_n(&stripe->sequence, __ATOMIC_RELAXED) != sequence);
+        __atomic_fetch_sub(&slot->readerCount[epoch], 1, __ATOMIC_RELEASE);
+        __atomic_fetch_add(value != zero ? &slot->hits : &slot->misses, 1, __ATOMIC_RELAXED);
+
+        return value;
+    }
+
+    static Entry *findEntryLockless(Table *table, UInt64 hash, const KeyType &key) {
+        Entry *entry = __atomic_load_n(&table->buckets[hash % table->bucketCount].entry, __ATOMIC_ACQUIRE);
+        while (entry != nullptr) {
+            if (key == entry->key) {
+                return entry;
+            }
+            entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Find the entry of the key in a table
+     * Called with the lock of the stripe held.
+
+     * @param table     table to search
+     * @param hash      mixed hash of the key
+     * @param key       key to find
+     * @param bucket    bucket of the key
+     * @param last      entry before the found one, or the tail of the bucket if not found
+     * @return          the entry, nullptr if not found
+     */
+    static Entry *findEntry(Table *table, UInt64 hash, const KeyType &key, Bucket **bucket, Entry **last) {
+        *bucket = &table->buckets[hash % table->bucketCount];
+        *last = nullptr;
+        Entry *current = (*bucket)->entry;
+        while (current != nullptr) {
+            if (key == current->key) {
+                return current;
+            }
+            *last = current;
+            current = current->next;
+        }
+        return nullptr;
+    }
+
+    Table *allocTable(UInt64 bucketCount) {
+        Table *table = (Table *)IOMallocAligned(sizeof(Table) + sizeof(Bucket)*bucketCount, 2);
+        if (table == nullptr) {
+            return nullptr;
+        }
+        table->bucketCount = bucketCount;
+        table->buckets = (Bucket *)(table + 1);
+        table->retired = nullptr;
+        bzero(table->buckets, sizeof(Bucket)*bucketCount);
+        return table;
+    }
+
+    void freeTable(Table *table) {
+        IOFreeAligned(table, sizeof(Table) + sizeof(Bucket)*table->bucketCount);
+    }
+
+    // Called with the lock of the stripe held.
+    void releaseTable(Stripe *stripe, Table *table) {
+        if (m_readMostly) {
+            table->retired = stripe->retiredTables[stripe->readEpoch];
+            stripe->retiredTables[stripe->readEpoch] = table;
+        } else {
+            freeTable(table);
+        }
+    }
+
+    /**
+     * @brief Start moving the stripe to a table sized for its items
+     * The load factor is kept around kDefaultBucketCapacity, with some slack before
+     * shrinking so that a stripe does not flap between two sizes.
+     * Called with the lock of the stripe held.
+     */
+    void resizeTable(Stripe *stripe) {
+        if (stripe->oldTable != nullptr) {
+            return;
+        }
+
+        UInt64 bucketCount = stripe->table->bucketCount;
+        if (stripe->itemCount > bucketCount * kDefaultBucketCapacity) {
+            bucketCount <<= 1;
+        } else if (bucketCount > kMinBucketCount && stripe->itemCount * 8 < bucketCount * kDefaultBucketCapacity) {
+            bucketCount >>= 1;
+        } else {
+            return;
+        }
+
+        beginMigration(stripe, bucketCount);
+    }
+
+    /**
+     * @brief Start moving the stripe to a table holding the given number of items
+     * Used by batches, which would otherwise resize many times. The table is sized in one
+     * step but still migrated a few buckets per write, and a migration already running is
+     * left to end first.
+     * Called with the lock of the stripe held.
+     */
+    void reserveTable(Stripe *stripe, UInt64 itemCount) {
+        if (stripe->oldTable != nullptr) {
+            return;
+        }
+        UInt64 capacity = __atomic_load_n(&stripe->capacity, __ATOMIC_RELAXED);
+        if (itemCount > capacity) {
+            itemCount = capacity;
+        }
+
+        UInt64 bucketCount = stripe->table->bucketCount;
+        while (itemCount > bucketCount * kDefaultBucketCapacity) {
+            bucketCount <<= 1;
+        }
+        if (bucketCount != stripe->table->bucketCount) {
+            beginMigration(stripe, bucketCount);
+        }
+    }
+
+    // Called with the lock of the stripe held.
+    bool beginMigration(Stripe *stripe, UInt64 bucketCount) {
+        Table *table = allocTable(bucketCount);
+        if (table == nullptr) {
+            return false;
+        }
+        stripe->migrateIndex = 0;
+        stripe->clockHand = 0;
+        stripe->sweepHand = 0;
+        __atomic_store_n(&stripe->oldTable, stripe->table, __ATOMIC_RELEASE);
+        __atomic_store_n(&stripe->table, table, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Called with the lock of the stripe held.
+    void migrateBucket(Stripe *stripe, UInt64 index) {
+        Bucket *bucket = &stripe->oldTable->buckets[index];
+        Table *table = stripe->table;
+
+        while (bucket->entry != nullptr) {
+            Entry *entry = bucket->entry;
+            Bucket *target = &table->buckets[cacheMixer(entry->key) % table->bucketCount];
+            __atomic_store_n(&bucket->entry, entry->next, __ATOMIC_RELEASE);
+            __atomic_store_n(&entry->next, target->entry, __ATOMIC_RELEASE);
+            __atomic_store_n(&target->entry, entry, __ATOMIC_RELEASE);
+        }
+    }
+
+    /**
+     * @brief Move a few buckets of the old table into the current one
+     * The bucket of the key is always moved, so the caller only has to look at the
+     * current table, and a few more are moved so that the resize ends after a bounded
+     * number of writes without any of them paying the whole rehash.
+     * Called with the lock of the stripe held.
+
+     * @param stripe    stripe to migrate
+     * @param hash      mixed hash of the key being written
+     */
+    void migrateBuckets(Stripe *stripe, UInt64 hash) {
+        if (stripe->oldTable == nullptr) {
+            return;
+        }
+
+        Table *oldTable = stripe->oldTable;
+        migrateBucket(stripe, hash % oldTable->bucketCount);
+        for (UInt8 i = 0; i < kCacheMigrateBuckets && stripe->migrateIndex < oldTable->bucketCount; ++i) {
+            migrateBucket(stripe, stripe->migrateIndex++);
+        }
+        if (stripe->migrateIndex == oldTable->bucketCount) {
+            __atomic_store_n(&stripe->oldTable, (Table *)nullptr, __ATOMIC_RELEASE);
+            releaseTable(stripe, oldTable);
+        }
+    }
+
+    // Called with the lock of the stripe held.
+    void beginWrite(Stripe *stripe) {
+        if (m_readMostly) {
+            __atomic_store_n(&stripe->sequence, stripe->sequence + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+        }
+    }
+
+    // Called with the lock of the stripe held.
+    void endWrite(Stripe *stripe) {
+        if (!m_readMostly) {
+            return;
+        }
+        __atomic_store_n(&stripe->sequence, stripe->sequence + 1, __ATOMIC_RELEASE);
+        // Pairs with the increment of the reader count, a reader entering after this
+        // point can no longer reach the retired entries.
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        // Readers of the other epoch entered before anything of this one was retired. Once they
+        // are gone, what they could see is freed and the epoch moves on, so new readers never
+        // keep the old slot busy and retired entries do not pile up under steady reads.
+        UInt32 epoch = stripe->readEpoch ^ 1;
+        if (!hasReaders(stripe, epoch)) {
+            freeRetired(stripe, epoch);
+            __atomic_store_n(&stripe->readEpoch, epoch, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    // Called with the lock of the stripe held.
+    void releaseEntry(Stripe *stripe, Entry *entry) {
+        if (m_readMostly) {
+            entry->retired = stripe->retired[stripe->readEpoch];
+            stripe->retired[stripe->readEpoch] = entry;
+        } else {
+            m_allocator.freeObject(entry);
+        }
+    }
+
+    // Called with the lock of the stripe held and no reader of the epoch inside.
+    void freeRetired(Stripe *stripe, UInt32 epoch) {
+        Entry *current = stripe->retired[epoch];
+        Entry *next = nullptr;
+        while (current != nullptr) {
+            next = current->retired;
+            m_allocator.freeObject(current);
+            current = next;
+        }
+        stripe->retired[epoch] = nullptr;
+
+        while (stripe->retiredTables[epoch] != nullptr) {
+            Table *table = stripe->retiredTables[epoch];
+            stripe->retiredTables[epoch] = table->retired;
+            freeTable(table);
+        }
+    }
+
+    // Called with the lock of the stripe held, after the fence of endWrite.
+    bool hasReaders(Stripe *stripe, UInt32 epoch) const {
+        for (UInt32 i = 0; stripe->readers != nullptr && i < kCacheReaderSlots; ++i) {
+            if (__atomic_load_n(&stripe->readers[i].readerCount[epoch], __ATOMIC_SEQ_CST) != 0) {
+                return true;
             }
-            lck_mtx_lock(m_lock);
         }
+        return false;
+    }
+
+    // Called with the lock of the stripe held, the counters are only read without it.
+    static void countEvent(UInt64 *counter) {
+        __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+    }
+
+    static void storeValue(Entry *entry, ValueType value) {
+        __atomic_store(&entry->value, &value, __ATOMIC_RELAXED);
+    }
+
+    UInt64 getExpiry() const {
+        return m_lifetime == 0 ? 0 : cacheUptime() + m_lifetime;
+    }
+
+    /**
+     * @brief Check whether the entry is stale
+
+     * @param entry entry to check
+     * @param now   current uptime, 0 to obtain it only when the entry may expire
+     */
+    static bool isExpired(const Entry *entry, UInt64 now) {
+        UInt64 expiry = __atomic_load_n(&entry->expiry, __ATOMIC_RELAXED);
+        if (expiry == 0) {
+            return false;
+        }
+        return expiry <= (now != 0 ? now : cacheUptime());
+    }
+
+    // Called with the lock of the stripe held.
+    void unlinkEntry(Stripe *stripe, Bucket *bucket, Entry *last, Entry *entry) {
+        if (last == nullptr) {
+            __atomic_store_n(&bucket->entry, entry->next, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&last->next, entry->next, __ATOMIC_RELEASE);
+        }
+        releaseEntry(stripe, entry);
+        __atomic_store_n(&stripe->itemCount, stripe->itemCount - 1, __ATOMIC_RELAXED);
+    }
 
-        Entry *entry = (Entry *)IOMallocAligned(sizeof(Entry), 2);
+    /**
+     * @brief Drop the expired entries of a few buckets
+     * Each write sweeps the next buckets, so stale entries go away within a full
+     * turn of writes even if they are never looked up again.
+     * Called with the lock of the stripe held.
+     */
+    void sweepExpired(Stripe *stripe) {
+        UInt64 now = cacheUptime();
+        Table *table = stripe->table;
+
+        for (UInt8 i = 0; i < kCacheSweepBuckets; ++i) {
+            Bucket *bucket = &table->buckets[stripe->sweepHand % table->bucketCount];
+            Entry *last = nullptr;
+            Entry *current = bucket->entry;
+
+            while (current != nullptr) {
+                Entry *next = current->next;
+                if (isExpired(current, now)) {
+                    unlinkEntry(stripe, bucket, last, current);
+                    countEvent(&stripe->expirations);
+                } else {
+                    last = current;
+                }
+                current = next;
+            }
+            stripe->sweepHand = (stripe->sweepHand + 1) % table->bucketCount;
+        }
+    }
+
+    /**
+     * @brief Evict one entry of the full stripe with the CLOCK policy
+     * The hand sweeps the buckets, giving referenced entries a second chance, so the
+     * cost is amortized O(1) per insert and recently used entries survive.
+     * While resizing, the victim is taken from the buckets not migrated yet, which
+     * the migration would otherwise have to move.
+     * Called with the lock of the stripe held.
+
+     * @return  false if the stripe is empty
+     */
+    bool evictObject(Stripe *stripe) {
+        Table *oldTable = stripe->oldTable;
+        if (oldTable != nullptr) {
+            // A pass starts over at the migration point, the bits cleared by the last one stay cleared.
+            UInt64 hand = 0;
+            if (evictFromTable(stripe, oldTable, stripe->migrateIndex, &hand)) {
+                return true;
+            }
+        }
+        return evictFromTable(stripe, stripe->table, 0, &stripe->clockHand);
+    }
+
+    /**
+     * @brief Run the clock hand over the buckets of a table from the first one
+
+     * @param stripe    stripe of the table
+     * @param table     table to evict from
+     * @param first     first bucket of the table the hand walks
+     * @param hand      position of the hand, relative to the first bucket
+     * @return          false if no entry is left in those buckets
+     */
+    bool evictFromTable(Stripe *stripe, Table *table, UInt64 first, UInt64 *hand) {
+        UInt64 span = table->bucketCount - first;
+        // Two rounds are enough, the first one clears every referenced bit.
+        for (UInt64 scanned = 0; scanned <= span * 2; ++scanned) {
+            Bucket *bucket = &table->buckets[first + *hand % span];
+            Entry *last = nullptr;
+            Entry *current = bucket->entry;
+
+            while (current != nullptr) {
+                if (!__atomic_load_n(&current->referenced, __ATOMIC_RELAXED) || isExpired(current, 0)) {
+                    unlinkEntry(stripe, bucket, last, current);
+                    countEvent(&stripe->evictions);
+                    return true;
+                }
+                __atomic_store_n(&current->referenced, false, __ATOMIC_RELAXED);
+                last = current;
+                current = current->next;
+            }
+            *hand = (*hand + 1) % span;
+        }
+        return false;
+    }
+
+    // Called with the lock of the stripe held.
+    void clearStripe(Stripe *stripe) {
+        if (stripe->oldTable != nullptr) {
+            Table *oldTable = stripe->oldTable;
+            clearTable(stripe, oldTable);
+            __atomic_store_n(&stripe->oldTable, (Table *)nullptr, __ATOMIC_RELEASE);
+            releaseTable(stripe, oldTable);
+        }
+        clearTable(stripe, stripe->table);
+        __atomic_store_n(&stripe->itemCount, (UInt64)0, __ATOMIC_RELAXED);
+    }
+
+    // Called with the lock of the stripe held.
+    void clearTable(Stripe *stripe, Table *table) {
+        for (UInt64 i = 0; i < table->bucketCount; ++i) {
+            Entry *current = table->buckets[i].entry;
+            Entry *next = nullptr;
+            __atomic_store_n(&table->buckets[i].entry, (Entry *)nullptr, __ATOMIC_RELEASE);
+            while (current != nullptr) {
+                next = current->next;
+                releaseEntry(stripe, current);
+                current = next;
+            }
+        }
+    }
+
+    // Called with the lock of the stripe held.
+    bool addObject(Stripe *stripe, Bucket *bucket, Entry *last, const KeyType &key, const ValueType &value, Entry **spares) {
+        Entry *entry = nullptr;
+        if (spares != nullptr && *spares != nullptr) {
+            entry = *spares;
+            *spares = entry->next;
+        } else {
+            entry = m_allocator.allocObject();
+        }
         if (entry == nullptr) {
             return false;
         }
         entry->key = key;
         entry->value = value;
         entry->next = nullptr;
-        
+        entry->referenced = true;
+        entry->expiry = getExpiry();
+        entry->retired = nullptr;
+
+        // Publish the entry only after it is filled, readers may be walking the chain.
         if (bucket->entry == nullptr) {
-            bucket->entry = entry;
+            __atomic_store_n(&bucket->entry, entry, __ATOMIC_RELEASE);
         } else if (last != nullptr) {
-            last->next = entry;
+            __atomic_store_n(&last->next, entry, __ATOMIC_RELEASE);
         } else {
+            m_allocator.freeObject(entry);
             return false;
         }
-        OSIncrementAtomic(&m_itemCount);
+        __atomic_store_n(&stripe->itemCount, stripe->itemCount + 1, __ATOMIC_RELAXED);
         return true;
     }
-    
+
     UInt64 m_capacity;
-    UInt64 m_itemCount;
-    UInt64 m_bucketCount;
-    Bucket *m_buckets;
-    
-    lck_mtx_t *m_lock;
+    UInt64 m_lifetime;
+    bool m_isSweeping;
+    bool m_readMostly;
+    UInt32 m_stripeCount;
+    Stripe *m_stripes;
+    Allocator<Entry> m_allocator;
 };
 
 #endif /* DriverCache_hpp */
@@ -0,0 +1,80 @@
+//
+//  EventCounters.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventCounters.hpp"
+
+EventCounters::EventCounters() {
+    bzero(m_counters, sizeof(m_counters));
+    bzero(m_skippedEvents, sizeof(m_skippedEvents));
+    bzero(m_sampleTicks, sizeof(m_sampleTicks));
+    m_unreportedDrops = 0;
+    m_unreportedSamples = 0;
+    m_lastReportTime = 0;
+    nanoseconds_to_absolutetime(kDropReportInterval * NSEC_PER_MSEC, &m_reportInterval);
+}
+
+bool EventCounters::isSampledOut(UInt32 eventClass, UInt32 usage) {
+    if (((1 << eventClass) & kSampledEventClasses) == 0 || usage < kOverloadWatermark) {
+        return false;
+    }
+    return __atomic_fetch_add(&m_sampleTicks[eventClass], 1, __ATOMIC_RELAXED) % kOverloadSampleRate != 0;
+}
+
+void EventCounters::countEnqueued(UInt32 eventClass) {
+    __atomic_fetch_add(&m_counters[eventClass].enqueued, 1, __ATOMIC_RELAXED);
+}
+
+void EventCounters::countSkipped(UInt32 eventClass, bool dropped) {
+    if (dropped) {
+        __atomic_fetch_add(&m_counters[eventClass].dropped, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&m_unreportedDrops, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&m_counters[eventClass].sampled, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&m_unreportedSamples, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&m_skippedEvents[eventClass], 1, __ATOMIC_RELAXED);
+}
+
+void EventCounters::countThrottled(UInt32 eventClass) {
+    // Not reported in log, the throttle summaries tell the client of them.
+    __atomic_fetch_add(&m_counters[eventClass].throttled, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m_skippedEvents[eventClass], 1, __ATOMIC_RELAXED);
+}
+
+UInt32 EventCounters::takeSkipped(UInt32 eventClass) {
+    return __atomic_exchange_n(&m_skippedEvents[eventClass], 0, __ATOMIC_RELAXED);
+}
+
+void EventCounters::restoreSkipped(UInt32 eventClass, UInt32 skipped) {
+    __atomic_fetch_add(&m_skippedEvents[eventClass], skipped, __ATOMIC_RELAXED);
+}
+
+bool EventCounters::takeReport(UInt32 *drops, UInt32 *samples) {
+    UInt64 now = 0;
+    clock_get_uptime(&now);
+    UInt64 last = __atomic_load_n(&m_lastReportTime, __ATOMIC_RELAXED);
+    // One report per interval however many events are skipped, whoever moves the time reports.
+    if (now - last < m_reportInterval ||
+        !__atomic_compare_exchange_n(&m_lastReportTime, &last, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    *drops = __atomic_exchange_n(&m_unreportedDrops, 0, __ATOMIC_RELAXED);
+    *samples = __atomic_exchange_n(&m_unreportedSamples, 0, __ATOMIC_RELAXED);
+    return true;
+}
+
+UInt32 EventCounters::obtainCounters(NuwaKextEventCounters *counters, UInt32 count) const {
+    count = count < kEventClassCount ? count : kEventClassCount;
+    for (UInt32 i = 0; i < count; ++i) {
+        counters[i].enqueued = __atomic_load_n(&m_counters[i].enqueued, __ATOMIC_RELAXED);
+        counters[i].dropped = __atomic_load_n(&m_counters[i].dropped, __ATOMIC_RELAXED);
+        counters[i].sampled = __atomic_load_n(&m_counters[i].sampled, __ATOMIC_RELAXED);
+        counters[i].throttled = __atomic_load_n(&m_counters[i].throttled, __ATOMIC_RELAXED);
+    }
+    return count;
+}
@@ -0,0 +1,66 @@
+//
+//  EventCounters.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventCounters_hpp
+#define EventCounters_hpp
+
+#include "KextPlatform.hpp"
+#include "KextCommon.hpp"
+
+/**
+ * @brief Events sent and skipped of each class, and the sampling of the classes given up under overload
+ * Skipped events are counted three ways: in the counters read by the client, in a count carried
+ * by the next event of the class, and in a report in log at most once per kDropReportInterval.
+ */
+class EventCounters {
+
+public:
+    EventCounters();
+
+    // Called when check whether the event of a sampled class is given up, usage being the percentage of its ring taken.
+    bool isSampledOut(UInt32 eventClass, UInt32 usage);
+
+    // Called when the event is sent to client.
+    void countEnqueued(UInt32 eventClass);
+
+    // Called when the event is skipped, dropped if its queue was full, else sampled out.
+    void countSkipped(UInt32 eventClass, bool dropped);
+
+    // Called when the event is skipped by the rate limit of its process.
+    void countThrottled(UInt32 eventClass);
+
+    // Called when take the events of the class skipped since the previous one sent, for the next one to carry.
+    UInt32 takeSkipped(UInt32 eventClass);
+
+    // Called when the event taking the skipped count could not carry it, the next one does.
+    void restoreSkipped(UInt32 eventClass, UInt32 skipped);
+
+    /**
+     * @brief Take the events skipped since the previous report, once it is due
+
+     * @param drops     set to the events dropped since
+     * @param samples   set to the events sampled out since
+     * @return          true for a single caller once the interval has passed, false otherwise
+     */
+    bool takeReport(UInt32 *drops, UInt32 *samples);
+
+    // Called when copy the counters of the event classes out, returns the number copied.
+    UInt32 obtainCounters(NuwaKextEventCounters *counters, UInt32 count) const;
+
+private:
+    NuwaKextEventCounters m_counters[kEventClassCount];
+    // Skipped since the previous event of the class was sent, carried by the next one.
+    UInt32 m_skippedEvents[kEventClassCount];
+    UInt32 m_sampleTicks[kEventClassCount];
+    // Skipped since the previous report in log.
+    UInt32 m_unreportedDrops;
+    UInt32 m_unreportedSamples;
+    UInt64 m_lastReportTime;
+    UInt64 m_reportInterval;
+};
+
+#endif /* EventCounters_hpp */
@@ -0,0 +1,51 @@
+//
+//  EventLanes.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventLanes_hpp
+#define EventLanes_hpp
+
+#include "KextPlatform.hpp"
+#include "KextCommon.hpp"
+
+/**
+ * @brief Mapping of the event classes to the queues of NuwaKextQueue
+ * Exec auth has its queue with a waiter, the critical classes the critical lane, and the
+ * others the bulk rings. A storm of bulk events never takes the room of a critical one.
+ */
+class EventLanes {
+
+public:
+    EventLanes() {
+        m_criticalClasses = kDefaultCriticalClasses;
+    }
+
+    // Called when set the notify classes sent to the critical lane, a NuwaKextSubscription mask.
+    void setCriticalClasses(UInt32 mask) {
+        // Exec auth is not a notify class, its events keep their queue.
+        __atomic_store_n(&m_criticalClasses, mask & kSubscribeAll & ~kSubscribeAuthExec, __ATOMIC_RELAXED);
+    }
+
+    UInt32 getCriticalClasses() const {
+        return __atomic_load_n(&m_criticalClasses, __ATOMIC_RELAXED);
+    }
+
+    // Called when pick the queue of the event, kQueueTypeNotify standing for whichever bulk ring the producer takes.
+    UInt32 getLane(NuwaKextAction action, UInt32 eventClass) const {
+        if (action == kActionAuthProcessCreate) {
+            return kQueueTypeAuth;
+        }
+        if (eventClass < kEventClassCount && ((1 << eventClass) & getCriticalClasses()) != 0) {
+            return kQueueTypeCritical;
+        }
+        return kQueueTypeNotify;
+    }
+
+private:
+    UInt32 m_criticalClasses;
+};
+
+#endif /* EventLanes_hpp */
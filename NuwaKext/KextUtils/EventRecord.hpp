@@ -0,0 +1,355 @@
+//
+//  EventRecord.hpp
+//  NuwaStone
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventRecord_h
+#define EventRecord_h
+
+#include "KextCommon.hpp"
+#include <string.h>
+#include <stddef.h>
+
+static const UInt16 kEventRecordVersion = 3;
+static const UInt32 kEventRecordAlign = 4;
+
+/**
+* @berif Fixed part of an event record in the data queues
+* The header is followed by fields up to size bytes, each starting on a 4 bytes boundary.
+* Records are only 4 bytes aligned in the queues, so read them with memcpy.
+*/
+typedef struct {
+    UInt16 version;
+    UInt16 size;
+    NuwaKextAction eventType;
+    UInt64 vnodeID;
+    // Wall clock seconds of the event, only for display.
+    UInt64 eventTime;
+    // Nanoseconds since boot when the event was seen, monotonic.
+    UInt64 eventUptime;
+    // Nanoseconds since boot of the commit, the client merges the notify rings by it.
+    UInt64 uptime;
+    // Order of the record in its queue, a hole is an event dropped for a full queue or given up.
+    UInt32 sequence;
+    NuwaKextProc mainProcess;
+} NuwaKextRecordHeader;
+
+/**
+* @berif Field of an event record, followed by length bytes of data
+* Strings are stored with their actual length and without terminator.
+*/
+typedef struct {
+    UInt16 type;
+    UInt16 length;
+} NuwaKextRecordField;
+
+/**
+* @berif Field types of an event record, unknown ones are skipped by decoders
+*/
+typedef enum {
+    kRecordFieldNull        = 0,
+    kRecordFieldFileAttr    = 1,    // NuwaKextFileAttr
+    kRecordFieldPath        = 2,
+    kRecordFieldNewPath     = 3,
+    kRecordFieldProtocol    = 4,    // UInt16
+    kRecordFieldLocalAddr   = 5,    // struct sockaddr
+    kRecordFieldRemoteAddr  = 6,    // struct sockaddr
+    kRecordFieldQueryStatus = 7,    // SInt32
+    kRecordFieldDomainName  = 8,
+    kRecordFieldQueryResult = 9,
+    kRecordFieldSkipped     = 10,   // UInt32, events of the class skipped since the previous one sent
+    kRecordFieldRepeats     = 11,   // UInt32, repeats of the event coalesced since the previous one sent
+    kRecordFieldThrottled   = 12    // UInt32[kEventClassCount], events of the process suppressed per class
+} NuwaKextRecordFieldType;
+
+/**
+* @berif Attributes of a file, laid out as NuwaKextFile up to its path
+*/
+typedef struct {
+    UInt32 uid;
+    UInt32 gid;
+    UInt16 mode;
+    UInt64 atime;
+    UInt64 mtime;
+    UInt64 ctime;
+} NuwaKextFileAttr;
+
+#ifdef __cplusplus
+static_assert(sizeof(NuwaKextFileAttr) == offsetof(NuwaKextFile, path), "NuwaKextFileAttr must match NuwaKextFile");
+#endif
+
+// Room of the skipped count, appended by the dispatcher when events of the class were skipped.
+static const UInt32 kRecordSkippedFieldSize = sizeof(NuwaKextRecordField) + sizeof(UInt32);
+
+// Largest record, a rename with both paths full, or a dns reply with both strings full, and a skipped count.
+static const UInt32 kMaxEventRecordSize = sizeof(NuwaKextRecordHeader) + 3 * sizeof(NuwaKextRecordField) +
+    sizeof(NuwaKextFileAttr) + 2 * kMaxPathLength + 2 * kEventRecordAlign + kRecordSkippedFieldSize;
+
+static inline UInt32 alignRecordSize(UInt32 size) {
+    return (size + kEventRecordAlign - 1) & ~(kEventRecordAlign - 1);
+}
+
+/**
+ * @brief Open a field of a record being built, so that its data is filled in place
+
+ * @param record    buffer of the record
+ * @param capacity  size of the buffer
+ * @param offset    end of the record so far
+ * @param maxLength max number of bytes of the field data
+ * @return          where the field data goes, NULL if it does not fit
+ */
+static inline void *openRecordField(void *record, UInt32 capacity, UInt32 offset, UInt32 maxLength) {
+    if (offset == 0 || maxLength > 0xFFFF || alignRecordSize(offset + sizeof(NuwaKextRecordField) + maxLength) > capacity) {
+        return NULL;
+    }
+    return (UInt8 *)record + offset + sizeof(NuwaKextRecordField);
+}
+
+/**
+ * @brief Close a field opened by openRecordField once its data is filled
+
+ * @param record    buffer of the record
+ * @param offset    end of the record before the field
+ * @param type      field type
+ * @param length    number of bytes filled, no more than the opened ones
+ * @return          end of the record with the field
+ */
+static inline UInt32 closeRecordField(void *record, UInt32 offset, UInt16 type, UInt32 length) {
+    NuwaKextRecordField field = { type, (UInt16)length };
+    memcpy((UInt8 *)record + offset, &field, sizeof(field));
+    return alignRecordSize(offset + sizeof(field) + length);
+}
+
+// Called when the fields are all added, the header is stamped with the version and size.
+static inline UInt32 closeEventRecord(void *record, UInt32 size, const NuwaKextRecordHeader *header) {
+    NuwaKextRecordHeader stamp = *header;
+    if (size < sizeof(stamp) || size > 0xFFFF) {
+        return 0;
+    }
+    stamp.version = kEventRecordVersion;
+    stamp.size = (UInt16)size;
+    memcpy(record, &stamp, sizeof(stamp));
+    return size;
+}
+
+// Called when the record is committed, the header is stamped with the nanoseconds since boot and the sequence of its queue.
+static inline void stampEventRecord(void *record, UInt64 uptime, UInt32 sequence) {
+    memcpy((UInt8 *)record + offsetof(NuwaKextRecordHeader, uptime), &uptime, sizeof(uptime));
+    memcpy((UInt8 *)record + offsetof(NuwaKextRecordHeader, sequence), &sequence, sizeof(sequence));
+}
+
+// Called when append a field whose data is already at hand, returns 0 if it does not fit.
+static inline UInt32 appendRecordField(UInt8 *record, UInt32 capacity, UInt32 offset,
+                                       UInt16 type, const void *data, UInt32 length) {
+    void *field = openRecordField(record, capacity, offset, length);
+    if (field == NULL) {
+        return 0;
+    }
+    memcpy(field, data, length);
+    return closeRecordField(record, offset, type, length);
+}
+
+static inline UInt32 appendRecordString(UInt8 *record, UInt32 capacity, UInt32 offset,
+                                        UInt16 type, const char *string, UInt32 maxLength) {
+    return appendRecordField(record, capacity, offset, type, string, (UInt32)strnlen(string, maxLength));
+}
+
+/**
+ * @brief Encode an event into a record, only the fields used by its type are kept
+
+ * @param event     event to encode
+ * @param record    buffer of the record
+ * @param capacity  size of the buffer, kMaxEventRecordSize is always enough
+ * @return          size of the record, 0 if it does not fit
+ */
+static inline UInt32 encodeEventRecord(const NuwaKextEvent *event, void *record, UInt32 capacity) {
+    UInt8 *buffer = (UInt8 *)record;
+    UInt32 offset = sizeof(NuwaKextRecordHeader);
+    const NuwaKextFile *file = NULL;
+    if (capacity < offset) {
+        return 0;
+    }
+
+    switch (event->eventType) {
+        case kActionAuthProcessCreate:
+        case kActionNotifyProcessCreate:
+        case kActionNotifyFileOpen:
+        case kActionNotifyFileCloseModify:
+        case kActionNotifyFileDelete:
+        case kActionNotifyFileRename:
+            // All of them share the layout of the file info.
+            file = &event->fileRename.srcFile;
+            offset = appendRecordField(buffer, capacity, offset, kRecordFieldFileAttr, file, sizeof(NuwaKextFileAttr));
+            offset = appendRecordString(buffer, capacity, offset, kRecordFieldPath, file->path, kMaxPathLength);
+            if (event->eventType == kActionNotifyFileRename) {
+                offset = appendRecordString(buffer, capacity, offset, kRecordFieldNewPath, event->fileRename.newPath, kMaxPathLength);
+            }
+            break;
+
+        case kActionNotifyNetworkAccess:
+            offset = appendRecordField(buffer, capacity, offset, kRecordFieldProtocol, &event->netAccess.protocol, sizeof(UInt16));
+            offset = appendRecordField(buffer, capacity, offset, kRecordFieldLocalAddr, &event->netAccess.localAddr, sizeof(struct sockaddr));
+            offset = appendRecordField(buffer, capacity, offset, kRecordFieldRemoteAddr, &event->netAccess.remoteAddr, sizeof(struct sockaddr));
+            break;
+
+        case kActionNotifyDnsQuery:
+            offset = appendRecordField(buffer, capacity, offset, kRecordFieldQueryStatus, &event->dnsQuery.queryStatus, sizeof(SInt32));
+            offset = appendRecordString(buffer, capacity, offset, kRecordFieldDomainName, event->dnsQuery.domainName, kMaxNameLength);
+            offset = appendRecordString(buffer, capacity, offset, kRecordFieldQueryResult, event->dnsQuery.queryResult, kMaxPathLength);
+            break;
+
+        default:
+            break;
+    }
+    if (offset == 0) {
+        return 0;
+    }
+
+    // Times and sequence are stamped when the record is queued, none of them comes from the event.
+    NuwaKextRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.eventType = event->eventType;
+    header.vnodeID = event->vnodeID;
+    header.eventTime = event->eventTime;
+    header.mainProcess = event->mainProcess;
+    return closeEventRecord(buffer, offset, &header);
+}
+
+/**
+ * @brief Find a field of a record in place
+
+ * @param record    record as dequeued
+ * @param size      size of the record
+ * @param type      field type to look for
+ * @param length    set to the length of the field data
+ * @return          the field data within the record, NULL if the record has no such field
+ */
+static inline const void *findRecordField(const void *record, UInt32 size, UInt16 type, UInt32 *length) {
+    const UInt8 *buffer = (const UInt8 *)record;
+    UInt32 offset = sizeof(NuwaKextRecordHeader);
+
+    while (offset + sizeof(NuwaKextRecordField) <= size) {
+        NuwaKextRecordField field;
+        memcpy(&field, buffer + offset, sizeof(field));
+        offset += sizeof(field);
+        if (offset + field.length > size) {
+            break;
+        }
+        if (field.type == type) {
+            *length = field.length;
+            return buffer + offset;
+        }
+        offset = alignRecordSize(offset + field.length);
+    }
+    return NULL;
+}
+
+static inline void copyRecordString(char *string, UInt32 capacity, const void *data, UInt32 length) {
+    length = length < capacity ? length : capacity - 1;
+    memcpy(string, data, length);
+    string[length] = '\0';
+}
+
+// Called when read the header of a record in place, false if the record is too short.
+static inline bool readRecordHeader(const void *record, UInt32 size, NuwaKextRecordHeader *header) {
+    if (size < sizeof(NuwaKextRecordHeader)) {
+        return false;
+    }
+    memcpy(header, record, sizeof(NuwaKextRecordHeader));
+    return true;
+}
+
+// Called when obtain the commit time of a record, to pick the oldest one among the queue heads.
+static inline UInt64 getRecordUptime(const void *record, UInt32 size) {
+    NuwaKextRecordHeader header;
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, record, sizeof(header));
+    return header.uptime;
+}
+
+/**
+ * @brief Decode a record back into an event
+
+ * @param record    record as dequeued
+ * @param size      size of the record
+ * @param event     event to fill, fields missing from the record are left zero
+ * @return          size of the record, 0 if it is invalid or of another version
+ */
+static inline UInt32 decodeEventRecord(const void *record, UInt32 size, NuwaKextEvent *event) {
+    NuwaKextRecordHeader header;
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, record, sizeof(header));
+    if (header.version != kEventRecordVersion || header.size < sizeof(header) || header.size > size) {
+        return 0;
+    }
+
+    memset(event, 0, sizeof(NuwaKextEvent));
+    event->eventType = header.eventType;
+    event->vnodeID = header.vnodeID;
+    event->eventTime = header.eventTime;
+    event->mainProcess = header.mainProcess;
+
+    const UInt8 *buffer = (const UInt8 *)record;
+    UInt32 offset = sizeof(header);
+    while (offset + sizeof(NuwaKextRecordField) <= header.size) {
+        NuwaKextRecordField field;
+        memcpy(&field, buffer + offset, sizeof(field));
+        offset += sizeof(field);
+        if (offset + field.length > header.size) {
+            return 0;
+        }
+
+        const UInt8 *data = buffer + offset;
+        switch (field.type) {
+            case kRecordFieldFileAttr:
+                if (field.length == sizeof(NuwaKextFileAttr)) {
+                    memcpy(&event->fileRename.srcFile, data, field.length);
+                }
+                break;
+            case kRecordFieldPath:
+                copyRecordString(event->fileRename.srcFile.path, kMaxPathLength, data, field.length);
+                break;
+            case kRecordFieldNewPath:
+                copyRecordString(event->fileRename.newPath, kMaxPathLength, data, field.length);
+                break;
+            case kRecordFieldProtocol:
+                if (field.length == sizeof(UInt16)) {
+                    memcpy(&event->netAccess.protocol, data, field.length);
+                }
+                break;
+            case kRecordFieldLocalAddr:
+                if (field.length == sizeof(struct sockaddr)) {
+                    memcpy(&event->netAccess.localAddr, data, field.length);
+                }
+                break;
+            case kRecordFieldRemoteAddr:
+                if (field.length == sizeof(struct sockaddr)) {
+                    memcpy(&event->netAccess.remoteAddr, data, field.length);
+                }
+                break;
+            case kRecordFieldQueryStatus:
+                if (field.length == sizeof(SInt32)) {
+                    memcpy(&event->dnsQuery.queryStatus, data, field.length);
+                }
+                break;
+            case kRecordFieldDomainName:
+                copyRecordString(event->dnsQuery.domainName, kMaxNameLength, data, field.length);
+                break;
+            case kRecordFieldQueryResult:
+                copyRecordString(event->dnsQuery.queryResult, kMaxPathLength, data, field.length);
+                break;
+            default:
+                break;
+        }
+        offset = alignRecordSize(offset + field.length);
+    }
+    return header.size;
+}
+
+#endif /* EventRecord_h */
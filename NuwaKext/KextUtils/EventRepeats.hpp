@@ -0,0 +1,66 @@
+//
+//  EventRepeats.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventRepeats_hpp
+#define EventRepeats_hpp
+
+#include "FlatCache.hpp"
+
+/**
+ * @brief Key of the repeats of an event, same type, process and file
+ */
+typedef struct EventRepeatKey {
+    UInt64 vnodeID;
+    UInt32 pid;
+    UInt32 eventType;
+
+    bool operator==(const EventRepeatKey &other) const {
+        return vnodeID == other.vnodeID && pid == other.pid && eventType == other.eventType;
+    }
+} EventRepeatKey;
+
+static inline UInt64 cacheMixer(const EventRepeatKey &key) {
+    return cacheMixer(key.vnodeID ^ (((UInt64)key.pid << 32) | key.eventType));
+}
+
+typedef FlatCache<EventRepeatKey, UInt32> EventRepeatCache;
+
+// Event whose repeats were coalesced but never sent with a later one, its value being the repeats.
+typedef EventRepeatCache::DroppedEntry EventRepeatEntry;
+
+// Room for the entries a single count may drop, one evicted and one per slot swept.
+static const UInt32 kMaxDroppedRepeats = kFlatCacheSweepSlots + 1;
+
+/**
+ * @brief Count an event in the cache of repeated events, the first one of each lifetime is sent
+
+ * @param cache     cache whose lifetime is the window of coalescing
+ * @param key       type, process and file of the event
+ * @param repeats   set to the repeats coalesced since the previous one sent, when this one is sent
+ * @param dropped   filled with other events expired or evicted meanwhile, with repeats still to send
+ * @param dropCount room of dropped, at least kMaxDroppedRepeats, set to the number of events filled
+ * @return          true if the event repeats one sent within the lifetime and is coalesced
+ */
+static inline bool countEventRepeat(EventRepeatCache *cache, const EventRepeatKey &key, UInt32 *repeats,
+                                    EventRepeatEntry *dropped, UInt32 *dropCount) {
+    UInt32 count = 0;
+    bool result = cache->countObject(key, &count, dropped, dropCount);
+    // The count of a lifetime includes the event sent then, only the rest are repeats.
+    UInt32 pending = 0;
+    for (UInt32 i = 0; i < *dropCount; ++i) {
+        if (dropped[i].value > 1) {
+            dropped[pending].key = dropped[i].key;
+            dropped[pending].value = dropped[i].value - 1;
+            pending++;
+        }
+    }
+    *dropCount = pending;
+    *repeats = !result && count > 1 ? count - 1 : 0;
+    return result;
+}
+
+#endif /* EventRepeats_hpp */
@@ -0,0 +1,217 @@
+//
+//  EventRing.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventRing.hpp"
+#include "ObjectPool.hpp"
+
+// Set in the size of an entry until it is committed, the client never sees it.
+static const UInt32 kEntryPending = 0x80000000;
+
+EventRing::EventRing(IODataQueueMemory *memory, UInt32 queueSize) {
+    m_memory = memory;
+    m_queueSize = queueSize;
+    m_reserveTail = memory != nullptr ? memory->tail : 0;
+    m_sequence = 0;
+    m_publishRequests = 0;
+    m_isClosed = false;
+    m_reserveLock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+}
+
+EventRing::~EventRing() {
+    if (m_reserveLock != nullptr) {
+        lck_mtx_free(m_reserveLock, g_driverLockGrp);
+        m_reserveLock = nullptr;
+    }
+}
+
+UInt32 EventRing::loadEntrySize(UInt32 offset) const {
+    IODataQueueEntry *entry = (IODataQueueEntry *)((UInt8 *)m_memory->queue + offset);
+    return __atomic_load_n(&entry->size, __ATOMIC_ACQUIRE);
+}
+
+void *EventRing::reserve(UInt32 size, Reservation *reservation) {
+    size = alignEntrySize(size);
+    UInt32 entrySize = size + DATA_QUEUE_ENTRY_HEADER_SIZE;
+    if (m_memory == nullptr || m_reserveLock == nullptr || size >= kEntryPending || entrySize > m_queueSize) {
+        return nullptr;
+    }
+
+    lck_mtx_lock(m_reserveLock);
+    if (m_isClosed) {
+        lck_mtx_unlock(m_reserveLock);
+        return nullptr;
+    }
+    UInt32 sequence = m_sequence++;
+    UInt32 head = __atomic_load_n(&m_memory->head, __ATOMIC_ACQUIRE);
+    UInt32 tail = m_reserveTail;
+    UInt32 offset = tail;
+    if (!findRoom(head, tail, entrySize, &offset)) {
+        lck_mtx_unlock(m_reserveLock);
+        return nullptr;
+    }
+
+    IODataQueueEntry *entry = (IODataQueueEntry *)((UInt8 *)m_memory->queue + offset);
+    if (offset != tail && m_queueSize - tail >= DATA_QUEUE_ENTRY_HEADER_SIZE) {
+        // Its size does not fit before the end, telling the client to go on from the start.
+        IODataQueueEntry *marker = (IODataQueueEntry *)((UInt8 *)m_memory->queue + tail);
+        __atomic_store_n(&marker->size, size, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&entry->size, size | kEntryPending, __ATOMIC_RELAXED);
+    // Entries below the tail of the reservations are always readable by a publisher.
+    __atomic_store_n(&m_reserveTail, offset + entrySize, __ATOMIC_RELEASE);
+    lck_mtx_unlock(m_reserveLock);
+
+    reservation->start = tail;
+    reservation->entry = offset;
+    reservation->size = size;
+    reservation->end = offset + entrySize;
+    reservation->sequence = sequence;
+    return entry->data;
+}
+
+bool EventRing::findRoom(UInt32 head, UInt32 tail, UInt32 entrySize, UInt32 *offset) const {
+    // Same room checks as IOSharedDataQueue::enqueue, with the reservations counted as queued.
+    *offset = tail;
+    if (tail >= head) {
+        if (entrySize > m_queueSize - tail) {
+            if (head <= entrySize) {
+                return false;
+            }
+            *offset = 0;
+        }
+    } else if (head - tail <= entrySize) {
+        return false;
+    }
+    return true;
+}
+
+bool EventRing::hasRoom(UInt32 size) const {
+    UInt32 entrySize = alignEntrySize(size) + DATA_QUEUE_ENTRY_HEADER_SIZE;
+    if (m_memory == nullptr || isClosed() || entrySize > m_queueSize) {
+        return false;
+    }
+    UInt32 offset = 0;
+    UInt32 head = __atomic_load_n(&m_memory->head, __ATOMIC_ACQUIRE);
+    return findRoom(head, __atomic_load_n(&m_reserveTail, __ATOMIC_ACQUIRE), entrySize, &offset);
+}
+
+UInt32 EventRing::shareByCpus(UInt32 ring, UInt32 ringCount, UInt32 cpuCount, UInt32 entries, UInt32 minEntries) {
+    if (ringCount == 0 || cpuCount == 0) {
+        return minEntries;
+    }
+    // CPU c takes ring c % ringCount, so the first cpuCount % ringCount rings have one more.
+    UInt32 cpus = cpuCount / ringCount + (ring % ringCount < cpuCount % ringCount ? 1 : 0);
+    UInt32 share = (UInt32)((UInt64)entries * cpus / cpuCount);
+    return share > minEntries ? share : minEntries;
+}
+
+bool EventRing::commit(Reservation *reservation, UInt32 size) {
+    size = alignEntrySize(size);
+    if (size < reservation->size && __atomic_load_n(&m_reserveTail, __ATOMIC_RELAXED) == reservation->end) {
+        // Nobody reserved after it, so the unused bytes go back to the queue.
+        lck_mtx_lock(m_reserveLock);
+        if (m_reserveTail == reservation->end) {
+            reservation->size = size;
+            reservation->end = reservation->entry + size + DATA_QUEUE_ENTRY_HEADER_SIZE;
+            __atomic_store_n(&m_reserveTail, reservation->end, __ATOMIC_RELEASE);
+        }
+        lck_mtx_unlock(m_reserveLock);
+    }
+
+    IODataQueueEntry *entry = (IODataQueueEntry *)((UInt8 *)m_memory->queue + reservation->entry);
+    __atomic_store_n(&entry->size, reservation->size, __ATOMIC_RELEASE);
+    return publish();
+}
+
+bool EventRing::abort(Reservation *reservation) {
+    bool result = false;
+
+    lck_mtx_lock(m_reserveLock);
+    // Its sequence goes back too, or the client would count the entry as dropped.
+    if (m_reserveTail == reservation->end && m_sequence == reservation->sequence + 1) {
+        __atomic_store_n(&m_reserveTail, reservation->start, __ATOMIC_RELEASE);
+        m_sequence = reservation->sequence;
+        result = true;
+    }
+    lck_mtx_unlock(m_reserveLock);
+    return result;
+}
+
+UInt32 EventRing::getUsedSize() const {
+    UInt32 head = __atomic_load_n(&m_memory->head, __ATOMIC_RELAXED);
+    UInt32 tail = __atomic_load_n(&m_reserveTail, __ATOMIC_RELAXED);
+    return tail >= head ? tail - head : m_queueSize - head + tail;
+}
+
+void EventRing::close() {
+    if (m_reserveLock == nullptr) {
+        return;
+    }
+    // Taken under the lock, so no reservation gets past it once it returns.
+    lck_mtx_lock(m_reserveLock);
+    __atomic_store_n(&m_isClosed, true, __ATOMIC_RELEASE);
+    lck_mtx_unlock(m_reserveLock);
+}
+
+bool EventRing::isSettled() const {
+    if (m_memory == nullptr) {
+        return true;
+    }
+    return __atomic_load_n(&m_memory->tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&m_reserveTail, __ATOMIC_ACQUIRE);
+}
+
+bool EventRing::publish() {
+    // One producer moves the tail at a time, the others leave a request it takes before leaving.
+    if (__atomic_fetch_add(&m_publishRequests, 1, __ATOMIC_ACQ_REL) != 0) {
+        return false;
+    }
+
+    bool wasEmpty = false;
+    UInt32 requests = 1;
+    do {
+        wasEmpty = advanceTail() || wasEmpty;
+        // Requests left meanwhile may be for entries the walk stopped at, so it walks again.
+    } while (!__atomic_compare_exchange_n(&m_publishRequests, &requests, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    return wasEmpty;
+}
+
+bool EventRing::advanceTail() {
+    bool wasEmpty = false;
+
+    while (true) {
+        UInt32 tail = __atomic_load_n(&m_memory->tail, __ATOMIC_RELAXED);
+        if (tail == __atomic_load_n(&m_reserveTail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // Walk the entries the way IODataQueueDequeue does.
+        UInt32 offset = tail;
+        UInt32 size = 0;
+        if (m_queueSize - tail < DATA_QUEUE_ENTRY_HEADER_SIZE) {
+            offset = 0;
+        } else {
+            size = loadEntrySize(tail);
+            if (size & kEntryPending) {
+                break;
+            }
+            if (size > m_queueSize - tail - DATA_QUEUE_ENTRY_HEADER_SIZE) {
+                offset = 0;
+            }
+        }
+        if (offset != tail) {
+            size = loadEntrySize(0);
+            if (size & kEntryPending) {
+                break;
+            }
+        }
+
+        // Only the publisher moves it, so the entry read at the tail is still the one there.
+        wasEmpty = wasEmpty || tail == __atomic_load_n(&m_memory->head, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&m_memory->tail, offset + size + DATA_QUEUE_ENTRY_HEADER_SIZE, __ATOMIC_RELEASE);
+    }
+    return wasEmpty;
+}
@@ -0,0 +1,121 @@
+//
+//  EventRing.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef EventRing_hpp
+#define EventRing_hpp
+
+#include "KextPlatform.hpp"
+
+/**
+ * @brief Producer side of a shared data queue, filled in place by many producers
+ * Entries keep the IODataQueue layout, so the client dequeues them as usual. A producer
+ * reserves an entry, fills it in the queue memory and commits it. The tail seen by the
+ * client only moves over committed entries, in reservation order. One committing producer
+ * at a time moves it, for the entries of the others too, so nobody waits for a slower one.
+ */
+class EventRing {
+
+public:
+    /**
+     * @brief Entry reserved by a producer
+     */
+    struct Reservation {
+        // Where the reservation starts, at the wrap marker if it wrapped.
+        UInt32 start;
+        UInt32 entry;
+        UInt32 size;
+        // Private tail right after the reservation.
+        UInt32 end;
+        // Taken by every attempt to reserve, so the entries refused for room leave holes.
+        UInt32 sequence;
+    };
+
+    /**
+     * @brief Create the ring over the memory of a data queue
+
+     * @param memory    memory shared with the client, head and tail included
+     * @param queueSize number of bytes of the entries
+     */
+    EventRing(IODataQueueMemory *memory, UInt32 queueSize);
+    ~EventRing();
+
+    /**
+     * @brief Reserve an entry
+
+     * @param size          max number of bytes of the data, rounded up to 4
+     * @param reservation   filled with the reserved entry
+     * @return              where the data goes, nullptr if the queue is full
+     */
+    void *reserve(UInt32 size, Reservation *reservation);
+
+    /**
+     * @brief Publish a filled entry
+
+     * @param reservation   reserved entry
+     * @param size          number of bytes filled, the unused ones are given back if nobody reserved after
+     * @return              true if the queue was empty, so the client has to be woken up
+     */
+    bool commit(Reservation *reservation, UInt32 size);
+
+    // Called when give a reservation back unfilled, false if others tried to reserve after it and it has to be committed.
+    bool abort(Reservation *reservation);
+
+    // Called when check, without taking a sequence, whether an entry of size bytes fits now; reserve may still refuse it.
+    bool hasRoom(UInt32 size) const;
+
+    // Called when obtain the bytes taken by queued and reserved entries.
+    UInt32 getUsedSize() const;
+
+    // Called when stop taking reservations, those taken are still committed.
+    void close();
+
+    bool isClosed() const {
+        return __atomic_load_n(&m_isClosed, __ATOMIC_ACQUIRE);
+    }
+
+    // Called when check whether every reservation is committed or given back, so the client sees all of them.
+    bool isSettled() const;
+
+    UInt32 getQueueSize() const {
+        return m_queueSize;
+    }
+
+    static UInt32 alignEntrySize(UInt32 size) {
+        return (size + 3) & ~3U;
+    }
+
+    /**
+     * @brief Share the entries of a lane among rings picked by cpu_number() % ringCount
+
+     * @param ring          index of the ring
+     * @param ringCount     number of rings of the lane
+     * @param cpuCount      number of CPUs, those above ringCount share rings
+     * @param entries       entries of the lane, each ring gets its part of the CPUs mapped to it
+     * @param minEntries    least entries of a ring, those no CPU maps to still take producers falling over
+     * @return              entries of the ring
+     */
+    static UInt32 shareByCpus(UInt32 ring, UInt32 ringCount, UInt32 cpuCount, UInt32 entries, UInt32 minEntries);
+
+private:
+    bool publish();
+    bool advanceTail();
+    bool findRoom(UInt32 head, UInt32 tail, UInt32 entrySize, UInt32 *offset) const;
+    UInt32 loadEntrySize(UInt32 offset) const;
+
+    IODataQueueMemory *m_memory;
+    UInt32 m_queueSize;
+    // Tail of the reservations, ahead of the tail seen by the client.
+    UInt32 m_reserveTail;
+    // Sequence of the next attempt to reserve.
+    UInt32 m_sequence;
+    // Commits since the publisher began, 0 when nobody publishes.
+    UInt32 m_publishRequests;
+    bool m_isClosed;
+    lck_mtx_t *m_reserveLock;
+};
+
+#endif /* EventRing_hpp */
@@ -0,0 +1,460 @@
+//
+//  FlatCache.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef FlatCache_hpp
+#define FlatCache_hpp
+
+#include "DriverCache.hpp"
+
+static const UInt8 kFlatCacheLoadFactor = 75; // percent
+static const UInt8 kFlatCacheMaxProbe = 0xFF;
+static const UInt8 kFlatCacheSweepSlots = 8;
+
+/**
+ * @brief Open addressing cache with the same interface as DriverCache
+ * Keys and values are stored inline in a slot array preallocated per stripe, collisions
+ * are resolved by Robin Hood linear probing, so inserts never allocate and lookups touch
+ * a few adjacent control bytes instead of chasing a chain of nodes.
+ */
+template <typename KeyType, typename ValueType>
+class FlatCache {
+
+public:
+    ValueType zero;
+
+    /**
+     * @brief Entry dropped on expiry or eviction, given back to the caller that dropped it
+     */
+    struct DroppedEntry {
+        KeyType key;
+        ValueType value;
+    };
+
+    FlatCache(UInt64 capacity = 1024) {
+        if (capacity < 1) {
+            capacity = 1;
+        }
+        m_capacity = capacity;
+        m_lifetime = 0;
+        m_isSweeping = false;
+
+        m_stripeCount = 1;
+        while (m_stripeCount < kMaxCacheStripes && m_stripeCount * kDefaultBucketCapacity * 2 <= capacity) {
+            m_stripeCount <<= 1;
+        }
+
+        UInt64 stripeCapacity = (capacity + m_stripeCount - 1) / m_stripeCount;
+        // Keep the load factor under the limit, the slot count must be a power of two
+        UInt64 slotCount = 2;
+        while (slotCount * kFlatCacheLoadFactor < stripeCapacity * 100) {
+            slotCount <<= 1;
+        }
+
+        m_stripes = (Stripe *)IOMallocAligned(sizeof(Stripe)*m_stripeCount, kCacheLineSize);
+        if (m_stripes == nullptr) {
+            m_stripeCount = 0;
+            return;
+        }
+        bzero(m_stripes, sizeof(Stripe)*m_stripeCount);
+
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            stripe->capacity = stripeCapacity;
+            stripe->slotMask = slotCount - 1;
+            stripe->control = (UInt8 *)IOMallocAligned(slotCount, kCacheLineSize);
+            stripe->slots = (Slot *)IOMallocAligned(sizeof(Slot)*slotCount, kCacheLineSize);
+            if (stripe->control != nullptr && stripe->slots != nullptr) {
+                bzero(stripe->control, slotCount);
+                stripe->lock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+            }
+        }
+    }
+
+    ~FlatCache() {
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            UInt64 slotCount = stripe->slotMask + 1;
+            if (stripe->control != nullptr) {
+                IOFreeAligned(stripe->control, slotCount);
+            }
+            if (stripe->slots != nullptr) {
+                IOFreeAligned(stripe->slots, sizeof(Slot)*slotCount);
+            }
+            if (stripe->lock != nullptr) {
+                lck_mtx_free(stripe->lock, g_driverLockGrp);
+            }
+        }
+        if (m_stripes != nullptr) {
+            IOFreeAligned(m_stripes, sizeof(Stripe)*m_stripeCount);
+        }
+    }
+
+    ValueType getObject(KeyType key) {
+        ValueType value = zero;
+        UInt64 hash = cacheMixer(key);
+        Stripe *stripe = getStripe(hash);
+        if (stripe == nullptr) {
+            return value;
+        }
+
+        lck_mtx_lock(stripe->lock);
+        SInt64 index = findSlot(stripe, hash, key);
+        if (index >= 0 && isExpired(&stripe->slots[index], 0)) {
+            // Expire lazily, the caller sees a miss.
+            removeSlot(stripe, index);
+            stripe->expirations++;
+            index = -1;
+        }
+        if (index >= 0) {
+            value = stripe->slots[index].value;
+            stripe->slots[index].referenced = true;
+            stripe->hits++;
+        } else {
+            stripe->misses++;
+        }
+        lck_mtx_unlock(stripe->lock);
+
+        return value;
+    }
+
+    bool setObject(const KeyType &key, const ValueType &value) {
+        bool result = false;
+        UInt64 hash = cacheMixer(key);
+        Stripe *stripe = getStripe(hash);
+        if (stripe == nullptr) {
+            return result;
+        }
+
+        lck_mtx_lock(stripe->lock);
+        SInt64 index = findSlot(stripe, hash, key);
+        if (index >= 0) {
+            if (value == zero) {
+                removeSlot(stripe, index);
+            } else {
+                stripe->slots[index].value = value;
+                stripe->slots[index].expiry = getExpiry();
+            }
+            result = true;
+        } else if (value != zero) {
+            if (stripe->itemCount >= stripe->capacity) {
+                evictSlot(stripe);
+            }
+            result = insertSlot(stripe, hash, key, value);
+        }
+        if (m_isSweeping) {
+            sweepExpired(stripe);
+        }
+        lck_mtx_unlock(stripe->lock);
+
+        return result;
+    }
+
+    /**
+     * @brief Count one more use of a live entry, or start the entry anew
+     * The value of an entry is its count, a missing or expired entry starts at one.
+
+     * @param key       key of the entry
+     * @param previous  set to the count the entry ends with when it starts anew, zero if it was missing
+     * @param dropped   filled with the other entries dropped meanwhile on expiry or eviction, may be nullptr
+     * @param dropCount room of dropped, set to the number of entries filled
+     * @return          true if the entry was live and only counted
+     */
+    bool countObject(const KeyType &key, ValueType *previous, DroppedEntry *dropped = nullptr, UInt32 *dropCount = nullptr) {
+        bool result = false;
+        UInt64 hash = cacheMixer(key);
+        Stripe *stripe = getStripe(hash);
+        DropList drops = { dropped, dropped != nullptr ? *dropCount : 0, 0 };
+        *previous = zero;
+        if (dropCount != nullptr) {
+            *dropCount = 0;
+        }
+        if (stripe == nullptr) {
+            return result;
+        }
+
+        lck_mtx_lock(stripe->lock);
+        SInt64 index = findSlot(stripe, hash, key);
+        if (index >= 0 && !isExpired(&stripe->slots[index], 0)) {
+            stripe->slots[index].value++;
+            stripe->slots[index].referenced = true;
+            stripe->hits++;
+            result = true;
+        } else if (index >= 0) {
+            *previous = stripe->slots[index].value;
+            stripe->slots[index].value = 1;
+            stripe->slots[index].expiry = getExpiry();
+            stripe->expirations++;
+        } else {
+            if (stripe->itemCount >= stripe->capacity) {
+                evictSlot(stripe, &drops);
+            }
+            insertSlot(stripe, hash, key, 1);
+            stripe->misses++;
+        }
+        if (m_isSweeping) {
+            sweepExpired(stripe, &drops);
+        }
+        lck_mtx_unlock(stripe->lock);
+
+        if (dropCount != nullptr) {
+            *dropCount = drops.count;
+        }
+        return result;
+    }
+
+    void clearObjects() {
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            Stripe *stripe = &m_stripes[i];
+            if (stripe->lock == nullptr) {
+                continue;
+            }
+            lck_mtx_lock(stripe->lock);
+            clearStripe(stripe);
+            lck_mtx_unlock(stripe->lock);
+        }
+    }
+
+    UInt64 getCount() const {
+        UInt64 count = 0;
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            count += m_stripes[i].itemCount;
+        }
+        return count;
+    }
+
+    void getStatistics(CacheStatistics *stats) const {
+        bzero(stats, sizeof(CacheStatistics));
+        for (UInt32 i = 0; i < m_stripeCount; ++i) {
+            stats->hits += m_stripes[i].hits;
+            stats->misses += m_stripes[i].misses;
+            stats->evictions += m_stripes[i].evictions;
+            stats->expirations += m_stripes[i].expirations;
+        }
+    }
+
+    /**
+     * @brief Set how long an entry stays valid after it is set
+
+     * @param milliseconds  lifetime of entries set from now on, 0 means forever
+     */
+    void setLifetime(UInt64 milliseconds) {
+        UInt64 lifetime = 0;
+        nanoseconds_to_absolutetime(milliseconds * NSEC_PER_MSEC, &lifetime);
+        m_lifetime = lifetime;
+        // Entries set before keep their expiry, so they are still swept once the lifetime is lifted.
+        if (lifetime != 0) {
+            m_isSweeping = true;
+        }
+    }
+
+private:
+    struct Slot {
+        KeyType key;
+        ValueType value;
+        // Set on lookup, cleared when the clock hand passes by.
+        bool referenced;
+        // Uptime after which the entry is stale, 0 means never.
+        UInt64 expiry;
+    };
+
+    /**
+     * @brief Independently locked part of the cache
+     * A control byte holds the probe distance of its slot plus one, zero means empty.
+     */
+    struct __attribute__((aligned(kCacheLineSize))) Stripe {
+        lck_mtx_t *lock;
+        UInt64 itemCount;
+        UInt64 capacity;
+        UInt64 slotMask;
+        UInt8 *control;
+        Slot *slots;
+        // Slot the clock hand of the eviction points to.
+        UInt64 clockHand;
+        // Slot the sweeper of expired entries points to.
+        UInt64 sweepHand;
+        UInt64 hits;
+        UInt64 misses;
+        UInt64 evictions;
+        UInt64 expirations;
+    };
+
+    // Where the entries dropped during a call go, a full list stops the sweeping.
+    struct DropList {
+        DroppedEntry *entries;
+        UInt32 room;
+        UInt32 count;
+    };
+
+    Stripe *getStripe(UInt64 hash) const {
+        if (m_stripeCount == 0) {
+            return nullptr;
+        }
+        Stripe *stripe = &m_stripes[(hash >> 48) & (m_stripeCount - 1)];
+        if (stripe->lock == nullptr) {
+            return nullptr;
+        }
+        return stripe;
+    }
+
+    static UInt64 homeSlot(const Stripe *stripe, UInt64 hash) {
+        // The low bits of the product only depend on the low bits of the key, skip them.
+        return (hash >> 16) & stripe->slotMask;
+    }
+
+    // Called with the lock of the stripe held.
+    SInt64 findSlot(const Stripe *stripe, UInt64 hash, const KeyType &key) const {
+        UInt64 index = homeSlot(stripe, hash);
+        UInt8 distance = 1;
+
+        // Robin Hood keeps slots ordered by distance, stop once ours would have been placed.
+        while (stripe->control[index] >= distance) {
+            if (stripe->slots[index].key == key) {
+                return (SInt64)index;
+            }
+            index = (index + 1) & stripe->slotMask;
+            if (++distance == kFlatCacheMaxProbe) {
+                break;
+            }
+        }
+        return -1;
+    }
+
+    // Called with the lock of the stripe held.
+    bool insertSlot(Stripe *stripe, UInt64 hash, const KeyType &key, const ValueType &value) {
+        UInt64 index = homeSlot(stripe, hash);
+        UInt8 distance = 1;
+
+        // The entry goes before the first richer one, which moves on with those after it.
+        while (stripe->control[index] >= distance) {
+            index = (index + 1) & stripe->slotMask;
+            if (++distance == kFlatCacheMaxProbe) {
+                // Only happens with a pathological hash, nothing is moved yet.
+                return false;
+            }
+        }
+        // Checked before anything moves, so no entry already stored is dropped.
+        UInt64 end = index;
+        while (stripe->control[end] != 0) {
+            if (stripe->control[end] + 1 == kFlatCacheMaxProbe) {
+                return false;
+            }
+            end = (end + 1) & stripe->slotMask;
+        }
+
+        // Shift the entries up to the empty slot one slot on, the last one first.
+        while (end != index) {
+            UInt64 previous = (end - 1) & stripe->slotMask;
+            stripe->slots[end] = stripe->slots[previous];
+            stripe->control[end] = stripe->control[previous] + 1;
+            end = previous;
+        }
+        stripe->slots[index] = { key, value, true, getExpiry() };
+        stripe->control[index] = distance;
+        stripe->itemCount++;
+        return true;
+    }
+
+    // Called with the lock of the stripe held.
+    void removeSlot(Stripe *stripe, UInt64 index) {
+        UInt64 next = (index + 1) & stripe->slotMask;
+
+        // Shift the following entries back instead of leaving a tombstone.
+        while (stripe->control[next] > 1) {
+            stripe->slots[index] = stripe->slots[next];
+            stripe->control[index] = stripe->control[next] - 1;
+            index = next;
+            next = (next + 1) & stripe->slotMask;
+        }
+        stripe->control[index] = 0;
+        stripe->itemCount--;
+    }
+
+    /**
+     * @brief Evict one entry of the full stripe with the CLOCK policy
+     * The hand sweeps the slots, giving referenced entries a second chance.
+     * Called with the lock of the stripe held.
+     */
+    void evictSlot(Stripe *stripe, DropList *drops = nullptr) {
+        UInt64 slotCount = stripe->slotMask + 1;
+
+        // Two rounds are enough, the first one clears every referenced bit.
+        for (UInt64 scanned = 0; scanned <= slotCount * 2; ++scanned) {
+            UInt64 index = stripe->clockHand;
+            if (stripe->control[index] != 0) {
+                if (!stripe->slots[index].referenced || isExpired(&stripe->slots[index], 0)) {
+                    keepDropped(drops, &stripe->slots[index]);
+                    removeSlot(stripe, index);
+                    stripe->evictions++;
+                    return;
+                }
+                stripe->slots[index].referenced = false;
+            }
+            stripe->clockHand = (index + 1) & stripe->slotMask;
+        }
+    }
+
+    UInt64 getExpiry() const {
+        return m_lifetime == 0 ? 0 : cacheUptime() + m_lifetime;
+    }
+
+    static bool isExpired(const Slot *slot, UInt64 now) {
+        if (slot->expiry == 0) {
+            return false;
+        }
+        return slot->expiry <= (now != 0 ? now : cacheUptime());
+    }
+
+    /**
+     * @brief Drop the expired entries of a few slots after the sweep hand
+     * Called with the lock of the stripe held.
+     */
+    void sweepExpired(Stripe *stripe, DropList *drops = nullptr) {
+        UInt64 now = cacheUptime();
+
+        for (UInt8 i = 0; i < kFlatCacheSweepSlots; ++i) {
+            UInt64 index = stripe->sweepHand;
+            // Removing shifts the next entry into this slot, so check it again.
+            while (stripe->control[index] != 0 && isExpired(&stripe->slots[index], now)) {
+                if (!keepDropped(drops, &stripe->slots[index])) {
+                    // Left for a later sweep, rather than dropped without the caller knowing.
+                    return;
+                }
+                removeSlot(stripe, index);
+                stripe->expirations++;
+            }
+            stripe->sweepHand = (index + 1) & stripe->slotMask;
+        }
+    }
+
+    // Called when an entry is about to be dropped, false if the list has no room left for it.
+    static bool keepDropped(DropList *drops, const Slot *slot) {
+        if (drops == nullptr || drops->entries == nullptr) {
+            return true;
+        }
+        if (drops->count >= drops->room) {
+            return false;
+        }
+        drops->entries[drops->count].key = slot->key;
+        drops->entries[drops->count].value = slot->value;
+        drops->count++;
+        return true;
+    }
+
+    // Called with the lock of the stripe held.
+    void clearStripe(Stripe *stripe) {
+        bzero(stripe->control, stripe->slotMask + 1);
+        stripe->itemCount = 0;
+    }
+
+    UInt64 m_capacity;
+    UInt64 m_lifetime;
+    bool m_isSweeping;
+    UInt32 m_stripeCount;
+    Stripe *m_stripes;
+};
+
+#endif /* FlatCache_hpp */
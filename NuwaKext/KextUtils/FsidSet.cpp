@@ -0,0 +1,65 @@
+//
+//  FsidSet.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "FsidSet.hpp"
+
+FsidSet::FsidSet() {
+    m_bitmap = 0;
+    m_count = 0;
+    bzero(m_fsids, sizeof(m_fsids));
+    bzero(m_drops, sizeof(m_drops));
+}
+
+SInt32 FsidSet::findFsid(UInt32 fsid) const {
+    if ((m_bitmap & getFsidBit(fsid)) == 0) {
+        return -1;
+    }
+    for (UInt32 i = 0; i < m_count; ++i) {
+        if (m_fsids[i] == fsid) {
+            return (SInt32)i;
+        }
+    }
+    return -1;
+}
+
+bool FsidSet::addFsid(UInt32 fsid, const FsidSet *previous) {
+    if (findFsid(fsid) >= 0) {
+        return true;
+    }
+    if (m_count >= kMaxExcludedFsids) {
+        return false;
+    }
+
+    m_fsids[m_count] = fsid;
+    m_drops[m_count] = 0;
+    // Filesystems still excluded keep their counters.
+    SInt32 index = previous != nullptr ? previous->findFsid(fsid) : -1;
+    if (index >= 0) {
+        m_drops[m_count] = __atomic_load_n(&previous->m_drops[index], __ATOMIC_RELAXED);
+    }
+    m_bitmap |= getFsidBit(fsid);
+    m_count++;
+    return true;
+}
+
+bool FsidSet::isExcluded(UInt32 fsid) {
+    SInt32 index = findFsid(fsid);
+    if (index < 0) {
+        return false;
+    }
+    __atomic_fetch_add(&m_drops[index], 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+UInt32 FsidSet::getDrops(NuwaKextFsidDrops *drops, UInt32 count) const {
+    count = m_count < count ? m_count : count;
+    for (UInt32 i = 0; i < count; ++i) {
+        drops[i].fsid = m_fsids[i];
+        drops[i].drops = __atomic_load_n(&m_drops[i], __ATOMIC_RELAXED);
+    }
+    return count;
+}
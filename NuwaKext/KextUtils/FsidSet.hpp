@@ -0,0 +1,58 @@
+//
+//  FsidSet.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef FsidSet_hpp
+#define FsidSet_hpp
+
+#include "KextPlatform.hpp"
+#include "KextCommon.hpp"
+
+/**
+ * @brief Filesystems whose file events are dropped, with the drops counted for each
+ * A bit per hashed fsid is checked first, so the events of the other filesystems cost
+ * a single test. The set is built once and published, only its counters change after.
+ */
+class FsidSet {
+
+public:
+    FsidSet();
+
+    /**
+     * @brief Add a filesystem while the set is built
+
+     * @param fsid      fsid of the filesystem, added once whatever the times it is given
+     * @param previous  set replaced by this one, the drops it counted for the filesystem are kept
+     * @return          false if the set already holds kMaxExcludedFsids
+     */
+    bool addFsid(UInt32 fsid, const FsidSet *previous);
+
+    // Called when check whether the filesystem is excluded, its drops are counted if so.
+    bool isExcluded(UInt32 fsid);
+
+    // Called when obtain the drops counted for the filesystems, returns their number.
+    UInt32 getDrops(NuwaKextFsidDrops *drops, UInt32 count) const;
+
+    bool isEmpty() const {
+        return m_count == 0;
+    }
+
+private:
+    static UInt64 getFsidBit(UInt32 fsid) {
+        // Device numbers differ in a few bits only, spread them over the top 6 bits.
+        return 1ULL << ((fsid * 0x9E3779B1U) >> 26);
+    }
+
+    SInt32 findFsid(UInt32 fsid) const;
+
+    // One bit per hashed fsid, lookups of the other filesystems stop here.
+    UInt64 m_bitmap;
+    UInt32 m_count;
+    UInt32 m_fsids[kMaxExcludedFsids];
+    UInt64 m_drops[kMaxExcludedFsids];
+};
+
+#endif /* FsidSet_hpp */
@@ -19,14 +19,39 @@ extern "C" {
 }
 #endif
 
-static const char *kSocketFilterName = "NuwaStone.socketfilter";
+static const char * const kSocketFilterName = "NuwaStone.socketfilter";
 static const UInt32 kBaseFilterHandle = 0xFEEDBEEF;
 static const UInt32 kMaxAuthWaitTime = 30000; // ms
 static const UInt32 kMaxAuthQueueEvents = 1024;
-static const UInt32 kMaxNotifyQueueEvents = 2048;
+static const UInt32 kMaxNotifyQueueEvents = 2048; // shared by the notify rings
+static const UInt32 kMaxCriticalQueueEvents = 512;
+static const UInt32 kMinResizedQueueEvents = 64; // bounds of the sizes set by client, those above being initial
+static const UInt32 kMaxResizedQueueEvents = 32768;
+static const UInt32 kNotifyRingCount = 8;
+static const UInt32 kDefaultWakeupEvents = 32;
+static const UInt32 kDefaultWakeupDelay = 1000; // us
+static const UInt32 kMaxWakeupDelay = 100000; // us
+static const UInt32 kOverloadWatermark = 75; // % of a notify ring
+static const UInt32 kOverloadSampleRate = 8; // 1 in N events of the sampled classes kept under overload
+static const UInt32 kDropReportInterval = 1000; // ms
+static const UInt32 kDefaultProcEventRate = 500; // events per second of a class per process
+static const UInt32 kDefaultProcEventBurst = 2000;
+static const UInt32 kThrottleSummaryInterval = 1000; // ms
 static const UInt32 kMaxCacheItems = 1024;
+static const UInt32 kMaxCacheCapacity = 65536; // items, bound of the capacity set by client
 static const UInt32 kMaxPathLength = 1024;
 static const UInt32 kMaxNameLength = 256;
+// Ports and resolver addresses are reused, so their owners expire. The auth caches keep entries
+// until evicted, unless the client sets a lifetime through kNuwaUserClientSetCacheLifetime.
+static const UInt32 kAuthResultCacheLifetime = 0; // ms, 0 means forever
+static const UInt32 kAuthExecCacheLifetime = 0; // ms, 0 means forever
+static const UInt32 kPortBindCacheLifetime = 600000; // ms
+static const UInt32 kDnsOutCacheLifetime = 30000; // ms
+static const UInt32 kEventRepeatCacheLifetime = 1000; // ms, 0 turns coalescing off
+static const UInt32 kMaxMuteDeltaItems = 4096;
+static const UInt64 kDefaultListMemoryBudget = 8 * 1024 * 1024; // bytes
+static const UInt32 kMaxMutePathsSize = 1024 * 1024; // bytes
+static const UInt32 kMaxExcludedFsids = 32;
 
 /**
 * @berif Interface types supporting communication with NuwaClient
@@ -37,17 +62,48 @@ typedef enum {
     kNuwaUserClientDenyBinary,
     kNuwaUserClientSetLogLevel,
     kNuwaUserClientUpdateMuteList,
+    kNuwaUserClientSetCacheLifetime,
+    kNuwaUserClientUpdateMuteDelta,
+    kNuwaUserClientSetListBudget,
+    kNuwaUserClientUpdateMutePaths,
+    kNuwaUserClientSetExcludedFsids,
+    kNuwaUserClientGetFsidDrops,
+    kNuwaUserClientSetSubscription,
+    kNuwaUserClientSetWakeupCoalescing,
+    kNuwaUserClientGetEventCounters,
+    kNuwaUserClientSetCriticalClasses,
+    kNuwaUserClientSetRateLimit,
+    kNuwaUserClientSetQueueSize,
+    kNuwaUserClientGetCacheCounters,
+    kNuwaUserClientSetCacheCapacity,
     kNuwaUserClientMethodsNumber
 } NuwaKextMethods;
 
 /**
 * @berif Data queue for sending event info to NuwaClient
+* Notify events of the critical classes go to the critical lane, drained first by NuwaClient.
+* The others go to the bulk lane of kNotifyRingCount rings, kQueueTypeNotify + i being the type of ring i.
 */
 typedef enum {
     kQueueTypeAuth,
+    kQueueTypeCritical,
     kQueueTypeNotify
 } NuwaKextQueue;
 
+/**
+* @berif Caches whose entry lifetime can be set by NuwaClient
+*/
+typedef enum {
+    kCacheTypeAuthResult,
+    kCacheTypeAuthExec,
+    kCacheTypePortBind,
+    kCacheTypeDnsOut,
+    kCacheTypeEventRepeat
+} NuwaKextCacheType;
+
+// Caches of NuwaKextCacheType.
+static const UInt32 kCacheTypeCount = 5;
+
 /**
 * @berif Event types now supported in kext
 */
@@ -64,9 +120,59 @@ typedef enum {
     kActionNotifyFileRename,
     kActionNotifyFileDelete,
     kActionNotifyNetworkAccess,
-    kActionNotifyDnsQuery
+    kActionNotifyDnsQuery,
+    kActionNotifyThrottle
 } NuwaKextAction;
 
+/**
+* @berif Event classes NuwaClient subscribes to
+* A notify class takes the bit of its offset from kActionNotifyBegin.
+*/
+typedef enum {
+    kSubscribeAuthExec          = 1 << 0,
+    kSubscribeProcessCreate     = 1 << (kActionNotifyProcessCreate - kActionNotifyBegin),
+    kSubscribeFileOpen          = 1 << (kActionNotifyFileOpen - kActionNotifyBegin),
+    kSubscribeFileCloseModify   = 1 << (kActionNotifyFileCloseModify - kActionNotifyBegin),
+    kSubscribeFileRename        = 1 << (kActionNotifyFileRename - kActionNotifyBegin),
+    kSubscribeFileDelete        = 1 << (kActionNotifyFileDelete - kActionNotifyBegin),
+    kSubscribeNetworkAccess     = 1 << (kActionNotifyNetworkAccess - kActionNotifyBegin),
+    kSubscribeDnsQuery          = 1 << (kActionNotifyDnsQuery - kActionNotifyBegin),
+    kSubscribeThrottle          = 1 << (kActionNotifyThrottle - kActionNotifyBegin),
+    kSubscribeAll               = 0x1FF
+} NuwaKextSubscription;
+
+// Event classes, one per bit of NuwaKextSubscription.
+static const UInt32 kEventClassCount = 9;
+// Classes sampled under overload, the others are never given up while the queues have room.
+static const UInt32 kSampledEventClasses = kSubscribeFileOpen | kSubscribeNetworkAccess;
+// Classes whose repeats of the same process and file are coalesced within the lifetime of kCacheTypeEventRepeat.
+static const UInt32 kCoalescedEventClasses = kSubscribeFileOpen | kSubscribeFileCloseModify;
+// Classes sent to the critical lane unless NuwaClient maps them otherwise.
+static const UInt32 kDefaultCriticalClasses = kSubscribeProcessCreate | kSubscribeFileRename | kSubscribeFileDelete |
+    kSubscribeThrottle;
+// Classes limited per process unless NuwaClient sets otherwise, the others are let through.
+static const UInt32 kRateLimitedEventClasses = kSubscribeFileOpen | kSubscribeFileCloseModify | kSubscribeNetworkAccess;
+
+/**
+* @berif Event counters of a class, indexed by the bit of the class in NuwaKextSubscription
+*/
+typedef struct {
+    UInt64 enqueued;
+    UInt64 dropped;     // the queue was full
+    UInt64 sampled;     // skipped by sampling under overload
+    UInt64 throttled;   // skipped by the rate limit of the process
+} NuwaKextEventCounters;
+
+/**
+* @berif Counters of a cache, indexed by NuwaKextCacheType
+*/
+typedef struct {
+    UInt64 hits;
+    UInt64 misses;
+    UInt64 evictions;   // the cache was full
+    UInt64 expirations; // past the lifetime of the cache
+} NuwaKextCacheCounters;
+
 /**
 * @berif Mute types now supported in kext
 */
@@ -85,6 +191,47 @@ typedef struct {
     UInt64 vnodeIDs[kMaxCacheItems];
 } NuwaKextMuteInfo;
 
+/**
+* @berif Flags of a mute list delta
+*/
+typedef enum {
+    kMuteDeltaBegin     = 1 << 0,   // First chunk of an update
+    kMuteDeltaReset     = 1 << 1,   // Start from an empty list, whatever the generation
+    kMuteDeltaCommit    = 1 << 2    // Last chunk of an update, publish the list
+} NuwaKextMuteDeltaFlags;
+
+/**
+* @berif Chunk of changes to a mute list sent by NuwaClient
+* The header is followed by addCount vnode IDs to add, then removeCount vnode IDs to remove.
+* All chunks of an update carry the generation of the list they are based on, the kext
+* returns the generation of the list once the update is committed.
+*/
+typedef struct {
+    NuwaKextMuteType muteType;
+    UInt32 flags;
+    UInt64 generation;
+    UInt32 addCount;
+    UInt32 removeCount;
+} NuwaKextMuteDelta;
+
+/**
+* @berif Path prefixes replacing a mute list sent by NuwaClient
+* The header is followed by size bytes of absolute paths, each terminated by a zero byte.
+* A file, or the file of a process, is muted once its path is one of them or below one.
+*/
+typedef struct {
+    NuwaKextMuteType muteType;
+    UInt32 size;
+} NuwaKextMutePaths;
+
+/**
+* @berif File events dropped on a filesystem excluded by NuwaClient
+*/
+typedef struct {
+    UInt32 fsid;
+    UInt64 drops;
+} NuwaKextFsidDrops;
+
 /**
 * @berif Process info for reporting
 */
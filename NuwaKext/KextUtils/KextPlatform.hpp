@@ -0,0 +1,23 @@
+//
+//  KextPlatform.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef KextPlatform_hpp
+#define KextPlatform_hpp
+
+// The containers of KextUtils only use the kernel interfaces below, so they also build
+// in user space for tests, against the pthread stand-ins of NuwaTests/Shim.
+#ifdef KEXT_USER_SPACE
+#include "KextShim.hpp"
+#else
+#include <IOKit/IOLib.h>
+#include <IOKit/IODataQueueShared.h>
+#include <libkern/OSTypes.h>
+#include <kern/clock.h>
+#include <kern/cpu_number.h>
+#endif
+
+#endif /* KextPlatform_hpp */
@@ -0,0 +1,180 @@
+//
+//  MuteDelta.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "MuteDelta.hpp"
+#include "ObjectPool.hpp"
+
+static const UInt32 kMinDeltaShift = 4;
+
+MuteDelta::MuteDelta() {
+    m_generation = 0;
+    m_isPending = false;
+    m_slots = nullptr;
+    m_shift = 0;
+    m_count = 0;
+    m_otherCount = 0;
+}
+
+MuteDelta::~MuteDelta() {
+    drop();
+}
+
+void MuteDelta::drop() {
+    if (m_slots != nullptr) {
+        IOFreeAligned(m_slots, sizeof(UInt64) << m_shift);
+        m_slots = nullptr;
+    }
+    m_isPending = false;
+    m_shift = 0;
+    m_count = 0;
+}
+
+void MuteDelta::reset() {
+    m_generation++;
+    drop();
+}
+
+bool MuteDelta::reserve(UInt64 count) {
+    // Kept at most half full, so probes stay short.
+    UInt32 shift = m_shift > kMinDeltaShift ? m_shift : kMinDeltaShift;
+    while ((count << 1) > (1ULL << shift)) {
+        shift++;
+    }
+    if (m_slots != nullptr && shift == m_shift) {
+        return true;
+    }
+    if (shift > 31) {
+        return false;
+    }
+
+    UInt64 *slots = (UInt64 *)IOMallocAligned(sizeof(UInt64) << shift, kCacheLineSize);
+    if (slots == nullptr) {
+        return false;
+    }
+    bzero(slots, sizeof(UInt64) << shift);
+    UInt64 *oldSlots = m_slots;
+    UInt32 oldShift = m_shift;
+    m_slots = slots;
+    m_shift = shift;
+    m_count = 0;
+    for (UInt64 i = 0; oldSlots != nullptr && i < (1ULL << oldShift); ++i) {
+        if (oldSlots[i] != 0) {
+            addKey(oldSlots[i]);
+        }
+    }
+    if (oldSlots != nullptr) {
+        IOFreeAligned(oldSlots, sizeof(UInt64) << oldShift);
+    }
+    return true;
+}
+
+bool MuteDelta::addKey(UInt64 key) {
+    UInt64 mask = (1ULL << m_shift) - 1;
+    for (UInt64 slot = getSlot(key); ; slot = (slot + 1) & mask) {
+        if (m_slots[slot] == key) {
+            return false;
+        }
+        if (m_slots[slot] == 0) {
+            m_slots[slot] = key;
+            m_count++;
+            return true;
+        }
+    }
+}
+
+void MuteDelta::removeKey(UInt64 key) {
+    UInt64 mask = (1ULL << m_shift) - 1;
+    UInt64 slot = getSlot(key);
+    while (m_slots[slot] != key) {
+        if (m_slots[slot] == 0) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift the keys probing past the hole back into it, so no lookup stops early.
+    UInt64 hole = slot;
+    for (UInt64 next = (hole + 1) & mask; m_slots[next] != 0; next = (next + 1) & mask) {
+        UInt64 home = getSlot(m_slots[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            m_slots[hole] = m_slots[next];
+            hole = next;
+        }
+    }
+    m_slots[hole] = 0;
+    m_count--;
+}
+
+bool MuteDelta::begin(const VnodeSet *current, UInt8 value, bool empty) {
+    drop();
+    UInt32 count = current->countItems(value);
+    m_otherCount = current->getCount() - count;
+    if (!reserve(empty ? 0 : count)) {
+        return false;
+    }
+    for (UInt32 i = 0; !empty && i < current->getCount(); ++i) {
+        if (current->getValueAt(i) == value) {
+            addKey(current->getKeyAt(i));
+        }
+    }
+    m_isPending = true;
+    return true;
+}
+
+NuwaKextListStatus MuteDelta::apply(const NuwaKextMuteDelta *delta, const UInt64 *keys, const VnodeSet *current,
+                                    UInt8 value, UInt64 budget, VnodeSet **list) {
+    *list = nullptr;
+    NuwaKextListStatus status = kListUpdateSuccess;
+    if (delta->flags & kMuteDeltaBegin) {
+        if (!(delta->flags & kMuteDeltaReset) && delta->generation != m_generation) {
+            status = kListUpdateStale;
+        } else if (!begin(current, value, delta->flags & kMuteDeltaReset)) {
+            status = kListUpdateNoMemory;
+        }
+    } else if (!m_isPending || delta->generation != m_generation) {
+        // Another update was committed in between, the client has to start over.
+        status = kListUpdateStale;
+    }
+
+    UInt64 count = (UInt64)m_count + delta->addCount;
+    if (status == kListUpdateSuccess && (VnodeSet::getMemorySize(count + m_otherCount) > budget || !reserve(count))) {
+        status = kListUpdateNoMemory;
+    }
+    if (status != kListUpdateSuccess) {
+        drop();
+        return status;
+    }
+
+    // Removals first, a key both added and removed by a chunk stays.
+    for (UInt32 i = 0; i < delta->removeCount; ++i) {
+        removeKey(keys[delta->addCount + i]);
+    }
+    for (UInt32 i = 0; i < delta->addCount; ++i) {
+        if (keys[i] != 0) {
+            addKey(keys[i]);
+        }
+    }
+    if (!(delta->flags & kMuteDeltaCommit)) {
+        return kListUpdateSuccess;
+    }
+
+    // Items of the other mute type sharing the list are kept as they are.
+    VnodeSet *newList = new VnodeSet(current->getCount() + m_count);
+    if (newList != nullptr) {
+        newList->addItems(current, value);
+        // Free slots are zero, which adding ignores.
+        newList->addItems(m_slots, 1U << m_shift, value);
+    }
+    if (newList == nullptr || !newList->finish()) {
+        delete newList;
+        drop();
+        return kListUpdateNoMemory;
+    }
+    *list = newList;
+    reset();
+    return kListUpdateSuccess;
+}
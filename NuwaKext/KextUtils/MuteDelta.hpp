@@ -0,0 +1,83 @@
+//
+//  MuteDelta.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef MuteDelta_hpp
+#define MuteDelta_hpp
+
+#include "KextPlatform.hpp"
+#include "KextCommon.hpp"
+#include "VnodeSet.hpp"
+
+typedef enum {
+    kListUpdateSuccess  = 0,
+    kListUpdateInvalid  = 1,
+    kListUpdateStale    = 2,
+    kListUpdateNoMemory = 3
+} NuwaKextListStatus;
+
+/**
+ * @brief Update of a mute list sent in chunks, applied to pending items until committed
+ * The pending items are kept in an open-addressing hash set, so a chunk only costs its own
+ * items, and the list is built once on commit. Every chunk carries the generation of the
+ * list it is based on, those of an older one are refused as stale and the update dropped.
+ */
+class MuteDelta {
+
+public:
+    MuteDelta();
+    ~MuteDelta();
+
+    /**
+     * @brief Apply a chunk of changes to the pending items
+
+     * @param delta     header of the chunk, its flags begin and commit the update
+     * @param keys      addCount vnode IDs to add, then removeCount to remove
+     * @param current   published list, the items tagged with value are those of this mute type
+     * @param value     tag of the items of this mute type
+     * @param budget    max memory of the list built on commit
+     * @param list      set to the list to publish on commit, nullptr otherwise
+     * @return          kListUpdateSuccess, or the reason the update was dropped
+     */
+    NuwaKextListStatus apply(const NuwaKextMuteDelta *delta, const UInt64 *keys, const VnodeSet *current,
+                             UInt8 value, UInt64 budget, VnodeSet **list);
+
+    // Called when the list was replaced otherwise, the update in progress is stale.
+    void reset();
+
+    UInt64 getGeneration() const {
+        return m_generation;
+    }
+
+    // Called when obtain the number of pending items, 0 when no update is in progress.
+    UInt32 getPendingCount() const {
+        return m_count;
+    }
+
+private:
+    bool begin(const VnodeSet *current, UInt8 value, bool empty);
+    void drop();
+    bool reserve(UInt64 count);
+    bool addKey(UInt64 key);
+    void removeKey(UInt64 key);
+
+    UInt64 getSlot(UInt64 key) const {
+        // Fibonacci hashing, the top bits of the product spread vnode IDs of one volume.
+        return (key * 0x9E3779B97F4A7C15ULL) >> (64 - m_shift);
+    }
+
+    // Bumped by each committed update, or by a replacement of the list.
+    UInt64 m_generation;
+    bool m_isPending;
+    // Pending keys, 0 marks a free slot.
+    UInt64 *m_slots;
+    UInt32 m_shift;
+    UInt32 m_count;
+    // Items of the other mute type sharing the list when the update began, counted in the budget.
+    UInt32 m_otherCount;
+};
+
+#endif /* MuteDelta_hpp */
@@ -0,0 +1,256 @@
+//
+//  ObjectPool.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "ObjectPool.hpp"
+
+ObjectPool::ObjectPool(UInt32 objectSize, UInt32 reserveCount) {
+    if (objectSize < sizeof(FreeObject)) {
+        objectSize = sizeof(FreeObject);
+    }
+    m_objectSize = (objectSize + kPoolObjectAlign - 1) & ~(kPoolObjectAlign - 1);
+    // Objects start after the slab header, keeping their alignment.
+    m_slabOffset = (sizeof(Slab) + kPoolObjectAlign - 1) & ~(kPoolObjectAlign - 1);
+    m_slabObjects = (kPoolSlabSize - m_slabOffset) / m_objectSize;
+    m_maxEmptySlabs = kPoolMaxEmptySlabs;
+    m_slabs = nullptr;
+    m_lastSlab = nullptr;
+    m_emptySlabs = 0;
+    m_depotLock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+
+    m_magazines = (Magazine *)IOMallocAligned(sizeof(Magazine)*kPoolMagazineCount, kCacheLineSize);
+    if (m_magazines != nullptr) {
+        bzero(m_magazines, sizeof(Magazine)*kPoolMagazineCount);
+        for (UInt8 i = 0; i < kPoolMagazineCount; ++i) {
+            m_magazines[i].lock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+        }
+    }
+
+    if (m_depotLock == nullptr || m_slabObjects == 0) {
+        return;
+    }
+    UInt32 reservedSlabs = (reserveCount + m_slabObjects - 1) / m_slabObjects;
+    // The reserve is kept even once its objects have all come back.
+    if (reservedSlabs > m_maxEmptySlabs) {
+        m_maxEmptySlabs = reservedSlabs;
+    }
+    for (UInt32 i = 0; i < reservedSlabs; ++i) {
+        if (!growSlabs()) {
+            break;
+        }
+    }
+}
+
+ObjectPool::~ObjectPool() {
+    // Every object must have been returned, those still in magazines go back to their slabs first.
+    if (m_magazines != nullptr && m_depotLock != nullptr) {
+        for (UInt8 i = 0; i < kPoolMagazineCount; ++i) {
+            returnToDepot(m_magazines[i].objects, m_magazines[i].count);
+            m_magazines[i].count = 0;
+        }
+    }
+    while (m_slabs != nullptr) {
+        Slab *slab = m_slabs;
+        m_slabs = slab->next;
+        IOFreeAligned(slab, kPoolSlabSize);
+    }
+    m_lastSlab = nullptr;
+
+    if (m_magazines != nullptr) {
+        for (UInt8 i = 0; i < kPoolMagazineCount; ++i) {
+            if (m_magazines[i].lock != nullptr) {
+                lck_mtx_free(m_magazines[i].lock, g_driverLockGrp);
+            }
+        }
+        IOFreeAligned(m_magazines, sizeof(Magazine)*kPoolMagazineCount);
+        m_magazines = nullptr;
+    }
+    if (m_depotLock != nullptr) {
+        lck_mtx_free(m_depotLock, g_driverLockGrp);
+        m_depotLock = nullptr;
+    }
+}
+
+ObjectPool::Magazine *ObjectPool::getMagazine() {
+    if (m_magazines == nullptr) {
+        return nullptr;
+    }
+    // Threads on the same CPU take turns, so the lock of its magazine is hardly ever contended.
+    Magazine *magazine = &m_magazines[(UInt32)cpu_number() % kPoolMagazineCount];
+    if (magazine->lock == nullptr) {
+        return nullptr;
+    }
+    return magazine;
+}
+
+// Called with the depot lock held.
+void ObjectPool::linkSlab(Slab *slab, bool atTail) {
+    if (atTail) {
+        slab->prev = m_lastSlab;
+        slab->next = nullptr;
+    } else {
+        slab->prev = nullptr;
+        slab->next = m_slabs;
+    }
+    if (slab->prev != nullptr) {
+        slab->prev->next = slab;
+    } else {
+        m_slabs = slab;
+    }
+    if (slab->next != nullptr) {
+        slab->next->prev = slab;
+    } else {
+        m_lastSlab = slab;
+    }
+}
+
+// Called with the depot lock held.
+void ObjectPool::unlinkSlab(Slab *slab) {
+    if (slab->prev != nullptr) {
+        slab->prev->next = slab->next;
+    } else {
+        m_slabs = slab->next;
+    }
+    if (slab->next != nullptr) {
+        slab->next->prev = slab->prev;
+    } else {
+        m_lastSlab = slab->prev;
+    }
+    slab->prev = nullptr;
+    slab->next = nullptr;
+}
+
+// Called with no lock held, the kernel allocator may block.
+bool ObjectPool::growSlabs() {
+    if (m_depotLock == nullptr || m_slabObjects == 0) {
+        return false;
+    }
+    Slab *slab = (Slab *)IOMallocAligned(kPoolSlabSize, kPoolSlabSize);
+    if (slab == nullptr) {
+        return false;
+    }
+    slab->freeList = nullptr;
+    slab->freeCount = m_slabObjects;
+
+    char *object = (char *)slab + m_slabOffset;
+    for (UInt32 i = 0; i < m_slabObjects; ++i, object += m_objectSize) {
+        FreeObject *item = (FreeObject *)object;
+        item->next = slab->freeList;
+        slab->freeList = item;
+    }
+
+    lck_mtx_lock(m_depotLock);
+    linkSlab(slab, true);
+    m_emptySlabs++;
+    lck_mtx_unlock(m_depotLock);
+    return true;
+}
+
+UInt32 ObjectPool::takeFromDepot(void **objects, UInt32 count) {
+    UInt32 taken = 0;
+    if (m_depotLock == nullptr) {
+        return taken;
+    }
+
+    lck_mtx_lock(m_depotLock);
+    while (taken < count && m_slabs != nullptr) {
+        Slab *slab = m_slabs;
+        if (slab->freeCount == m_slabObjects) {
+            m_emptySlabs--;
+        }
+        while (taken < count && slab->freeList != nullptr) {
+            objects[taken++] = slab->freeList;
+            slab->freeList = slab->freeList->next;
+            slab->freeCount--;
+        }
+        if (slab->freeCount == 0) {
+            unlinkSlab(slab);
+        }
+    }
+    lck_mtx_unlock(m_depotLock);
+    return taken;
+}
+
+void ObjectPool::returnToDepot(void **objects, UInt32 count) {
+    Slab *released = nullptr;
+
+    lck_mtx_lock(m_depotLock);
+    for (UInt32 i = 0; i < count; ++i) {
+        FreeObject *item = (FreeObject *)objects[i];
+        Slab *slab = (Slab *)((uintptr_t)item & ~(uintptr_t)(kPoolSlabSize - 1));
+        if (slab->freeCount == 0) {
+            linkSlab(slab, false);
+        }
+        item->next = slab->freeList;
+        slab->freeList = item;
+        if (++slab->freeCount < m_slabObjects) {
+            continue;
+        }
+
+        unlinkSlab(slab);
+        if (m_emptySlabs < m_maxEmptySlabs) {
+            // Taken last, so it stays empty while partly used slabs have room.
+            linkSlab(slab, true);
+            m_emptySlabs++;
+        } else {
+            slab->next = released;
+            released = slab;
+        }
+    }
+    lck_mtx_unlock(m_depotLock);
+
+    // Like growing, the kernel allocator is called with no lock held.
+    while (released != nullptr) {
+        Slab *next = released->next;
+        IOFreeAligned(released, kPoolSlabSize);
+        released = next;
+    }
+}
+
+void *ObjectPool::allocObject() {
+    void *object = nullptr;
+    Magazine *magazine = getMagazine();
+
+    do {
+        if (magazine == nullptr) {
+            takeFromDepot(&object, 1);
+            continue;
+        }
+        lck_mtx_lock(magazine->lock);
+        if (magazine->count == 0) {
+            // Refill half of the magazine, so that a free right after does not go back at once.
+            magazine->count = takeFromDepot(magazine->objects, kPoolMagazineSize / 2);
+        }
+        if (magazine->count > 0) {
+            object = magazine->objects[--magazine->count];
+        }
+        lck_mtx_unlock(magazine->lock);
+        // The depot is dry, a slab is added with no lock held and the magazine tried again.
+    } while (object == nullptr && growSlabs());
+    return object;
+}
+
+void ObjectPool::freeObject(void *object) {
+    if (object == nullptr) {
+        return;
+    }
+    Magazine *magazine = getMagazine();
+    if (magazine == nullptr) {
+        returnToDepot(&object, 1);
+        return;
+    }
+
+    lck_mtx_lock(magazine->lock);
+    if (magazine->count == kPoolMagazineSize) {
+        // Flush the older half of the magazine, keeping the recently freed objects warm.
+        UInt32 half = kPoolMagazineSize / 2;
+        returnToDepot(magazine->objects, half);
+        memmove(magazine->objects, magazine->objects + half, sizeof(void *)*(kPoolMagazineSize - half));
+        magazine->count -= half;
+    }
+    magazine->objects[magazine->count++] = object;
+    lck_mtx_unlock(magazine->lock);
+}
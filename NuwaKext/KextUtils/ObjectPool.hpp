@@ -0,0 +1,125 @@
+//
+//  ObjectPool.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef ObjectPool_hpp
+#define ObjectPool_hpp
+
+#include "KextPlatform.hpp"
+
+extern lck_attr_t *g_driverLockAttr;
+extern lck_grp_attr_t *g_driverLockGrpAttr;
+extern lck_grp_t *g_driverLockGrp;
+
+static const UInt8 kCacheLineSize = 64;
+static const UInt32 kPoolSlabSize = 16384;
+static const UInt8 kPoolObjectAlign = 16;
+static const UInt8 kPoolMagazineSize = 32;
+static const UInt8 kPoolMagazineCount = 8;
+// Empty slabs kept for later growth, those above it go back to the kernel.
+static const UInt8 kPoolMaxEmptySlabs = 2;
+
+/**
+ * @brief Allocator of fixed-size objects
+ * Objects are carved out of page sized slabs and recycled through per-CPU magazines.
+ * A magazine is picked by cpu_number(), locked since the thread may move to another CPU
+ * meanwhile, and only talks to the shared depot to move half a magazine at a time.
+ * The depot keeps the free objects in their slabs, so that a slab whose objects all came
+ * back is released once more than the reserve or kPoolMaxEmptySlabs are empty.
+ */
+class ObjectPool {
+
+public:
+    /**
+     * @brief Create the pool
+
+     * @param objectSize    size of every object
+     * @param reserveCount  number of objects carved out of slabs up front
+     */
+    ObjectPool(UInt32 objectSize, UInt32 reserveCount = 0);
+    ~ObjectPool();
+
+    void *allocObject();
+    void freeObject(void *object);
+
+private:
+    struct FreeObject {
+        FreeObject *next;
+    };
+    // Slabs are aligned to their size, the one of an object is found from its address.
+    struct Slab {
+        // Links the slab into the depot while it has free objects.
+        Slab *prev;
+        Slab *next;
+        FreeObject *freeList;
+        UInt32 freeCount;
+    };
+    struct __attribute__((aligned(kCacheLineSize))) Magazine {
+        lck_mtx_t *lock;
+        UInt32 count;
+        void *objects[kPoolMagazineSize];
+    };
+
+    Magazine *getMagazine();
+    bool growSlabs();
+    UInt32 takeFromDepot(void **objects, UInt32 count);
+    void returnToDepot(void **objects, UInt32 count);
+    void linkSlab(Slab *slab, bool atTail);
+    void unlinkSlab(Slab *slab);
+
+    UInt32 m_objectSize;
+    UInt32 m_slabOffset;
+    UInt32 m_slabObjects;
+    UInt32 m_maxEmptySlabs;
+    Magazine *m_magazines;
+
+    lck_mtx_t *m_depotLock;
+    // Slabs with free objects, the partly used ones first so that the empty ones stay empty.
+    Slab *m_slabs;
+    Slab *m_lastSlab;
+    UInt32 m_emptySlabs;
+};
+
+/**
+ * @brief Allocator of one object type backed by its own pool, used as template argument of caches
+ */
+template <typename ObjectType>
+class PoolAllocator {
+
+public:
+    PoolAllocator(UInt32 reserveCount = 0) : m_pool(sizeof(ObjectType), reserveCount) {}
+
+    ObjectType *allocObject() {
+        return (ObjectType *)m_pool.allocObject();
+    }
+
+    void freeObject(ObjectType *object) {
+        m_pool.freeObject(object);
+    }
+
+private:
+    ObjectPool m_pool;
+};
+
+/**
+ * @brief Allocator of one object type backed by the general kernel allocator
+ */
+template <typename ObjectType>
+class MallocAllocator {
+
+public:
+    MallocAllocator(UInt32 /* reserveCount */ = 0) {}
+
+    ObjectType *allocObject() {
+        return (ObjectType *)IOMallocAligned(sizeof(ObjectType), 2);
+    }
+
+    void freeObject(ObjectType *object) {
+        IOFreeAligned(object, sizeof(ObjectType));
+    }
+};
+
+#endif /* ObjectPool_hpp */
@@ -0,0 +1,243 @@
+//
+//  PathTrie.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "PathTrie.hpp"
+#include "ObjectPool.hpp"
+
+static const UInt32 kMaxTriePathLength = 0xFFFF;
+
+static inline bool isItemBefore(const char *bytes, const PathTrie::Item &first, const PathTrie::Item &second) {
+    UInt32 length = first.length < second.length ? first.length : second.length;
+    int result = memcmp(&bytes[first.offset], &bytes[second.offset], length);
+    return result < 0 || (result == 0 && first.length < second.length);
+}
+
+static void siftDown(const char *bytes, PathTrie::Item *items, UInt32 root, UInt32 count) {
+    while (root * 2 + 1 < count) {
+        UInt32 child = root * 2 + 1;
+        if (child + 1 < count && isItemBefore(bytes, items[child], items[child + 1])) {
+            child++;
+        }
+        if (!isItemBefore(bytes, items[root], items[child])) {
+            return;
+        }
+        PathTrie::Item item = items[root];
+        items[root] = items[child];
+        items[child] = item;
+        root = child;
+    }
+}
+
+PathTrie::PathTrie(UInt32 capacity, UInt32 size) {
+    m_capacity = capacity;
+    m_count = 0;
+    m_size = size;
+    m_used = 0;
+    m_nodes = nullptr;
+    m_nodeCount = 0;
+
+    m_bytes = (char *)IOMallocAligned(size + 1, 2);
+    m_items = (Item *)IOMallocAligned(sizeof(Item)*(capacity + 1), 2);
+    if (m_bytes == nullptr || m_items == nullptr) {
+        m_capacity = 0;
+        m_size = 0;
+    }
+}
+
+PathTrie::~PathTrie() {
+    if (m_bytes != nullptr) {
+        IOFreeAligned(m_bytes, m_size + 1);
+    }
+    if (m_items != nullptr) {
+        IOFreeAligned(m_items, sizeof(Item)*(m_capacity + 1));
+    }
+    if (m_nodes != nullptr) {
+        IOFreeAligned(m_nodes, sizeof(Node)*(m_count * 2 + 1));
+    }
+}
+
+UInt32 PathTrie::addPaths(const char *paths, UInt32 size) {
+    UInt32 added = 0;
+    if (m_items == nullptr || m_bytes == nullptr || m_nodes != nullptr || paths == nullptr) {
+        return added;
+    }
+
+    UInt32 start = 0;
+    while (start < size && m_count < m_capacity) {
+        const char *path = &paths[start];
+        UInt32 length = 0;
+        while (start + length < size && path[length] != '\0') {
+            length++;
+        }
+        if (start + length == size) {
+            // The last path is not terminated, drop it.
+            break;
+        }
+        start += length + 1;
+
+        // "/a/b/" is stored as "/a/b", the root alone keeps its slash.
+        while (length > 1 && path[length - 1] == '/') {
+            length--;
+        }
+        if (length == 0 || path[0] != '/' || length > kMaxTriePathLength || m_used + length > m_size) {
+            continue;
+        }
+        memcpy(&m_bytes[m_used], path, length);
+        m_items[m_count].offset = m_used;
+        m_items[m_count].length = length;
+        m_used += length;
+        m_count++;
+        added++;
+    }
+    return added;
+}
+
+bool PathTrie::finish() {
+    if (m_items == nullptr || m_nodes != nullptr) {
+        return false;
+    }
+
+    sortItems();
+    UInt32 unique = 0;
+    for (UInt32 i = 0; i < m_count; ++i) {
+        if (unique == 0 || isItemBefore(m_bytes, m_items[unique - 1], m_items[i])) {
+            m_items[unique++] = m_items[i];
+        }
+    }
+    m_count = unique;
+
+    if (!buildNodes()) {
+        return false;
+    }
+    IOFreeAligned(m_items, sizeof(Item)*(m_capacity + 1));
+    m_items = nullptr;
+    return true;
+}
+
+void PathTrie::sortItems() {
+    // Heap sort, no scratch memory and no recursion.
+    for (UInt32 i = m_count / 2; i > 0; --i) {
+        siftDown(m_bytes, m_items, i - 1, m_count);
+    }
+    for (UInt32 end = m_count; end > 1; --end) {
+        Item item = m_items[0];
+        m_items[0] = m_items[end - 1];
+        m_items[end - 1] = item;
+        siftDown(m_bytes, m_items, 0, end - 1);
+    }
+}
+
+bool PathTrie::buildNodes() {
+    // Every node below the root but the leaves has two children at least.
+    UInt32 capacity = m_count * 2 + 1;
+    m_nodes = (Node *)IOMallocAligned(sizeof(Node)*capacity, kCacheLineSize);
+    Range *pending = (Range *)IOMallocAligned(sizeof(Range)*capacity, 2);
+    if (m_nodes == nullptr || pending == nullptr) {
+        if (m_nodes != nullptr) {
+            IOFreeAligned(m_nodes, sizeof(Node)*capacity);
+            m_nodes = nullptr;
+        }
+        if (pending != nullptr) {
+            IOFreeAligned(pending, sizeof(Range)*capacity);
+        }
+        return false;
+    }
+    bzero(m_nodes, sizeof(Node)*capacity);
+    m_nodeCount = 1;
+
+    // Paths may be as deep as they like, so walk with a stack of our own.
+    UInt32 pendingCount = 0;
+    pending[pendingCount++] = { 0, 0, m_count, 0 };
+    while (pendingCount > 0) {
+        Range range = pending[--pendingCount];
+        pendingCount = fillChildren(range, pending, pendingCount);
+    }
+
+    IOFreeAligned(pending, sizeof(Range)*capacity);
+    return true;
+}
+
+UInt32 PathTrie::fillChildren(const Range &range, Range *pending, UInt32 pendingCount) {
+    Node *node = &m_nodes[range.node];
+    UInt32 first = range.first;
+
+    // Sorted, so a path ending at this node comes first.
+    if (first < range.last && m_items[first].length == range.depth) {
+        node->terminal = true;
+        first++;
+        if (m_bytes[m_items[range.first].offset + range.depth - 1] == '/') {
+            // Only the root ends with a slash, it covers everything.
+            first = range.last;
+        }
+    }
+
+    node->firstChild = m_nodeCount;
+    node->childCount = 0;
+    for (UInt32 i = first; i < range.last;) {
+        const Item &item = m_items[i];
+        UInt8 byte = m_bytes[item.offset + range.depth];
+        UInt32 end = i + 1;
+        while (end < range.last && (UInt8)m_bytes[m_items[end].offset + range.depth] == byte) {
+            end++;
+        }
+        if (node->terminal && byte == '/') {
+            // Paths below a muted one are muted anyway.
+            i = end;
+            continue;
+        }
+
+        // Sorted, the first and last paths of the group share the longest prefix of all.
+        const Item &last = m_items[end - 1];
+        UInt32 limit = item.length < last.length ? item.length : last.length;
+        UInt32 depth = range.depth + 1;
+        while (depth < limit && m_bytes[item.offset + depth] == m_bytes[last.offset + depth]) {
+            depth++;
+        }
+
+        Node *child = &m_nodes[m_nodeCount];
+        child->labelOffset = item.offset + range.depth;
+        child->labelLength = depth - range.depth;
+        child->firstByte = byte;
+        pending[pendingCount++] = { m_nodeCount, i, end, depth };
+        m_nodeCount++;
+        node->childCount++;
+        i = end;
+    }
+    return pendingCount;
+}
+
+bool PathTrie::matchPath(const char *path) const {
+    if (m_nodes == nullptr || path == nullptr) {
+        return false;
+    }
+
+    const Node *node = m_nodes;
+    UInt32 position = 0;
+    while (true) {
+        UInt8 byte = path[position];
+        // Whole components only, "/a/b" mutes "/a/b/c" but not "/a/bc".
+        if (node->terminal && (byte == '\0' || byte == '/' || path[position - 1] == '/')) {
+            return true;
+        }
+        if (byte == '\0') {
+            return false;
+        }
+
+        const Node *child = &m_nodes[node->firstChild];
+        const Node *end = child + node->childCount;
+        while (child < end && child->firstByte < byte) {
+            child++;
+        }
+        // The label holds no zero byte, so the comparison stops at the end of the path.
+        if (child == end || child->firstByte != byte ||
+            strncmp(&path[position], &m_bytes[child->labelOffset], child->labelLength) != 0) {
+            return false;
+        }
+        position += child->labelLength;
+        node = child;
+    }
+}
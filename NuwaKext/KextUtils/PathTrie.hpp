@@ -0,0 +1,98 @@
+//
+//  PathTrie.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef PathTrie_hpp
+#define PathTrie_hpp
+
+#include "KextPlatform.hpp"
+
+/**
+ * @brief Read-only set of path prefixes
+ * Paths are added once, then built into a radix trie whose edges are slices of the added
+ * paths, so a node takes 16 bytes and the labels no extra memory. A lookup walks the path
+ * once, comparing a whole edge at a time. Nothing changes once built, lookups take no lock.
+ */
+class PathTrie {
+
+public:
+    /**
+     * @brief Create the trie
+
+     * @param capacity  max number of paths added before finishing
+     * @param size      max number of bytes of these paths, terminators included
+     */
+    PathTrie(UInt32 capacity, UInt32 size);
+    ~PathTrie();
+
+    /**
+     * @brief Add paths packed one after another
+
+     * @param paths     absolute paths, each terminated by a zero byte
+     * @param size      number of bytes of the paths
+     * @return          number of paths added, invalid ones are skipped
+     */
+    UInt32 addPaths(const char *paths, UInt32 size);
+
+    // Called when all paths are added.
+    bool finish();
+
+    // Called when check whether the path is one of the prefixes or below one of them.
+    bool matchPath(const char *path) const;
+
+    UInt32 getCount() const {
+        return m_count;
+    }
+
+    // Called when obtain the memory taken by a finished trie of the given size.
+    static UInt64 getMemorySize(UInt64 count, UInt64 size) {
+        return size + (count * 2 + 1) * sizeof(Node);
+    }
+
+    struct Item {
+        UInt32 offset;
+        UInt32 length;
+    };
+
+private:
+    /**
+     * @brief Node reached by an edge labeled with a slice of the path bytes
+     * Children are contiguous and ordered by the first byte of their labels.
+     */
+    struct Node {
+        UInt32 labelOffset;
+        UInt16 labelLength;
+        UInt8 firstByte;
+        bool terminal;
+        UInt32 firstChild;
+        UInt32 childCount;
+    };
+
+    struct Range {
+        UInt32 node;
+        UInt32 first;
+        UInt32 last;
+        UInt32 depth;
+    };
+
+    void sortItems();
+    bool buildNodes();
+    UInt32 fillChildren(const Range &range, Range *pending, UInt32 pendingCount);
+
+    UInt32 m_capacity;
+    UInt32 m_count;
+    UInt32 m_size;
+    UInt32 m_used;
+    // Added paths without their terminators, the labels point into it.
+    char *m_bytes;
+    // Pending paths, released once the nodes are built.
+    Item *m_items;
+    // The root is the first node, its label is empty.
+    Node *m_nodes;
+    UInt32 m_nodeCount;
+};
+
+#endif /* PathTrie_hpp */
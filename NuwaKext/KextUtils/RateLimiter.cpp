@@ -0,0 +1,169 @@
+//
+//  RateLimiter.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "RateLimiter.hpp"
+
+RateLimiter::RateLimiter() {
+    bzero(m_rates, sizeof(m_rates));
+    bzero(m_bursts, sizeof(m_bursts));
+    nanoseconds_to_absolutetime(kThrottleSummaryInterval * NSEC_PER_MSEC, &m_summaryInterval);
+
+    m_stripes = (Stripe *)IOMallocAligned(sizeof(Stripe)*kRateLimiterStripes, kCacheLineSize);
+    if (m_stripes == nullptr) {
+        return;
+    }
+    bzero(m_stripes, sizeof(Stripe)*kRateLimiterStripes);
+    for (UInt32 i = 0; i < kRateLimiterStripes; ++i) {
+        m_stripes[i].lock = lck_mtx_alloc_init(g_driverLockGrp, g_driverLockAttr);
+    }
+}
+
+RateLimiter::~RateLimiter() {
+    if (m_stripes == nullptr) {
+        return;
+    }
+    for (UInt32 i = 0; i < kRateLimiterStripes; ++i) {
+        if (m_stripes[i].lock != nullptr) {
+            lck_mtx_free(m_stripes[i].lock, g_driverLockGrp);
+        }
+    }
+    IOFreeAligned(m_stripes, sizeof(Stripe)*kRateLimiterStripes);
+}
+
+void RateLimiter::setLimit(UInt32 eventClass, UInt32 rate, UInt32 burst) {
+    if (eventClass >= kEventClassCount) {
+        return;
+    }
+    // A bucket holds one token at least, or the class would be shut.
+    __atomic_store_n(&m_bursts[eventClass], burst > 0 ? burst : 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_rates[eventClass], rate, __ATOMIC_RELAXED);
+}
+
+RateLimiter::Slot *RateLimiter::findSlot(Stripe *stripe, UInt32 key, UInt64 now, ThrottleSummary *evicted, UInt32 *summaryCount) {
+    Slot *victim = &stripe->slots[0];
+
+    for (UInt32 i = 0; i < kRateLimiterWays; ++i) {
+        Slot *slot = &stripe->slots[i];
+        if (slot->key == key) {
+            return slot;
+        }
+        if (victim->key != 0 && (slot->key == 0 || slot->lastRefill < victim->lastRefill)) {
+            victim = slot;
+        }
+    }
+
+    // Its counts would be lost with the slot, so they are summarized whenever due.
+    if (victim->key != 0 && takeSummary(victim, 0, evicted)) {
+        (*summaryCount)++;
+    }
+    bzero(victim, sizeof(Slot));
+    victim->key = key;
+    victim->lastRefill = now;
+    victim->lastSummary = now;
+    for (UInt32 i = 0; i < kEventClassCount; ++i) {
+        victim->tokens[i] = (UInt64)__atomic_load_n(&m_bursts[i], __ATOMIC_RELAXED) * NSEC_PER_SEC;
+    }
+    return victim;
+}
+
+void RateLimiter::refillSlot(Slot *slot, UInt64 now) {
+    UInt64 elapsed = 0;
+    absolutetime_to_nanoseconds(now - slot->lastRefill, &elapsed);
+    slot->lastRefill = now;
+
+    for (UInt32 i = 0; i < kEventClassCount; ++i) {
+        UInt64 rate = __atomic_load_n(&m_rates[i], __ATOMIC_RELAXED);
+        UInt64 capacity = (UInt64)__atomic_load_n(&m_bursts[i], __ATOMIC_RELAXED) * NSEC_PER_SEC;
+        if (rate == 0) {
+            continue;
+        }
+        // Past the time to fill up it is full, which also keeps the product from overflowing.
+        if (elapsed >= capacity / rate || slot->tokens[i] + elapsed * rate >= capacity) {
+            slot->tokens[i] = capacity;
+        } else {
+            slot->tokens[i] += elapsed * rate;
+        }
+    }
+}
+
+bool RateLimiter::takeSummary(Slot *slot, UInt64 now, ThrottleSummary *summary) {
+    UInt32 suppressed = 0;
+    for (UInt32 i = 0; i < kEventClassCount; ++i) {
+        suppressed |= slot->suppressed[i];
+    }
+    if (suppressed == 0) {
+        return false;
+    }
+    
+    summary->pid = slot->key - 1;
+    memcpy(summary->suppressed, slot->suppressed, sizeof(slot->suppressed));
+    bzero(slot->suppressed, sizeof(slot->suppressed));
+    slot->lastSummary = now;
+    return true;
+}
+
+bool RateLimiter::consume(UInt32 pid, UInt32 eventClass, ThrottleSummary *summaries, UInt32 *summaryCount) {
+    bool result = true;
+    *summaryCount = 0;
+    if (m_stripes == nullptr || eventClass >= kEventClassCount) {
+        return result;
+    }
+
+    UInt32 key = pid + 1;
+    Stripe *stripe = &m_stripes[(key * 2654435761U) >> 28];
+    if (stripe->lock == nullptr) {
+        return result;
+    }
+    UInt64 now = 0;
+    clock_get_uptime(&now);
+
+    lck_mtx_lock(stripe->lock);
+    Slot *slot = findSlot(stripe, key, now, &summaries[0], summaryCount);
+    refillSlot(slot, now);
+    if (__atomic_load_n(&m_rates[eventClass], __ATOMIC_RELAXED) != 0) {
+        if (slot->tokens[eventClass] >= NSEC_PER_SEC) {
+            slot->tokens[eventClass] -= NSEC_PER_SEC;
+        } else {
+            slot->suppressed[eventClass]++;
+            result = false;
+        }
+    }
+
+    // Suppressed events are summarized once in a while, those of a quiet process by collectSummaries.
+    if (now - slot->lastSummary >= m_summaryInterval && takeSummary(slot, now, &summaries[*summaryCount])) {
+        (*summaryCount)++;
+    }
+    lck_mtx_unlock(stripe->lock);
+
+    return result;
+}
+
+UInt32 RateLimiter::collectSummaries(ThrottleSummary *summaries, UInt32 count) {
+    UInt32 collected = 0;
+    if (m_stripes == nullptr) {
+        return collected;
+    }
+    UInt64 now = 0;
+    clock_get_uptime(&now);
+
+    for (UInt32 i = 0; i < kRateLimiterStripes && collected < count; ++i) {
+        Stripe *stripe = &m_stripes[i];
+        if (stripe->lock == nullptr) {
+            continue;
+        }
+        lck_mtx_lock(stripe->lock);
+        for (UInt32 j = 0; j < kRateLimiterWays && collected < count; ++j) {
+            Slot *slot = &stripe->slots[j];
+            if (slot->key != 0 && now - slot->lastSummary >= m_summaryInterval &&
+                takeSummary(slot, now, &summaries[collected])) {
+                collected++;
+            }
+        }
+        lck_mtx_unlock(stripe->lock);
+    }
+    return collected;
+}
@@ -0,0 +1,97 @@
+//
+//  RateLimiter.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef RateLimiter_hpp
+#define RateLimiter_hpp
+
+#include "KextPlatform.hpp"
+#include "ObjectPool.hpp"
+#include "KextCommon.hpp"
+
+static const UInt32 kRateLimiterStripes = 16;
+static const UInt32 kRateLimiterWays = 16;
+// Summaries a single consume may give, that of the process evicted and its own.
+static const UInt32 kMaxConsumeSummaries = 2;
+
+/**
+ * @brief Events of a process suppressed since its previous summary
+ */
+typedef struct {
+    UInt32 pid;
+    UInt32 suppressed[kEventClassCount];
+} ThrottleSummary;
+
+/**
+ * @brief Token buckets of the event classes of each process
+ * The table takes fixed memory, kRateLimiterStripes stripes of kRateLimiterWays processes each,
+ * allocated once. A process missing from its full stripe takes the place of the one idle the
+ * longest, so its buckets start full again and its suppressed events are summarized at once.
+ * Otherwise they are counted until the next summary, at most one per kThrottleSummaryInterval,
+ * given by its next event or by a periodic collection once it is quiet.
+ */
+class RateLimiter {
+
+public:
+    RateLimiter();
+    ~RateLimiter();
+
+    /**
+     * @brief Set the limit of an event class
+
+     * @param eventClass    bit of the class in NuwaKextSubscription
+     * @param rate          events per second let through once the burst is spent, 0 lets them all through
+     * @param burst         events let through at once
+     */
+    void setLimit(UInt32 eventClass, UInt32 rate, UInt32 burst);
+
+    /**
+     * @brief Take a token of the class from the bucket of the process
+
+     * @param pid           pid of the process
+     * @param eventClass    bit of the class in NuwaKextSubscription
+     * @param summaries     room for kMaxConsumeSummaries, filled with the summaries due
+     * @param summaryCount  set to the number of summaries filled
+     * @return              true if the event goes on
+     */
+    bool consume(UInt32 pid, UInt32 eventClass, ThrottleSummary *summaries, UInt32 *summaryCount);
+
+    /**
+     * @brief Take the summaries due of the processes that went quiet since their events were suppressed
+
+     * @param summaries     filled with the summaries due
+     * @param count         room of summaries, those left are taken by the next call
+     * @return              number of summaries filled
+     */
+    UInt32 collectSummaries(ThrottleSummary *summaries, UInt32 count);
+
+private:
+    struct Slot {
+        // Pid plus one, 0 when the slot is free.
+        UInt32 key;
+        UInt32 suppressed[kEventClassCount];
+        UInt64 lastRefill;
+        UInt64 lastSummary;
+        // In nanotokens, a token being NSEC_PER_SEC of them, so a refill takes no division.
+        UInt64 tokens[kEventClassCount];
+    };
+
+    struct __attribute__((aligned(kCacheLineSize))) Stripe {
+        lck_mtx_t *lock;
+        Slot slots[kRateLimiterWays];
+    };
+
+    Slot *findSlot(Stripe *stripe, UInt32 key, UInt64 now, ThrottleSummary *evicted, UInt32 *summaryCount);
+    void refillSlot(Slot *slot, UInt64 now);
+    bool takeSummary(Slot *slot, UInt64 now, ThrottleSummary *summary);
+
+    UInt32 m_rates[kEventClassCount];
+    UInt32 m_bursts[kEventClassCount];
+    UInt64 m_summaryInterval;
+    Stripe *m_stripes;
+};
+
+#endif /* RateLimiter_hpp */
@@ -0,0 +1,63 @@
+//
+//  ReaderEpoch.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "ReaderEpoch.hpp"
+
+ReaderEpoch::ReaderEpoch() {
+    m_epoch = 0;
+    m_slots = (Slot *)IOMallocAligned(sizeof(Slot) * kReaderEpochSlots, kCacheLineSize);
+    if (m_slots != nullptr) {
+        bzero(m_slots, sizeof(Slot) * kReaderEpochSlots);
+    }
+}
+
+ReaderEpoch::~ReaderEpoch() {
+    if (m_slots != nullptr) {
+        IOFreeAligned(m_slots, sizeof(Slot) * kReaderEpochSlots);
+        m_slots = nullptr;
+    }
+}
+
+UInt32 ReaderEpoch::enter() {
+    UInt32 slot = (UInt32)cpu_number() % kReaderEpochSlots;
+    UInt32 epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST) & 1;
+    __atomic_fetch_add(&m_slots[slot].readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+    while ((__atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST) & 1) != epoch) {
+        // Counted in an epoch drained meanwhile, the writer may have freed the data without waiting for it.
+        __atomic_fetch_sub(&m_slots[slot].readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+        epoch = __atomic_load_n(&m_epoch, __ATOMIC_SEQ_CST) & 1;
+        __atomic_fetch_add(&m_slots[slot].readerCount[epoch], 1, __ATOMIC_SEQ_CST);
+    }
+    return slot << 1 | epoch;
+}
+
+void ReaderEpoch::leave(UInt32 ticket) {
+    // The slot it entered in, so no slot ever counts below zero.
+    __atomic_fetch_sub(&m_slots[ticket >> 1].readerCount[ticket & 1], 1, __ATOMIC_RELEASE);
+}
+
+bool ReaderEpoch::isDrained(UInt32 epoch) const {
+    // A reader entering once this began sees the flipped epoch and leaves the slot before reading.
+    for (UInt32 i = 0; i < kReaderEpochSlots; ++i) {
+        if (__atomic_load_n(&m_slots[i].readerCount[epoch & 1], __ATOMIC_SEQ_CST) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReaderEpoch::synchronize(UInt32 timeout, UInt32 *epoch) {
+    *epoch = __atomic_fetch_xor(&m_epoch, 1, __ATOMIC_SEQ_CST) & 1;
+    // Readers only hold the data for a lookup, so this is short unless one is preempted.
+    for (UInt32 waited = 0; !isDrained(*epoch); ++waited) {
+        if (waited >= timeout) {
+            return false;
+        }
+        IOSleep(1);
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+//
+//  ReaderEpoch.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef ReaderEpoch_hpp
+#define ReaderEpoch_hpp
+
+#include "KextPlatform.hpp"
+#include "ObjectPool.hpp"
+
+static const UInt32 kReaderEpochSlots = 16;
+
+/**
+ * @brief Readers of data replaced by writers, so the replaced data is freed once nobody reads it
+ * A reader counts itself in the slot of its CPU under the current epoch, so readers on other CPUs
+ * never share a line. A writer swaps the data, flips the epoch and waits for the readers counted
+ * in the old one. New readers count in the other epoch, the old one drains even under a steady load.
+ */
+class ReaderEpoch {
+
+public:
+    ReaderEpoch();
+    ~ReaderEpoch();
+
+    bool isReady() const {
+        return m_slots != nullptr;
+    }
+
+    // Called when enter a read section, returns the ticket to leave it with.
+    UInt32 enter();
+
+    // Called when leave the read section entered with the ticket, from whatever CPU.
+    void leave(UInt32 ticket);
+
+    /**
+     * @brief Flip the epoch and wait for the readers counted in the old one
+
+     * @param timeout   max milliseconds to wait
+     * @param epoch     set to the old epoch, whose readers may still see the replaced data
+     * @return          false if some of them are still inside when it expires
+     */
+    bool synchronize(UInt32 timeout, UInt32 *epoch);
+
+    // Called when check whether no reader is counted in the epoch.
+    bool isDrained(UInt32 epoch) const;
+
+private:
+    struct __attribute__((aligned(kCacheLineSize))) Slot {
+        SInt32 readerCount[2];
+    };
+
+    Slot *m_slots;
+    UInt32 m_epoch;
+};
+
+#endif /* ReaderEpoch_hpp */
@@ -0,0 +1,228 @@
+//
+//  VnodeSet.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "VnodeSet.hpp"
+#include "ObjectPool.hpp"
+
+static inline bool isItemBefore(const VnodeSet::Item &first, const VnodeSet::Item &second) {
+    return first.key < second.key || (first.key == second.key && first.value < second.value);
+}
+
+static void siftDown(VnodeSet::Item *items, UInt32 root, UInt32 count) {
+    while (root * 2 + 1 < count) {
+        UInt32 child = root * 2 + 1;
+        if (child + 1 < count && isItemBefore(items[child], items[child + 1])) {
+            child++;
+        }
+        if (!isItemBefore(items[root], items[child])) {
+            return;
+        }
+        VnodeSet::Item item = items[root];
+        items[root] = items[child];
+        items[child] = item;
+        root = child;
+    }
+}
+
+VnodeSet::VnodeSet(UInt32 capacity) {
+    m_capacity = capacity;
+    m_count = 0;
+    m_keys = nullptr;
+    m_values = nullptr;
+    m_filter = nullptr;
+    m_filterMask = 0;
+
+    m_items = (Item *)IOMallocAligned(sizeof(Item)*(capacity + 1), 2);
+    if (m_items == nullptr) {
+        m_capacity = 0;
+    }
+}
+
+VnodeSet::~VnodeSet() {
+    if (m_items != nullptr) {
+        IOFreeAligned(m_items, sizeof(Item)*(m_capacity + 1));
+    }
+    if (m_keys != nullptr) {
+        IOFreeAligned(m_keys, sizeof(UInt64)*(m_count + 1));
+    }
+    if (m_values != nullptr) {
+        IOFreeAligned(m_values, m_count + 1);
+    }
+    if (m_filter != nullptr) {
+        IOFreeAligned(m_filter, sizeof(UInt64)*(m_filterMask + 1));
+    }
+}
+
+UInt32 VnodeSet::addItems(const UInt64 *keys, UInt32 count, UInt8 value) {
+    UInt32 added = 0;
+    if (m_items == nullptr || m_keys != nullptr || value == 0) {
+        return added;
+    }
+
+    for (UInt32 i = 0; i < count && m_count < m_capacity; ++i) {
+        if (keys[i] == 0) {
+            continue;
+        }
+        m_items[m_count].key = keys[i];
+        m_items[m_count].value = value;
+        m_count++;
+        added++;
+    }
+    return added;
+}
+
+UInt32 VnodeSet::addItems(const VnodeSet *other, UInt8 exceptValue) {
+    UInt32 added = 0;
+    if (m_items == nullptr || m_keys != nullptr || other == nullptr || other->m_keys == nullptr) {
+        return added;
+    }
+
+    for (UInt32 i = 1; i <= other->m_count && m_count < m_capacity; ++i) {
+        if (other->m_values[i] == exceptValue) {
+            continue;
+        }
+        m_items[m_count].key = other->m_keys[i];
+        m_items[m_count].value = other->m_values[i];
+        m_count++;
+        added++;
+    }
+    return added;
+}
+
+UInt32 VnodeSet::copyItems(const VnodeSet *other, UInt8 value, const VnodeSet *removed) {
+    UInt32 added = 0;
+    if (m_items == nullptr || m_keys != nullptr || other == nullptr || other->m_keys == nullptr) {
+        return added;
+    }
+
+    for (UInt32 i = 1; i <= other->m_count && m_count < m_capacity; ++i) {
+        if (other->m_values[i] != value || (removed != nullptr && removed->getValue(other->m_keys[i]) != 0)) {
+            continue;
+        }
+        m_items[m_count].key = other->m_keys[i];
+        m_items[m_count].value = value;
+        m_count++;
+        added++;
+    }
+    return added;
+}
+
+bool VnodeSet::finish() {
+    if (m_items == nullptr || m_keys != nullptr) {
+        return false;
+    }
+
+    // Heap sort by key then value, no scratch memory and no recursion.
+    for (UInt32 i = m_count / 2; i > 0; --i) {
+        siftDown(m_items, i - 1, m_count);
+    }
+    for (UInt32 end = m_count; end > 1; --end) {
+        Item item = m_items[0];
+        m_items[0] = m_items[end - 1];
+        m_items[end - 1] = item;
+        siftDown(m_items, 0, end - 1);
+    }
+
+    // A key may stay with several values, lookups find the smallest one first.
+    UInt32 unique = 0;
+    for (UInt32 i = 0; i < m_count; ++i) {
+        if (unique == 0 || m_items[i].key != m_items[unique - 1].key || m_items[i].value != m_items[unique - 1].value) {
+            m_items[unique++] = m_items[i];
+        }
+    }
+    m_count = unique;
+
+    m_keys = (UInt64 *)IOMallocAligned(sizeof(UInt64)*(m_count + 1), kCacheLineSize);
+    m_values = (UInt8 *)IOMallocAligned(m_count + 1, kCacheLineSize);
+    if (m_keys == nullptr || m_values == nullptr) {
+        if (m_keys != nullptr) {
+            IOFreeAligned(m_keys, sizeof(UInt64)*(m_count + 1));
+            m_keys = nullptr;
+        }
+        if (m_values != nullptr) {
+            IOFreeAligned(m_values, m_count + 1);
+            m_values = nullptr;
+        }
+        return false;
+    }
+    m_keys[0] = 0;
+    m_values[0] = 0;
+    fillLayout(0, 1);
+    buildFilter();
+
+    IOFreeAligned(m_items, sizeof(Item)*(m_capacity + 1));
+    m_items = nullptr;
+    return true;
+}
+
+UInt32 VnodeSet::fillLayout(UInt32 sorted, UInt32 position) {
+    // An in-order walk of the implicit tree visits the positions in sorted order.
+    if (position > m_count) {
+        return sorted;
+    }
+    sorted = fillLayout(sorted, position * 2);
+    m_keys[position] = m_items[sorted].key;
+    m_values[position] = m_items[sorted].value;
+    return fillLayout(sorted + 1, position * 2 + 1);
+}
+
+void VnodeSet::buildFilter() {
+    // A power of two words, 16 bits per item keep false positives under 1%.
+    UInt64 wordCount = 1;
+    while (wordCount * 64 < (UInt64)m_count * kVnodeFilterBitsPerItem) {
+        wordCount <<= 1;
+    }
+
+    m_filter = (UInt64 *)IOMallocAligned(sizeof(UInt64)*wordCount, kCacheLineSize);
+    if (m_filter == nullptr) {
+        return;
+    }
+    bzero(m_filter, sizeof(UInt64)*wordCount);
+    m_filterMask = wordCount - 1;
+
+    for (UInt32 i = 1; i <= m_count; ++i) {
+        UInt64 hash = filterHash(m_keys[i]);
+        m_filter[(hash >> 32) & m_filterMask] |= filterBits(hash);
+    }
+}
+
+UInt32 VnodeSet::countItems(UInt8 value) const {
+    UInt32 count = 0;
+    for (UInt32 i = 1; m_values != nullptr && i <= m_count; ++i) {
+        count += (m_values[i] == value);
+    }
+    return count;
+}
+
+bool VnodeSet::mayContain(UInt64 key) const {
+    if (m_filter == nullptr) {
+        return m_keys != nullptr;
+    }
+    UInt64 hash = filterHash(key);
+    UInt64 bits = filterBits(hash);
+    return (m_filter[(hash >> 32) & m_filterMask] & bits) == bits;
+}
+
+UInt8 VnodeSet::getValue(UInt64 key) const {
+    if (m_keys == nullptr || !mayContain(key)) {
+        return 0;
+    }
+
+    UInt64 position = 1;
+    while (position <= m_count) {
+        // The 8 descendants three levels down fill one cache line.
+        __builtin_prefetch(&m_keys[position * 8]);
+        position = position * 2 + (m_keys[position] < key);
+    }
+    // Drop the right turns taken after the last left one, that node is the lower bound.
+    position >>= __builtin_ffsll(~position);
+
+    if (position != 0 && m_keys[position] == key) {
+        return m_values[position];
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+//
+//  VnodeSet.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef VnodeSet_hpp
+#define VnodeSet_hpp
+
+#include "KextPlatform.hpp"
+
+static const UInt8 kVnodeFilterBitsPerItem = 16;
+
+/**
+ * @brief Read-only set of vnode IDs, each tagged with a small value
+ * Items are added once, then sorted into an Eytzinger (breadth-first) layout, so a
+ * lookup is a branch-free descent whose next levels are always prefetched. An item
+ * takes 9 bytes and no node allocation. Lookups take no lock, nothing changes once built.
+ * Most lookups miss, so a blocked Bloom filter answers those from a single word first.
+ */
+class VnodeSet {
+
+public:
+    /**
+     * @brief Create the set
+
+     * @param capacity  max number of items added before finishing
+     */
+    VnodeSet(UInt32 capacity);
+    ~VnodeSet();
+
+    /**
+     * @brief Add items tagged with the same value
+
+     * @param keys      vnode IDs to add, zero is ignored
+     * @param count     number of vnode IDs
+     * @param value     non zero value returned by the lookups of these keys
+     * @return          number of items added
+     */
+    UInt32 addItems(const UInt64 *keys, UInt32 count, UInt8 value);
+
+    // Called when carry the items of another set over, except those tagged with the value.
+    UInt32 addItems(const VnodeSet *other, UInt8 exceptValue);
+
+    // Called when carry the items of another set tagged with the value over, except the removed keys.
+    UInt32 copyItems(const VnodeSet *other, UInt8 value, const VnodeSet *removed);
+
+    // Called when all items are added, a key added with several values is found with the smallest.
+    bool finish();
+
+    // Called when obtain the value of the key, 0 if not found.
+    UInt8 getValue(UInt64 key) const;
+
+    // Called when ask the filter alone, false means the key is surely not in the set.
+    bool mayContain(UInt64 key) const;
+
+    UInt32 getCount() const {
+        return m_count;
+    }
+
+    // Called when count the items tagged with the value.
+    UInt32 countItems(UInt8 value) const;
+
+    // Called when obtain the key of the item at the index of a finished set, from 0 to getCount() - 1.
+    UInt64 getKeyAt(UInt32 index) const {
+        return m_keys[index + 1];
+    }
+
+    UInt8 getValueAt(UInt32 index) const {
+        return m_values[index + 1];
+    }
+
+    // Called when obtain the memory taken by a finished set of the given size.
+    static UInt64 getMemorySize(UInt64 count) {
+        return (count + 1) * (sizeof(UInt64) + sizeof(UInt8)) + count * kVnodeFilterBitsPerItem / 8;
+    }
+
+    struct Item {
+        UInt64 key;
+        UInt8 value;
+    };
+
+private:
+    UInt32 fillLayout(UInt32 sorted, UInt32 position);
+    void buildFilter();
+
+    static UInt64 filterHash(UInt64 key) {
+        // Finalizer of MurmurHash3, vnode IDs of one volume only differ in their low bits.
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdUL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53UL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static UInt64 filterBits(UInt64 hash) {
+        // Four bits in the word, each picked by 6 bits of the hash.
+        return (1UL << (hash & 63)) | (1UL << ((hash >> 6) & 63)) |
+            (1UL << ((hash >> 12) & 63)) | (1UL << ((hash >> 18) & 63));
+    }
+
+    UInt32 m_capacity;
+    UInt32 m_count;
+    // Pending items, released once the layout is built.
+    Item *m_items;
+    // Both are indexed from 1, a node i has its children at 2i and 2i+1.
+    UInt64 *m_keys;
+    UInt8 *m_values;
+    // One word per key, nullptr if it could not be allocated.
+    UInt64 *m_filter;
+    UInt64 m_filterMask;
+};
+
+#endif /* VnodeSet_hpp */
@@ -0,0 +1,49 @@
+//
+//  WakeupBatch.cpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "WakeupBatch.hpp"
+
+WakeupBatch::WakeupBatch() {
+    m_count = 1;
+    m_delay = 0;
+    m_pendingEvents = 0;
+}
+
+void WakeupBatch::setCoalescing(UInt32 count, UInt32 delay) {
+    __atomic_store_n(&m_count, count, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_delay, delay, __ATOMIC_RELAXED);
+}
+
+UInt32 WakeupBatch::addEvent(bool wasEmpty) {
+    UInt32 count = __atomic_load_n(&m_count, __ATOMIC_RELAXED);
+    UInt32 delay = __atomic_load_n(&m_delay, __ATOMIC_RELAXED);
+    if (count <= 1 || delay == 0) {
+        // Same as IOSharedDataQueue, the client is only woken up when it may be waiting.
+        return wasEmpty ? kWakeupNow : kWakeupNone;
+    }
+
+    // Events found the queue non empty while no wakeup is owed are drained by an awake client.
+    UInt32 pending = __atomic_load_n(&m_pendingEvents, __ATOMIC_RELAXED);
+    UInt32 next = 0;
+    do {
+        if (pending == 0 && !wasEmpty) {
+            return kWakeupNone;
+        }
+        next = pending + 1;
+    } while (!__atomic_compare_exchange_n(&m_pendingEvents, &pending, next, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    UInt32 actions = next == 1 ? kWakeupArmTimer : kWakeupNone;
+    if (next >= count) {
+        actions |= kWakeupBatchFull;
+    }
+    return actions;
+}
+
+UInt32 WakeupBatch::takeBatch() {
+    // Whoever takes the batch sends the wakeup, the timer finds nothing left after a full batch.
+    return __atomic_exchange_n(&m_pendingEvents, 0, __ATOMIC_ACQ_REL);
+}
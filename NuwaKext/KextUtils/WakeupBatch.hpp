@@ -0,0 +1,59 @@
+//
+//  WakeupBatch.hpp
+//  NuwaKext
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef WakeupBatch_hpp
+#define WakeupBatch_hpp
+
+#include "KextPlatform.hpp"
+
+/**
+ * @brief What a producer does for the client once its event is counted
+ */
+typedef enum {
+    kWakeupNone         = 0,
+    kWakeupNow          = 1 << 0,   // Not batching, the client may be waiting
+    kWakeupArmTimer     = 1 << 1,   // First event of a batch, the timer bounds its latency
+    kWakeupBatchFull    = 1 << 2    // Last event of a batch, whoever takes it wakes the client up
+} WakeupAction;
+
+/**
+ * @brief Wakeups of the client of a queue, batched by count and by delay
+ * Producers count the events they commit without a lock. A batch starts with an event
+ * finding the queue empty, and ends when full or when the timer armed by its first event
+ * takes it, whichever comes first.
+ */
+class WakeupBatch {
+
+public:
+    WakeupBatch();
+
+    /**
+     * @brief Set the size of the batches
+
+     * @param count     events of a batch, 1 turns batching off
+     * @param delay     max microseconds the first event of a batch waits, 0 turns batching off
+     */
+    void setCoalescing(UInt32 count, UInt32 delay);
+
+    UInt32 getDelay() const {
+        return __atomic_load_n(&m_delay, __ATOMIC_RELAXED);
+    }
+
+    // Called when count a committed event, wasEmpty if the queue was empty before, returns WakeupAction flags.
+    UInt32 addEvent(bool wasEmpty);
+
+    // Called when the batch is full, the timer fires or the batch is cut short, returns the events taken, 0 if none.
+    UInt32 takeBatch();
+
+private:
+    UInt32 m_count;
+    UInt32 m_delay;
+    // Events counted since a wakeup became owed to the client, 0 when none is.
+    UInt32 m_pendingEvents;
+};
+
+#endif /* WakeupBatch_hpp */
@@ -26,6 +26,8 @@ bool SocketFilter::init() {
     if (!OSObject::init()) {
         return false;
     }
+    m_isRegistered = false;
+    m_withData = false;
     return true;
 }
 
@@ -33,7 +35,7 @@ void SocketFilter::free() {
     OSObject::free();
 }
 
-bool SocketFilter::registerSocketFilter(sflt_filter *filter, UInt32 handle, UInt32 domain, UInt32 proto) {
+bool SocketFilter::registerSocketFilter(sflt_filter *filter, UInt32 handle, UInt32 domain, UInt32 proto, bool withData) {
     errno_t error = 0;
     UInt32 type = 0;
     bzero(filter, sizeof(sflt_filter));
@@ -45,8 +47,10 @@ bool SocketFilter::registerSocketFilter(sflt_filter *filter, UInt32 handle, UInt
     filter->sf_detach = socket_detach_callback;
     filter->sf_bind = socket_bind_callback;
     filter->sf_notify = socket_notify_callback;
-    filter->sf_data_in = socket_data_in_callback;
-    filter->sf_data_out = socket_data_out_callback;
+    if (withData) {
+        filter->sf_data_in = socket_data_in_callback;
+        filter->sf_data_out = socket_data_out_callback;
+    }
     
     switch (proto) {
         case IPPROTO_TCP:
@@ -82,27 +86,29 @@ void SocketFilter::unregisterSocketFilter(sflt_filter *filter) {
     }
 }
 
-bool SocketFilter::registerFilters() {
-    if (!registerSocketFilter(&m_TCPv4Filter, s_TCPv4FilterHandle, AF_INET, IPPROTO_TCP)) {
+bool SocketFilter::registerFilters(bool withData) {
+    if (!registerSocketFilter(&m_TCPv4Filter, s_TCPv4FilterHandle, AF_INET, IPPROTO_TCP, withData)) {
         return false;
     }
-    if (!registerSocketFilter(&m_TCPv6Filter, s_TCPv6FilterHandle, AF_INET6, IPPROTO_TCP)) {
+    if (!registerSocketFilter(&m_TCPv6Filter, s_TCPv6FilterHandle, AF_INET6, IPPROTO_TCP, withData)) {
         unregisterSocketFilter(&m_TCPv4Filter);
         return false;
     }
     
-    if (!registerSocketFilter(&m_UDPv4Filter, s_UDPv4FilterHandle, AF_INET, IPPROTO_UDP)) {
+    if (!registerSocketFilter(&m_UDPv4Filter, s_UDPv4FilterHandle, AF_INET, IPPROTO_UDP, withData)) {
         unregisterSocketFilter(&m_TCPv4Filter);
         unregisterSocketFilter(&m_TCPv6Filter);
         return false;
     }
-    if (!registerSocketFilter(&m_UDPv6Filter, s_UDPv6FilterHandle, AF_INET6, IPPROTO_UDP)) {
+    if (!registerSocketFilter(&m_UDPv6Filter, s_UDPv6FilterHandle, AF_INET6, IPPROTO_UDP, withData)) {
         unregisterSocketFilter(&m_TCPv4Filter);
         unregisterSocketFilter(&m_TCPv6Filter);
         unregisterSocketFilter(&m_UDPv4Filter);
         return false;
     }
     
+    m_isRegistered = true;
+    m_withData = withData;
     return true;
 }
 
@@ -116,12 +122,27 @@ void SocketFilter::unregisterFilters() {
     unregisterSocketFilter(&m_TCPv6Filter);
     unregisterSocketFilter(&m_UDPv4Filter);
     unregisterSocketFilter(&m_UDPv6Filter);
+    m_isRegistered = false;
     
     while (s_activeEventCount > 0) {
         msleep(nullptr, nullptr, 0, "wait for socket filters stopped", &wait);
     }
 }
 
+bool SocketFilter::updateFilters(UInt32 mask) {
+    bool needed = (mask & (kSubscribeNetworkAccess | kSubscribeDnsQuery)) != 0;
+    bool withData = (mask & kSubscribeDnsQuery) != 0;
+    if (needed == m_isRegistered && (!needed || withData == m_withData)) {
+        return true;
+    }
+    
+    // Filters cannot be changed once registered, so swap them, sockets opened meanwhile are not filtered.
+    if (m_isRegistered) {
+        unregisterFilters();
+    }
+    return needed ? registerFilters(withData) : true;
+}
+
 #pragma mark - Callback Methods
 
 extern "C"
@@ -21,16 +21,23 @@ public:
     // Called automatically when retain count drops to 0.
     void free() override;
     
-    // Register the socket filters.
-    bool registerFilters();
+    // Register the socket filters, with the data callbacks or not.
+    bool registerFilters(bool withData = true);
 
     // Unregister the socket filters.
     void unregisterFilters();
     
+    // Register the socket filters with the callbacks needed by the subscribed event classes only.
+    bool updateFilters(UInt32 mask);
+    
 private:
-    bool registerSocketFilter(sflt_filter *filter, UInt32 handle, UInt32 domain, UInt32 proto);
+    bool registerSocketFilter(sflt_filter *filter, UInt32 handle, UInt32 domain, UInt32 proto, bool withData);
     void unregisterSocketFilter(sflt_filter *filter);
     
+    bool m_isRegistered;
+    // Data callbacks run for every packet, they are only needed by dns query events.
+    bool m_withData;
+    
     sflt_filter m_TCPv4Filter;
     sflt_filter m_TCPv6Filter;
     sflt_filter m_UDPv4Filter;
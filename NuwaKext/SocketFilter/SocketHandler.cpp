@@ -12,6 +12,7 @@
 #include <sys/kauth.h>
 #include <sys/vnode.h>
 #include <sys/kpi_mbuf.h>
+#include <kern/clock.h>
 
 OSDefineMetaClassAndStructors(SocketHandler, OSObject);
 
@@ -44,32 +45,35 @@ void SocketHandler::free() {
     OSObject::free();
 }
 
-errno_t SocketHandler::fillBasicInfo(NuwaKextEvent *netEvent, NuwaKextAction action) {
+errno_t SocketHandler::fillBasicInfo(NuwaKextRecordHeader *header, NuwaKextAction action) {
     timeval time;
+    UInt64 uptime = 0;
     microtime(&time);
+    clock_get_uptime(&uptime);
     vfs_context_t context = vfs_context_create(nullptr);
     proc_t proc = vfs_context_proc(context);
     kauth_cred_t cred = vfs_context_ucred(context);
     
-    netEvent->eventType = action;
-    netEvent->eventTime = time.tv_sec;
+    header->eventType = action;
+    header->eventTime = time.tv_sec;
+    absolutetime_to_nanoseconds(uptime, &header->eventUptime);
     
     if (proc != nullptr) {
-        netEvent->mainProcess.pid = proc_pid(proc);
-        netEvent->mainProcess.ppid = proc_ppid(proc);
+        header->mainProcess.pid = proc_pid(proc);
+        header->mainProcess.ppid = proc_ppid(proc);
     }
     if (cred != nullptr) {
-        netEvent->mainProcess.euid = kauth_cred_getuid(cred);
-        netEvent->mainProcess.ruid = kauth_cred_getruid(cred);
-        netEvent->mainProcess.egid = kauth_cred_getgid(cred);
-        netEvent->mainProcess.rgid = kauth_cred_getrgid(cred);
+        header->mainProcess.euid = kauth_cred_getuid(cred);
+        header->mainProcess.ruid = kauth_cred_getruid(cred);
+        header->mainProcess.egid = kauth_cred_getgid(cred);
+        header->mainProcess.rgid = kauth_cred_getrgid(cred);
     }
     
     vfs_context_rele(context);
     return 0;
 }
 
-errno_t SocketHandler::fillConnectionInfo(NuwaKextEvent *netEvent) {
+errno_t SocketHandler::fillConnectionInfo(UInt16 *protocol) {
     errno_t error = 0;
     int sockType = 0;
     int length = sizeof(sockType);
@@ -95,31 +99,28 @@ errno_t SocketHandler::fillConnectionInfo(NuwaKextEvent *netEvent) {
     }
     switch (sockType) {
         case SOCK_STREAM:
-            netEvent->netAccess.protocol = IPPROTO_TCP;
+            *protocol = IPPROTO_TCP;
             break;
         case SOCK_DGRAM:
-            netEvent->netAccess.protocol = IPPROTO_UDP;
+            *protocol = IPPROTO_UDP;
             break;
         default:
             return EINVAL;
     }
     
-    netEvent->netAccess.localAddr = m_localAddr;
-    netEvent->netAccess.remoteAddr = m_remoteAddr;
-    
     return 0;
 }
 
-errno_t SocketHandler::fillNetEventInfo(NuwaKextEvent *netEvent, NuwaKextAction action) {
+errno_t SocketHandler::fillNetEventInfo(NuwaKextRecordHeader *header, UInt16 *protocol, NuwaKextAction action) {
     errno_t error = 0;
     
-    error = fillBasicInfo(netEvent, action);
+    error = fillBasicInfo(header, action);
     if (error != 0) {
         Logger(LOG_WARN, "Failed to fill basic info [%d].", error)
         return error;
     }
     
-    error = fillConnectionInfo(netEvent);
+    error = fillConnectionInfo(protocol);
     if (error != 0) {
         Logger(LOG_WARN, "Failed to fill connection info [%d].", error)
         return error;
@@ -128,79 +129,119 @@ errno_t SocketHandler::fillNetEventInfo(NuwaKextEvent *netEvent, NuwaKextAction
     return error;
 }
 
-void SocketHandler::fillInfoFromCache(NuwaKextEvent *netEvent) {
-    if (netEvent->mainProcess.pid != 0) {
+void SocketHandler::fillInfoFromCache(NuwaKextRecordHeader *header, UInt16 protocol) {
+    if (header->mainProcess.pid != 0) {
         return;
     }
     
-    netEvent->mainProcess = m_procInfo;
+    header->mainProcess = m_procInfo;
     if (m_procInfo.pid != 0) {
         return;
     }
     
-    if (netEvent->eventType == kActionNotifyNetworkAccess) {
-        if (netEvent->netAccess.protocol == IPPROTO_TCP) {
-            UInt16 port = ((UInt16)netEvent->netAccess.localAddr.sa_data[0] << 8) | (UInt8)netEvent->netAccess.localAddr.sa_data[1];
+    if (header->eventType == kActionNotifyNetworkAccess) {
+        if (protocol == IPPROTO_TCP) {
+            UInt16 port = ((UInt16)m_localAddr.sa_data[0] << 8) | (UInt8)m_localAddr.sa_data[1];
             UInt64 value = m_cacheManager->obtainPortBindCache(port);
-            netEvent->mainProcess.pid = value >> 32;
-            netEvent->mainProcess.ppid = (value << 32) >> 32;
+            header->mainProcess.pid = value >> 32;
+            header->mainProcess.ppid = (value << 32) >> 32;
         }
-    } else if (netEvent->eventType == kActionNotifyDnsQuery) {
-        UInt64 addr = *(UInt64 *)&netEvent->netAccess.remoteAddr.sa_data[2];
+    } else if (header->eventType == kActionNotifyDnsQuery) {
+        // Same key as in the outbound callback, the address of the name server.
+        UInt64 addr = *(UInt64 *)&m_remoteAddr.sa_data[2];
         UInt64 value = m_cacheManager->obtainDnsOutCache(addr);
-        netEvent->mainProcess.pid = value >> 32;
-        netEvent->mainProcess.ppid = (value << 32) >> 32;
+        header->mainProcess.pid = value >> 32;
+        header->mainProcess.ppid = (value << 32) >> 32;
+    }
+}
+
+void SocketHandler::postNetAccess(const NuwaKextRecordHeader *header, UInt16 protocol) {
+    EventReservation reservation;
+    UInt32 size = sizeof(NuwaKextRecordHeader) + alignRecordSize(sizeof(NuwaKextRecordField) + sizeof(UInt16)) +
+        2 * alignRecordSize(sizeof(NuwaKextRecordField) + sizeof(sockaddr));
+    UInt8 *record = (UInt8 *)m_eventDispatcher->reserveEvent(kActionNotifyNetworkAccess, size, &reservation);
+    if (record == nullptr) {
+        return;
+    }
+    
+    UInt32 offset = sizeof(NuwaKextRecordHeader);
+    offset = appendRecordField(record, size, offset, kRecordFieldProtocol, &protocol, sizeof(UInt16));
+    offset = appendRecordField(record, size, offset, kRecordFieldLocalAddr, &m_localAddr, sizeof(sockaddr));
+    offset = appendRecordField(record, size, offset, kRecordFieldRemoteAddr, &m_remoteAddr, sizeof(sockaddr));
+    m_eventDispatcher->commitEvent(&reservation, closeEventRecord(record, offset, header));
+}
+
+void SocketHandler::postDnsQuery(const NuwaKextRecordHeader *header, const DNSParseResult *result) {
+    EventReservation reservation;
+    SInt32 status = result->replyCode;
+    UInt32 nameLength = (UInt32)strnlen(result->domainName, kMaxNameLength - 1);
+    UInt32 resultLength = (UInt32)strnlen(result->queryResult, kMaxPathLength - 1);
+    UInt32 size = sizeof(NuwaKextRecordHeader) + alignRecordSize(sizeof(NuwaKextRecordField) + sizeof(SInt32)) +
+        alignRecordSize(sizeof(NuwaKextRecordField) + nameLength) + alignRecordSize(sizeof(NuwaKextRecordField) + resultLength);
+    UInt8 *record = (UInt8 *)m_eventDispatcher->reserveEvent(kActionNotifyDnsQuery, size, &reservation);
+    if (record == nullptr) {
+        return;
     }
+    
+    UInt32 offset = sizeof(NuwaKextRecordHeader);
+    offset = appendRecordField(record, size, offset, kRecordFieldQueryStatus, &status, sizeof(SInt32));
+    offset = appendRecordField(record, size, offset, kRecordFieldDomainName, result->domainName, nameLength);
+    offset = appendRecordField(record, size, offset, kRecordFieldQueryResult, result->queryResult, resultLength);
+    m_eventDispatcher->commitEvent(&reservation, closeEventRecord(record, offset, header));
 }
 
 void SocketHandler::bindSocketCallback(socket_t socket, const sockaddr *to) {
     m_socket = socket;
     m_localAddr = *to;
-    NuwaKextEvent netEvent = {};
-    if (fillNetEventInfo(&netEvent, kActionNotifyNetworkAccess) != 0) {
+    NuwaKextRecordHeader header = {};
+    UInt16 protocol = 0;
+    if (fillNetEventInfo(&header, &protocol, kActionNotifyNetworkAccess) != 0) {
         return;
     }
     
-    m_procInfo = netEvent.mainProcess;
-    if (netEvent.netAccess.protocol == IPPROTO_TCP) {
+    m_procInfo = header.mainProcess;
+    if (protocol == IPPROTO_TCP) {
         UInt16 port = ((UInt16)m_localAddr.sa_data[0] << 8) | (UInt8)m_localAddr.sa_data[1];
-        UInt64 value = ((UInt64)netEvent.mainProcess.pid << 32) | netEvent.mainProcess.ppid;
+        UInt64 value = ((UInt64)header.mainProcess.pid << 32) | header.mainProcess.ppid;
         m_cacheManager->updatePortBindCache(port, value);
     }
 }
 
 void SocketHandler::notifySocketCallback(socket_t socket, sflt_event_t event) {
     m_socket = socket;
-    NuwaKextEvent *netEvent = (NuwaKextEvent *)IOMallocAligned(sizeof(NuwaKextEvent), 2);
-    if (netEvent == nullptr) {
+    if (!m_eventDispatcher->isSubscribed(kActionNotifyNetworkAccess)) {
         return;
     }
-    
-    bzero(netEvent, sizeof(NuwaKextEvent));
+    NuwaKextRecordHeader header = {};
+    UInt16 protocol = 0;
     // Process info cann't be obtained in this callback, so the info cached in bind/connect callback.
-    if (fillNetEventInfo(netEvent, kActionNotifyNetworkAccess) == 0) {
-        fillInfoFromCache(netEvent);
-        m_eventDispatcher->postToNotifyQueue(netEvent);
+    if (fillNetEventInfo(&header, &protocol, kActionNotifyNetworkAccess) == 0) {
+        fillInfoFromCache(&header, protocol);
+        if (!m_eventDispatcher->isThrottled(&header)) {
+            postNetAccess(&header, protocol);
+        }
     }
-    IOFreeAligned(netEvent, sizeof(NuwaKextEvent));
 }
 
 void SocketHandler::connectSocketCallback(socket_t socket, const sockaddr *to) {
-    NuwaKextEvent netEvent = {};
-    if (fillBasicInfo(&netEvent, kActionNotifyNetworkAccess) == 0) {
-        m_procInfo = netEvent.mainProcess;
+    NuwaKextRecordHeader header = {};
+    if (fillBasicInfo(&header, kActionNotifyNetworkAccess) == 0) {
+        m_procInfo = header.mainProcess;
     }
 }
 
 void SocketHandler::inboundSocketCallback(socket_t socket, mbuf_t *data, const sockaddr *from) {
     m_socket = socket;
+    if (!m_eventDispatcher->isSubscribed(kActionNotifyDnsQuery)) {
+        return;
+    }
     mbuf_t packet = *data;
     if (from != nullptr) {
         m_remoteAddr = *from;
     }
     
-    NuwaKextEvent event = {};
-    if (fillConnectionInfo(&event) != 0) {
+    UInt16 protocol = 0;
+    if (fillConnectionInfo(&protocol) != 0) {
         Logger(LOG_ERROR, "Failed to fill info for inbound flow.")
         return;
     }
@@ -213,42 +254,38 @@ void SocketHandler::inboundSocketCallback(socket_t socket, mbuf_t *data, const s
         packet = mbuf_next(packet);
     }
     size_t size = mbuf_len(packet);
-    DNSResolver resolver((char *)mbuf_data(packet), size, event.netAccess.protocol);
+    DNSResolver resolver((char *)mbuf_data(packet), size, protocol);
     DNSResolveResults results = resolver.getResults();
     if (results.count == 0 || results.results == nullptr) {
         return;
     }
     
-    NuwaKextEvent *netEvent = (NuwaKextEvent *)IOMallocAligned(sizeof(NuwaKextEvent), 2);
-    if (netEvent == nullptr) {
-        return;
-    }
     for (UInt16 i = 0; i < results.count; ++i) {
         if (strlen(results.results[i].queryResult) == 0) {
             continue;
         }
-        bzero(netEvent, sizeof(NuwaKextEvent));
+        NuwaKextRecordHeader header = {};
         // Process info cann't be obtained in this callback, so the info cached in outbound callback.
-        if (fillBasicInfo(netEvent, kActionNotifyDnsQuery) == 0) {
-            fillInfoFromCache(netEvent);
-            netEvent->dnsQuery.queryStatus = results.results[i].replyCode;
-            strlcpy(netEvent->dnsQuery.domainName, results.results[i].domainName, kMaxNameLength);
-            strlcpy(netEvent->dnsQuery.queryResult, results.results[i].queryResult, kMaxPathLength);
-            m_eventDispatcher->postToNotifyQueue(netEvent);
+        if (fillBasicInfo(&header, kActionNotifyDnsQuery) == 0) {
+            fillInfoFromCache(&header, protocol);
+            if (!m_eventDispatcher->isThrottled(&header)) {
+                postDnsQuery(&header, &results.results[i]);
+            }
         }
     }
-    
-    IOFreeAligned(netEvent, sizeof(NuwaKextEvent));
 }
 
 void SocketHandler::outboundSocketCallback(socket_t socket, const sockaddr *to) {
     m_socket = socket;
+    if (!m_eventDispatcher->isSubscribed(kActionNotifyDnsQuery)) {
+        return;
+    }
     if (to != nullptr) {
         m_remoteAddr = *to;
     }
     
-    NuwaKextEvent event = {};
-    if (fillBasicInfo(&event, kActionNotifyDnsQuery) != 0) {
+    NuwaKextRecordHeader header = {};
+    if (fillBasicInfo(&header, kActionNotifyDnsQuery) != 0) {
         Logger(LOG_ERROR, "Failed to fill info for outbound flow.")
         return;
     }
@@ -258,6 +295,6 @@ void SocketHandler::outboundSocketCallback(socket_t socket, const sockaddr *to)
         return;
     }
     UInt64 addr = *(UInt64 *)&m_remoteAddr.sa_data[2];
-    UInt64 value = ((UInt64)event.mainProcess.pid << 32) | event.mainProcess.ppid;
+    UInt64 value = ((UInt64)header.mainProcess.pid << 32) | header.mainProcess.ppid;
     m_cacheManager->updateDnsOutCache(addr, value);
 }
@@ -10,6 +10,7 @@
 
 #include "CacheManager.hpp"
 #include "EventDispatcher.hpp"
+#include "DNSResolver.hpp"
 #include <sys/kpi_socketfilter.h>
 
 class SocketHandler : public OSObject {
@@ -29,10 +30,12 @@ public:
     void outboundSocketCallback(socket_t socket, const sockaddr *to);
     
 private:
-    errno_t fillBasicInfo(NuwaKextEvent *netEvent, NuwaKextAction action);
-    errno_t fillConnectionInfo(NuwaKextEvent *netEvent);
-    errno_t fillNetEventInfo(NuwaKextEvent *netEvent, NuwaKextAction action);
-    void fillInfoFromCache(NuwaKextEvent *netEvent);
+    errno_t fillBasicInfo(NuwaKextRecordHeader *header, NuwaKextAction action);
+    errno_t fillConnectionInfo(UInt16 *protocol);
+    errno_t fillNetEventInfo(NuwaKextRecordHeader *header, UInt16 *protocol, NuwaKextAction action);
+    void fillInfoFromCache(NuwaKextRecordHeader *header, UInt16 protocol);
+    void postNetAccess(const NuwaKextRecordHeader *header, UInt16 protocol);
+    void postDnsQuery(const NuwaKextRecordHeader *header, const DNSParseResult *result);
     
     socket_t m_socket;
     sockaddr m_localAddr;
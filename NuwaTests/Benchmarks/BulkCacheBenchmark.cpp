@@ -0,0 +1,106 @@
+//
+//  BulkCacheBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "DriverCache.hpp"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * @brief Time spent on each kind of operation, in nanoseconds
+ */
+typedef struct {
+    double set;
+    double get;
+    double remove;
+} BatchCost;
+
+static double elapsedSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Lists are pushed, looked up and dropped again, as ListManager does with the mute lists.
+static void runItems(DriverCache<UInt64, UInt64> *cache, const UInt64 *keys, UInt32 count, BatchCost *cost, UInt64 *found) {
+    auto start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < count; ++i) {
+        cache->setObject(keys[i], 1);
+    }
+    cost->set += elapsedSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < count; ++i) {
+        *found += cache->getObject(keys[i]) == 1;
+    }
+    cost->get += elapsedSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < count; ++i) {
+        cache->setObject(keys[i], 0);
+    }
+    cost->remove += elapsedSince(start);
+}
+
+static void runBatch(DriverCache<UInt64, UInt64> *cache, const UInt64 *keys, UInt32 count, BatchCost *cost, UInt64 *found,
+                     std::vector<UInt64> *values) {
+    auto start = std::chrono::steady_clock::now();
+    cache->setObjects(keys, count, 1);
+    cost->set += elapsedSince(start);
+
+    start = std::chrono::steady_clock::now();
+    *found += cache->getObjects(keys, values->data(), count);
+    cost->get += elapsedSince(start);
+
+    start = std::chrono::steady_clock::now();
+    cache->removeObjects(keys, count);
+    cost->remove += elapsedSince(start);
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    printf("%llu keys per batch size, ns per key\n", (unsigned long long)operations);
+    printf("%8s %10s %10s %10s %10s %10s %10s\n", "batch", "item set", "bulk set", "item get", "bulk get", "item del",
+           "bulk del");
+
+    std::mt19937_64 random(5);
+    std::vector<UInt64> keys(operations);
+    for (UInt64 &key : keys) {
+        key = random() | 1;
+    }
+    std::vector<UInt64> values;
+
+    UInt64 expected = 0;
+    UInt64 found = 0;
+    for (UInt32 batchSize = 16; batchSize <= 1024; batchSize <<= 2) {
+        values.resize(batchSize);
+        BatchCost items = { 0, 0, 0 };
+        BatchCost batches = { 0, 0, 0 };
+        // Sized for the largest list, as the caches ListManager fills are.
+        DriverCache<UInt64, UInt64> *itemCache = new DriverCache<UInt64, UInt64>(1024 * 4);
+        DriverCache<UInt64, UInt64> *batchCache = new DriverCache<UInt64, UInt64>(1024 * 4);
+        itemCache->zero = 0;
+        batchCache->zero = 0;
+        UInt64 done = 0;
+        for (; done + batchSize <= operations; done += batchSize) {
+            runItems(itemCache, keys.data() + done, batchSize, &items, &found);
+            runBatch(batchCache, keys.data() + done, batchSize, &batches, &found, &values);
+        }
+        expected += done * 2;
+        delete itemCache;
+        delete batchCache;
+
+        printf("%8u %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", batchSize, items.set / done, batches.set / done,
+               items.get / done, batches.get / done, items.remove / done, batches.remove / done);
+    }
+    if (found != expected) {
+        fprintf(stderr, "%llu keys set were not found\n", (unsigned long long)(expected - found));
+        return 1;
+    }
+    return 0;
+}
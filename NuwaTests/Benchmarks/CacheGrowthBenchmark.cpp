@@ -0,0 +1,121 @@
+//
+//  CacheGrowthBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "DriverCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+static const UInt32 kBatchSize = 256;
+
+/**
+ * @brief Latencies of single operations, in nanoseconds
+ */
+class LatencyRecorder {
+
+public:
+    template <typename Operation>
+    void time(Operation operation) {
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        m_latencies.push_back(elapsed.count());
+    }
+
+    void print(const char *name) {
+        std::sort(m_latencies.begin(), m_latencies.end());
+        printf("%24s %10.0f %10.0f %10.0f %12.0f\n", name, percentile(50), percentile(99), percentile(99.9),
+               m_latencies.back());
+    }
+
+private:
+    double percentile(double percent) const {
+        size_t index = (size_t)((double)(m_latencies.size() - 1) * percent / 100);
+        return m_latencies[index];
+    }
+
+    std::vector<double> m_latencies;
+};
+
+/**
+ * @brief A locked table rehashed at once when it grows, as the stripes were before
+ */
+class RehashedCache {
+
+public:
+    bool setObject(UInt64 key, UInt64 value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_table[key] = value;
+        return true;
+    }
+
+private:
+    std::mutex m_lock;
+    std::unordered_map<UInt64, UInt64> m_table;
+};
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    printf("%llu inserts into an empty cache, latency in ns\n", (unsigned long long)operations);
+    printf("%24s %10s %10s %10s %12s\n", "", "p50", "p99", "p99.9", "max");
+    // Random keys, the identity hash of unordered_map would walk sequential ones in order.
+    std::mt19937_64 random(3);
+    std::vector<UInt64> keys(operations);
+    for (UInt64 &key : keys) {
+        key = random() | 1;
+    }
+
+    // Created small, so the stripes start with few buckets and grow with the items.
+    DriverCache<UInt64, UInt64> *cache = new DriverCache<UInt64, UInt64>(kMaxCacheStripes * kDefaultBucketCapacity * 2);
+    cache->zero = 0;
+    cache->setCapacity(operations * 2);
+    LatencyRecorder incremental;
+    for (UInt64 key : keys) {
+        incremental.time([cache, key] {
+            cache->setObject(key, key);
+        });
+    }
+    incremental.print("incremental resize");
+    UInt64 count = cache->getCount();
+    delete cache;
+
+    RehashedCache *rehashed = new RehashedCache();
+    LatencyRecorder whole;
+    for (UInt64 key : keys) {
+        whole.time([rehashed, key] {
+            rehashed->setObject(key, key);
+        });
+    }
+    whole.print("rehash at once");
+    delete rehashed;
+
+    // Batches size the table in one step and migrate it with their own writes.
+    cache = new DriverCache<UInt64, UInt64>(kMaxCacheStripes * kDefaultBucketCapacity * 2);
+    cache->zero = 0;
+    cache->setCapacity(operations * 2);
+    LatencyRecorder batches;
+    for (UInt64 base = 0; base + kBatchSize <= operations; base += kBatchSize) {
+        const UInt64 *batch = keys.data() + base;
+        batches.time([cache, batch] {
+            cache->setObjects(batch, kBatchSize, 1);
+        });
+    }
+    batches.print("batches of 256");
+    delete cache;
+
+    if (count != operations) {
+        fprintf(stderr, "the cache holds %llu items of %llu\n", (unsigned long long)count,
+                (unsigned long long)operations);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+//
+//  CacheReplayBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "FlatCache.hpp"
+#include "KextCommon.hpp"
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+// Processes seen over and over, the rest of the trace are one-shot ones such as short lived tools.
+static const UInt32 kRecurringKeys = 4096;
+static const UInt32 kOneShotPercent = 20;
+static const double kZipfSkew = 0.9;
+
+/**
+ * @brief A full table is wiped before the next insert, as the caches did before CLOCK
+ */
+class ClearOnFullCache {
+
+public:
+    UInt64 zero;
+
+    explicit ClearOnFullCache(UInt64 capacity) : m_capacity(capacity), m_hits(0), m_misses(0), m_evictions(0) {}
+
+    UInt64 getObject(UInt64 key) {
+        auto found = m_table.find(key);
+        if (found == m_table.end()) {
+            m_misses++;
+            return 0;
+        }
+        m_hits++;
+        return found->second;
+    }
+
+    bool setObject(UInt64 key, UInt64 value) {
+        if (m_table.size() >= m_capacity) {
+            m_evictions += m_table.size();
+            m_table.clear();
+        }
+        m_table[key] = value;
+        return true;
+    }
+
+    void getStatistics(CacheStatistics *stats) const {
+        bzero(stats, sizeof(CacheStatistics));
+        stats->hits = m_hits;
+        stats->misses = m_misses;
+        stats->evictions = m_evictions;
+    }
+
+private:
+    UInt64 m_capacity;
+    UInt64 m_hits;
+    UInt64 m_misses;
+    UInt64 m_evictions;
+    std::unordered_map<UInt64, UInt64> m_table;
+};
+
+// Called when read a trace with one key per line, as dumped from the kext, decimal or 0x hex.
+static bool readTrace(const char *path, std::vector<UInt64> *trace) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[64];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        UInt64 key = strtoull(line, nullptr, 0);
+        if (key != 0) {
+            trace->push_back(key);
+        }
+    }
+    fclose(file);
+    return !trace->empty();
+}
+
+// Called when build a trace shaped as exec and port bind keys are, a skewed recurring set and one-shot keys.
+static void makeTrace(UInt64 length, std::vector<UInt64> *trace) {
+    std::mt19937_64 random(11);
+    std::vector<double> weights(kRecurringKeys);
+    for (UInt32 i = 0; i < kRecurringKeys; ++i) {
+        weights[i] = 1.0 / pow((double)(i + 1), kZipfSkew);
+    }
+    std::discrete_distribution<UInt32> recurring(weights.begin(), weights.end());
+    UInt64 oneShot = 1ULL << 40;
+
+    for (UInt64 n = 0; n < length; ++n) {
+        if (random() % 100 < kOneShotPercent) {
+            trace->push_back(oneShot++);
+        } else {
+            // Spread as vnode ids are, the rank of a key says nothing of its bits.
+            trace->push_back((recurring(random) + 1) * 11400714819323198549ULL | 1);
+        }
+    }
+}
+
+// Each key is looked up and set on a miss, as the auth caches are used.
+template <typename CacheType>
+static void replay(const char *name, CacheType *cache, const std::vector<UInt64> &trace) {
+    cache->zero = 0;
+    for (UInt64 key : trace) {
+        if (cache->getObject(key) == 0) {
+            cache->setObject(key, key);
+        }
+    }
+    CacheStatistics stats;
+    cache->getStatistics(&stats);
+    printf("%20s %9.1f%% %12llu %12llu\n", name, (double)stats.hits * 100 / (double)trace.size(),
+           (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 length = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<UInt64> trace;
+    if (argc > 2) {
+        if (!readTrace(argv[2], &trace)) {
+            fprintf(stderr, "no keys read from %s\n", argv[2]);
+            return 1;
+        }
+        printf("%zu keys replayed from %s", trace.size(), argv[2]);
+    } else {
+        makeTrace(length, &trace);
+        printf("%zu keys, %u%% one-shot, the others over %u recurring with skew %.1f", trace.size(), kOneShotPercent,
+               kRecurringKeys, kZipfSkew);
+    }
+    printf(", caches of %u items\n", kMaxCacheItems);
+    printf("%20s %10s %12s %12s\n", "", "hit rate", "misses", "evictions");
+
+    ClearOnFullCache *cleared = new ClearOnFullCache(kMaxCacheItems);
+    replay("clear on full", cleared, trace);
+    delete cleared;
+
+    DriverCache<UInt64, UInt64> *chained = new DriverCache<UInt64, UInt64>(kMaxCacheItems);
+    replay("CLOCK, chained", chained, trace);
+    delete chained;
+
+    FlatCache<UInt64, UInt64> *flat = new FlatCache<UInt64, UInt64>(kMaxCacheItems);
+    replay("CLOCK, flat", flat, trace);
+    delete flat;
+    return 0;
+}
@@ -0,0 +1,99 @@
+//
+//  DriverCacheBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "DriverCache.hpp"
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static const UInt64 kBenchmarkKeys = 4096;
+// 1 in N operations is an insert, the rest are lookups, as the socket callbacks do.
+static const UInt32 kInsertRate = 10;
+
+/**
+ * @brief The cache behind one lock, as it was before the stripes
+ */
+class SingleLockCache {
+
+public:
+    SingleLockCache() : m_cache(kBenchmarkKeys) {
+        m_cache.zero = 0;
+    }
+
+    UInt64 getObject(UInt64 key) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_cache.getObject(key);
+    }
+
+    bool setObject(UInt64 key, UInt64 value) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_cache.setObject(key, value);
+    }
+
+private:
+    std::mutex m_lock;
+    DriverCache<UInt64, UInt64> m_cache;
+};
+
+template <typename CacheType>
+static double runThreads(CacheType *cache, UInt32 threadCount, UInt64 operations, UInt64 *hits) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back([cache, operations, hits, i] {
+            std::mt19937_64 random(i + 1);
+            UInt64 found = 0;
+            for (UInt64 n = 0; n < operations; ++n) {
+                UInt64 key = random() % kBenchmarkKeys + 1;
+                if (n % kInsertRate == 0) {
+                    cache->setObject(key, key);
+                } else if (cache->getObject(key) == key) {
+                    found++;
+                }
+            }
+            __atomic_fetch_add(hits, found, __ATOMIC_RELAXED);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)(operations * threadCount);
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    printf("%llu operations per thread over %llu keys, 1 in %u inserts, %u hardware threads\n",
+           (unsigned long long)operations, (unsigned long long)kBenchmarkKeys, kInsertRate,
+           std::thread::hardware_concurrency());
+    printf("%8s %16s %16s %16s\n", "threads", "one lock ns/op", "striped ns/op", "read-mostly ns/op");
+
+    for (UInt32 threadCount = 1; threadCount <= 16; threadCount <<= 1) {
+        UInt64 hits = 0;
+        SingleLockCache single;
+        double singleCost = runThreads(&single, threadCount, operations, &hits);
+
+        DriverCache<UInt64, UInt64> striped(kBenchmarkKeys);
+        striped.zero = 0;
+        double stripedCost = runThreads(&striped, threadCount, operations, &hits);
+
+        DriverCache<UInt64, UInt64> readMostly(kBenchmarkKeys, true);
+        readMostly.zero = 0;
+        double readMostlyCost = runThreads(&readMostly, threadCount, operations, &hits);
+
+        printf("%8u %16.1f %16.1f %16.1f\n", threadCount, singleCost, stripedCost, readMostlyCost);
+        if (hits == 0) {
+            fprintf(stderr, "no lookup found its key\n");
+            return 1;
+        }
+    }
+    return 0;
+}
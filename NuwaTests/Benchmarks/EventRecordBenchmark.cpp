@@ -0,0 +1,101 @@
+//
+//  EventRecordBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventRecord.hpp"
+#include "EventRing.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+template <typename Operation>
+static double timeOperations(UInt64 operations, Operation operation) {
+    auto start = std::chrono::steady_clock::now();
+    for (UInt64 i = 0; i < operations; ++i) {
+        operation();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)operations;
+}
+
+static NuwaKextEvent *makeEvent(NuwaKextAction type, const char *path) {
+    NuwaKextEvent *event = new NuwaKextEvent();
+    event->eventType = type;
+    event->vnodeID = 0x500000001234ULL;
+    event->mainProcess.pid = 4242;
+    switch (type) {
+        case kActionNotifyNetworkAccess:
+            event->netAccess.protocol = IPPROTO_TCP;
+            event->netAccess.localAddr.sa_family = AF_INET;
+            event->netAccess.remoteAddr.sa_family = AF_INET;
+            break;
+        case kActionNotifyDnsQuery:
+            snprintf(event->dnsQuery.domainName, sizeof(event->dnsQuery.domainName), "%s", "updates.example.com");
+            snprintf(event->dnsQuery.queryResult, sizeof(event->dnsQuery.queryResult), "%s", path);
+            break;
+        case kActionNotifyFileRename:
+            snprintf(event->fileRename.srcFile.path, sizeof(event->fileRename.srcFile.path), "%s", path);
+            snprintf(event->fileRename.newPath, sizeof(event->fileRename.newPath), "%s.1", path);
+            break;
+        default:
+            snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "%s", path);
+            break;
+    }
+    return event;
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    const char *path = "/Users/me/Library/Application Support/App/Cache/data.db";
+    struct {
+        const char *name;
+        NuwaKextAction type;
+    } kinds[] = {
+        { "file open", kActionNotifyFileOpen },
+        { "file rename", kActionNotifyFileRename },
+        { "net access", kActionNotifyNetworkAccess },
+        { "dns query", kActionNotifyDnsQuery },
+    };
+
+    // Fixed events took a whole NuwaKextEvent in the queue, whatever they carried.
+    UInt32 structEntry = DATA_QUEUE_ENTRY_HEADER_SIZE + EventRing::alignEntrySize(sizeof(NuwaKextEvent));
+    printf("%llu encodes and decodes per event, %zu-byte path\n", (unsigned long long)operations, strlen(path));
+    printf("%12s %10s %10s %10s %10s %12s %12s\n", "event", "copy ns", "encode ns", "decode ns", "bytes",
+           "struct /MB", "record /MB");
+
+    std::vector<UInt8> record(kMaxEventRecordSize);
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    NuwaKextEvent *copied = new NuwaKextEvent();
+    for (auto &kind : kinds) {
+        NuwaKextEvent *event = makeEvent(kind.type, path);
+        UInt32 size = 0;
+        UInt64 checksum = 0;
+        double copyCost = timeOperations(operations, [&]() {
+            memcpy(copied, event, sizeof(NuwaKextEvent));
+            checksum += copied->mainProcess.pid;
+        });
+        double encodeCost = timeOperations(operations, [&]() {
+            size = encodeEventRecord(event, record.data(), (UInt32)record.size());
+            checksum += size;
+        });
+        double decodeCost = timeOperations(operations, [&]() {
+            checksum += decodeEventRecord(record.data(), size, decoded);
+        });
+        UInt32 recordEntry = DATA_QUEUE_ENTRY_HEADER_SIZE + EventRing::alignEntrySize(size);
+        printf("%12s %10.1f %10.1f %10.1f %10u %12u %12u\n", kind.name, copyCost, encodeCost, decodeCost, size,
+               (1 << 20) / structEntry, (1 << 20) / recordEntry);
+        delete event;
+
+        if (size == 0 || checksum == 0) {
+            fprintf(stderr, "%s could not be encoded\n", kind.name);
+            return 1;
+        }
+    }
+    delete decoded;
+    delete copied;
+    return 0;
+}
@@ -0,0 +1,97 @@
+//
+//  FlatCacheBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "FlatCache.hpp"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * @brief Cost of filling a cache and looking it up, and what it holds once full
+ */
+typedef struct {
+    double insertNs;
+    double hitNs;
+    double missNs;
+    double bytesPerEntry;
+    // Stripes fill unevenly, some entries are evicted before the cache holds as many as its capacity.
+    double hitRate;
+} CacheCost;
+
+template <typename Operation>
+static double timeEach(UInt64 count, Operation operation) {
+    auto start = std::chrono::steady_clock::now();
+    for (UInt64 i = 0; i < count; ++i) {
+        operation(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)count;
+}
+
+// Lookups walk the keys in a random order, so the cache lines of the table are not reused in order.
+template <typename CacheType>
+static CacheCost measure(const std::vector<UInt64> &keys, const std::vector<UInt64> &misses, const std::vector<UInt32> &order,
+                         UInt64 *wrong) {
+    CacheCost cost;
+    UInt64 hits = 0;
+    UInt64 before = getAlignedBytes();
+    CacheType *cache = new CacheType(keys.size());
+    cache->zero = 0;
+
+    cost.insertNs = timeEach(keys.size(), [cache, &keys](UInt64 i) {
+        cache->setObject(keys[i], i + 1);
+    });
+    cost.bytesPerEntry = (double)(getAlignedBytes() - before) / (double)cache->getCount();
+    cost.hitNs = timeEach(order.size(), [cache, &keys, &order, &hits, wrong](UInt64 i) {
+        UInt64 value = cache->getObject(keys[order[i]]);
+        hits += value != 0;
+        *wrong += value != 0 && value != (UInt64)order[i] + 1;
+    });
+    cost.missNs = timeEach(order.size(), [cache, &misses, &order, wrong](UInt64 i) {
+        *wrong += cache->getObject(misses[order[i]]) != 0;
+    });
+    cost.hitRate = (double)hits * 100 / (double)order.size();
+    delete cache;
+    return cost;
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    printf("%llu lookups per size, latency in ns, memory in bytes per entry\n", (unsigned long long)operations);
+    printf("%10s %8s %10s %10s %10s %10s %10s\n", "entries", "layout", "insert", "hit", "miss", "memory", "hit rate");
+
+    std::mt19937_64 random(7);
+    UInt64 wrong = 0;
+    for (UInt64 entries : { 1ULL << 10, 1ULL << 16, 1ULL << 20 }) {
+        // Odd keys are stored and even ones missed, both random as vnode and socket ids look.
+        std::vector<UInt64> keys(entries);
+        std::vector<UInt64> misses(entries);
+        for (UInt64 i = 0; i < entries; ++i) {
+            keys[i] = random() | 1;
+            misses[i] = random() & ~1ULL;
+        }
+        std::vector<UInt32> order(operations);
+        for (UInt32 &index : order) {
+            index = (UInt32)(random() % entries);
+        }
+
+        CacheCost chained = measure<DriverCache<UInt64, UInt64>>(keys, misses, order, &wrong);
+        CacheCost flat = measure<FlatCache<UInt64, UInt64>>(keys, misses, order, &wrong);
+        printf("%10llu %8s %10.1f %10.1f %10.1f %10.1f %9.1f%%\n", (unsigned long long)entries, "chained",
+               chained.insertNs, chained.hitNs, chained.missNs, chained.bytesPerEntry, chained.hitRate);
+        printf("%10llu %8s %10.1f %10.1f %10.1f %10.1f %9.1f%%\n", (unsigned long long)entries, "flat",
+               flat.insertNs, flat.hitNs, flat.missNs, flat.bytesPerEntry, flat.hitRate);
+    }
+    // A key missed or evicted reads as zero, never as the value of another one.
+    if (wrong != 0) {
+        fprintf(stderr, "%llu lookups found a wrong entry\n", (unsigned long long)wrong);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+//
+//  NotifyRingBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "TestQueue.hpp"
+#include <chrono>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Producers write file events through the rings, the client merges them, every event is checked for order.
+static double runThreads(UInt32 ringCount, UInt32 threadCount, UInt64 operations, UInt64 *disorders) {
+    TestRings rings(ringCount, kMaxNotifyQueueEvents / ringCount * sizeof(NuwaKextEvent));
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&rings, operations, i] {
+            NuwaKextEvent *event = new NuwaKextEvent();
+            event->eventType = kActionNotifyFileOpen;
+            event->mainProcess.pid = (SInt32)i;
+            snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "/Users/me/Library/Caches/%u/data.db", i);
+            // Threads stay on a ring, as they would on their CPU in the kext, their order is checked without falling over.
+            EventRing *ring = rings.getRing(i);
+            for (UInt64 n = 0; n < operations; ++n) {
+                event->vnodeID = n;
+                EventRing::Reservation reservation;
+                void *record = nullptr;
+                while ((record = ring->reserve(kMaxEventRecordSize, &reservation)) == nullptr) {
+                    sched_yield();
+                }
+                commitRecord(ring, &reservation, record, encodeEventRecord(event, record, reservation.size));
+            }
+            delete event;
+        });
+    }
+
+    std::vector<UInt64> nextEvents(threadCount, 0);
+    std::vector<UInt8> data;
+    UInt64 received = 0;
+    while (received < threadCount * operations) {
+        if (rings.dequeueOldest(&data) < 0) {
+            sched_yield();
+            continue;
+        }
+        NuwaKextRecordHeader header;
+        if (!readRecordHeader(data.data(), (UInt32)data.size(), &header) || (UInt32)header.mainProcess.pid >= threadCount ||
+            header.vnodeID != nextEvents[header.mainProcess.pid]) {
+            (*disorders)++;
+        } else {
+            nextEvents[header.mainProcess.pid]++;
+        }
+        received++;
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)received;
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    printf("%llu events per thread, %u hardware threads\n", (unsigned long long)operations,
+           std::thread::hardware_concurrency());
+    char spreadTitle[32];
+    snprintf(spreadTitle, sizeof(spreadTitle), "%u rings ns", kNotifyRingCount);
+    printf("%8s %14s %14s\n", "threads", "1 ring ns", spreadTitle);
+
+    UInt64 disorders = 0;
+    for (UInt32 threadCount : { 1u, 2u, 4u, 8u, 16u, 32u, 64u }) {
+        double single = runThreads(1, threadCount, operations, &disorders);
+        double spread = runThreads(kNotifyRingCount, threadCount, operations, &disorders);
+        printf("%8u %14.1f %14.1f\n", threadCount, single, spread);
+    }
+    if (disorders != 0) {
+        fprintf(stderr, "%llu events lost or out of order\n", (unsigned long long)disorders);
+        return 1;
+    }
+    return 0;
+}
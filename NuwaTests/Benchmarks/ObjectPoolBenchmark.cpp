@@ -0,0 +1,88 @@
+//
+//  ObjectPoolBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "ObjectPool.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Objects each thread holds at once, about what a burst of cache inserts keeps before they are freed.
+static const UInt32 kHeldObjects = 64;
+
+typedef struct {
+    UInt64 key;
+    UInt64 value;
+    void *next;
+    UInt64 expiry;
+} TestNode;
+
+// Every thread allocates a batch and frees it again, the cost is that of one alloc and one free.
+template <typename AllocatorType>
+static double runThreads(AllocatorType *allocator, UInt32 threadCount, UInt64 operations, UInt64 *failures) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (UInt32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back([allocator, operations, failures] {
+            TestNode *held[kHeldObjects];
+            UInt64 failed = 0;
+            for (UInt64 n = 0; n < operations; n += kHeldObjects) {
+                for (UInt32 k = 0; k < kHeldObjects; ++k) {
+                    held[k] = allocator->allocObject();
+                    if (held[k] == nullptr) {
+                        failed++;
+                        continue;
+                    }
+                    held[k]->key = n + k;
+                }
+                for (UInt32 k = 0; k < kHeldObjects; ++k) {
+                    if (held[k] != nullptr) {
+                        allocator->freeObject(held[k]);
+                    }
+                }
+            }
+            __atomic_fetch_add(failures, failed, __ATOMIC_RELAXED);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    UInt64 rounded = (operations + kHeldObjects - 1) / kHeldObjects * kHeldObjects;
+    return elapsed.count() / (double)(rounded * threadCount);
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    UInt32 maxThreads = std::thread::hardware_concurrency() * 2;
+    if (maxThreads < 16) {
+        maxThreads = 16;
+    }
+    printf("%llu alloc and free pairs per thread, %u held at once, %u hardware threads\n", (unsigned long long)operations,
+           kHeldObjects, std::thread::hardware_concurrency());
+    printf("%8s %14s %14s %16s %16s\n", "threads", "pool ns", "malloc ns", "pool Mops/s", "malloc Mops/s");
+
+    UInt64 failures = 0;
+    for (UInt32 threadCount = 1; threadCount <= maxThreads; threadCount <<= 1) {
+        PoolAllocator<TestNode> *pool = new PoolAllocator<TestNode>();
+        double pooled = runThreads(pool, threadCount, operations, &failures);
+        delete pool;
+
+        MallocAllocator<TestNode> *heap = new MallocAllocator<TestNode>();
+        double malloced = runThreads(heap, threadCount, operations, &failures);
+        delete heap;
+
+        // Wall time per pair of all threads together, its inverse is their throughput.
+        printf("%8u %14.1f %14.1f %16.1f %16.1f\n", threadCount, pooled, malloced, 1000 / pooled, 1000 / malloced);
+    }
+    if (failures != 0) {
+        fprintf(stderr, "%llu allocations failed\n", (unsigned long long)failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+//  PathTrieBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "PathTrie.hpp"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static const char *kRoots[] = {
+    "/Users/developer/Projects", "/Users/developer/Library/Caches", "/private/var/folders/zz/T",
+    "/Applications/Xcode.app/Contents/Developer", "/usr/local/Cellar",
+};
+static const char *kComponents[] = {
+    "build", "intermediates", "node_modules", "DerivedData", "Objects-normal", "arm64", "com.apple.Safari",
+    "fsCachedData", "src", "include", "Release", "x86_64", "sources", "generated", "Index.noindex",
+};
+
+static std::string makeDirectory(std::mt19937 &random, UInt32 depth) {
+    std::string path = kRoots[random() % (sizeof(kRoots) / sizeof(kRoots[0]))];
+    for (UInt32 i = 0; i < depth; ++i) {
+        path += "/";
+        path += kComponents[random() % (sizeof(kComponents) / sizeof(kComponents[0]))];
+        path += std::to_string(random() % 50);
+    }
+    return path;
+}
+
+template <typename Match>
+static double timeMatches(const std::vector<std::string> &paths, UInt64 operations, UInt64 *matched, Match match) {
+    auto start = std::chrono::steady_clock::now();
+    for (UInt64 i = 0; i < operations; ++i) {
+        *matched += match(paths[i % paths.size()].c_str());
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)operations;
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    std::mt19937 random(19);
+    printf("%llu file paths per list, 1 in 5 below a muted directory\n", (unsigned long long)operations);
+    printf("%8s %12s %12s %12s %12s %12s %14s\n", "prefixes", "path bytes", "trie ns", "scan ns",
+           "trie match %", "scan match %", "trie B/prefix");
+
+    for (UInt32 count : { 10u, 100u, 1000u, 10000u }) {
+        std::vector<std::string> prefixes;
+        std::string packed;
+        for (UInt32 i = 0; i < count; ++i) {
+            prefixes.push_back(makeDirectory(random, random() % 3 + 2));
+            packed += prefixes.back();
+            packed += '\0';
+        }
+
+        UInt64 baseBytes = getAlignedBytes();
+        PathTrie trie(count, (UInt32)packed.size());
+        trie.addPaths(packed.data(), (UInt32)packed.size());
+        trie.finish();
+        UInt64 trieBytes = getAlignedBytes() - baseBytes;
+
+        std::vector<std::string> paths;
+        UInt64 pathBytes = 0;
+        for (UInt32 i = 0; i < 1 << 14; ++i) {
+            std::string directory = i % 5 == 0 ? prefixes[random() % count] : makeDirectory(random, random() % 3 + 2);
+            paths.push_back(directory + "/" + makeDirectory(random, 2).substr(1) + "/file" + std::to_string(i) + ".o");
+            pathBytes += paths.back().size();
+        }
+
+        UInt64 trieMatched = 0;
+        double trieCost = timeMatches(paths, operations, &trieMatched, [&trie](const char *path) {
+            return trie.matchPath(path);
+        });
+        // The scan of every prefix is what a list without the trie does, too slow to run in full on big lists.
+        UInt64 scanOperations = operations / (count / 10);
+        UInt64 scanMatched = 0;
+        double scanCost = timeMatches(paths, scanOperations, &scanMatched, [&prefixes](const char *path) {
+            for (const std::string &prefix : prefixes) {
+                if (strncmp(path, prefix.c_str(), prefix.size()) == 0 && path[prefix.size()] == '/') {
+                    return true;
+                }
+            }
+            return false;
+        });
+        printf("%8u %12.1f %12.1f %12.1f %12.1f %12.1f %14.1f\n", count, (double)pathBytes / paths.size(), trieCost,
+               scanCost, 100.0 * trieMatched / operations, 100.0 * scanMatched / scanOperations,
+               (double)trieBytes / count);
+
+        if (trieMatched < operations / 5) {
+            fprintf(stderr, "the trie matched %llu paths of %llu\n",
+                    (unsigned long long)trieMatched, (unsigned long long)operations);
+            return 1;
+        }
+    }
+    return 0;
+}
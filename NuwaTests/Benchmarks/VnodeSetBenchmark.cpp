@@ -0,0 +1,88 @@
+//
+//  VnodeSetBenchmark.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "DriverCache.hpp"
+#include "VnodeSet.hpp"
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+template <typename Lookup>
+static double timeLookups(const std::vector<UInt64> &keys, UInt64 operations, UInt64 *found, Lookup lookup) {
+    auto start = std::chrono::steady_clock::now();
+    for (UInt64 i = 0; i < operations; ++i) {
+        *found += lookup(keys[i % keys.size()]) != 0;
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)operations;
+}
+
+int main(int argc, char *argv[]) {
+    UInt64 operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    std::mt19937_64 random(11);
+    printf("%llu lookups per list, 1 in 10 finds its key\n", (unsigned long long)operations);
+    printf("%8s %14s %14s %14s %14s %14s %14s\n", "items", "cache ns", "set ns", "miss ns",
+           "cache B/item", "set B/item", "filter fp %");
+
+    for (UInt32 count : { 100u, 1000u, 10000u, 100000u }) {
+        std::vector<UInt64> members;
+        for (UInt32 i = 0; i < count; ++i) {
+            members.push_back(((random() % 8 + 1) << 32) | (random() & 0xFFFFFFFF));
+        }
+        std::vector<UInt64> probes;
+        for (UInt32 i = 0; i < 1 << 16; ++i) {
+            probes.push_back(i % 10 == 0 ? members[random() % count] : random() | 1);
+        }
+
+        // The lists as they were, one locked cache per type, with room for all the items.
+        UInt64 baseBytes = getAlignedBytes();
+        DriverCache<UInt64, UInt8> *cache = new DriverCache<UInt64, UInt8>(count * 2);
+        cache->zero = 0;
+        for (UInt64 key : members) {
+            cache->setObject(key, 1);
+        }
+        UInt64 cacheBytes = getAlignedBytes() - baseBytes;
+
+        VnodeSet *set = new VnodeSet(count);
+        set->addItems(members.data(), count, 1);
+        set->finish();
+        UInt64 setBytes = getAlignedBytes() - baseBytes - cacheBytes;
+
+        UInt64 cacheFound = 0;
+        UInt64 setFound = 0;
+        double cacheCost = timeLookups(probes, operations, &cacheFound, [cache](UInt64 key) {
+            return cache->getObject(key);
+        });
+        double setCost = timeLookups(probes, operations, &setFound, [set](UInt64 key) {
+            return set->getValue(key);
+        });
+        // Lookups of the file-open path, nearly all of them miss.
+        std::vector<UInt64> misses;
+        UInt64 passed = 0;
+        for (UInt32 i = 0; i < 1 << 16; ++i) {
+            misses.push_back(random() | 1);
+            passed += set->mayContain(misses.back());
+        }
+        UInt64 missFound = 0;
+        double missCost = timeLookups(misses, operations, &missFound, [set](UInt64 key) {
+            return set->getValue(key);
+        });
+        printf("%8u %14.1f %14.1f %14.1f %14.1f %14.1f %14.2f\n", count, cacheCost, setCost, missCost,
+               (double)cacheBytes / count, (double)setBytes / count, 100.0 * passed / misses.size());
+        delete cache;
+        delete set;
+
+        if (cacheFound != setFound) {
+            fprintf(stderr, "the set found %llu keys, the cache %llu\n",
+                    (unsigned long long)setFound, (unsigned long long)cacheFound);
+            return 1;
+        }
+    }
+    return 0;
+}
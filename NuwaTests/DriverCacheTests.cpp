@@ -0,0 +1,374 @@
+//
+//  DriverCacheTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "DriverCache.hpp"
+#include "KextCommon.hpp"
+#include "TestHarness.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const UInt32 kTestThreads = 4;
+static const UInt64 kKeysPerThread = 1000;
+
+static void testSetAndGet() {
+    DriverCache<UInt64, UInt64> cache(1024);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 500; ++key) {
+        EXPECT(cache.setObject(key, key * 2))
+    }
+    EXPECT(cache.getCount() == 500)
+    for (UInt64 key = 1; key <= 500; ++key) {
+        EXPECT(cache.getObject(key) == key * 2)
+    }
+    EXPECT(cache.getObject(501) == 0)
+
+    // Setting zero removes the key.
+    for (UInt64 key = 1; key <= 100; ++key) {
+        cache.setObject(key, 0);
+    }
+    EXPECT(cache.getCount() == 400)
+    EXPECT(cache.getObject(50) == 0)
+    EXPECT(cache.getObject(150) == 300)
+
+    cache.clearObjects();
+    EXPECT(cache.getCount() == 0)
+}
+
+static void testCapacityEvicts() {
+    DriverCache<UInt64, UInt64> cache(64);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 1000; ++key) {
+        cache.setObject(key, key);
+    }
+    // Each stripe holds its share of the capacity, rounded up.
+    EXPECT(cache.getCount() <= 64 + kMaxCacheStripes)
+    EXPECT(cache.getObject(1000) == 1000)
+}
+
+// Threads on disjoint keys go through different stripes, none of their items may be lost.
+static void testConcurrentStripes() {
+    DriverCache<UInt64, UInt64> cache(kTestThreads * kKeysPerThread * 2);
+    cache.zero = 0;
+    std::vector<std::thread> threads;
+    UInt32 mismatches = 0;
+
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        threads.emplace_back([&cache, &mismatches, i] {
+            UInt64 base = (i + 1) * 1000000;
+            for (UInt32 round = 0; round < 20; ++round) {
+                for (UInt64 key = base; key < base + kKeysPerThread; ++key) {
+                    cache.setObject(key, key + round);
+                }
+                for (UInt64 key = base; key < base + kKeysPerThread; ++key) {
+                    if (cache.getObject(key) != key + round) {
+                        __atomic_fetch_add(&mismatches, 1, __ATOMIC_RELAXED);
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT(mismatches == 0)
+    EXPECT(cache.getCount() == kTestThreads * kKeysPerThread)
+}
+
+// Entries unlinked under steady lockless reads are freed once the readers move on.
+static void testReadMostlyRetires() {
+    DriverCache<UInt64, UInt64> cache(1 << 16, true);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 1000; ++key) {
+        cache.setObject(key, key);
+    }
+
+    bool isStopped = false;
+    UInt32 mismatches = 0;
+    std::vector<std::thread> readers;
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        readers.emplace_back([&cache, &isStopped, &mismatches, i] {
+            UInt64 key = i;
+            while (!__atomic_load_n(&isStopped, __ATOMIC_RELAXED)) {
+                key = key % 1000 + 1;
+                if (cache.getObject(key) != key) {
+                    __atomic_fetch_add(&mismatches, 1, __ATOMIC_RELAXED);
+                }
+            }
+        });
+    }
+
+    UInt64 firstRound = 0;
+    UInt64 maxBytes = 0;
+    for (UInt32 round = 0; round < 20; ++round) {
+        for (UInt64 key = 10000; key < 30000; ++key) {
+            cache.setObject(key, key);
+        }
+        for (UInt64 key = 10000; key < 30000; ++key) {
+            cache.setObject(key, 0);
+        }
+        UInt64 bytes = getAlignedBytes();
+        if (round == 0) {
+            firstRound = bytes;
+        }
+        maxBytes = bytes > maxBytes ? bytes : maxBytes;
+    }
+    __atomic_store_n(&isStopped, true, __ATOMIC_RELAXED);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT(mismatches == 0)
+    // Retired entries kept for readers long gone would grow the memory by every round.
+    EXPECT(maxBytes <= firstRound * 2)
+}
+
+// Writers update, remove, evict and resize under lockless readers, run it under ThreadSanitizer too.
+static void testReadMostlyStress() {
+    DriverCache<UInt64, UInt64> cache(512, true);
+    cache.zero = 0;
+    bool isStopped = false;
+    UInt32 mismatches = 0;
+    UInt64 lookups = 0;
+
+    std::vector<std::thread> readers;
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        readers.emplace_back([&cache, &isStopped, &mismatches, &lookups, i] {
+            UInt64 key = i * 7;
+            UInt64 count = 0;
+            while (!__atomic_load_n(&isStopped, __ATOMIC_RELAXED)) {
+                key = (key * 31 + 17) % 2000 + 1;
+                // Values carry their key, a torn or stale entry shows up as another key.
+                UInt64 value = cache.getObject(key);
+                if (value != 0 && (value >> 20) != key) {
+                    __atomic_fetch_add(&mismatches, 1, __ATOMIC_RELAXED);
+                }
+                count++;
+            }
+            __atomic_fetch_add(&lookups, count, __ATOMIC_RELAXED);
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (UInt32 i = 0; i < 2; ++i) {
+        writers.emplace_back([&cache, i] {
+            for (UInt64 round = 1; round < 40; ++round) {
+                for (UInt64 key = i + 1; key <= 2000; key += 2) {
+                    cache.setObject(key, (key << 20) | round);
+                }
+                // Shrinks the tables again, so the migrations run both ways.
+                for (UInt64 key = i + 1; key <= 2000; key += 2 + round % 3) {
+                    cache.setObject(key, 0);
+                }
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    __atomic_store_n(&isStopped, true, __ATOMIC_RELAXED);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT(mismatches == 0)
+    EXPECT(cache.getCount() <= 512 + kMaxCacheStripes)
+    // Lockless lookups are counted in the slots of their CPU.
+    CacheStatistics stats;
+    cache.getStatistics(&stats);
+    EXPECT(stats.hits + stats.misses == lookups)
+    EXPECT(stats.evictions > 0)
+}
+
+static void testStatistics() {
+    DriverCache<UInt64, UInt64> cache(64);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 10; ++key) {
+        cache.setObject(key, key);
+    }
+    for (UInt64 key = 1; key <= 15; ++key) {
+        cache.getObject(key);
+    }
+    CacheStatistics stats;
+    cache.getStatistics(&stats);
+    EXPECT(stats.hits == 10)
+    EXPECT(stats.misses == 5)
+    EXPECT(stats.evictions == 0)
+
+    // Every item set beyond the capacity of its stripe evicts one.
+    for (UInt64 key = 11; key <= 110; ++key) {
+        cache.setObject(key, key);
+    }
+    cache.getStatistics(&stats);
+    EXPECT(stats.evictions >= 110 - 64)
+    EXPECT(stats.evictions + cache.getCount() == 110)
+
+    DriverCache<UInt64, UInt64> expiring(64);
+    expiring.zero = 0;
+    expiring.setLifetime(1);
+    for (UInt64 key = 1; key <= 10; ++key) {
+        expiring.setObject(key, key);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    for (UInt64 key = 1; key <= 10; ++key) {
+        EXPECT(expiring.getObject(key) == 0)
+    }
+    expiring.getStatistics(&stats);
+    EXPECT(stats.expirations == 10)
+    EXPECT(stats.misses == 10)
+    EXPECT(expiring.getCount() == 0)
+}
+
+// Entries of a port bind cache outlive neither their lifetime on lookup nor, unlooked, the sweeping by later writes.
+static void testLifetime() {
+    DriverCache<UInt16, UInt64> cache(kMaxCacheItems);
+    cache.zero = 0;
+    cache.setLifetime(100);
+    for (UInt16 port = 1; port <= 50; ++port) {
+        cache.setObject(port, (UInt64)port << 32 | 1);
+    }
+    EXPECT(cache.getObject(7) == (7ULL << 32 | 1))
+    // Set before the lifetime is lifted, the others keep theirs.
+    cache.setLifetime(0);
+    cache.setObject(60, 60);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    UInt16 written = 0;
+    CacheStatistics stats;
+    do {
+        cache.setObject(1000 + written, 1);
+        written++;
+        cache.getStatistics(&stats);
+    } while (stats.expirations < 50 && written < 2000);
+    EXPECT(stats.expirations == 50)
+    EXPECT(cache.getCount() == (UInt64)written + 1)
+    EXPECT(cache.getObject(60) == 60 && cache.getObject(7) == 0)
+
+    // Set again before it ends, an entry starts a new lifetime.
+    cache.setLifetime(300);
+    cache.setObject(70, 70);
+    cache.setObject(80, 80);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    cache.setObject(80, 81);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT(cache.getObject(70) == 0 && cache.getObject(80) == 81)
+    cache.getStatistics(&stats);
+    EXPECT(stats.expirations == 51)
+}
+
+// A lowered capacity is reached by the next inserts, a raised one lets the cache grow.
+static void testSetCapacity() {
+    DriverCache<UInt64, UInt64> cache(2048);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 1000; ++key) {
+        cache.setObject(key, key);
+    }
+    EXPECT(cache.getCount() == 1000)
+
+    cache.setCapacity(128);
+    for (UInt64 key = 2001; key <= 2200; ++key) {
+        cache.setObject(key, key);
+    }
+    EXPECT(cache.getCount() <= 128)
+    EXPECT(cache.getObject(2200) == 2200)
+
+    cache.setCapacity(4096);
+    for (UInt64 key = 3001; key <= 4000; ++key) {
+        cache.setObject(key, key);
+    }
+    EXPECT(cache.getCount() >= 1000)
+    for (UInt64 key = 3001; key <= 4000; ++key) {
+        EXPECT(cache.getObject(key) == key)
+    }
+}
+
+// Evictions while the stripes resize take their victims from the buckets not migrated yet.
+static void testEvictWhileResizing() {
+    DriverCache<UInt64, UInt64> cache(kMaxCacheStripes * kDefaultBucketCapacity * 2);
+    cache.zero = 0;
+    cache.setCapacity(1 << 16);
+    UInt32 mismatches = 0;
+    for (UInt64 key = 1; key <= 20000; ++key) {
+        cache.setObject(key, key);
+        if (key % 5000 == 0) {
+            // Lowered in the middle of the growth, the next inserts evict down to it.
+            cache.setCapacity(key / 4);
+        }
+    }
+    EXPECT(cache.getCount() <= 5000 + kMaxCacheStripes)
+    for (UInt64 key = 19900; key <= 20000; ++key) {
+        mismatches += cache.getObject(key) != key;
+    }
+    for (UInt64 key = 1; key <= 20000; ++key) {
+        UInt64 value = cache.getObject(key);
+        mismatches += value != 0 && value != key;
+    }
+    EXPECT(mismatches == 0)
+
+    // A batch larger than the stripes sizes their tables in one step.
+    std::vector<UInt64> keys;
+    for (UInt64 key = 100001; key <= 120000; ++key) {
+        keys.push_back(key);
+    }
+    cache.setCapacity(1 << 16);
+    EXPECT(cache.setObjects(keys.data(), (UInt32)keys.size(), 1) == keys.size())
+    EXPECT(cache.getObject(120000) == 1)
+}
+
+// Batches group their keys by stripe, they must agree with setting the keys one by one.
+static void checkBatches(bool readMostly) {
+    DriverCache<UInt64, UInt64> cache(4096, readMostly);
+    cache.zero = 0;
+    std::vector<UInt64> keys;
+    std::vector<UInt64> values;
+    for (UInt64 key = 1; key <= 1200; ++key) {
+        keys.push_back(key);
+        values.push_back(key * 3);
+    }
+
+    EXPECT(cache.setObjects(keys.data(), values.data(), 1000) == 1000)
+    std::vector<UInt64> found(keys.size());
+    EXPECT(cache.getObjects(keys.data(), found.data(), (UInt32)keys.size()) == 1000)
+    for (UInt32 i = 0; i < keys.size(); ++i) {
+        EXPECT(found[i] == (keys[i] <= 1000 ? values[i] : 0))
+    }
+
+    // The last duplicate of a key in the batch wins.
+    UInt64 duplicates[] = { 5, 6, 5 };
+    UInt64 updates[] = { 1, 2, 3 };
+    cache.setObjects(duplicates, updates, 3);
+    EXPECT(cache.getObject(5) == 3)
+    EXPECT(cache.getObject(6) == 2)
+
+    EXPECT(cache.setObjects(keys.data() + 1000, 200, 7) == 200)
+    EXPECT(cache.getObject(1100) == 7)
+    EXPECT(cache.getCount() == 1200)
+
+    EXPECT(cache.removeObjects(keys.data(), 500) == 500)
+    EXPECT(cache.getCount() == 700)
+    EXPECT(cache.getObject(500) == 0)
+    EXPECT(cache.getObject(501) == 501 * 3)
+}
+
+static void testBatches() {
+    checkBatches(false);
+    checkBatches(true);
+}
+
+int main() {
+    RUN_TEST(testSetAndGet)
+    RUN_TEST(testCapacityEvicts)
+    RUN_TEST(testConcurrentStripes)
+    RUN_TEST(testReadMostlyRetires)
+    RUN_TEST(testReadMostlyStress)
+    RUN_TEST(testStatistics)
+    RUN_TEST(testLifetime)
+    RUN_TEST(testSetCapacity)
+    RUN_TEST(testEvictWhileResizing)
+    RUN_TEST(testBatches)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+//
+//  EventCountersTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventCounters.hpp"
+#include "TestHarness.hpp"
+
+static const UInt32 kSampledClass = kActionNotifyFileOpen - kActionNotifyBegin;
+static const UInt32 kLosslessClass = kActionNotifyFileDelete - kActionNotifyBegin;
+
+// Under the watermark nothing is sampled out, above it the sampled classes keep 1 in kOverloadSampleRate.
+static void testOverloadSampling() {
+    EventCounters counters;
+    for (UInt32 i = 0; i < 100; ++i) {
+        EXPECT(!counters.isSampledOut(kSampledClass, kOverloadWatermark - 1))
+    }
+
+    UInt32 kept = 0;
+    for (UInt32 i = 0; i < 10 * kOverloadSampleRate; ++i) {
+        kept += !counters.isSampledOut(kSampledClass, kOverloadWatermark);
+    }
+    EXPECT(kept == 10)
+    // Exec, rename and delete stay lossless however full the ring is.
+    for (UInt32 i = 0; i < 100; ++i) {
+        EXPECT(!counters.isSampledOut(kLosslessClass, 100))
+        EXPECT(!counters.isSampledOut(0, 100))
+    }
+}
+
+// Each way of skipping an event has its counter, the next event of the class carries them all.
+static void testDropCounters() {
+    EventCounters counters;
+    counters.countEnqueued(kSampledClass);
+    counters.countSkipped(kSampledClass, true);
+    counters.countSkipped(kSampledClass, true);
+    counters.countSkipped(kSampledClass, false);
+    counters.countThrottled(kSampledClass);
+    counters.countSkipped(kLosslessClass, true);
+
+    NuwaKextEventCounters copied[kEventClassCount + 1];
+    EXPECT(counters.obtainCounters(copied, kEventClassCount + 1) == kEventClassCount)
+    EXPECT(copied[kSampledClass].enqueued == 1 && copied[kSampledClass].dropped == 2)
+    EXPECT(copied[kSampledClass].sampled == 1 && copied[kSampledClass].throttled == 1)
+    EXPECT(copied[kLosslessClass].enqueued == 0 && copied[kLosslessClass].dropped == 1)
+    EXPECT(counters.obtainCounters(copied, 2) == 2)
+
+    EXPECT(counters.takeSkipped(kSampledClass) == 4)
+    EXPECT(counters.takeSkipped(kSampledClass) == 0)
+    // Not carried by the event taking them, they wait for the next one with those skipped meanwhile.
+    counters.countSkipped(kLosslessClass, false);
+    UInt32 skipped = counters.takeSkipped(kLosslessClass);
+    EXPECT(skipped == 2)
+    counters.countSkipped(kLosslessClass, true);
+    counters.restoreSkipped(kLosslessClass, skipped);
+    EXPECT(counters.takeSkipped(kLosslessClass) == 3)
+}
+
+// Skipped events are reported once per interval with those since the previous report.
+static void testReports() {
+    EventCounters counters;
+    UInt32 drops = 0;
+    UInt32 samples = 0;
+    counters.countSkipped(kSampledClass, true);
+    counters.countSkipped(kSampledClass, false);
+    EXPECT(counters.takeReport(&drops, &samples) && drops == 1 && samples == 1)
+
+    for (UInt32 i = 0; i < 5; ++i) {
+        counters.countSkipped(kSampledClass, i % 2 == 0);
+        EXPECT(!counters.takeReport(&drops, &samples))
+    }
+    IOSleep(kDropReportInterval + 100);
+    EXPECT(counters.takeReport(&drops, &samples) && drops == 3 && samples == 2)
+    EXPECT(!counters.takeReport(&drops, &samples))
+    // The counters read by the client are never reset by a report.
+    NuwaKextEventCounters copied[kEventClassCount];
+    counters.obtainCounters(copied, kEventClassCount);
+    EXPECT(copied[kSampledClass].dropped == 4 && copied[kSampledClass].sampled == 3)
+}
+
+int main() {
+    RUN_TEST(testOverloadSampling)
+    RUN_TEST(testDropCounters)
+    RUN_TEST(testReports)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+//
+//  EventLanesTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventLanes.hpp"
+#include "TestHarness.hpp"
+#include "TestQueue.hpp"
+#include <vector>
+
+static UInt32 getLane(const EventLanes &lanes, NuwaKextAction action) {
+    UInt32 eventClass = action == kActionAuthProcessCreate ? 0 : action - kActionNotifyBegin;
+    return lanes.getLane(action, eventClass);
+}
+
+// Exec, rename, delete and the throttle summaries go to the critical lane by default, the noisy classes to the rings.
+static void testDefaultLanes() {
+    EventLanes lanes;
+    EXPECT(getLane(lanes, kActionAuthProcessCreate) == kQueueTypeAuth)
+    EXPECT(getLane(lanes, kActionNotifyProcessCreate) == kQueueTypeCritical)
+    EXPECT(getLane(lanes, kActionNotifyFileRename) == kQueueTypeCritical)
+    EXPECT(getLane(lanes, kActionNotifyFileDelete) == kQueueTypeCritical)
+    EXPECT(getLane(lanes, kActionNotifyThrottle) == kQueueTypeCritical)
+    EXPECT(getLane(lanes, kActionNotifyFileOpen) == kQueueTypeNotify)
+    EXPECT(getLane(lanes, kActionNotifyFileCloseModify) == kQueueTypeNotify)
+    EXPECT(getLane(lanes, kActionNotifyNetworkAccess) == kQueueTypeNotify)
+    EXPECT(getLane(lanes, kActionNotifyDnsQuery) == kQueueTypeNotify)
+    EXPECT(lanes.getLane(kActionNull, kEventClassCount) == kQueueTypeNotify)
+}
+
+// The client maps the notify classes as it likes, exec auth and unknown bits are left out.
+static void testClientMapping() {
+    EventLanes lanes;
+    lanes.setCriticalClasses(kSubscribeNetworkAccess | kSubscribeAuthExec | 0x8000);
+    EXPECT(lanes.getCriticalClasses() == kSubscribeNetworkAccess)
+    EXPECT(getLane(lanes, kActionNotifyNetworkAccess) == kQueueTypeCritical)
+    EXPECT(getLane(lanes, kActionNotifyProcessCreate) == kQueueTypeNotify)
+    EXPECT(getLane(lanes, kActionAuthProcessCreate) == kQueueTypeAuth)
+
+    lanes.setCriticalClasses(0);
+    EXPECT(getLane(lanes, kActionNotifyFileDelete) == kQueueTypeNotify)
+}
+
+// Called when send an event to the queue of its lane, the bulk ones falling over as EventDispatcher does.
+static bool produceEvent(const EventLanes &lanes, EventRing *criticalRing, TestRings *rings, NuwaKextEvent *event) {
+    EventRing *ring = criticalRing;
+    if (getLane(lanes, (NuwaKextAction)event->eventType) == kQueueTypeNotify) {
+        ring = rings->getRing(rings->pickRing(0, kMaxEventRecordSize));
+    }
+    EventRing::Reservation reservation;
+    void *record = ring->reserve(kMaxEventRecordSize, &reservation);
+    if (record == nullptr) {
+        return false;
+    }
+    commitRecord(ring, &reservation, record, encodeEventRecord(event, record, reservation.size));
+    return true;
+}
+
+// A storm of file opens fills every bulk ring, processes and deletes keep flowing through the critical lane.
+static void testCriticalUnderStorm() {
+    UInt32 ringSize = kMaxNotifyQueueEvents / kNotifyRingCount * sizeof(NuwaKextEvent);
+    TestRings rings(kNotifyRingCount, ringSize);
+    TestQueue critical(kMaxCriticalQueueEvents * sizeof(NuwaKextEvent));
+    EventRing criticalRing(critical.getMemory(), kMaxCriticalQueueEvents * sizeof(NuwaKextEvent));
+    EventLanes lanes;
+    NuwaKextEvent *event = new NuwaKextEvent();
+
+    event->eventType = kActionNotifyFileOpen;
+    snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "%s", "/tmp/indexed");
+    UInt32 bulkSent = 0;
+    UInt32 bulkDropped = 0;
+    // Nobody drains the rings, the storm goes on until all are full.
+    while (bulkDropped == 0 && bulkSent < 1024 * kMaxNotifyQueueEvents) {
+        event->vnodeID = bulkSent;
+        if (produceEvent(lanes, &criticalRing, &rings, event)) {
+            bulkSent++;
+        } else {
+            bulkDropped++;
+        }
+    }
+    EXPECT(bulkDropped == 1)
+    for (UInt32 i = 0; i < kNotifyRingCount; ++i) {
+        EXPECT(!rings.getRing(i)->hasRoom(kMaxEventRecordSize))
+    }
+
+    UInt32 criticalSent = 0;
+    for (UInt32 n = 0; n < kMaxCriticalQueueEvents / 4; ++n) {
+        event->eventType = n % 2 == 0 ? kActionNotifyProcessCreate : kActionNotifyFileDelete;
+        event->vnodeID = n;
+        criticalSent += produceEvent(lanes, &criticalRing, &rings, event);
+    }
+    EXPECT(criticalSent == kMaxCriticalQueueEvents / 4)
+
+    // Drained first by the client, in order and with no hole in its sequences.
+    std::vector<UInt8> data;
+    UInt32 received = 0;
+    UInt32 disorders = 0;
+    while (critical.dequeue(&data)) {
+        NuwaKextRecordHeader header;
+        disorders += !readRecordHeader(data.data(), (UInt32)data.size(), &header) || header.vnodeID != received ||
+            header.sequence != received;
+        received++;
+    }
+    EXPECT(received == criticalSent && disorders == 0)
+    delete event;
+}
+
+int main() {
+    RUN_TEST(testDefaultLanes)
+    RUN_TEST(testClientMapping)
+    RUN_TEST(testCriticalUnderStorm)
+    return g_testFailures == 0 ? 0 : 1;
+}
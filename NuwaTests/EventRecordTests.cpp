@@ -0,0 +1,211 @@
+//
+//  EventRecordTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventRecord.hpp"
+#include "TestHarness.hpp"
+#include "TestQueue.hpp"
+#include <cstdio>
+#include <vector>
+
+static NuwaKextEvent *makeEvent(NuwaKextAction type) {
+    NuwaKextEvent *event = new NuwaKextEvent();
+    event->eventType = type;
+    event->vnodeID = 0x500000001234ULL;
+    event->eventTime = 1792224000;
+    event->mainProcess.pid = 4242;
+    event->mainProcess.ppid = 1;
+    event->mainProcess.euid = 501;
+    return event;
+}
+
+static void fillFile(NuwaKextFile *file, const char *path) {
+    file->uid = 501;
+    file->gid = 20;
+    file->mode = 0100644;
+    file->atime = 1;
+    file->mtime = 2;
+    file->ctime = 3;
+    snprintf(file->path, sizeof(file->path), "%s", path);
+}
+
+static bool isSameHeader(const NuwaKextEvent *first, const NuwaKextEvent *second) {
+    return first->eventType == second->eventType && first->vnodeID == second->vnodeID &&
+        first->eventTime == second->eventTime &&
+        memcmp(&first->mainProcess, &second->mainProcess, sizeof(NuwaKextProc)) == 0;
+}
+
+static UInt32 roundTrip(const NuwaKextEvent *event, NuwaKextEvent *decoded) {
+    std::vector<UInt8> record(kMaxEventRecordSize);
+    UInt32 size = encodeEventRecord(event, record.data(), (UInt32)record.size());
+    if (size == 0 || decodeEventRecord(record.data(), size, decoded) != size) {
+        return 0;
+    }
+    return size;
+}
+
+static void testFileEvents() {
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    NuwaKextEvent *open = makeEvent(kActionNotifyFileOpen);
+    fillFile(&open->fileOpen, "/Users/me/Documents/report.txt");
+    UInt32 size = roundTrip(open, decoded);
+    EXPECT(size != 0)
+    EXPECT(size < 256)
+    EXPECT(isSameHeader(open, decoded))
+    EXPECT(decoded->fileOpen.uid == 501 && decoded->fileOpen.gid == 20 && decoded->fileOpen.mode == 0100644)
+    EXPECT(decoded->fileOpen.atime == 1 && decoded->fileOpen.mtime == 2 && decoded->fileOpen.ctime == 3)
+    EXPECT(strcmp(decoded->fileOpen.path, open->fileOpen.path) == 0)
+
+    NuwaKextEvent *rename = makeEvent(kActionNotifyFileRename);
+    fillFile(&rename->fileRename.srcFile, "/tmp/a");
+    snprintf(rename->fileRename.newPath, sizeof(rename->fileRename.newPath), "%s", "/tmp/b/c");
+    EXPECT(roundTrip(rename, decoded) != 0)
+    EXPECT(strcmp(decoded->fileRename.srcFile.path, "/tmp/a") == 0)
+    EXPECT(strcmp(decoded->fileRename.newPath, "/tmp/b/c") == 0)
+
+    // Both paths full, the largest record there is.
+    memset(rename->fileRename.srcFile.path, 'a', kMaxPathLength);
+    memset(rename->fileRename.newPath, 'b', kMaxPathLength);
+    size = roundTrip(rename, decoded);
+    EXPECT(size != 0 && size <= kMaxEventRecordSize)
+    EXPECT(strlen(decoded->fileRename.srcFile.path) == kMaxPathLength - 1)
+    EXPECT(strlen(decoded->fileRename.newPath) == kMaxPathLength - 1)
+
+    delete open;
+    delete rename;
+    delete decoded;
+}
+
+static void testNetworkEvents() {
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    NuwaKextEvent *access = makeEvent(kActionNotifyNetworkAccess);
+    access->netAccess.protocol = IPPROTO_TCP;
+    access->netAccess.localAddr.sa_family = AF_INET;
+    access->netAccess.localAddr.sa_data[1] = 80;
+    access->netAccess.remoteAddr.sa_family = AF_INET;
+    access->netAccess.remoteAddr.sa_data[5] = 7;
+    UInt32 size = roundTrip(access, decoded);
+    EXPECT(size != 0)
+    EXPECT(size * 16 < sizeof(NuwaKextEvent))
+    EXPECT(isSameHeader(access, decoded))
+    EXPECT(decoded->netAccess.protocol == IPPROTO_TCP)
+    EXPECT(memcmp(&decoded->netAccess.localAddr, &access->netAccess.localAddr, sizeof(struct sockaddr)) == 0)
+    EXPECT(memcmp(&decoded->netAccess.remoteAddr, &access->netAccess.remoteAddr, sizeof(struct sockaddr)) == 0)
+
+    NuwaKextEvent *query = makeEvent(kActionNotifyDnsQuery);
+    query->dnsQuery.queryStatus = 3;
+    snprintf(query->dnsQuery.domainName, sizeof(query->dnsQuery.domainName), "%s", "example.com");
+    snprintf(query->dnsQuery.queryResult, sizeof(query->dnsQuery.queryResult), "%s", "93.184.216.34");
+    EXPECT(roundTrip(query, decoded) != 0)
+    EXPECT(decoded->dnsQuery.queryStatus == 3)
+    EXPECT(strcmp(decoded->dnsQuery.domainName, "example.com") == 0)
+    EXPECT(strcmp(decoded->dnsQuery.queryResult, "93.184.216.34") == 0)
+
+    delete access;
+    delete query;
+    delete decoded;
+}
+
+// Records of another version, cut short or with a field overrunning are refused, unknown fields skipped.
+static void testInvalidRecords() {
+    NuwaKextEvent *event = makeEvent(kActionNotifyFileOpen);
+    fillFile(&event->fileOpen, "/a/b");
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    std::vector<UInt8> record(kMaxEventRecordSize);
+    UInt32 size = encodeEventRecord(event, record.data(), (UInt32)record.size());
+    EXPECT(size != 0)
+
+    EXPECT(encodeEventRecord(event, record.data(), size - 1) == 0)
+    std::vector<UInt8> copy(record.begin(), record.begin() + size);
+    EXPECT(decodeEventRecord(copy.data(), size - 1, decoded) == 0)
+
+    NuwaKextRecordHeader header;
+    EXPECT(readRecordHeader(copy.data(), size, &header))
+    header.version = kEventRecordVersion + 1;
+    memcpy(copy.data(), &header, sizeof(header));
+    EXPECT(decodeEventRecord(copy.data(), size, decoded) == 0)
+
+    // A path field claiming more bytes than the record has.
+    copy.assign(record.begin(), record.begin() + size);
+    UInt32 length = 0;
+    const UInt8 *path = (const UInt8 *)findRecordField(copy.data(), size, kRecordFieldPath, &length);
+    EXPECT(path != nullptr && length == 4)
+    UInt16 overrun = 0xFFF0;
+    memcpy(copy.data() + (path - copy.data()) - sizeof(NuwaKextRecordField) + offsetof(NuwaKextRecordField, length),
+           &overrun, sizeof(overrun));
+    EXPECT(decodeEventRecord(copy.data(), size, decoded) == 0)
+
+    // A field unknown to this decoder, as a newer kext may add.
+    copy.assign(record.begin(), record.begin() + size);
+    copy.resize(kMaxEventRecordSize);
+    UInt32 extra = 0xABCD;
+    UInt32 extended = appendRecordField(copy.data(), (UInt32)copy.size(), size, 200, &extra, sizeof(extra));
+    readRecordHeader(copy.data(), size, &header);
+    EXPECT(closeEventRecord(copy.data(), extended, &header) == extended)
+    EXPECT(decodeEventRecord(copy.data(), extended, decoded) == extended)
+    EXPECT(strcmp(decoded->fileOpen.path, "/a/b") == 0)
+
+    delete event;
+    delete decoded;
+}
+
+// Called when read the clock as commitEvent does, in nanoseconds since boot.
+static UInt64 getUptime() {
+    UInt64 uptime = 0;
+    clock_get_uptime(&uptime);
+    absolutetime_to_nanoseconds(uptime, &uptime);
+    return uptime;
+}
+
+// The commit time and sequence go in place into a record only 4 bytes aligned, the rest is left as encoded.
+static void testStamping() {
+    NuwaKextEvent *event = makeEvent(kActionNotifyFileDelete);
+    fillFile(&event->fileDelete, "/a/b");
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    std::vector<UInt32> buffer(kMaxEventRecordSize / 4 + 2);
+    UInt8 *record = (UInt8 *)(buffer.data() + 1);
+    UInt32 size = encodeEventRecord(event, record, kMaxEventRecordSize);
+    EXPECT(size != 0)
+
+    NuwaKextRecordHeader header;
+    EXPECT(readRecordHeader(record, size, &header) && header.uptime == 0 && header.sequence == 0)
+    stampEventRecord(record, 0x123456789ABCULL, 0xFFFFFFFE);
+    EXPECT(readRecordHeader(record, size, &header) && header.uptime == 0x123456789ABCULL && header.sequence == 0xFFFFFFFE)
+    EXPECT(header.size == size && header.eventTime == event->eventTime && header.eventUptime == 0)
+    EXPECT(getRecordUptime(record, size) == 0x123456789ABCULL)
+    EXPECT(decodeEventRecord(record, size, decoded) == size && isSameHeader(event, decoded))
+    EXPECT(strcmp(decoded->fileDelete.path, "/a/b") == 0)
+
+    // Committed one after another, records take the next sequence of their queue and a time between the calls.
+    TestQueue queue(4096);
+    EventRing ring(queue.getMemory(), 4096);
+    for (UInt32 n = 0; n < 8; ++n) {
+        EventRing::Reservation reservation;
+        void *entry = ring.reserve(size, &reservation);
+        EXPECT(entry != nullptr)
+        if (entry == nullptr) {
+            break;
+        }
+        memcpy(entry, record, size);
+        UInt64 before = getUptime();
+        commitRecord(&ring, &reservation, entry, size);
+        UInt64 after = getUptime();
+
+        std::vector<UInt8> data;
+        EXPECT(queue.dequeue(&data) && readRecordHeader(data.data(), (UInt32)data.size(), &header))
+        EXPECT(header.sequence == n && header.uptime >= before && header.uptime <= after)
+    }
+    delete event;
+    delete decoded;
+}
+
+int main() {
+    RUN_TEST(testFileEvents)
+    RUN_TEST(testNetworkEvents)
+    RUN_TEST(testInvalidRecords)
+    RUN_TEST(testStamping)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+//
+//  EventRepeatsTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "EventRepeats.hpp"
+#include "KextCommon.hpp"
+#include "TestHarness.hpp"
+#include <vector>
+
+static const UInt32 kTestLifetime = 200; // ms
+
+// Called when count an event, its dropped repeats are kept with those of the previous calls.
+static bool countEvent(EventRepeatCache *cache, UInt64 vnodeID, UInt32 pid, UInt32 *repeats,
+                       std::vector<EventRepeatEntry> *dropped) {
+    EventRepeatEntry entries[kMaxDroppedRepeats];
+    UInt32 dropCount = kMaxDroppedRepeats;
+    EventRepeatKey key = { vnodeID, pid, kActionNotifyFileOpen };
+    bool result = countEventRepeat(cache, key, repeats, entries, &dropCount);
+    dropped->insert(dropped->end(), entries, entries + dropCount);
+    return result;
+}
+
+// Repeats within the lifetime are coalesced, the first event after it is sent with their count.
+static void testCoalesced() {
+    EventRepeatCache cache(kMaxCacheItems);
+    cache.zero = 0;
+    cache.setLifetime(kTestLifetime);
+    std::vector<EventRepeatEntry> dropped;
+    UInt32 repeats = 0;
+
+    EXPECT(!countEvent(&cache, 7, 100, &repeats, &dropped) && repeats == 0)
+    for (UInt32 i = 0; i < 5; ++i) {
+        EXPECT(countEvent(&cache, 7, 100, &repeats, &dropped) && repeats == 0)
+    }
+    // Another process or another file is an event of its own.
+    EXPECT(!countEvent(&cache, 7, 101, &repeats, &dropped) && repeats == 0)
+    EXPECT(!countEvent(&cache, 8, 100, &repeats, &dropped) && repeats == 0)
+
+    IOSleep(kTestLifetime + 50);
+    EXPECT(!countEvent(&cache, 7, 100, &repeats, &dropped) && repeats == 5)
+    EXPECT(countEvent(&cache, 7, 100, &repeats, &dropped) && repeats == 0)
+    // Sent once without repeats, it has none to carry.
+    IOSleep(kTestLifetime + 50);
+    EXPECT(!countEvent(&cache, 8, 100, &repeats, &dropped) && repeats == 0)
+}
+
+// Events expired before they came again give their repeats back, those without any are not given.
+static void testDroppedOnExpiry() {
+    EventRepeatCache cache(kMaxCacheItems);
+    cache.zero = 0;
+    cache.setLifetime(kTestLifetime);
+    std::vector<EventRepeatEntry> dropped;
+    UInt32 repeats = 0;
+
+    for (UInt32 i = 0; i < 3; ++i) {
+        countEvent(&cache, 7, 100, &repeats, &dropped);
+    }
+    countEvent(&cache, 8, 100, &repeats, &dropped);
+    IOSleep(kTestLifetime + 50);
+    // Each count sweeps a few slots, others are counted until the sweep went all over the table.
+    for (UInt64 vnodeID = 1000; vnodeID < 1000 + 4 * kMaxCacheItems; ++vnodeID) {
+        countEvent(&cache, vnodeID, 100, &repeats, &dropped);
+    }
+    EXPECT(dropped.size() == 1 && dropped[0].key.vnodeID == 7 && dropped[0].key.pid == 100 && dropped[0].value == 2)
+}
+
+// Evicted by a full cache within its lifetime, an event gives its repeats back all the same.
+static void testDroppedOnEviction() {
+    EventRepeatCache cache(64);
+    cache.zero = 0;
+    cache.setLifetime(60000);
+    std::vector<EventRepeatEntry> dropped;
+    UInt32 repeats = 0;
+
+    for (UInt32 i = 0; i < 4; ++i) {
+        countEvent(&cache, 7, 100, &repeats, &dropped);
+    }
+    for (UInt64 vnodeID = 1000; vnodeID < 1000 + 64 * 16; ++vnodeID) {
+        countEvent(&cache, vnodeID, 100, &repeats, &dropped);
+    }
+    EXPECT(dropped.size() == 1 && dropped[0].key.vnodeID == 7 && dropped[0].value == 3)
+    // Dropped with its repeats given, it starts over as a new event.
+    EXPECT(!countEvent(&cache, 7, 100, &repeats, &dropped) && repeats == 0)
+}
+
+int main() {
+    RUN_TEST(testCoalesced)
+    RUN_TEST(testDroppedOnExpiry)
+    RUN_TEST(testDroppedOnEviction)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+//
+//  EventRingTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "TestHarness.hpp"
+#include "TestQueue.hpp"
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+static const UInt32 kTestThreads = 4;
+
+// Called when leave garbage where the next call from the same frame keeps its locals.
+static void __attribute__((noinline)) dirtyStack() {
+    volatile UInt8 garbage[4096];
+    for (UInt32 i = 0; i < sizeof(garbage); ++i) {
+        garbage[i] = 0xA5;
+    }
+}
+
+static UInt32 __attribute__((noinline)) encodeInPlace(const NuwaKextEvent *event, void *record, UInt32 size) {
+    return encodeEventRecord(event, record, size);
+}
+
+// Entries come out in reservation order, the queue is full once the client lags a whole queue behind.
+static void testReserveAndCommit() {
+    TestQueue queue(256);
+    EventRing ring(queue.getMemory(), 256);
+    EventRing::Reservation first;
+    EventRing::Reservation second;
+    std::vector<UInt8> data;
+
+    UInt8 *firstData = (UInt8 *)ring.reserve(10, &first);
+    UInt8 *secondData = (UInt8 *)ring.reserve(20, &second);
+    EXPECT(firstData != nullptr && secondData != nullptr)
+    EXPECT(first.size == 12 && second.sequence == first.sequence + 1)
+    memset(secondData, 2, 20);
+    EXPECT(!ring.commit(&second, 20))
+    // The second one waits behind the first, still pending.
+    EXPECT(!queue.dequeue(&data))
+    EXPECT(!ring.isSettled())
+    memset(firstData, 1, 10);
+    EXPECT(ring.commit(&first, 10))
+    EXPECT(ring.isSettled())
+    EXPECT(queue.dequeue(&data) && data.size() == 12 && data[0] == 1)
+    EXPECT(queue.dequeue(&data) && data.size() == 20 && data[19] == 2)
+    EXPECT(!queue.dequeue(&data))
+
+    // Filling it up, the entries wrap around the end of the queue.
+    UInt32 committed = 0;
+    EventRing::Reservation reservation;
+    for (UInt32 i = 0; i < 20; ++i) {
+        UInt8 *entry = (UInt8 *)ring.reserve(36, &reservation);
+        if (entry == nullptr) {
+            break;
+        }
+        memset(entry, i, 36);
+        ring.commit(&reservation, 36);
+        committed++;
+    }
+    EXPECT(committed > 0 && committed < 20)
+    EXPECT(ring.reserve(36, &reservation) == nullptr)
+    for (UInt32 i = 0; i < committed; ++i) {
+        EXPECT(queue.dequeue(&data) && data.size() == 36 && data[35] == i)
+    }
+    EXPECT(ring.getUsedSize() == 0)
+    for (UInt32 i = 0; i < committed; ++i) {
+        UInt8 *entry = (UInt8 *)ring.reserve(36, &reservation);
+        EXPECT(entry != nullptr)
+        if (entry != nullptr) {
+            memset(entry, 100 + i, 36);
+            ring.commit(&reservation, 36);
+        }
+        EXPECT(queue.dequeue(&data) && data.size() == 36 && data[0] == 100 + i)
+    }
+
+    // Entries larger than the queue are never taken, nor any once closed.
+    EXPECT(ring.reserve(256, &reservation) == nullptr)
+    ring.close();
+    EXPECT(ring.isClosed())
+    EXPECT(ring.reserve(4, &reservation) == nullptr)
+}
+
+// Room and sequences given back by a reservation left unfilled or filled short.
+static void testAbortAndShrink() {
+    TestQueue queue(1024);
+    EventRing ring(queue.getMemory(), 1024);
+    EventRing::Reservation first;
+    EventRing::Reservation second;
+    std::vector<UInt8> data;
+
+    EXPECT(ring.reserve(100, &first) != nullptr)
+    EXPECT(ring.abort(&first))
+    EXPECT(ring.getUsedSize() == 0)
+    EXPECT(ring.reserve(100, &first) != nullptr && first.sequence == 0)
+
+    // Another one was reserved after it, so it stays and has to be committed.
+    EXPECT(ring.reserve(100, &second) != nullptr)
+    EXPECT(!ring.abort(&first))
+    EXPECT(ring.commit(&first, 0))
+    EXPECT(!ring.commit(&second, 40))
+    EXPECT(ring.getUsedSize() == 100 + 40 + 2 * DATA_QUEUE_ENTRY_HEADER_SIZE)
+    EXPECT(queue.dequeue(&data) && data.size() == 100)
+    // Nobody reserved after the second one, the 60 bytes not filled went back.
+    EXPECT(queue.dequeue(&data) && data.size() == 40)
+    EXPECT(ring.isSettled() && ring.getUsedSize() == 0)
+}
+
+// Times and sequence of a record built in place are only those stamped at commit.
+static void testRecordInPlace() {
+    TestQueue queue(4096);
+    EventRing ring(queue.getMemory(), 4096);
+    NuwaKextEvent *event = new NuwaKextEvent();
+    event->eventType = kActionNotifyFileOpen;
+    snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "%s", "/tmp/a");
+    std::vector<UInt8> data;
+
+    for (UInt32 i = 0; i < 3; ++i) {
+        EventRing::Reservation reservation;
+        void *record = ring.reserve(kMaxEventRecordSize, &reservation);
+        EXPECT(record != nullptr)
+        if (record == nullptr) {
+            break;
+        }
+        memset(record, 0xA5, reservation.size);
+        dirtyStack();
+        UInt32 size = encodeInPlace(event, record, reservation.size);
+        NuwaKextRecordHeader header;
+        EXPECT(readRecordHeader(record, size, &header))
+        EXPECT(header.uptime == 0 && header.eventUptime == 0 && header.sequence == 0)
+
+        commitRecord(&ring, &reservation, record, size);
+        EXPECT(queue.dequeue(&data) && data.size() == EventRing::alignEntrySize(size))
+        EXPECT(readRecordHeader(data.data(), (UInt32)data.size(), &header))
+        EXPECT(header.uptime != 0 && header.sequence == i)
+    }
+    delete event;
+}
+
+// Records built in place by several producers reach the client once each, in order for each producer.
+static void testConcurrentProducers() {
+    const UInt32 queueSize = 16 * 1024;
+    const UInt32 eventsPerThread = 20000;
+    TestQueue queue(queueSize);
+    EventRing ring(queue.getMemory(), queueSize);
+    std::vector<std::thread> threads;
+
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        threads.emplace_back([&ring, i] {
+            NuwaKextEvent *event = new NuwaKextEvent();
+            event->eventType = kActionNotifyFileOpen;
+            event->mainProcess.pid = (SInt32)i;
+            for (UInt32 n = 0; n < eventsPerThread; ++n) {
+                event->vnodeID = n;
+                snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "/tmp/%u/%u", i, n);
+                // Reserved for the largest record, what is not filled goes back at commit.
+                EventRing::Reservation reservation;
+                void *record = nullptr;
+                while ((record = ring.reserve(kMaxEventRecordSize, &reservation)) == nullptr) {
+                    sched_yield();
+                }
+                UInt32 size = encodeEventRecord(event, record, reservation.size);
+                commitRecord(&ring, &reservation, record, size);
+            }
+            delete event;
+        });
+    }
+
+    std::vector<UInt32> nextEvents(kTestThreads, 0);
+    UInt32 received = 0;
+    UInt32 disorders = 0;
+    // Entries are reused, a header built in place keeps nothing of the record there before.
+    UInt32 staleHeaders = 0;
+    UInt64 lastSequence = 0;
+    std::vector<UInt8> data;
+    NuwaKextEvent *decoded = new NuwaKextEvent();
+    while (received < kTestThreads * eventsPerThread) {
+        if (!queue.dequeue(&data)) {
+            sched_yield();
+            continue;
+        }
+        NuwaKextRecordHeader header;
+        UInt32 producer = kTestThreads;
+        if (decodeEventRecord(data.data(), (UInt32)data.size(), decoded) != 0 && readRecordHeader(data.data(), (UInt32)data.size(), &header)) {
+            producer = (UInt32)decoded->mainProcess.pid;
+            staleHeaders += header.eventUptime != 0 || header.uptime == 0;
+        }
+        if (producer >= kTestThreads || decoded->vnodeID != nextEvents[producer] ||
+            (received > 0 && header.sequence <= lastSequence)) {
+            disorders++;
+        } else {
+            char path[64];
+            snprintf(path, sizeof(path), "/tmp/%u/%u", producer, nextEvents[producer]);
+            disorders += strcmp(decoded->fileOpen.path, path) != 0;
+            nextEvents[producer]++;
+            lastSequence = header.sequence;
+        }
+        received++;
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT(disorders == 0)
+    EXPECT(staleHeaders == 0)
+    EXPECT(!queue.dequeue(&data))
+    EXPECT(ring.isSettled())
+    for (UInt32 next : nextEvents) {
+        EXPECT(next == eventsPerThread)
+    }
+    delete decoded;
+}
+
+// A small queue wraps every few entries, so publishers keep finding the tail back at offsets seen before.
+static void testWrapAround() {
+    const UInt32 queueSize = 256;
+    const UInt32 eventsPerThread = 50000;
+    TestQueue queue(queueSize);
+    EventRing ring(queue.getMemory(), queueSize);
+    std::vector<std::thread> threads;
+
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        threads.emplace_back([&ring, i] {
+            for (UInt32 n = 0; n < eventsPerThread; ++n) {
+                // Sizes differ by producer, an entry read at a reused offset would be taken with a wrong one.
+                UInt32 size = 8 + 4 * i;
+                EventRing::Reservation reservation;
+                UInt32 *entry = nullptr;
+                while ((entry = (UInt32 *)ring.reserve(size, &reservation)) == nullptr) {
+                    sched_yield();
+                }
+                entry[0] = i;
+                entry[1] = n;
+                ring.commit(&reservation, size);
+            }
+        });
+    }
+
+    std::vector<UInt32> nextEvents(kTestThreads, 0);
+    UInt32 received = 0;
+    UInt32 disorders = 0;
+    std::vector<UInt8> data;
+    while (received < kTestThreads * eventsPerThread) {
+        if (!queue.dequeue(&data)) {
+            sched_yield();
+            continue;
+        }
+        UInt32 producer = kTestThreads;
+        UInt32 event = 0;
+        if (data.size() >= 8) {
+            memcpy(&producer, data.data(), sizeof(producer));
+            memcpy(&event, data.data() + 4, sizeof(event));
+        }
+        if (producer >= kTestThreads || data.size() != 8 + 4 * producer || event != nextEvents[producer]) {
+            disorders++;
+        } else {
+            nextEvents[producer]++;
+        }
+        received++;
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT(disorders == 0)
+    EXPECT(!queue.dequeue(&data))
+    EXPECT(ring.isSettled())
+}
+
+int main() {
+    RUN_TEST(testReserveAndCommit)
+    RUN_TEST(testAbortAndShrink)
+    RUN_TEST(testRecordInPlace)
+    RUN_TEST(testConcurrentProducers)
+    RUN_TEST(testWrapAround)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+//
+//  FlatCacheTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "FlatCache.hpp"
+#include "TestHarness.hpp"
+
+/**
+ * @brief Key whose hash is chosen by the test, to build runs of colliding keys
+ */
+typedef struct CollidingKey {
+    UInt64 value;
+
+    bool operator==(const CollidingKey &other) const {
+        return value == other.value;
+    }
+} CollidingKey;
+
+// Keys below 1000 share a home slot, those below 2000 the slot ten further, those below 3000 the last slot, the others spread.
+static inline UInt64 cacheMixer(const CollidingKey &key) {
+    if (key.value < 1000) {
+        return 0x1234ULL << 16;
+    }
+    if (key.value < 2000) {
+        return (0x1234ULL + 10) << 16;
+    }
+    if (key.value < 3000) {
+        return 0xFFFFULL << 16;
+    }
+    return key.value * 11400714819323198549UL;
+}
+
+static void testSetAndGet() {
+    FlatCache<UInt64, UInt64> cache(1024);
+    cache.zero = 0;
+    for (UInt64 key = 1; key <= 700; ++key) {
+        EXPECT(cache.setObject(key, key + 1))
+    }
+    for (UInt64 key = 1; key <= 700; ++key) {
+        EXPECT(cache.getObject(key) == key + 1)
+    }
+    for (UInt64 key = 1; key <= 700; key += 2) {
+        cache.setObject(key, 0);
+    }
+    EXPECT(cache.getCount() == 350)
+    EXPECT(cache.getObject(1) == 0)
+    EXPECT(cache.getObject(2) == 3)
+}
+
+// A run reaching the probe bound refuses the insert instead of dropping an entry it displaces.
+static void testProbeBoundKeepsEntries() {
+    FlatCache<CollidingKey, UInt64> cache(1 << 20);
+    cache.zero = 0;
+    UInt64 stored = 0;
+    UInt64 refused = 0;
+
+    // A run of 200 from one home, 64 more from a home inside it pushed to its end, then the first run grows.
+    for (UInt64 value = 1; value <= 200; ++value) {
+        stored += cache.setObject(CollidingKey{value}, value);
+    }
+    for (UInt64 value = 1000; value < 1064; ++value) {
+        stored += cache.setObject(CollidingKey{value}, value);
+    }
+    for (UInt64 value = 201; value < 260; ++value) {
+        if (cache.setObject(CollidingKey{value}, value)) {
+            stored++;
+        } else {
+            refused++;
+        }
+    }
+
+    UInt64 lost = 0;
+    for (UInt64 value = 1; value < 260; ++value) {
+        UInt64 found = cache.getObject(CollidingKey{value});
+        if (found != 0 && found != value) {
+            lost++;
+        }
+    }
+    for (UInt64 value = 1000; value < 1064; ++value) {
+        if (cache.getObject(CollidingKey{value}) != value) {
+            lost++;
+        }
+    }
+    EXPECT(refused > 0)
+    EXPECT(lost == 0)
+    EXPECT(cache.getCount() == stored)
+}
+
+// A single run stops at the probe bound, the keys past it are refused until one of the run leaves.
+static void testProbeBoundOverflow() {
+    FlatCache<CollidingKey, UInt64> cache(1 << 20);
+    cache.zero = 0;
+    UInt64 stored = 0;
+    for (UInt64 value = 1; value <= 300; ++value) {
+        stored += cache.setObject(CollidingKey{value}, value);
+    }
+    EXPECT(stored == kFlatCacheMaxProbe - 1)
+    EXPECT(cache.getCount() == stored)
+    for (UInt64 value = 1; value <= 300; ++value) {
+        EXPECT(cache.getObject(CollidingKey{value}) == (value <= stored ? value : 0))
+    }
+
+    // Removing from the run gives its room back, the next key goes in at the end.
+    cache.setObject(CollidingKey{5}, 0);
+    EXPECT(cache.getObject(CollidingKey{5}) == 0)
+    EXPECT(cache.setObject(CollidingKey{299}, 299))
+    EXPECT(!cache.setObject(CollidingKey{300}, 300))
+    EXPECT(cache.getObject(CollidingKey{299}) == 299 && cache.getObject(CollidingKey{stored}) == stored)
+    EXPECT(cache.getCount() == stored)
+}
+
+// Deletes shift the rest of the run back, so runs sharing slots and runs wrapping the end stay reachable.
+static void testDeleteShiftsBack() {
+    FlatCache<CollidingKey, UInt64> cache(1024);
+    cache.zero = 0;
+    // Twelve from one home run past the home ten further, whose keys follow at the end.
+    for (UInt64 value = 1; value <= 12; ++value) {
+        EXPECT(cache.setObject(CollidingKey{value}, value))
+    }
+    for (UInt64 value = 1000; value < 1004; ++value) {
+        EXPECT(cache.setObject(CollidingKey{value}, value))
+    }
+    // Six from the last slot wrap around to the first ones.
+    for (UInt64 value = 2000; value < 2006; ++value) {
+        EXPECT(cache.setObject(CollidingKey{value}, value))
+    }
+
+    UInt64 removed[] = { 6, 1, 12, 1001, 2000, 2003 };
+    for (UInt64 value : removed) {
+        EXPECT(cache.setObject(CollidingKey{value}, 0))
+    }
+    EXPECT(cache.getCount() == 22 - sizeof(removed) / sizeof(removed[0]))
+    for (UInt64 value = 1; value < 2006; value = value == 12 ? 1000 : value == 1003 ? 2000 : value + 1) {
+        bool gone = false;
+        for (UInt64 other : removed) {
+            gone |= other == value;
+        }
+        EXPECT(cache.getObject(CollidingKey{value}) == (gone ? 0 : value))
+    }
+
+    // Emptied, the first run left the keys of the second one back in reach of their home.
+    for (UInt64 value = 1; value <= 12; ++value) {
+        cache.setObject(CollidingKey{value}, 0);
+    }
+    for (UInt64 value = 2000; value < 2006; ++value) {
+        cache.setObject(CollidingKey{value}, 0);
+    }
+    EXPECT(cache.getCount() == 3)
+    EXPECT(cache.getObject(CollidingKey{1000}) == 1000 && cache.getObject(CollidingKey{1003}) == 1003)
+    for (UInt64 value = 2000; value < 2006; ++value) {
+        EXPECT(cache.setObject(CollidingKey{value}, value + 1))
+    }
+    EXPECT(cache.getObject(CollidingKey{2005}) == 2006 && cache.getCount() == 9)
+}
+
+int main() {
+    RUN_TEST(testSetAndGet)
+    RUN_TEST(testProbeBoundKeepsEntries)
+    RUN_TEST(testProbeBoundOverflow)
+    RUN_TEST(testDeleteShiftsBack)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+//
+//  FsidSetTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "FsidSet.hpp"
+#include "TestHarness.hpp"
+#include <set>
+
+// Only the filesystems added are excluded, whatever the bits their hashes share with others.
+static void testExcluded() {
+    FsidSet set;
+    EXPECT(set.isEmpty())
+    EXPECT(!set.isExcluded(0x1000004))
+
+    std::set<UInt32> fsids;
+    for (UInt32 i = 0; i < kMaxExcludedFsids; ++i) {
+        UInt32 fsid = 0x1000000 + i * 7;
+        EXPECT(set.addFsid(fsid, nullptr))
+        fsids.insert(fsid);
+    }
+    EXPECT(!set.isEmpty())
+    EXPECT(!set.addFsid(0x2000000, nullptr))
+    // Given again, a filesystem takes no room.
+    EXPECT(set.addFsid(0x1000000, nullptr))
+
+    // 64 bits for 32 fsids, most others share a bit with one of them and still go through.
+    UInt32 wrong = 0;
+    for (UInt32 fsid = 0x1000000; fsid < 0x1000000 + 4096; ++fsid) {
+        wrong += set.isExcluded(fsid) != (fsids.count(fsid) != 0);
+    }
+    EXPECT(wrong == 0)
+}
+
+// Every event dropped is counted for its filesystem, the counts of those excluded again are kept.
+static void testDrops() {
+    FsidSet *first = new FsidSet();
+    first->addFsid(10, nullptr);
+    first->addFsid(20, nullptr);
+    for (UInt32 i = 0; i < 5; ++i) {
+        first->isExcluded(10);
+    }
+    first->isExcluded(20);
+    first->isExcluded(30);
+
+    NuwaKextFsidDrops drops[kMaxExcludedFsids];
+    EXPECT(first->getDrops(drops, kMaxExcludedFsids) == 2)
+    EXPECT(drops[0].fsid == 10 && drops[0].drops == 5)
+    EXPECT(drops[1].fsid == 20 && drops[1].drops == 1)
+    EXPECT(first->getDrops(drops, 1) == 1 && drops[0].fsid == 10)
+
+    FsidSet *second = new FsidSet();
+    second->addFsid(30, first);
+    second->addFsid(10, first);
+    second->isExcluded(30);
+    EXPECT(second->getDrops(drops, kMaxExcludedFsids) == 2)
+    EXPECT(drops[0].fsid == 30 && drops[0].drops == 1)
+    EXPECT(drops[1].fsid == 10 && drops[1].drops == 5)
+    delete first;
+    delete second;
+}
+
+int main() {
+    RUN_TEST(testExcluded)
+    RUN_TEST(testDrops)
+    return g_testFailures == 0 ? 0 : 1;
+}
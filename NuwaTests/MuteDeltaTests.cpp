@@ -0,0 +1,172 @@
+//
+//  MuteDeltaTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "MuteDelta.hpp"
+#include "TestHarness.hpp"
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+// Values of the process list, as NuwaKextProcType tags them.
+static const UInt8 kTestAllowValue = 1;
+static const UInt8 kTestDenyValue = 2;
+static const UInt64 kTestBudget = 1ULL << 32;
+
+static UInt64 makeVnodeID(std::mt19937_64 &random) {
+    // A few volumes, the file IDs in the low bits.
+    return ((random() % 8 + 1) << 32) | (random() & 0xFFFFFFFF);
+}
+
+static VnodeSet *buildList(const std::unordered_set<UInt64> &allowed, const std::unordered_set<UInt64> &denied) {
+    VnodeSet *list = new VnodeSet((UInt32)(allowed.size() + denied.size()));
+    std::vector<UInt64> keys(allowed.begin(), allowed.end());
+    list->addItems(keys.data(), (UInt32)keys.size(), kTestAllowValue);
+    keys.assign(denied.begin(), denied.end());
+    list->addItems(keys.data(), (UInt32)keys.size(), kTestDenyValue);
+    list->finish();
+    return list;
+}
+
+static bool isListOf(const VnodeSet *list, const std::unordered_set<UInt64> &allowed, const std::unordered_set<UInt64> &denied) {
+    if (list->getCount() != allowed.size() + denied.size()) {
+        return false;
+    }
+    for (UInt32 i = 0; i < list->getCount(); ++i) {
+        const std::unordered_set<UInt64> &expected = list->getValueAt(i) == kTestAllowValue ? allowed : denied;
+        if (expected.count(list->getKeyAt(i)) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends a chunk of adds then removes, the way NuwaClient lays it out.
+static NuwaKextListStatus sendChunk(MuteDelta *delta, UInt32 flags, UInt64 generation, const std::vector<UInt64> &adds,
+                                    const std::vector<UInt64> &removes, const VnodeSet *current, VnodeSet **list) {
+    NuwaKextMuteDelta header = {};
+    header.muteType = kAllowAuthExec;
+    header.flags = flags;
+    header.generation = generation;
+    header.addCount = (UInt32)adds.size();
+    header.removeCount = (UInt32)removes.size();
+    std::vector<UInt64> keys(adds);
+    keys.insert(keys.end(), removes.begin(), removes.end());
+    return delta->apply(&header, keys.data(), current, kTestAllowValue, kTestBudget, list);
+}
+
+// Long updates of large lists, chunk by chunk, end in the same list as the changes applied one by one.
+static void testLargeUpdates() {
+    std::mt19937_64 random(11);
+    std::unordered_set<UInt64> allowed;
+    std::unordered_set<UInt64> denied;
+    for (UInt32 i = 0; i < 200000; ++i) {
+        allowed.insert(makeVnodeID(random));
+        if (i % 4 == 0) {
+            denied.insert(makeVnodeID(random));
+        }
+    }
+    VnodeSet *current = buildList(allowed, denied);
+    MuteDelta delta;
+
+    for (UInt32 update = 0; update < 2; ++update) {
+        std::chrono::duration<double, std::milli> elapsed(0);
+        std::vector<UInt64> known(allowed.begin(), allowed.end());
+        UInt64 generation = delta.getGeneration();
+        VnodeSet *list = nullptr;
+        const UInt32 chunkCount = 256;
+        for (UInt32 chunk = 0; chunk < chunkCount; ++chunk) {
+            std::vector<UInt64> adds;
+            std::vector<UInt64> removes;
+            for (UInt32 i = 0; i < kMaxMuteDeltaItems / 2; ++i) {
+                UInt64 key = makeVnodeID(random);
+                adds.push_back(key);
+                known.push_back(key);
+                removes.push_back(known[random() % known.size()]);
+            }
+            // Removals go first, a key added and removed by the same chunk stays.
+            for (UInt64 key : removes) {
+                allowed.erase(key);
+            }
+            allowed.insert(adds.begin(), adds.end());
+
+            UInt32 flags = (chunk == 0 ? kMuteDeltaBegin : 0) | (chunk == chunkCount - 1 ? kMuteDeltaCommit : 0);
+            auto start = std::chrono::steady_clock::now();
+            NuwaKextListStatus status = sendChunk(&delta, flags, generation, adds, removes, current, &list);
+            elapsed += std::chrono::steady_clock::now() - start;
+            EXPECT(status == kListUpdateSuccess)
+            EXPECT((list != nullptr) == (chunk == chunkCount - 1))
+            EXPECT(list != nullptr || delta.getPendingCount() == allowed.size())
+        }
+        printf("%u chunks of %u items over %zu items in %.1f ms\n", chunkCount, kMaxMuteDeltaItems, allowed.size(), elapsed.count());
+
+        EXPECT(list != nullptr && isListOf(list, allowed, denied))
+        EXPECT(delta.getGeneration() == generation + 1 && delta.getPendingCount() == 0)
+        if (list != nullptr) {
+            delete current;
+            current = list;
+        }
+    }
+    delete current;
+}
+
+// Chunks based on a replaced list are refused, and so are the following ones of that update.
+static void testStaleUpdates() {
+    std::unordered_set<UInt64> allowed = { 1, 2, 3 };
+    std::unordered_set<UInt64> denied = { 3, 4 };
+    VnodeSet *current = buildList(allowed, denied);
+    MuteDelta delta;
+    VnodeSet *list = nullptr;
+
+    EXPECT(sendChunk(&delta, kMuteDeltaBegin, 0, { 5 }, { 1 }, current, &list) == kListUpdateSuccess)
+    // Replaced by a full update meanwhile.
+    delta.reset();
+    EXPECT(sendChunk(&delta, kMuteDeltaCommit, 0, { 6 }, {}, current, &list) == kListUpdateStale)
+    EXPECT(list == nullptr && delta.getPendingCount() == 0)
+    EXPECT(sendChunk(&delta, kMuteDeltaBegin, 0, {}, {}, current, &list) == kListUpdateStale)
+    // A chunk without a begun update is stale too.
+    EXPECT(sendChunk(&delta, 0, delta.getGeneration(), { 6 }, {}, current, &list) == kListUpdateStale)
+
+    // Reset starts from an empty list whatever the generation, items of the other type stay.
+    EXPECT(sendChunk(&delta, kMuteDeltaBegin | kMuteDeltaReset | kMuteDeltaCommit, 42, { 7, 8, 0 }, { 8 }, current, &list) ==
+           kListUpdateSuccess)
+    EXPECT(list != nullptr && isListOf(list, { 7, 8 }, denied))
+    EXPECT(list != nullptr && list->getValue(3) == kTestDenyValue && list->getValue(1) == 0)
+    delete list;
+    delete current;
+}
+
+// Updates going over the budget are dropped, the list stays as it was.
+static void testBudget() {
+    std::unordered_set<UInt64> allowed = { 1, 2, 3 };
+    VnodeSet *current = buildList(allowed, {});
+    MuteDelta delta;
+    VnodeSet *list = nullptr;
+    NuwaKextMuteDelta header = {};
+    header.muteType = kAllowAuthExec;
+    header.flags = kMuteDeltaBegin;
+    header.addCount = 100;
+    std::vector<UInt64> keys(100);
+    for (UInt32 i = 0; i < keys.size(); ++i) {
+        keys[i] = 100 + i;
+    }
+
+    EXPECT(delta.apply(&header, keys.data(), current, kTestAllowValue, VnodeSet::getMemorySize(50), &list) == kListUpdateNoMemory)
+    EXPECT(list == nullptr && delta.getPendingCount() == 0)
+    header.flags = kMuteDeltaBegin | kMuteDeltaCommit;
+    EXPECT(delta.apply(&header, keys.data(), current, kTestAllowValue, VnodeSet::getMemorySize(103), &list) == kListUpdateSuccess)
+    EXPECT(list != nullptr && list->getCount() == 103)
+    delete list;
+    delete current;
+}
+
+int main() {
+    RUN_TEST(testLargeUpdates)
+    RUN_TEST(testStaleUpdates)
+    RUN_TEST(testBudget)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+//
+//  NotifyRingTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "TestHarness.hpp"
+#include "TestQueue.hpp"
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+// Ring bytes as EventDispatcher shares the notify budget among the rings.
+static const UInt32 kRingSize = kMaxNotifyQueueEvents / kNotifyRingCount * sizeof(NuwaKextEvent);
+
+static void produceEvent(EventRing *ring, NuwaKextEvent *event) {
+    EventRing::Reservation reservation;
+    void *record = nullptr;
+    while ((record = ring->reserve(kMaxEventRecordSize, &reservation)) == nullptr) {
+        sched_yield();
+    }
+    commitRecord(ring, &reservation, record, encodeEventRecord(event, record, reservation.size));
+}
+
+// Events of one thread spread over all rings come out merged in the order they were committed.
+static void testMergedByUptime() {
+    TestRings rings(kNotifyRingCount, kRingSize);
+    NuwaKextEvent *event = new NuwaKextEvent();
+    event->eventType = kActionNotifyNetworkAccess;
+
+    for (UInt32 n = 0; n < 10 * kNotifyRingCount; ++n) {
+        event->vnodeID = n;
+        produceEvent(rings.getRing(n * 5 % kNotifyRingCount), event);
+        // Commit times are apart, the merge has nothing else to order them by.
+        UInt64 committed = 0;
+        UInt64 now = 0;
+        clock_get_uptime(&committed);
+        do {
+            clock_get_uptime(&now);
+        } while (now == committed);
+    }
+
+    std::vector<UInt8> data;
+    UInt32 received = 0;
+    int queue = 0;
+    while ((queue = rings.dequeueOldest(&data)) >= 0) {
+        NuwaKextRecordHeader header;
+        EXPECT(readRecordHeader(data.data(), (UInt32)data.size(), &header))
+        EXPECT(header.vnodeID == received && (UInt32)queue == received * 5 % kNotifyRingCount)
+        received++;
+    }
+    EXPECT(received == 10 * kNotifyRingCount)
+    delete event;
+}
+
+// Threads sharing rings with others keep their events in order, none lost or seen twice.
+static void testThreadOrder() {
+    const UInt32 threadCount = 2 * kNotifyRingCount + 3;
+    const UInt32 eventsPerThread = 5000;
+    TestRings rings(kNotifyRingCount, kRingSize);
+    std::vector<std::thread> threads;
+
+    for (UInt32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&rings, i] {
+            NuwaKextEvent *event = new NuwaKextEvent();
+            event->eventType = kActionNotifyFileOpen;
+            event->mainProcess.pid = (SInt32)i;
+            snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "/tmp/%u", i);
+            for (UInt32 n = 0; n < eventsPerThread; ++n) {
+                event->vnodeID = n;
+                produceEvent(rings.getRing(i), event);
+            }
+            delete event;
+        });
+    }
+
+    std::vector<UInt32> nextEvents(threadCount, 0);
+    std::vector<UInt64> nextSequences(kNotifyRingCount, 0);
+    UInt32 received = 0;
+    UInt32 disorders = 0;
+    std::vector<UInt8> data;
+    while (received < threadCount * eventsPerThread) {
+        int queue = rings.dequeueOldest(&data);
+        if (queue < 0) {
+            sched_yield();
+            continue;
+        }
+        NuwaKextRecordHeader header;
+        if (!readRecordHeader(data.data(), (UInt32)data.size(), &header) || (UInt32)header.mainProcess.pid >= threadCount) {
+            disorders++;
+        } else {
+            UInt32 producer = (UInt32)header.mainProcess.pid;
+            // Threads keep their ring, and a ring hands out sequences in commit order.
+            disorders += (UInt32)queue != producer % kNotifyRingCount || header.vnodeID != nextEvents[producer] ||
+                header.sequence < nextSequences[queue];
+            nextEvents[producer] = (UInt32)header.vnodeID + 1;
+            nextSequences[queue] = (UInt64)header.sequence + 1;
+        }
+        received++;
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT(disorders == 0)
+    EXPECT(rings.dequeueOldest(&data) < 0)
+    for (UInt32 next : nextEvents) {
+        EXPECT(next == eventsPerThread)
+    }
+}
+
+// Rings get the entries of their CPUs, those without any keep the least for producers falling over.
+static void testShareByCpus() {
+    for (UInt32 cpuCount : { 1u, 4u, 8u, 12u, 64u }) {
+        UInt32 total = 0;
+        UInt32 idle = 0;
+        for (UInt32 ring = 0; ring < kNotifyRingCount; ++ring) {
+            UInt32 entries = EventRing::shareByCpus(ring, kNotifyRingCount, cpuCount, kMaxNotifyQueueEvents, 8);
+            UInt32 cpus = 0;
+            for (UInt32 cpu = 0; cpu < cpuCount; ++cpu) {
+                cpus += cpu % kNotifyRingCount == ring;
+            }
+            if (cpus == 0) {
+                EXPECT(entries == 8)
+                idle++;
+            } else {
+                EXPECT(entries == kMaxNotifyQueueEvents * cpus / cpuCount)
+            }
+            total += entries;
+        }
+        EXPECT(total <= kMaxNotifyQueueEvents + idle * 8 && total + kNotifyRingCount >= kMaxNotifyQueueEvents)
+    }
+    EXPECT(EventRing::shareByCpus(3, kNotifyRingCount, 0, kMaxNotifyQueueEvents, 8) == 8)
+}
+
+// A producer whose ring is full goes to the next one with room, the full ring counts no drop for it.
+static void testFallOver() {
+    // Large enough that the largest record always fits in a drained ring, wherever its head is.
+    TestRings rings(kNotifyRingCount, 16 * 1024);
+    NuwaKextEvent *event = new NuwaKextEvent();
+    event->eventType = kActionNotifyFileOpen;
+    snprintf(event->fileOpen.path, sizeof(event->fileOpen.path), "%s", "/tmp/a");
+
+    UInt32 sent = 0;
+    while (rings.getRing(2)->hasRoom(kMaxEventRecordSize)) {
+        event->vnodeID = sent++;
+        produceEvent(rings.getRing(2), event);
+    }
+    EXPECT(sent > 0)
+    EXPECT(rings.pickRing(2, kMaxEventRecordSize) == 3)
+    EXPECT(rings.pickRing(4, kMaxEventRecordSize) == 4)
+    for (UInt32 n = 0; n < 3; ++n) {
+        event->vnodeID = sent++;
+        produceEvent(rings.getRing(rings.pickRing(2, kMaxEventRecordSize)), event);
+    }
+
+    // Every event is there, and the sequences of the full ring have no hole.
+    std::vector<UInt8> data;
+    std::vector<UInt64> nextSequences(kNotifyRingCount, 0);
+    UInt32 received = 0;
+    UInt32 holes = 0;
+    int queue = 0;
+    while ((queue = rings.dequeueOldest(&data)) >= 0) {
+        NuwaKextRecordHeader header;
+        EXPECT(readRecordHeader(data.data(), (UInt32)data.size(), &header))
+        EXPECT(header.vnodeID == received && (queue == 2 || queue == 3))
+        holes += header.sequence != nextSequences[queue];
+        nextSequences[queue] = (UInt64)header.sequence + 1;
+        received++;
+    }
+    EXPECT(received == sent && holes == 0)
+    EXPECT(nextSequences[3] == 3)
+    // Drained, the ring of the CPU takes its producers back.
+    EXPECT(rings.pickRing(2, kMaxEventRecordSize) == 2)
+    delete event;
+}
+
+int main() {
+    RUN_TEST(testMergedByUptime)
+    RUN_TEST(testThreadOrder)
+    RUN_TEST(testShareByCpus)
+    RUN_TEST(testFallOver)
+    return g_testFailures == 0 ? 0 : 1;
+}
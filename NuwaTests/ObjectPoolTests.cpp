@@ -0,0 +1,102 @@
+//
+//  ObjectPoolTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "ObjectPool.hpp"
+#include "TestHarness.hpp"
+#include <thread>
+#include <vector>
+
+static const UInt32 kTestThreads = 4;
+
+typedef struct {
+    UInt64 owner;
+    UInt64 index;
+    UInt64 padding[6];
+} TestObject;
+
+// Objects held by several threads at once are never handed out twice.
+static void testConcurrentAllocations() {
+    ObjectPool pool(sizeof(TestObject), 100);
+    UInt32 failures = 0;
+    std::vector<std::thread> threads;
+
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        threads.emplace_back([&pool, &failures, i] {
+            std::vector<TestObject *> held;
+            for (UInt32 round = 0; round < 30; ++round) {
+                UInt32 count = (round * 977 + i * 131) % 5000;
+                for (UInt32 n = 0; n < count; ++n) {
+                    TestObject *object = (TestObject *)pool.allocObject();
+                    if (object == nullptr) {
+                        __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+                        continue;
+                    }
+                    object->owner = i;
+                    object->index = n;
+                    held.push_back(object);
+                }
+                for (UInt32 n = 0; n < held.size(); ++n) {
+                    if (held[n]->owner != i || held[n]->index != n) {
+                        __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+                    }
+                    pool.freeObject(held[n]);
+                }
+                held.clear();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT(failures == 0)
+}
+
+// Slabs emptied beyond the high-water mark go back, the pool gives back all on release.
+static void testEmptySlabsReleased() {
+    UInt64 baseBytes = getAlignedBytes();
+    ObjectPool *pool = new ObjectPool(sizeof(TestObject), 0);
+    UInt64 poolBytes = getAlignedBytes();
+
+    std::vector<void *> objects;
+    for (UInt32 i = 0; i < 10000; ++i) {
+        objects.push_back(pool->allocObject());
+    }
+    UInt64 peakBytes = getAlignedBytes();
+    for (void *object : objects) {
+        pool->freeObject(object);
+    }
+    UInt64 idleBytes = getAlignedBytes();
+    delete pool;
+
+    EXPECT(peakBytes > poolBytes + 10 * kPoolSlabSize)
+    // The empty slabs kept, and those of the objects still cached in the magazine.
+    EXPECT(idleBytes <= poolBytes + (kPoolMaxEmptySlabs + 2) * kPoolSlabSize)
+    EXPECT(getAlignedBytes() == baseBytes)
+}
+
+// Slabs reserved up front are kept even once their objects all came back.
+static void testReserveKept() {
+    UInt32 perSlab = kPoolSlabSize / sizeof(TestObject);
+    ObjectPool pool(sizeof(TestObject), perSlab * (kPoolMaxEmptySlabs + 4));
+    UInt64 reservedBytes = getAlignedBytes();
+
+    std::vector<void *> objects;
+    for (UInt32 i = 0; i < perSlab * (kPoolMaxEmptySlabs + 4); ++i) {
+        objects.push_back(pool.allocObject());
+    }
+    for (void *object : objects) {
+        pool.freeObject(object);
+    }
+    EXPECT(getAlignedBytes() == reservedBytes)
+}
+
+int main() {
+    RUN_TEST(testConcurrentAllocations)
+    RUN_TEST(testEmptySlabsReleased)
+    RUN_TEST(testReserveKept)
+    return g_testFailures == 0 ? 0 : 1;
+}
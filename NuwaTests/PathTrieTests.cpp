@@ -0,0 +1,118 @@
+//
+//  PathTrieTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "PathTrie.hpp"
+#include "TestHarness.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// Pack the paths as NuwaClient sends them, one after another with their terminators.
+static std::string packPaths(const std::vector<std::string> &paths) {
+    std::string packed;
+    for (const std::string &path : paths) {
+        packed += path;
+        packed += '\0';
+    }
+    return packed;
+}
+
+static PathTrie *buildTrie(const std::vector<std::string> &paths) {
+    std::string packed = packPaths(paths);
+    PathTrie *trie = new PathTrie((UInt32)paths.size(), (UInt32)packed.size());
+    trie->addPaths(packed.data(), (UInt32)packed.size());
+    trie->finish();
+    return trie;
+}
+
+// Whole components only, as the kext mutes them.
+static bool isBelowPrefix(const std::string &path, std::string prefix) {
+    while (prefix.size() > 1 && prefix.back() == '/') {
+        prefix.pop_back();
+    }
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    return path.size() == prefix.size() || path[prefix.size()] == '/' || prefix.back() == '/';
+}
+
+static void testComponents() {
+    PathTrie *trie = buildTrie({ "/a/b", "/usr/local/", "/x", "/Users/me/Library/Caches" });
+    EXPECT(trie->getCount() == 4)
+    EXPECT(trie->matchPath("/a/b"))
+    EXPECT(trie->matchPath("/a/b/c"))
+    EXPECT(!trie->matchPath("/a/bc"))
+    EXPECT(!trie->matchPath("/a"))
+    EXPECT(trie->matchPath("/usr/local"))
+    EXPECT(trie->matchPath("/usr/local/bin/tool"))
+    EXPECT(!trie->matchPath("/usr/locale"))
+    EXPECT(trie->matchPath("/x/y"))
+    EXPECT(!trie->matchPath("/xy"))
+    EXPECT(trie->matchPath("/Users/me/Library/Caches/com.apple.Safari/Cache.db"))
+    EXPECT(!trie->matchPath("/Users/me/Library/Cache"))
+    EXPECT(!trie->matchPath(""))
+    EXPECT(!trie->matchPath(nullptr))
+    delete trie;
+
+    PathTrie *root = buildTrie({ "/" });
+    EXPECT(root->matchPath("/"))
+    EXPECT(root->matchPath("/any/path"))
+    delete root;
+}
+
+// Relative and empty paths are skipped, so is a last one without terminator.
+static void testInvalidPaths() {
+    std::string packed = packPaths({ "relative/path", "", "/kept", "/a/b" }) + "/unterminated";
+    PathTrie trie(8, (UInt32)packed.size());
+    EXPECT(trie.addPaths(packed.data(), (UInt32)packed.size()) == 2)
+    EXPECT(trie.finish())
+    EXPECT(trie.matchPath("/kept/file"))
+    EXPECT(!trie.matchPath("/unterminated"))
+    EXPECT(!trie.matchPath("relative/path"))
+}
+
+// Random prefixes sharing components, matched against a linear scan of them.
+static void testAgainstScan() {
+    static const char *components[] = { "a", "ab", "b", "lib", "Library", "Caches", "tmp", "x.y", "node_modules" };
+    std::mt19937 random(17);
+    auto makePath = [&random](UInt32 depth) {
+        std::string path;
+        for (UInt32 i = 0; i < depth; ++i) {
+            path += "/";
+            path += components[random() % (sizeof(components) / sizeof(components[0]))];
+        }
+        return path;
+    };
+
+    std::vector<std::string> prefixes;
+    for (UInt32 i = 0; i < 300; ++i) {
+        prefixes.push_back(makePath(random() % 4 + 1) + (i % 7 == 0 ? "/" : ""));
+    }
+    PathTrie *trie = buildTrie(prefixes);
+
+    UInt32 mismatches = 0;
+    UInt32 matches = 0;
+    for (UInt32 i = 0; i < 20000; ++i) {
+        std::string path = makePath(random() % 7 + 1);
+        bool expected = false;
+        for (const std::string &prefix : prefixes) {
+            expected = expected || isBelowPrefix(path, prefix);
+        }
+        matches += expected;
+        mismatches += trie->matchPath(path.c_str()) != expected;
+    }
+    delete trie;
+    EXPECT(matches > 0)
+    EXPECT(mismatches == 0)
+}
+
+int main() {
+    RUN_TEST(testComponents)
+    RUN_TEST(testInvalidPaths)
+    RUN_TEST(testAgainstScan)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+//
+//  RateLimiterTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "RateLimiter.hpp"
+#include "TestHarness.hpp"
+#include <vector>
+
+static const UInt32 kLimitedClass = kActionNotifyFileOpen - kActionNotifyBegin;
+static const UInt32 kOpenClass = kActionNotifyProcessCreate - kActionNotifyBegin;
+
+// Called when find pids hashed to the same stripe as the first one, as consume picks it.
+static std::vector<UInt32> getStripePids(UInt32 count) {
+    std::vector<UInt32> pids;
+    UInt32 stripe = ((100 + 1) * 2654435761U) >> 28;
+    for (UInt32 pid = 100; pids.size() < count; ++pid) {
+        if (((pid + 1) * 2654435761U) >> 28 == stripe) {
+            pids.push_back(pid);
+        }
+    }
+    return pids;
+}
+
+// The burst goes through at once, then the class of the process is held to its rate, others are not.
+static void testBurstAndRate() {
+    RateLimiter limiter;
+    limiter.setLimit(kLimitedClass, 1, 3);
+    ThrottleSummary summaries[kMaxConsumeSummaries];
+    UInt32 count = 0;
+
+    for (UInt32 i = 0; i < 3; ++i) {
+        EXPECT(limiter.consume(10, kLimitedClass, summaries, &count) && count == 0)
+    }
+    EXPECT(!limiter.consume(10, kLimitedClass, summaries, &count) && count == 0)
+    EXPECT(limiter.consume(11, kLimitedClass, summaries, &count))
+    for (UInt32 i = 0; i < 100; ++i) {
+        EXPECT(limiter.consume(10, kOpenClass, summaries, &count))
+    }
+
+    // Lifted, the class goes through again.
+    limiter.setLimit(kLimitedClass, 0, 3);
+    EXPECT(limiter.consume(10, kLimitedClass, summaries, &count))
+}
+
+// A full stripe gives the slot idle the longest to a new process, the evicted counts come with it.
+static void testBoundedTable() {
+    RateLimiter limiter;
+    limiter.setLimit(kLimitedClass, 1, 1);
+    ThrottleSummary summaries[kMaxConsumeSummaries];
+    UInt32 count = 0;
+    std::vector<UInt32> pids = getStripePids(kRateLimiterWays + 1);
+
+    EXPECT(limiter.consume(pids[0], kLimitedClass, summaries, &count))
+    EXPECT(!limiter.consume(pids[0], kLimitedClass, summaries, &count))
+    EXPECT(!limiter.consume(pids[0], kLimitedClass, summaries, &count))
+    for (UInt32 i = 1; i < kRateLimiterWays; ++i) {
+        EXPECT(limiter.consume(pids[i], kLimitedClass, summaries, &count) && count == 0)
+    }
+
+    EXPECT(limiter.consume(pids[kRateLimiterWays], kLimitedClass, summaries, &count))
+    EXPECT(count == 1 && summaries[0].pid == pids[0] && summaries[0].suppressed[kLimitedClass] == 2)
+    EXPECT(count == 1 && summaries[0].suppressed[kOpenClass] == 0)
+    // Back with full buckets, it evicts the next one idle, which had nothing suppressed.
+    EXPECT(limiter.consume(pids[0], kLimitedClass, summaries, &count) && count == 0)
+    EXPECT(!limiter.consume(pids[0], kLimitedClass, summaries, &count))
+    // Still there, the others keep their empty buckets.
+    EXPECT(!limiter.consume(pids[kRateLimiterWays], kLimitedClass, summaries, &count) && count == 0)
+    EXPECT(limiter.collectSummaries(summaries, kRateLimiterWays) == 0)
+}
+
+// Suppressed events are summarized once an interval has passed, by collection or by the next event.
+static void testSummaries() {
+    RateLimiter limiter;
+    limiter.setLimit(kLimitedClass, 1, 1);
+    ThrottleSummary summaries[kRateLimiterWays];
+    UInt32 count = 0;
+    std::vector<UInt32> pids = getStripePids(3);
+    pids.push_back(pids.back() + 1);
+
+    for (UInt32 pid : pids) {
+        EXPECT(limiter.consume(pid, kLimitedClass, summaries, &count))
+        for (UInt32 i = 0; i <= pid % 4; ++i) {
+            EXPECT(!limiter.consume(pid, kLimitedClass, summaries, &count) && count == 0)
+        }
+    }
+    EXPECT(limiter.collectSummaries(summaries, kRateLimiterWays) == 0)
+
+    IOSleep(kThrottleSummaryInterval + 100);
+    // Taken a few at a time, each process comes once with all its counts.
+    UInt32 taken = limiter.collectSummaries(summaries, 2);
+    EXPECT(taken == 2)
+    taken += limiter.collectSummaries(summaries + taken, kRateLimiterWays - taken);
+    EXPECT(taken == pids.size())
+    EXPECT(limiter.collectSummaries(summaries, kRateLimiterWays) == 0)
+    UInt32 found = 0;
+    for (UInt32 pid : pids) {
+        for (UInt32 i = 0; i < taken; ++i) {
+            if (summaries[i].pid == pid) {
+                found++;
+                EXPECT(summaries[i].suppressed[kLimitedClass] == pid % 4 + 1)
+            }
+        }
+    }
+    EXPECT(found == pids.size())
+
+    // Refilled by then, the next event goes on and brings the summary due.
+    EXPECT(limiter.consume(pids[0], kLimitedClass, summaries, &count) && count == 0)
+    EXPECT(!limiter.consume(pids[0], kLimitedClass, summaries, &count) && count == 0)
+    IOSleep(kThrottleSummaryInterval + 100);
+    EXPECT(limiter.consume(pids[0], kLimitedClass, summaries, &count))
+    EXPECT(count == 1 && summaries[0].pid == pids[0] && summaries[0].suppressed[kLimitedClass] == 1)
+    EXPECT(limiter.collectSummaries(summaries, kRateLimiterWays) == 0)
+}
+
+int main() {
+    RUN_TEST(testBurstAndRate)
+    RUN_TEST(testBoundedTable)
+    RUN_TEST(testSummaries)
+    return g_testFailures == 0 ? 0 : 1;
+}
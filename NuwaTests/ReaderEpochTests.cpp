@@ -0,0 +1,123 @@
+//
+//  ReaderEpochTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "ReaderEpoch.hpp"
+#include "TestHarness.hpp"
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+static const UInt32 kTestThreads = 4;
+static const UInt32 kListLength = 64;
+static const UInt64 kLiveMark = 0x4C495645;
+
+/**
+ * @brief Stand-in for a published list, marked dead before it is freed
+ */
+struct TestList {
+    UInt64 marks[kListLength];
+};
+
+// The wait gives up while a reader is inside, and the epoch drains once it leaves.
+static void testBoundedWait() {
+    ReaderEpoch readers;
+    EXPECT(readers.isReady())
+    UInt32 epoch = 0;
+    EXPECT(readers.synchronize(0, &epoch))
+
+    UInt32 ticket = readers.enter();
+    EXPECT(!readers.synchronize(5, &epoch))
+    EXPECT(!readers.isDrained(epoch))
+    // Readers entering now count in the other epoch, the stuck one holds only its own.
+    UInt32 other = readers.enter();
+    EXPECT((other & 1) != (ticket & 1) && !readers.isDrained(epoch ^ 1))
+    readers.leave(other);
+    readers.leave(ticket);
+    EXPECT(readers.isDrained(epoch))
+    EXPECT(readers.synchronize(0, &epoch))
+}
+
+// A reader may leave from another thread than the one it entered on.
+static void testLeaveElsewhere() {
+    ReaderEpoch readers;
+    UInt32 ticket = readers.enter();
+    std::thread([&readers, ticket] {
+        readers.leave(ticket);
+    }).join();
+    UInt32 epoch = 0;
+    EXPECT(readers.synchronize(0, &epoch))
+    EXPECT(readers.isDrained(0) && readers.isDrained(1))
+}
+
+// Readers never see a list the writer has freed, however often it is replaced.
+static void testReplaceUnderReaders() {
+    ReaderEpoch readers;
+    TestList *current = new TestList;
+    for (UInt64 &mark : current->marks) {
+        mark = kLiveMark;
+    }
+    bool stopped = false;
+    std::vector<std::thread> threads;
+    std::vector<UInt64> deadReads(kTestThreads, 0);
+    std::vector<UInt64> reads(kTestThreads, 0);
+
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        threads.emplace_back([&, i] {
+            while (!__atomic_load_n(&stopped, __ATOMIC_RELAXED)) {
+                UInt32 ticket = readers.enter();
+                TestList *list = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+                for (UInt32 n = 0; n < kListLength; ++n) {
+                    deadReads[i] += __atomic_load_n(&list->marks[n], __ATOMIC_RELAXED) != kLiveMark;
+                }
+                readers.leave(ticket);
+                reads[i]++;
+            }
+        });
+    }
+
+    UInt32 expired = 0;
+    for (UInt32 n = 0; n < 300; ++n) {
+        TestList *list = new TestList;
+        for (UInt64 &mark : list->marks) {
+            mark = kLiveMark;
+        }
+        TestList *old = __atomic_exchange_n(&current, list, __ATOMIC_SEQ_CST);
+        UInt32 epoch = 0;
+        while (!readers.synchronize(1000, &epoch)) {
+            expired++;
+        }
+        for (UInt64 &mark : old->marks) {
+            __atomic_store_n(&mark, 0, __ATOMIC_RELAXED);
+        }
+        delete old;
+        if (n % 16 == 0) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&stopped, true, __ATOMIC_RELAXED);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    UInt64 dead = 0;
+    UInt64 total = 0;
+    for (UInt32 i = 0; i < kTestThreads; ++i) {
+        dead += deadReads[i];
+        total += reads[i];
+    }
+    EXPECT(dead == 0)
+    EXPECT(total > 0)
+    EXPECT(expired == 0)
+    delete current;
+}
+
+int main() {
+    RUN_TEST(testBoundedWait)
+    RUN_TEST(testLeaveElsewhere)
+    RUN_TEST(testReplaceUnderReaders)
+    return g_testFailures == 0 ? 0 : 1;
+}
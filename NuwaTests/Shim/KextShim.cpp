@@ -0,0 +1,86 @@
+//
+//  KextShim.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "KextShim.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+// Set up by the kext on load, unused by the stand-ins.
+lck_attr_t *g_driverLockAttr = nullptr;
+lck_grp_attr_t *g_driverLockGrpAttr = nullptr;
+lck_grp_t *g_driverLockGrp = nullptr;
+
+static UInt64 s_alignedBytes = 0;
+
+lck_mtx_t *lck_mtx_alloc_init(lck_grp_t * /* group */, lck_attr_t * /* attr */) {
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+    if (mutex != nullptr) {
+        pthread_mutex_init(mutex, nullptr);
+    }
+    return (lck_mtx_t *)mutex;
+}
+
+void lck_mtx_free(lck_mtx_t *lock, lck_grp_t * /* group */) {
+    pthread_mutex_destroy((pthread_mutex_t *)lock);
+    free(lock);
+}
+
+void lck_mtx_lock(lck_mtx_t *lock) {
+    pthread_mutex_lock((pthread_mutex_t *)lock);
+}
+
+void lck_mtx_unlock(lck_mtx_t *lock) {
+    pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+void *IOMallocAligned(size_t size, size_t alignment) {
+    void *address = nullptr;
+    if (alignment < sizeof(void *)) {
+        alignment = sizeof(void *);
+    }
+    if (posix_memalign(&address, alignment, size) != 0) {
+        return nullptr;
+    }
+    __atomic_fetch_add(&s_alignedBytes, size, __ATOMIC_RELAXED);
+    return address;
+}
+
+void IOFreeAligned(void *address, size_t size) {
+    if (address != nullptr) {
+        __atomic_fetch_sub(&s_alignedBytes, size, __ATOMIC_RELAXED);
+    }
+    free(address);
+}
+
+UInt64 getAlignedBytes(void) {
+    return __atomic_load_n(&s_alignedBytes, __ATOMIC_RELAXED);
+}
+
+void IOSleep(unsigned milliseconds) {
+    usleep(milliseconds * 1000);
+}
+
+void clock_get_uptime(UInt64 *result) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    *result = (UInt64)now.tv_sec * NSEC_PER_SEC + (UInt64)now.tv_nsec;
+}
+
+void nanoseconds_to_absolutetime(UInt64 nanoseconds, UInt64 *result) {
+    *result = nanoseconds;
+}
+
+void absolutetime_to_nanoseconds(UInt64 abstime, UInt64 *result) {
+    *result = abstime;
+}
+
+int cpu_number(void) {
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+}
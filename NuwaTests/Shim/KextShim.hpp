@@ -0,0 +1,79 @@
+//
+//  KextShim.hpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef KextShim_hpp
+#define KextShim_hpp
+
+// User-space stand-ins for the kernel interfaces listed in KextPlatform.hpp.
+// Locks are pthread mutexes and the absolute time is in nanoseconds.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef uint8_t UInt8;
+typedef uint16_t UInt16;
+typedef uint32_t UInt32;
+typedef uint64_t UInt64;
+typedef int8_t SInt8;
+typedef int16_t SInt16;
+typedef int32_t SInt32;
+typedef int64_t SInt64;
+
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+// C functions as in the kernel, KextCommon.hpp may have the header included from its extern "C" block.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lck_mtx lck_mtx_t;
+typedef struct lck_attr lck_attr_t;
+typedef struct lck_grp_attr lck_grp_attr_t;
+typedef struct lck_grp lck_grp_t;
+
+lck_mtx_t *lck_mtx_alloc_init(lck_grp_t *group, lck_attr_t *attr);
+void lck_mtx_free(lck_mtx_t *lock, lck_grp_t *group);
+void lck_mtx_lock(lck_mtx_t *lock);
+void lck_mtx_unlock(lck_mtx_t *lock);
+
+void *IOMallocAligned(size_t size, size_t alignment);
+void IOFreeAligned(void *address, size_t size);
+// Bytes held through IOMallocAligned, tests watch it to see what a container keeps.
+UInt64 getAlignedBytes(void);
+
+void IOSleep(unsigned milliseconds);
+
+void clock_get_uptime(UInt64 *result);
+void nanoseconds_to_absolutetime(UInt64 nanoseconds, UInt64 *result);
+void absolutetime_to_nanoseconds(UInt64 abstime, UInt64 *result);
+
+// CPU the caller runs on, it may have moved once the call returns.
+int cpu_number(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+typedef struct _IODataQueueEntry {
+    UInt32 size;
+    UInt8 data[4];
+} IODataQueueEntry;
+
+typedef struct _IODataQueueMemory {
+    UInt32 queueSize;
+    volatile UInt32 head;
+    volatile UInt32 tail;
+    IODataQueueEntry queue[1];
+} IODataQueueMemory;
+
+#define DATA_QUEUE_ENTRY_HEADER_SIZE (sizeof(IODataQueueEntry) - 4)
+
+#endif /* KextShim_hpp */
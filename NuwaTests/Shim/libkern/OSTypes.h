@@ -0,0 +1,14 @@
+//
+//  OSTypes.h
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef OSTypes_h
+#define OSTypes_h
+
+// KextCommon.hpp is shared with NuwaClient and keeps the system header.
+#include "../KextShim.hpp"
+
+#endif /* OSTypes_h */
@@ -0,0 +1,29 @@
+//
+//  TestHarness.hpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef TestHarness_hpp
+#define TestHarness_hpp
+
+#include <stdio.h>
+
+// Failed checks of the test binary, its exit status.
+static int g_testFailures = 0;
+
+#define EXPECT(condition) \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+        g_testFailures++; \
+    } \
+
+#define RUN_TEST(test) \
+    { \
+        int failures = g_testFailures; \
+        test(); \
+        printf("%s %s\n", g_testFailures == failures ? "[ OK ]" : "[FAIL]", #test); \
+    } \
+
+#endif /* TestHarness_hpp */
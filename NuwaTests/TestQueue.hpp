@@ -0,0 +1,136 @@
+//
+//  TestQueue.hpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#ifndef TestQueue_hpp
+#define TestQueue_hpp
+
+#include "EventRecord.hpp"
+#include "EventRing.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Shared memory of a data queue and its client side, as IODataQueueDequeue reads it
+ */
+class TestQueue {
+
+public:
+    explicit TestQueue(UInt32 queueSize) : m_storage((offsetof(IODataQueueMemory, queue) + queueSize) / 4 + 1) {
+        m_memory = (IODataQueueMemory *)m_storage.data();
+        m_memory->queueSize = queueSize;
+        m_memory->head = 0;
+        m_memory->tail = 0;
+    }
+
+    IODataQueueMemory *getMemory() {
+        return m_memory;
+    }
+
+    // Called when look at the entry at the head, nullptr if the queue is empty.
+    IODataQueueEntry *peek() {
+        UInt32 head = __atomic_load_n(&m_memory->head, __ATOMIC_RELAXED);
+        UInt32 tail = __atomic_load_n(&m_memory->tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            return nullptr;
+        }
+
+        UInt32 queueSize = m_memory->queueSize;
+        IODataQueueEntry *entry = (IODataQueueEntry *)((UInt8 *)m_memory->queue + head);
+        if (queueSize - head < DATA_QUEUE_ENTRY_HEADER_SIZE || entry->size > queueSize - head - DATA_QUEUE_ENTRY_HEADER_SIZE) {
+            entry = m_memory->queue;
+        }
+        return entry;
+    }
+
+    // Called when take the entry at the head, false if the queue is empty.
+    bool dequeue(std::vector<UInt8> *data) {
+        IODataQueueEntry *entry = peek();
+        if (entry == nullptr) {
+            return false;
+        }
+        data->assign(entry->data, entry->data + entry->size);
+        UInt32 head = (UInt32)((UInt8 *)entry - (UInt8 *)m_memory->queue);
+        __atomic_store_n(&m_memory->head, head + entry->size + DATA_QUEUE_ENTRY_HEADER_SIZE, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    std::vector<UInt32> m_storage;
+    IODataQueueMemory *m_memory;
+};
+
+/**
+ * @brief Notify rings as the client maps them, merged by commit time
+ */
+class TestRings {
+
+public:
+    TestRings(UInt32 count, UInt32 queueSize) {
+        for (UInt32 i = 0; i < count; ++i) {
+            m_queues.push_back(new TestQueue(queueSize));
+            m_rings.push_back(new EventRing(m_queues.back()->getMemory(), queueSize));
+        }
+    }
+
+    ~TestRings() {
+        for (UInt32 i = 0; i < m_queues.size(); ++i) {
+            delete m_rings[i];
+            delete m_queues[i];
+        }
+    }
+
+    EventRing *getRing(UInt32 index) {
+        return m_rings[index % m_rings.size()];
+    }
+
+    // Called when pick a ring from the one of the CPU, falling over to the next with room as EventDispatcher does.
+    UInt32 pickRing(UInt32 first, UInt32 size) {
+        for (UInt32 i = 0; i < m_rings.size(); ++i) {
+            UInt32 ring = (first + i) % m_rings.size();
+            if (m_rings[ring]->hasRoom(size)) {
+                return ring;
+            }
+        }
+        return first % m_rings.size();
+    }
+
+    // Called when take the oldest head among the rings, as KextManager does, -1 if all are empty.
+    int dequeueOldest(std::vector<UInt8> *data) {
+        int oldestQueue = -1;
+        UInt64 oldestUptime = 0;
+        for (UInt32 i = 0; i < m_queues.size(); ++i) {
+            IODataQueueEntry *entry = m_queues[i]->peek();
+            if (entry == nullptr) {
+                continue;
+            }
+            UInt64 uptime = getRecordUptime(entry->data, entry->size);
+            if (oldestQueue < 0 || uptime < oldestUptime) {
+                oldestQueue = (int)i;
+                oldestUptime = uptime;
+            }
+        }
+        if (oldestQueue >= 0) {
+            m_queues[oldestQueue]->dequeue(data);
+        }
+        return oldestQueue;
+    }
+
+private:
+    std::vector<TestQueue *> m_queues;
+    std::vector<EventRing *> m_rings;
+};
+
+// Called when commit a record built in place, stamped the way EventDispatcher does.
+static inline bool commitRecord(EventRing *ring, EventRing::Reservation *reservation, void *record, UInt32 size) {
+    UInt64 uptime = 0;
+    clock_get_uptime(&uptime);
+    absolutetime_to_nanoseconds(uptime, &uptime);
+    stampEventRecord(record, uptime, reservation->sequence);
+    return ring->commit(reservation, size);
+}
+
+#endif /* TestQueue_hpp */
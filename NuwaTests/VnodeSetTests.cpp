@@ -0,0 +1,148 @@
+//
+//  VnodeSetTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "VnodeSet.hpp"
+#include "TestHarness.hpp"
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Values of the process list, as NuwaKextProcType tags them.
+static const UInt8 kTestAllowValue = 1;
+static const UInt8 kTestDenyValue = 2;
+
+static UInt64 makeVnodeID(std::mt19937_64 &random) {
+    // A few volumes, the file IDs in the low bits.
+    return ((random() % 8 + 1) << 32) | (random() & 0xFFFFFFFF);
+}
+
+static void testLookups() {
+    std::mt19937_64 random(7);
+    for (UInt32 count : { 0u, 1u, 2u, 7u, 100u, 1023u, 1024u, 50000u }) {
+        std::unordered_map<UInt64, UInt8> expected;
+        std::vector<UInt64> allowed;
+        std::vector<UInt64> denied;
+        while (expected.size() < count) {
+            UInt64 key = makeVnodeID(random);
+            if (expected.count(key) != 0) {
+                continue;
+            }
+            UInt8 value = expected.size() % 3 == 0 ? kTestDenyValue : kTestAllowValue;
+            expected[key] = value;
+            (value == kTestAllowValue ? allowed : denied).push_back(key);
+        }
+
+        VnodeSet set(count);
+        EXPECT(set.addItems(allowed.data(), (UInt32)allowed.size(), kTestAllowValue) == allowed.size())
+        EXPECT(set.addItems(denied.data(), (UInt32)denied.size(), kTestDenyValue) == denied.size())
+        EXPECT(set.finish())
+        EXPECT(set.getCount() == count)
+        EXPECT(set.countItems(kTestDenyValue) == denied.size())
+
+        UInt32 mismatches = 0;
+        for (const auto &item : expected) {
+            mismatches += set.getValue(item.first) != item.second;
+        }
+        for (UInt32 i = 0; i < 10000; ++i) {
+            UInt64 key = makeVnodeID(random);
+            if (expected.count(key) == 0) {
+                mismatches += set.getValue(key) != 0;
+            }
+        }
+        EXPECT(mismatches == 0)
+    }
+}
+
+// Allowed and denied processes share one list, a key in both is found as allowed.
+static void testSmallestValueWins() {
+    UInt64 keys[] = { 10, 20, 30, 0 };
+    VnodeSet set(8);
+    EXPECT(set.addItems(keys, 4, kTestDenyValue) == 3)
+    EXPECT(set.addItems(keys + 1, 1, kTestAllowValue) == 1)
+    EXPECT(set.finish())
+    EXPECT(set.getValue(10) == kTestDenyValue)
+    EXPECT(set.getValue(20) == kTestAllowValue)
+    EXPECT(set.getValue(0) == 0)
+    EXPECT(set.getValue(25) == 0)
+}
+
+// Lists are rebuilt from the previous one when a single type is pushed or changed.
+static void testCarryOver() {
+    UInt64 allowed[] = { 1, 2, 3, 4 };
+    UInt64 denied[] = { 5, 6 };
+    VnodeSet old(6);
+    old.addItems(allowed, 4, kTestAllowValue);
+    old.addItems(denied, 2, kTestDenyValue);
+    old.finish();
+
+    // The denied processes are replaced, the allowed ones carried over.
+    UInt64 newDenied[] = { 7 };
+    VnodeSet next(8);
+    EXPECT(next.addItems(&old, kTestDenyValue) == 4)
+    next.addItems(newDenied, 1, kTestDenyValue);
+    EXPECT(next.finish())
+    EXPECT(next.getValue(3) == kTestAllowValue)
+    EXPECT(next.getValue(5) == 0)
+    EXPECT(next.getValue(7) == kTestDenyValue)
+
+    // A delta keeps the allowed processes but the removed ones.
+    UInt64 removedKeys[] = { 2, 4 };
+    VnodeSet removed(2);
+    removed.addItems(removedKeys, 2, 1);
+    removed.finish();
+    VnodeSet copy(8);
+    EXPECT(copy.copyItems(&next, kTestAllowValue, &removed) == 2)
+    EXPECT(copy.finish())
+    EXPECT(copy.getValue(1) == kTestAllowValue)
+    EXPECT(copy.getValue(2) == 0)
+    EXPECT(copy.getValue(7) == 0)
+}
+
+// The filter never turns a member away, and lets few others through.
+static void testFilter() {
+    std::mt19937_64 random(13);
+    for (UInt32 count : { 100u, 1024u, 10000u, 50000u }) {
+        std::vector<UInt64> keys;
+        for (UInt32 i = 0; i < count; ++i) {
+            keys.push_back(makeVnodeID(random));
+        }
+        std::unordered_map<UInt64, UInt8> members;
+        for (UInt64 key : keys) {
+            members[key] = kTestAllowValue;
+        }
+
+        VnodeSet set(count);
+        set.addItems(keys.data(), count, kTestAllowValue);
+        set.finish();
+
+        UInt32 missed = 0;
+        for (UInt64 key : keys) {
+            missed += !set.mayContain(key);
+        }
+        EXPECT(missed == 0)
+
+        UInt32 probes = 0;
+        UInt32 passed = 0;
+        while (probes < 200000) {
+            UInt64 key = makeVnodeID(random);
+            if (members.count(key) == 0) {
+                probes++;
+                passed += set.mayContain(key);
+            }
+        }
+        // 16 bits per item hold the false positives around 1%.
+        EXPECT(passed < probes / 50)
+    }
+}
+
+int main() {
+    RUN_TEST(testLookups)
+    RUN_TEST(testSmallestValueWins)
+    RUN_TEST(testCarryOver)
+    RUN_TEST(testFilter)
+    return g_testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+//
+//  WakeupBatchTests.cpp
+//  NuwaTests
+//
+//  Created by ConradSun on 2026/10/17.
+//
+
+#include "TestHarness.hpp"
+#include "WakeupBatch.hpp"
+#include <thread>
+#include <vector>
+
+// Not batching, the client is woken up by every event finding the queue empty, as IOSharedDataQueue does.
+static void testImmediate() {
+    WakeupBatch batch;
+    EXPECT(batch.addEvent(true) == kWakeupNow)
+    EXPECT(batch.addEvent(false) == kWakeupNone)
+
+    // Either value turns batching off.
+    batch.setCoalescing(32, 0);
+    EXPECT(batch.addEvent(true) == kWakeupNow)
+    batch.setCoalescing(1, 1000);
+    EXPECT(batch.addEvent(true) == kWakeupNow)
+    EXPECT(batch.takeBatch() == 0)
+}
+
+// The first event arms the timer and the last one of the batch wakes the client up, the timer finds nothing then.
+static void testBatchByCount() {
+    WakeupBatch batch;
+    batch.setCoalescing(4, 1000);
+    EXPECT(batch.getDelay() == 1000)
+
+    EXPECT(batch.addEvent(true) == kWakeupArmTimer)
+    EXPECT(batch.addEvent(false) == kWakeupNone)
+    EXPECT(batch.addEvent(false) == kWakeupNone)
+    EXPECT(batch.addEvent(false) == kWakeupBatchFull)
+    EXPECT(batch.takeBatch() == 4)
+    EXPECT(batch.takeBatch() == 0)
+
+    // The client is awake and drains what follows, until an event finds the queue empty again.
+    EXPECT(batch.addEvent(false) == kWakeupNone)
+    EXPECT(batch.addEvent(true) == kWakeupArmTimer)
+    EXPECT(batch.takeBatch() == 1)
+}
+
+// A batch not filled is taken by the timer, its latency is bounded by the delay.
+static void testBatchByDelay() {
+    WakeupBatch batch;
+    batch.setCoalescing(32, 1000);
+
+    EXPECT(batch.addEvent(true) == kWakeupArmTimer)
+    EXPECT(batch.addEvent(false) == kWakeupNone)
+    EXPECT(batch.takeBatch() == 2)
+    EXPECT(batch.addEvent(true) == kWakeupArmTimer)
+
+    // Turned off meanwhile, the events batched before are taken at once.
+    batch.setCoalescing(1, 0);
+    EXPECT(batch.takeBatch() == 1)
+    EXPECT(batch.addEvent(true) == kWakeupNow)
+}
+
+// Producers and the timer racing for batches take every event once, with far fewer wakeups than events.
+static void testConcurrentBatches() {
+    const UInt32 threadCount = 4;
+    const UInt32 eventsPerThread = 100000;
+    WakeupBatch batch;
+    batch.setCoalescing(32, 1000);
+    UInt64 taken = 0;
+    UInt64 wakeups = 0;
+    UInt64 timers = 0;
+    bool isDone = false;
+
+    std::thread timer([&batch, &taken, &wakeups, &isDone] {
+        while (!__atomic_load_n(&isDone, __ATOMIC_ACQUIRE)) {
+            UInt32 events = batch.takeBatch();
+            __atomic_fetch_add(&taken, events, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&wakeups, events != 0, __ATOMIC_RELAXED);
+            IOSleep(1);
+        }
+    });
+    std::vector<std::thread> producers;
+    for (UInt32 i = 0; i < threadCount; ++i) {
+        producers.emplace_back([&batch, &taken, &wakeups, &timers] {
+            for (UInt32 n = 0; n < eventsPerThread; ++n) {
+                // Every event may find the queue empty, so none is left to an awake client.
+                UInt32 actions = batch.addEvent(true);
+                __atomic_fetch_add(&timers, (actions & kWakeupArmTimer) != 0, __ATOMIC_RELAXED);
+                if ((actions & kWakeupBatchFull) != 0) {
+                    UInt32 events = batch.takeBatch();
+                    __atomic_fetch_add(&taken, events, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&wakeups, events != 0, __ATOMIC_RELAXED);
+                }
+            }
+        });
+    }
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+    __atomic_store_n(&isDone, true, __ATOMIC_RELEASE);
+    timer.join();
+
+    UInt32 left = batch.takeBatch();
+    taken += left;
+    wakeups += left != 0;
+    EXPECT(taken == threadCount * eventsPerThread)
+    // Each batch is armed by its first event and woken up once.
+    EXPECT(wakeups == timers)
+    EXPECT(wakeups < taken / 2)
+}
+
+int main() {
+    RUN_TEST(testImmediate)
+    RUN_TEST(testBatchByCount)
+    RUN_TEST(testBatchByDelay)
+    RUN_TEST(testConcurrentBatches)
+    return g_testFailures == 0 ? 0 : 1;
+}
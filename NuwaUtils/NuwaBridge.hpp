@@ -9,6 +9,7 @@
 #define NuwaBridge_h
 
 #include "KextCommon.hpp"
+#include "EventRecord.hpp"
 #include <libproc.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
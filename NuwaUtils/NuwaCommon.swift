@@ -48,6 +48,7 @@ let PropRemoteAddr  = "Remote"
 let PropQueryStatus = "Status"
 let PropDomainName  = "Query"
 let PropReplyResult = "Reply"
+let PropRepeatCount = "Repeats"
 let MaxIPLength     = 41
 let MaxAuthWaitTime = 30000 //   ms
 let MaxSignWaitTime = 3000  //   ms